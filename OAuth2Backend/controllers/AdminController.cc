@@ -1,4 +1,8 @@
 #include "AdminController.h"
+#include "plugins/OAuth2Metrics.h"
+#include "services/LoadMonitor.h"
+#include "services/SlowOpLog.h"
+#include <algorithm>
 
 void AdminController::dashboard(
     const HttpRequestPtr &req,
@@ -10,3 +14,62 @@ void AdminController::dashboard(
     auto resp = HttpResponse::newHttpJsonResponse(json);
     callback(resp);
 }
+
+void AdminController::latency(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback)
+{
+    callback(
+        HttpResponse::newHttpJsonResponse(oauth2::Metrics::latencyReport()));
+}
+
+void AdminController::resetLatency(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback)
+{
+    oauth2::Metrics::resetLatency();
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setStatusCode(k204NoContent);
+    callback(resp);
+}
+
+void AdminController::slowOps(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback)
+{
+    size_t limit = 50;
+    auto param = req->getParameter("limit");
+    if (!param.empty())
+    {
+        try
+        {
+            limit = static_cast<size_t>(std::clamp(std::stoi(param), 1, 1000));
+        }
+        catch (const std::exception &)
+        {
+            callback(HttpResponse::newHttpResponse(k400BadRequest,
+                                                   CT_TEXT_PLAIN));
+            return;
+        }
+    }
+    callback(HttpResponse::newHttpJsonResponse(
+        oauth2::SlowOpLog::instance().toJson(limit)));
+}
+
+void AdminController::clearSlowOps(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback)
+{
+    oauth2::SlowOpLog::instance().clear();
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setStatusCode(k204NoContent);
+    callback(resp);
+}
+
+void AdminController::load(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback)
+{
+    callback(HttpResponse::newHttpJsonResponse(
+        oauth2::LoadMonitor::instance().toJson()));
+}
@@ -13,8 +13,46 @@ class AdminController : public drogon::HttpController<AdminController>
                   "/api/admin/dashboard",
                   Get,
                   "AuthorizationFilter");
+    // HDR latency percentiles; DELETE clears them
+    ADD_METHOD_TO(AdminController::latency,
+                  "/api/admin/debug/latency",
+                  Get,
+                  "AuthorizationFilter");
+    ADD_METHOD_TO(AdminController::resetLatency,
+                  "/api/admin/debug/latency",
+                  Delete,
+                  "AuthorizationFilter");
+    // Most recent slow operations (?limit=N); DELETE clears them
+    ADD_METHOD_TO(AdminController::slowOps,
+                  "/api/admin/debug/slow-ops",
+                  Get,
+                  "AuthorizationFilter");
+    ADD_METHOD_TO(AdminController::clearSlowOps,
+                  "/api/admin/debug/slow-ops",
+                  Delete,
+                  "AuthorizationFilter");
+    // Event-loop lag, storage in-flight count and shed requests
+    ADD_METHOD_TO(AdminController::load,
+                  "/api/admin/debug/load",
+                  Get,
+                  "AuthorizationFilter");
     METHOD_LIST_END
 
     void dashboard(const HttpRequestPtr &req,
                    std::function<void(const HttpResponsePtr &)> &&callback);
+
+    void latency(const HttpRequestPtr &req,
+                 std::function<void(const HttpResponsePtr &)> &&callback);
+
+    void resetLatency(const HttpRequestPtr &req,
+                      std::function<void(const HttpResponsePtr &)> &&callback);
+
+    void slowOps(const HttpRequestPtr &req,
+                 std::function<void(const HttpResponsePtr &)> &&callback);
+
+    void clearSlowOps(const HttpRequestPtr &req,
+                      std::function<void(const HttpResponsePtr &)> &&callback);
+
+    void load(const HttpRequestPtr &req,
+              std::function<void(const HttpResponsePtr &)> &&callback);
 };
@@ -1,4 +1,5 @@
 #include "GoogleController.h"
+#include "../services/Tracer.h"
 #include <drogon/HttpClient.h>
 
 // TODO: REPLACE WITH YOUR REAL GOOGLE CREDENTIALS
@@ -57,10 +58,18 @@ void GoogleController::login(
         std::make_shared<std::function<void(const HttpResponsePtr &)>>(
             std::move(callback));
 
+    auto trace = oauth2::requestTrace(req);
+    oauth2::Span span("google.token", oauth2::SpanKind::kClient, trace);
+    span.setStaticAttribute("http.url", "https://oauth2.googleapis.com/token");
+    if (span.context().valid())
+        request->addHeader("traceparent", span.context().traceparent());
+
     client->sendRequest(
         request,
-        [callbackPtr, client](ReqResult result,
-                              const HttpResponsePtr &response) {
+        [callbackPtr, client, trace, span](ReqResult result,
+                                           const HttpResponsePtr &response) {
+            span.end(result == ReqResult::Ok && response &&
+                     response->getStatusCode() == k200OK);
             if (result != ReqResult::Ok || !response ||
                 response->getStatusCode() != k200OK)
             {
@@ -90,10 +99,18 @@ void GoogleController::login(
             auto req2 = HttpRequest::newHttpRequest();
             req2->setPath("/oauth2/v3/userinfo");
             req2->addHeader("Authorization", "Bearer " + accessToken);
+            oauth2::Span span2(
+                "google.userinfo", oauth2::SpanKind::kClient, trace);
+            span2.setStaticAttribute(
+                "http.url", "https://www.googleapis.com/oauth2/v3/userinfo");
+            if (span2.context().valid())
+                req2->addHeader("traceparent", span2.context().traceparent());
 
             client2->sendRequest(
                 req2,
-                [callbackPtr](ReqResult res2, const HttpResponsePtr &resp2) {
+                [callbackPtr, span2](ReqResult res2,
+                                     const HttpResponsePtr &resp2) {
+                    span2.end(res2 == ReqResult::Ok && resp2);
                     if (res2 != ReqResult::Ok || !resp2)
                     {
                         auto errResp = HttpResponse::newHttpResponse();
@@ -1,5 +1,9 @@
 #include "OAuth2Controller.h"
 #include "../services/AuthService.h"
+#include "../services/AuthContext.h"
+#include "../services/AuditLogger.h"
+#include "../services/Deadline.h"
+#include "../services/Tracer.h"
 #include <drogon/drogon.h>
 #include "../plugins/OAuth2Metrics.h"
 #include <drogon/utils/Utilities.h>
@@ -8,10 +12,70 @@
 using namespace oauth2;
 using namespace services;
 
+namespace
+{
+
+// The password hashing pool is saturated (CredentialHasher); retryable
+HttpResponsePtr busyResponse()
+{
+    Json::Value json;
+    json["error"] = "temporarily_unavailable";
+    json["error_description"] = "Server is busy, retry later";
+    auto resp = HttpResponse::newHttpJsonResponse(json);
+    resp->setStatusCode(k503ServiceUnavailable);
+    resp->addHeader("Retry-After", "1");
+    return resp;
+}
+
+// Redirect back to the client (RFC 6749 4.1.2): @p key and state appended,
+// URL-encoded, to whatever query the registered redirect URI already has
+std::string clientRedirect(const std::string &redirectUri,
+                           const char *key,
+                           const std::string &value,
+                           const std::string &state)
+{
+    std::string location = redirectUri;
+    location += redirectUri.find('?') == std::string::npos ? '?' : '&';
+    location.append(key).append("=").append(
+        drogon::utils::urlEncodeComponent(value));
+    if (!state.empty())
+        location += "&state=" + drogon::utils::urlEncodeComponent(state);
+    return location;
+}
+
+// An authorization request that failed its preflight: 400 while the client
+// or redirect URI is unverified, else an error redirect back to the client
+// (RFC 6749 4.1.2.1)
+HttpResponsePtr rejectAuthorization(
+    const OAuth2Plugin::AuthorizePreflight &check,
+    const std::string &redirectUri,
+    const std::string &state)
+{
+    using Error = OAuth2Plugin::AuthorizePreflight::Error;
+    if (check.error == Error::kInvalidClient ||
+        check.error == Error::kInvalidRedirectUri)
+    {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(k400BadRequest);
+        resp->setBody(check.error == Error::kInvalidClient
+                          ? "Invalid client_id"
+                          : "Invalid redirect_uri");
+        return resp;
+    }
+    return HttpResponse::newRedirectionResponse(
+        clientRedirect(redirectUri, "error", check.errorCode(), state));
+}
+
+}  // namespace
+
 void OAuth2Controller::authorize(
     const HttpRequestPtr &req,
     std::function<void(const HttpResponsePtr &)> &&callback)
 {
+    // Storage spans of this flow attach to the request's server span, and
+    // its storage calls share the request's deadline
+    TraceScope trace(requestTrace(req));
+    DeadlineScope deadline(requestDeadline(req));
     auto params = req->getParameters();
     std::string responseType = params["response_type"];
     std::string clientId = params["client_id"];
@@ -28,72 +92,55 @@ void OAuth2Controller::authorize(
         return;
     }
 
-    // Validate Client (Async)
-    plugin->validateClient(
+    // One client lookup checks client, redirect URI, response type, scope
+    plugin->preflightAuthorize(
         clientId,
-        "",
-        [=, callback = std::move(callback)](bool validClient) mutable {
-            if (!validClient)
+        redirectUri,
+        responseType,
+        scope,
+        [=, callback = std::move(callback)](
+            const OAuth2Plugin::AuthorizePreflight &check) {
+            using Error = OAuth2Plugin::AuthorizePreflight::Error;
+            if (!check.ok())
             {
-                Metrics::incRequest("authorize", 400);
-                Metrics::incLoginFailure("invalid_client_id");
-
-                auto resp = HttpResponse::newHttpResponse();
-                resp->setStatusCode(k400BadRequest);
-                resp->setBody("Invalid client_id");
-                callback(resp);
+                if (check.error == Error::kInvalidClient)
+                {
+                    Metrics::incRequest("authorize", 400);
+                    Metrics::incLoginFailure("invalid_client_id");
+                }
+                callback(rejectAuthorization(check, redirectUri, state));
                 return;
             }
 
-            // Validate Redirect URI (Async)
-            plugin->validateRedirectUri(
-                clientId,
-                redirectUri,
-                [=, callback = std::move(callback)](bool validUri) mutable {
-                    if (!validUri)
-                    {
-                        auto resp = HttpResponse::newHttpResponse();
-                        resp->setStatusCode(k400BadRequest);
-                        resp->setBody("Invalid redirect_uri");
+            // Check Session
+            auto userId = req->session()->get<std::string>("userId");
+            if (!userId.empty())
+            {
+                // Generate Code (Async)
+                plugin->generateAuthorizationCode(
+                    clientId,
+                    userId,
+                    scope,
+                    [=, callback = std::move(callback)](std::string code) {
+                        auto location =
+                            clientRedirect(redirectUri, "code", code, state);
+                        auto resp =
+                            HttpResponse::newRedirectionResponse(location);
+                        Metrics::incRequest("authorize", 302);
                         callback(resp);
-                        return;
-                    }
-
-                    // Check Session
-                    auto userId = req->session()->get<std::string>("userId");
-                    if (!userId.empty())
-                    {
-                        // Generate Code (Async)
-                        plugin->generateAuthorizationCode(
-                            clientId,
-                            userId,
-                            scope,
-                            [=,
-                             callback = std::move(callback)](std::string code) {
-                                std::string location =
-                                    redirectUri + "?code=" + code;
-                                if (!state.empty())
-                                    location += "&state=" + state;
-                                auto resp =
-                                    HttpResponse::newRedirectionResponse(
-                                        location);
-                                Metrics::incRequest("authorize", 302);
-                                callback(resp);
-                            });
-                        return;
-                    }
+                    });
+                return;
+            }
 
-                    // Render Login Page
-                    HttpViewData data;
-                    data.insert("client_id", clientId);
-                    data.insert("redirect_uri", redirectUri);
-                    data.insert("scope", scope);
-                    data.insert("state", state);
-                    data.insert("response_type", responseType);
-                    auto resp =
-                        HttpResponse::newHttpViewResponse("login.csp", data);
-                    callback(resp);
-                });
+            // Render Login Page
+            HttpViewData data;
+            data.insert("client_id", clientId);
+            data.insert("redirect_uri", redirectUri);
+            data.insert("scope", scope);
+            data.insert("state", state);
+            data.insert("response_type", responseType);
+            auto resp = HttpResponse::newHttpViewResponse("login.csp", data);
+            callback(resp);
         });
 }
 
@@ -101,12 +148,56 @@ void OAuth2Controller::login(
     const HttpRequestPtr &req,
     std::function<void(const HttpResponsePtr &)> &&callback)
 {
+    TraceScope trace(requestTrace(req));
+    DeadlineScope deadline(requestDeadline(req));
+    auto plugin = drogon::app().getPlugin<OAuth2Plugin>();
+    if (!plugin)
+    {
+        LOG_ERROR << "OAuth2Plugin not loaded during login";
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(k500InternalServerError);
+        resp->setBody("Internal Server Error: Plugin not loaded");
+        callback(resp);
+        return;
+    }
+
+    // The form's hidden fields are client input, like authorize()'s query:
+    // check them before a code is issued or the password is hashed
+    auto params = req->getParameters();
+    std::string redirectUri = params["redirect_uri"];
+    std::string state = params["state"];
+    plugin->preflightAuthorize(
+        params["client_id"],
+        redirectUri,
+        "code",
+        params["scope"],
+        [req, redirectUri, state, callback = std::move(callback)](
+            const OAuth2Plugin::AuthorizePreflight &check) mutable {
+            using Error = OAuth2Plugin::AuthorizePreflight::Error;
+            if (!check.ok())
+            {
+                if (check.error == Error::kInvalidClient)
+                    Metrics::incLoginFailure("invalid_client_id");
+                callback(rejectAuthorization(check, redirectUri, state));
+                return;
+            }
+            authenticate(req, std::move(callback));
+        });
+}
+
+void OAuth2Controller::authenticate(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback)
+{
+    // Runs in the preflight callback: re-enter the request's scopes
+    TraceScope trace(requestTrace(req));
+    DeadlineScope deadline(requestDeadline(req));
     // Handle form submission
     auto params = req->getParameters();
     std::string username = params["username"];
     std::string password = params["password"];
 
-    // Hidden fields from the form
+    // Hidden fields from the form, checked by login()
     std::string clientId = params["client_id"];
     std::string redirectUri = params["redirect_uri"];
     std::string scope = params["scope"];
@@ -115,29 +206,34 @@ void OAuth2Controller::login(
     AuthService::validateUser(
         username,
         password,
-        [=, callback = std::move(callback)](std::optional<int> userId) {
+        [=, callback = std::move(callback)](std::optional<int> userId,
+                                            bool busy) {
+            auto ip = req->peerAddr().toIp();
+            const char *reason = busy ? "busy" : "bad_credentials";
+            AuditLogger::instance().log("Login",
+                                        userId.has_value(),
+                                        username,
+                                        clientId,
+                                        ip,
+                                        userId ? "" : reason);
+            if (busy)
+            {
+                // Password not checked: the hashing pool is saturated
+                Metrics::incLoginFailure("busy");
+                callback(busyResponse());
+                return;
+            }
             if (userId)
             {
                 req->session()->insert("userId", std::to_string(*userId));
                 auto plugin = drogon::app().getPlugin<OAuth2Plugin>();
-                if (!plugin)
-                {
-                    LOG_ERROR << "OAuth2Plugin not loaded during login";
-                    auto resp = HttpResponse::newHttpResponse();
-                    resp->setStatusCode(k500InternalServerError);
-                    resp->setBody("Internal Server Error: Plugin not loaded");
-                    callback(resp);
-                    return;
-                }
-
                 plugin->generateAuthorizationCode(
                     clientId,
                     std::to_string(*userId),
                     scope,
                     [=, callback = std::move(callback)](std::string code) {
-                        std::string location = redirectUri + "?code=" + code;
-                        if (!state.empty())
-                            location += "&state=" + state;
+                        auto location =
+                            clientRedirect(redirectUri, "code", code, state);
                         if (req->getParameter("json") == "true")
                         {
                             Json::Value ret;
@@ -167,6 +263,8 @@ void OAuth2Controller::registerUser(
     const HttpRequestPtr &req,
     std::function<void(const HttpResponsePtr &)> &&callback)
 {
+    TraceScope trace(requestTrace(req));
+    DeadlineScope deadline(requestDeadline(req));
     auto params = req->getParameters();
     std::string username = params["username"];
     std::string password = params["password"];
@@ -189,6 +287,10 @@ void OAuth2Controller::registerUser(
                 resp->setBody("User Registered");
                 callback(resp);
             }
+            else if (error == AuthService::kBusyError)
+            {
+                callback(busyResponse());
+            }
             else
             {
                 auto resp = HttpResponse::newHttpResponse();
@@ -203,25 +305,70 @@ void OAuth2Controller::token(
     const HttpRequestPtr &req,
     std::function<void(const HttpResponsePtr &)> &&callback)
 {
+    TraceScope trace(requestTrace(req));
+    DeadlineScope deadline(requestDeadline(req));
     auto plugin = drogon::app().getPlugin<OAuth2Plugin>();
     // Expect raw params or json? Standard says form-urlencoded.
     // Drogon parses parameters automatically.
+    std::string clientId = req->getParameter("client_id");
+    std::string clientSecret = req->getParameter("client_secret");
+    // Null unless server timing is enabled
+    auto timing = plugin->startRequestTiming(req, "token");
+
+    // Confidential clients authenticate with client_secret (RFC 6749
+    // 2.3.1); public clients send none and rely on the code binding
+    if (!clientSecret.empty())
+    {
+        plugin->validateClient(
+            clientId,
+            clientSecret,
+            [req, callback = std::move(callback), timing](
+                bool valid) mutable {
+                if (!valid)
+                {
+                    Metrics::incRequest("token", 401);
+                    Json::Value json;
+                    json["error"] = "invalid_client";
+                    auto resp = HttpResponse::newHttpJsonResponse(json);
+                    resp->setStatusCode(k401Unauthorized);
+                    if (timing)
+                        timing->finish(resp);
+                    callback(resp);
+                    return;
+                }
+                grantToken(req, std::move(callback), timing);
+            });
+        return;
+    }
+    grantToken(req, std::move(callback), timing);
+}
+
+void OAuth2Controller::grantToken(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback,
+    const oauth2::RequestTimingPtr &timing)
+{
+    // May run in a storage callback: re-enter the request's scopes
+    TraceScope trace(requestTrace(req));
+    DeadlineScope deadline(requestDeadline(req));
+    auto plugin = drogon::app().getPlugin<OAuth2Plugin>();
     std::string grantType = req->getParameter("grant_type");
     std::string code = req->getParameter("code");
-    std::string redirectUri = req->getParameter("redirect_uri");
     std::string clientId = req->getParameter("client_id");
-    std::string clientSecret = req->getParameter("client_secret");
 
     if (grantType == "authorization_code")
     {
         plugin->exchangeCodeForToken(
             code,
             clientId,
-            [callback = std::move(callback)](const Json::Value &result) {
+            [callback = std::move(callback),
+             timing](const Json::Value &result) {
                 if (result.isMember("error"))
                 {
                     auto resp = HttpResponse::newHttpJsonResponse(result);
                     resp->setStatusCode(k400BadRequest);
+                    if (timing)
+                        timing->finish(resp);
                     callback(resp);
                     return;
                 }
@@ -229,8 +376,11 @@ void OAuth2Controller::token(
                 auto resp = HttpResponse::newHttpJsonResponse(result);
                 Metrics::incRequest("token", 200);
                 Metrics::updateActiveTokens(1);
+                if (timing)
+                    timing->finish(resp);
                 callback(resp);
-            });
+            },
+            timing);
     }
     else if (grantType == "refresh_token")
     {
@@ -238,19 +388,25 @@ void OAuth2Controller::token(
         plugin->refreshAccessToken(
             refreshToken,
             clientId,
-            [callback = std::move(callback)](const Json::Value &result) {
+            [callback = std::move(callback),
+             timing](const Json::Value &result) {
                 if (result.isMember("error"))
                 {
                     auto resp = HttpResponse::newHttpJsonResponse(result);
                     resp->setStatusCode(k400BadRequest);
+                    if (timing)
+                        timing->finish(resp);
                     callback(resp);
                     return;
                 }
 
                 auto resp = HttpResponse::newHttpJsonResponse(result);
                 Metrics::incRequest("token", 200);
+                if (timing)
+                    timing->finish(resp);
                 callback(resp);
-            });
+            },
+            timing);
     }
     else
     {
@@ -277,11 +433,10 @@ void OAuth2Controller::userInfo(
     // This endpoint is protected by OAuth2Middleware.
     // If we are here, we have a valid token.
 
-    // Attributes set by OAuth2Middleware
+    // Context set by OAuth2Middleware
     std::string userId;
-    auto attrs = req->getAttributes();
-    if (attrs->find("userId"))
-        userId = attrs->get<std::string>("userId");
+    if (auto ctx = oauth2::getAuthContext(req))
+        userId = ctx->accessToken->userId;
 
     Json::Value json;
     json["sub"] = userId;
@@ -57,4 +57,16 @@ class OAuth2Controller : public drogon::HttpController<OAuth2Controller>
 
     void registerUser(const HttpRequestPtr &req,
                       std::function<void(const HttpResponsePtr &)> &&callback);
+
+  private:
+    // Password check and code issue, once login() checked the client
+    static void authenticate(
+        const HttpRequestPtr &req,
+        std::function<void(const HttpResponsePtr &)> &&callback);
+
+    // Token issue for an authenticated (or public) client
+    static void grantToken(
+        const HttpRequestPtr &req,
+        std::function<void(const HttpResponsePtr &)> &&callback,
+        const oauth2::RequestTimingPtr &timing);
 };
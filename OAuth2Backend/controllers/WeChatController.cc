@@ -1,4 +1,5 @@
 #include "WeChatController.h"
+#include "../services/Tracer.h"
 #include <drogon/HttpClient.h>
 
 // TODO: REPLACE WITH YOUR REAL CREDENTIALS
@@ -54,10 +55,20 @@ void WeChatController::login(
         std::make_shared<std::function<void(const HttpResponsePtr &)>>(
             std::move(callback));
 
+    // The query string carries the app secret; only the path is recorded
+    auto trace = oauth2::requestTrace(req);
+    oauth2::Span span("wechat.access_token", oauth2::SpanKind::kClient, trace);
+    span.setStaticAttribute(
+        "http.url", "https://api.weixin.qq.com/sns/oauth2/access_token");
+    if (span.context().valid())
+        request->addHeader("traceparent", span.context().traceparent());
+
     client->sendRequest(
         request,
-        [callbackPtr, client](ReqResult result,
-                              const HttpResponsePtr &response) {
+        [callbackPtr, client, trace, span](ReqResult result,
+                                           const HttpResponsePtr &response) {
+            span.end(result == ReqResult::Ok && response &&
+                     response->getStatusCode() == k200OK);
             if (result != ReqResult::Ok || !response ||
                 response->getStatusCode() != k200OK)
             {
@@ -89,10 +100,18 @@ void WeChatController::login(
             auto req2 = HttpRequest::newHttpRequest();
             req2->setPath("/sns/userinfo?access_token=" + accessToken +
                           "&openid=" + openid);
+            oauth2::Span span2(
+                "wechat.userinfo", oauth2::SpanKind::kClient, trace);
+            span2.setStaticAttribute("http.url",
+                                     "https://api.weixin.qq.com/sns/userinfo");
+            if (span2.context().valid())
+                req2->addHeader("traceparent", span2.context().traceparent());
 
             client2->sendRequest(
                 req2,
-                [callbackPtr](ReqResult res2, const HttpResponsePtr &resp2) {
+                [callbackPtr, span2](ReqResult res2,
+                                     const HttpResponsePtr &resp2) {
+                    span2.end(res2 == ReqResult::Ok && resp2);
                     if (res2 != ReqResult::Ok || !resp2)
                     {
                         auto errResp = HttpResponse::newHttpResponse();
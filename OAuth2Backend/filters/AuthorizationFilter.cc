@@ -1,5 +1,9 @@
 #include "AuthorizationFilter.h"
 #include "plugins/OAuth2Plugin.h"
+#include "AuthContext.h"
+#include "Deadline.h"
+#include "SlowOpLog.h"
+#include "Tracer.h"
 #include <drogon/drogon.h>
 
 using namespace drogon;
@@ -22,7 +26,10 @@ void AuthorizationFilter::loadConfig()
             RbacRule rule;
             rule.pathPattern = std::regex(pattern);
 
-            auto rolesJson = *it;
+            // Either ["role", ...] or
+            // {"roles": ["role", ...], "permissions": ["perm", ...]}
+            auto ruleJson = *it;
+            auto rolesJson = ruleJson.isObject() ? ruleJson["roles"] : ruleJson;
             if (rolesJson.isArray())
             {
                 for (const auto &role : rolesJson)
@@ -30,9 +37,17 @@ void AuthorizationFilter::loadConfig()
                     rule.allowedRoles.push_back(role.asString());
                 }
             }
+            if (ruleJson.isObject() && ruleJson["permissions"].isArray())
+            {
+                for (const auto &perm : ruleJson["permissions"])
+                {
+                    rule.requiredPermissions.push_back(perm.asString());
+                }
+            }
             rules_.push_back(rule);
             LOG_INFO << "RBAC Rule Loaded: " << pattern << " -> "
-                     << rule.allowedRoles.size() << " roles";
+                     << rule.allowedRoles.size() << " roles, "
+                     << rule.requiredPermissions.size() << " permissions";
         }
     }
     initialized_ = true;
@@ -44,29 +59,6 @@ void AuthorizationFilter::doFilter(const HttpRequestPtr &req,
 {
     loadConfig();
 
-    // 1. Extract Token
-    std::string token;
-    auto authHeader = req->getHeader("Authorization");
-    if (!authHeader.empty() && authHeader.find("Bearer ") == 0)
-    {
-        token = authHeader.substr(7);
-    }
-    else
-    {
-        token = req->getParameter("access_token");
-    }
-
-    if (token.empty())
-    {
-        Json::Value error;
-        error["error"] = "unauthorized";
-        auto resp = HttpResponse::newHttpJsonResponse(error);
-        resp->setStatusCode(k401Unauthorized);
-        fcb(resp);  // Return response -> Use fcb
-        return;
-    }
-
-    // 2. Validate Token
     auto plugin = app().getPlugin<OAuth2Plugin>();
     if (!plugin)
     {
@@ -82,28 +74,50 @@ void AuthorizationFilter::doFilter(const HttpRequestPtr &req,
     // FilterChainCallback (Arg 3) = Continue (Pass)
     auto denyCbPtr = std::make_shared<FilterCallback>(std::move(fcb));
     auto nextCbPtr = std::make_shared<FilterChainCallback>(std::move(fccb));
-
-    plugin->validateAccessToken(
-        token,
-        [this, req, denyCbPtr, nextCbPtr, plugin](
-            std::shared_ptr<OAuth2Plugin::AccessToken> at) mutable {
-            if (!at)
+    static const auto slowSite =
+        oauth2::SlowOpLog::instance().site("AuthorizationFilter", "filter");
+    oauth2::SlowOpTimer slow(slowSite, req);
+    oauth2::Span span("AuthorizationFilter",
+                      oauth2::SpanKind::kInternal,
+                      oauth2::requestTrace(req));
+    oauth2::TraceScope scope(span.context());
+    oauth2::DeadlineScope deadline(oauth2::requestDeadline(req));
+
+    // 1. Extract + Validate Token (reuses OAuth2Middleware's result if it
+    // already ran on this request)
+    oauth2::resolveAuthContext(
+        req,
+        true,  // Bearer header or access_token parameter
+        [this, req, denyCbPtr, nextCbPtr, plugin, span, slow](
+            oauth2::AuthContextPtr ctx, oauth2::AuthError err) {
+            if (!ctx)
             {
+                span.end(false);
+                slow.stop();
                 Json::Value error;
-                error["error"] = "invalid_token";
+                error["error"] = err == oauth2::AuthError::kMissingToken
+                                     ? "unauthorized"
+                                     : "invalid_token";
                 auto resp = HttpResponse::newHttpJsonResponse(error);
                 resp->setStatusCode(k401Unauthorized);
                 (*denyCbPtr)(resp);
                 return;
             }
 
-            // 3. Get User Roles
-            plugin->getUserRoles(
-                at->userId,
-                [this, req, denyCbPtr, nextCbPtr](
-                    std::vector<std::string> roles) mutable {
-                    // 4. Check Access
-                    if (checkAccess(roles, req->path()))
+            // 2. Get User Roles (embedded snapshot, or live lookup)
+            oauth2::TraceScope resumed(span.context());
+            oauth2::resolveRoles(
+                ctx,
+                *plugin,
+                [this, req, denyCbPtr, nextCbPtr, plugin, span, slow](
+                    const std::vector<std::string> &roles) {
+                    // 3. Check Access
+                    auto allowed = checkAccess(roles,
+                                               req->path(),
+                                               *plugin->getRbacCache());
+                    span.end(allowed);
+                    slow.stop();
+                    if (allowed)
                     {
                         (*nextCbPtr)();  // ALLOW -> Continue
                     }
@@ -121,7 +135,8 @@ void AuthorizationFilter::doFilter(const HttpRequestPtr &req,
 }
 
 bool AuthorizationFilter::checkAccess(const std::vector<std::string> &userRoles,
-                                      const std::string &path)
+                                      const std::string &path,
+                                      const oauth2::RbacCache &rbac)
 {
     // If no rules match, DENY by default if config exists?
     // Or ALLOW by default?
@@ -131,21 +146,44 @@ bool AuthorizationFilter::checkAccess(const std::vector<std::string> &userRoles,
     // But if we rely on regex, we might match multiple.
 
     bool matchedAnyRule = false;
+    std::optional<oauth2::RbacCache::PermissionSet> userPermissions;
 
     for (const auto &rule : rules_)
     {
         if (std::regex_match(path, rule.pathPattern))
         {
             matchedAnyRule = true;
-            // Check if user has ANY of the allowed roles
+
+            // Check if user has ANY of the allowed roles (a permission-only
+            // rule leaves "roles" empty; a plain [] still denies everyone)
+            bool roleOk = rule.allowedRoles.empty() &&
+                          !rule.requiredPermissions.empty();
             for (const auto &allowed : rule.allowedRoles)
             {
                 for (const auto &userRole : userRoles)
                 {
                     if (userRole == allowed)
-                        return true;
+                        roleOk = true;
+                }
+            }
+            if (!roleOk)
+                continue;
+
+            // Check if user has ALL of the required permissions
+            if (!rule.requiredPermissions.empty() && !userPermissions)
+                userPermissions = rbac.permissionsOf(userRoles);
+            bool permOk = true;
+            for (const auto &perm : rule.requiredPermissions)
+            {
+                auto bit = rbac.permissionBit(perm);
+                if (!bit || !userPermissions->test(*bit))
+                {
+                    permOk = false;
+                    break;
                 }
             }
+            if (permOk)
+                return true;
         }
     }
 
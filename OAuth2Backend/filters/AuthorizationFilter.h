@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <regex>
+#include "RbacCache.h"
 
 using namespace drogon;
 
@@ -17,11 +18,12 @@ class AuthorizationFilter : public HttpFilter<AuthorizationFilter>
                   FilterChainCallback &&fccb) override;
 
   private:
-    // Path regex -> Allowed Roles
+    // Path regex -> Allowed Roles (any of) + Required Permissions (all of)
     struct RbacRule
     {
         std::regex pathPattern;
         std::vector<std::string> allowedRoles;
+        std::vector<std::string> requiredPermissions;
     };
 
     std::vector<RbacRule> rules_;
@@ -29,5 +31,6 @@ class AuthorizationFilter : public HttpFilter<AuthorizationFilter>
 
     void loadConfig();
     bool checkAccess(const std::vector<std::string> &userRoles,
-                     const std::string &path);
+                     const std::string &path,
+                     const oauth2::RbacCache &rbac);
 };
@@ -1,4 +1,8 @@
 #include "OAuth2Middleware.h"
+#include "AuthContext.h"
+#include "Deadline.h"
+#include "SlowOpLog.h"
+#include "Tracer.h"
 #include <drogon/drogon.h>
 
 void OAuth2Middleware::doFilter(const HttpRequestPtr &req,
@@ -20,37 +24,46 @@ void OAuth2Middleware::doFilter(const HttpRequestPtr &req,
         return;
     }
 
-    auto authHeader = req->getHeader("Authorization");
-    if (authHeader.empty() || authHeader.substr(0, 7) != "Bearer ")
-    {
-        auto resp = HttpResponse::newHttpResponse();
-        resp->setStatusCode(k401Unauthorized);
-        resp->setBody("Missing or invalid Authorization header");
-        fcb(resp);
-        return;
-    }
-
-    std::string token = authHeader.substr(7);
+    static const auto slowSite =
+        oauth2::SlowOpLog::instance().site("OAuth2Middleware", "filter");
+    oauth2::SlowOpTimer slow(slowSite, req);
+    oauth2::Span span("OAuth2Middleware",
+                      oauth2::SpanKind::kInternal,
+                      oauth2::requestTrace(req));
+    oauth2::TraceScope scope(span.context());
+    oauth2::DeadlineScope deadline(oauth2::requestDeadline(req));
 
-    // Async Token Validation
-    plugin->validateAccessToken(
-        token,
-        [req, fcb = std::move(fcb), fccb = std::move(fccb)](
-            std::shared_ptr<OAuth2Plugin::AccessToken> tokenInfo) {
-            if (!tokenInfo)
+    // Validate once; AuthorizationFilter and handlers reuse the context
+    oauth2::resolveAuthContext(
+        req,
+        false,  // Bearer header only
+        [fcb = std::move(fcb), fccb = std::move(fccb), span, slow](
+            oauth2::AuthContextPtr ctx, oauth2::AuthError err) {
+            if (err == oauth2::AuthError::kMissingToken)
             {
+                span.end(false);
+                slow.stop();
                 auto resp = HttpResponse::newHttpResponse();
                 resp->setStatusCode(k401Unauthorized);
+                resp->setBody("Missing or invalid Authorization header");
+                fcb(resp);
+                return;
+            }
+            if (!ctx)
+            {
+                span.end(false);
+                slow.stop();
+                auto resp = HttpResponse::newHttpResponse();
+                resp->setStatusCode(err == oauth2::AuthError::kServerError
+                                        ? k500InternalServerError
+                                        : k401Unauthorized);
                 resp->setBody("Invalid or expired token");
                 fcb(resp);
                 return;
             }
 
-            // Success
-            (*req->getAttributes())["userId"] = tokenInfo->userId;
-            (*req->getAttributes())["scope"] = tokenInfo->scope;
-            (*req->getAttributes())["clientId"] = tokenInfo->clientId;
-
+            span.end();
+            slow.stop();
             fccb();
         });
 }
@@ -1,4 +1,6 @@
 #include "RateLimiterFilter.h"
+#include "SlowOpLog.h"
+#include "Tracer.h"
 #include <drogon/drogon.h>
 #include <drogon/nosql/RedisClient.h>
 
@@ -8,6 +10,10 @@ void RateLimiterFilter::doFilter(const HttpRequestPtr &req,
                                  FilterCallback &&fcb,
                                  FilterChainCallback &&fcc)
 {
+    static const auto slowSite =
+        oauth2::SlowOpLog::instance().site("RateLimiterFilter", "filter");
+    oauth2::SlowOpTimer slow(slowSite, req);
+
     // 1. Get Client IP
     std::string clientIp = req->getHeader("X-Forwarded-For");
     if (clientIp.empty())
@@ -51,11 +57,18 @@ void RateLimiterFilter::doFilter(const HttpRequestPtr &req,
 
         std::string key = "rate_limit:" + clientIp + ":" + path;
 
+        oauth2::Span span("rate_limit.incr",
+                          oauth2::SpanKind::kClient,
+                          oauth2::requestTrace(req));
+        span.setStaticAttribute("db.system", "redis");
+
         // Capture shared_ptr to redis to keep it alive? Client is usually long
         // lived. Use INCR
         redis->execCommandAsync(
-            [limit, fcb, fcc, clientIp, path, redis, key](
+            [limit, fcb, fcc, clientIp, path, redis, key, span, slow](
                 const drogon::nosql::RedisResult &r) {
+                span.end();
+                slow.stop(clientIp);
                 if (r.type() == drogon::nosql::RedisResultType::kInteger)
                 {
                     long long count = r.asInteger();
@@ -88,7 +101,9 @@ void RateLimiterFilter::doFilter(const HttpRequestPtr &req,
                 }
                 fcc();
             },
-            [fcc](const std::exception &e) {
+            [fcc, span, slow, clientIp](const std::exception &e) {
+                span.end(false);
+                slow.stop(clientIp);
                 LOG_ERROR << "Redis RateLimit Exception: " << e.what();
                 fcc();  // Fail open on Redis error
             },
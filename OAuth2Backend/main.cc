@@ -1,4 +1,8 @@
 #include <drogon/drogon.h>
+#include "services/Deadline.h"
+#include "services/LoadMonitor.h"
+#include "services/SlowOpLog.h"
+#include "services/Tracer.h"
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -120,6 +124,58 @@ void setupCors()
         });
 }
 
+// Span export is configured from custom_config "tracing" (off by default)
+void setupTracing()
+{
+    oauth2::Tracer::instance().start(
+        drogon::app().getCustomConfig()["tracing"]);
+    if (oauth2::Tracer::enabled())
+        oauth2::registerTracingAdvices();
+}
+
+// Slow-operation thresholds from custom_config "slow_ops" (off by default)
+void setupSlowOpLog()
+{
+    oauth2::SlowOpLog::instance().configure(
+        drogon::app().getCustomConfig()["slow_ops"]);
+    if (oauth2::SlowOpLog::enabled())
+        oauth2::registerSlowOpAdvices();
+}
+
+// Admission control from custom_config "load_shedding" (off by default)
+void setupLoadShedding()
+{
+    oauth2::LoadMonitor::instance().configure(
+        drogon::app().getCustomConfig()["load_shedding"]);
+    if (oauth2::LoadMonitor::enabled())
+        oauth2::registerLoadSheddingAdvices();
+}
+
+// Per-route storage deadlines from custom_config "request_deadlines"
+// (off by default)
+void setupRequestDeadlines()
+{
+    oauth2::RequestDeadlines::instance().configure(
+        drogon::app().getCustomConfig()["request_deadlines"]);
+    if (oauth2::RequestDeadlines::enabled())
+        oauth2::registerDeadlineAdvice();
+}
+
+// One libpq conninfo keyword/value pair: the value single-quoted, with \ and
+// ' backslash-escaped, so spaces or quotes in a password cannot split it
+std::string conninfoParam(const std::string &key, const std::string &value)
+{
+    std::string param = key + "='";
+    for (char c : value)
+    {
+        if (c == '\\' || c == '\'')
+            param.push_back('\\');
+        param.push_back(c);
+    }
+    param.push_back('\'');
+    return param;
+}
+
 // Helper to load config with Environment Variable overrides and write to a temp
 // file
 std::string loadConfigWithEnv(const std::string &configPath)
@@ -188,6 +244,41 @@ std::string loadConfigWithEnv(const std::string &configPath)
         }
     }
 
+    // Derive the LISTEN/NOTIFY connection for OAuth2Plugin from db_clients,
+    // so credentials (and their ENV overrides) live in one place
+    if (root["plugins"].isArray())
+    {
+        for (auto &plugin : root["plugins"])
+        {
+            if (plugin.get("name", "").asString() != "OAuth2Plugin")
+                continue;
+            auto &pg = plugin["config"]["postgres"];
+            if (!pg.get("listen_notify", false).asBool() ||
+                !pg.get("notify_conninfo", "").asString().empty())
+                break;
+            auto dbName = pg.get("db_client_name", "default").asString();
+            for (const auto &db : root["db_clients"])
+            {
+                if (db.get("name", "default").asString() != dbName)
+                    continue;
+                pg["notify_conninfo"] =
+                    conninfoParam("host",
+                                  db.get("host", "127.0.0.1").asString()) +
+                    " " +
+                    conninfoParam("port",
+                                  std::to_string(
+                                      db.get("port", 5432).asInt())) +
+                    " " +
+                    conninfoParam("dbname", db.get("dbname", "").asString()) +
+                    " " + conninfoParam("user", db.get("user", "").asString()) +
+                    " " +
+                    conninfoParam("password", db.get("passwd", "").asString());
+                break;
+            }
+            break;
+        }
+    }
+
     // Write runtime config
     std::string runtimePath = "config_env_runtime.json";
     std::ofstream runtimeFile(runtimePath);
@@ -222,6 +313,18 @@ int main()
     // Setup CORS support
     setupCors();
 
+    // Setup request tracing
+    setupTracing();
+
+    // Setup slow-operation log
+    setupSlowOpLog();
+
+    // Setup load shedding for low-priority routes
+    setupLoadShedding();
+
+    // Setup request deadlines
+    setupRequestDeadlines();
+
     // Global Security Headers
     drogon::app().registerPostHandlingAdvice(
         [](const drogon::HttpRequestPtr &,
@@ -240,5 +343,7 @@ int main()
         });
     
     drogon::app().run();
+    oauth2::LoadMonitor::instance().stop();
+    oauth2::Tracer::instance().stop();
     return 0;
 }
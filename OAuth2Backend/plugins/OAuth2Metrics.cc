@@ -1,85 +1,539 @@
 #include "OAuth2Metrics.h"
+#include "MetricsRegistry.h"
+#include "LatencyHistogram.h"
+#include "RequestTiming.h"
+#include "SlowOpLog.h"
 #include <drogon/drogon.h>
 #include <drogon/plugins/PromExporter.h>
+#include <drogon/utils/monitoring/Collector.h>
+#include <array>
+#include <atomic>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 using namespace drogon;
 
 namespace oauth2
 {
 
-// Helper to get labels safely
-// In a real implementation you would hold static pointers to metrics families
+namespace
+{
+
+constexpr size_t kOps = static_cast<size_t>(StorageOp::kCount);
+constexpr size_t kBackends = static_cast<size_t>(StorageBackend::kCount);
+constexpr size_t kPhases = static_cast<size_t>(Phase::kCount);
+
+// LatencyRecorder slots: storage [op][backend] first, then phases
+constexpr size_t storageSlot(StorageOp op, StorageBackend backend)
+{
+    return static_cast<size_t>(op) * kBackends + static_cast<size_t>(backend);
+}
+constexpr size_t phaseSlot(Phase phase)
+{
+    return kOps * kBackends + static_cast<size_t>(phase);
+}
+static_assert(kOps * kBackends + kPhases <= LatencyRecorder::kMaxSlots,
+              "Too many latency histograms for LatencyRecorder");
 
-void Metrics::incRequest(const std::string &endpoint, int statusCode)
+struct Families
 {
-    // Labels: endpoint, status
-    // Note: Concurrency safety is handled by Prometheus client usually, or we
-    // assume loose consistency
-    try
+    uint32_t requests;
+    uint32_t loginFailures;
+    uint32_t latency;
+    uint32_t activeTokens;
+    uint32_t storageRejected;
+    uint32_t deadlineExceeded;
+    uint32_t clientCache;
+    uint32_t credentialCache;
+    uint32_t hashRejected;
+    uint32_t circuitState;
+    uint32_t circuitTransitions;
+    uint32_t storageInFlight;
+    uint32_t storageInFlightCell;
+    uint32_t loopLag;
+    // Preallocated oauth2_latency_seconds series, by [op][backend]
+    std::array<std::array<uint32_t, kBackends>, kOps> storageLatency;
+    // SlowOpLog sites, same layout
+    std::array<std::array<uint32_t, kBackends>, kOps> slowSites;
+};
+
+const Families &families()
+{
+    static const Families f = [] {
+        auto &r = MetricsRegistry::instance();
+        using Kind = MetricsRegistry::Kind;
+        Families out;
+        out.requests = r.addFamily("oauth2_requests_total",
+                                   "OAuth2 endpoint responses",
+                                   Kind::kCounter,
+                                   {"endpoint", "status"});
+        out.loginFailures = r.addFamily("oauth2_login_failures_total",
+                                        "Failed login attempts",
+                                        Kind::kCounter,
+                                        {"reason"});
+        out.latency =
+            r.addFamily("oauth2_latency_seconds",
+                        "Storage operation latency",
+                        Kind::kHistogram,
+                        {"operation", "storage"},
+                        {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+                         0.05, 0.1, 0.25, 0.5, 1.0, 2.5});
+        out.activeTokens = r.addFamily("oauth2_active_tokens",
+                                       "Access tokens issued minus expired "
+                                       "(estimate)",
+                                       Kind::kGauge,
+                                       {});
+        out.storageRejected =
+            r.addFamily("oauth2_storage_rejected_total",
+                        "Storage operations rejected by the concurrency "
+                        "limiter before reaching the backend",
+                        Kind::kCounter,
+                        {"storage", "reason"});
+        out.deadlineExceeded =
+            r.addFamily("oauth2_storage_deadline_exceeded_total",
+                        "Storage operations completed by the request "
+                        "deadline instead of the backend",
+                        Kind::kCounter,
+                        {"operation"});
+        out.clientCache = r.addFamily("oauth2_client_cache_total",
+                                      "Client record lookups, by cache result",
+                                      Kind::kCounter,
+                                      {"result"});
+        out.credentialCache =
+            r.addFamily("oauth2_client_credential_cache_total",
+                        "Client secret checks, by verified-credential cache "
+                        "result",
+                        Kind::kCounter,
+                        {"result"});
+        out.hashRejected =
+            r.addFamily("oauth2_credential_hash_rejected_total",
+                        "Password hashes not run (queue full or timed out)",
+                        Kind::kCounter,
+                        {"reason"});
+        out.circuitState = r.addFamily("oauth2_circuit_breaker_state",
+                                       "Storage circuit breaker state (0 "
+                                       "closed, 1 open, 2 half-open)",
+                                       Kind::kGauge,
+                                       {"storage"});
+        out.circuitTransitions =
+            r.addFamily("oauth2_circuit_breaker_transitions_total",
+                        "Storage circuit breaker state changes, by the "
+                        "state entered",
+                        Kind::kCounter,
+                        {"storage", "state"});
+        out.storageInFlight = r.addFamily("oauth2_storage_inflight",
+                                          "Storage operations started but "
+                                          "not yet completed",
+                                          Kind::kGauge,
+                                          {});
+        out.storageInFlightCell = r.series(out.storageInFlight, {});
+        out.loopLag = r.addFamily("oauth2_event_loop_lag_seconds",
+                                  "Scheduling delay of each IO event loop",
+                                  Kind::kFixedPointGauge,
+                                  {"loop"});
+        for (size_t op = 0; op < kOps; ++op)
+        {
+            for (size_t b = 0; b < kBackends; ++b)
+            {
+                out.storageLatency[op][b] =
+                    r.series(out.latency,
+                             {std::string(kStorageOpNames[op]),
+                              std::string(kStorageBackendNames[b])});
+                out.slowSites[op][b] = SlowOpLog::instance().site(
+                    kStorageOpNames[op], kStorageBackendNames[b]);
+            }
+        }
+        CycleClock::init();
+        return out;
+    }();
+    return f;
+}
+
+uint64_t fnv1a(uint64_t h, std::string_view s)
+{
+    for (unsigned char c : s)
     {
-        // We use a simplified way to access metrics if widely available,
-        // Or we just ignore if Plugin is not loaded.
-        // For this example, we assume we just log if we can't find them, or
-        // standard integration. However, Drogon's PromExporter doesn't always
-        // expose a static 'inc' easily without setup. We will simulate
-        // "printing" or "logging" metrics if purely creating a full Prom
-        // integration is too complex given current dependencies. BUT, since the
-        // user asked for "Production Ready", we should try to use the real deal
-        // using custom collectors if possible. A simpler approach for this
-        // task: USE LOGGING for now as "Observability" pass 1 if Prom is hard,
-        // BUT config.json HAS PromExporter.
-        // Let's try to fetch the plugin and use it if possible.
-        // Since standard Drogon PromExporter just exports standard metrics,
-        // custom metrics need registering. We will assume usage of
-        // 'drogon::app().getPlugin<drogon::plugin::PromExporter>()' but that
-        // might fail if not registered. To be safe and fast: We'll LOG these
-        // metrics for now as "Structured Logs" doubling as metrics source via
-        // log processing, UNLESS we are sure about the API. Actually, let's use
-        // a static map for simulation or basic implementation? Let's go with
-        // Detailed LOG entries for "Metrics" as well to be safe, as compiling
-        // new dependencies might be risky. WAIT, the plan said "Prometheus
-        // Metrics". I will assume standard logging for this step to verify
-        // "Observability" logic first, then upgrade? No, I must implement what
-        // I promised. But I don't see `drogon::plugin::PromExporter` headers
-        // detailed usage. I will fallback to: LOG_INFO << "[METRIC] ..." which
-        // is a valid way to ship metrics (Log-based metrics).
-
-        // Actually, let's look at the include
-        // #include <drogon/plugins/PromExporter.h>
-        // If this exists, we might use it.
-
-        static std::string metric_req = "oauth2_requests_total";
-        LOG_INFO << "[METRIC] " << metric_req << " endpoint=" << endpoint
-                 << " status=" << statusCode;
+        h ^= c;
+        h *= 1099511628211ULL;
     }
-    catch (...)
+    return h ^ 0xff;  // Separator, so ("ab","c") != ("a","bc")
+}
+
+/**
+ * @brief Cell of a label combination, resolved once per thread
+ * Hot calls hash the labels and hit a thread-local map: no lock, no
+ * allocation. A 64-bit hash collision between the handful of label sets
+ * we use is not a practical concern.
+ */
+uint32_t cachedSeries(uint32_t family,
+                      std::string_view a,
+                      std::string_view b = {},
+                      size_t labels = 2)
+{
+    thread_local std::unordered_map<uint64_t, uint32_t> cache;
+    uint64_t key = fnv1a(fnv1a(14695981039346656037ULL + family, a), b);
+    auto it = cache.find(key);
+    if (it != cache.end())
+        return it->second;
+
+    std::vector<std::string> values;
+    if (labels > 0)
+        values.emplace_back(a);
+    if (labels > 1)
+        values.emplace_back(b);
+    auto cell = MetricsRegistry::instance().series(family, values);
+    cache.emplace(key, cell);
+    return cell;
+}
+
+// drogon's Metric only contributes the label set here; the values come
+// from the registry snapshot.
+class LabelSet : public monitoring::Metric
+{
+  public:
+    LabelSet(const std::string &name,
+             const std::vector<std::string> &names,
+             const std::vector<std::string> &values)
+        : Metric(name, names, values)
     {
     }
+    std::vector<monitoring::Sample> collect() const override
+    {
+        return {};
+    }
+};
+
+Json::Value describe(const LatencyHistogram &h)
+{
+    auto us = [](uint64_t nanos) { return static_cast<double>(nanos) / 1e3; };
+    Json::Value json;
+    json["count"] = static_cast<Json::UInt64>(h.count());
+    json["mean_us"] = h.mean() / 1e3;
+    json["min_us"] = us(h.min());
+    json["p50_us"] = us(h.percentile(0.5));
+    json["p90_us"] = us(h.percentile(0.9));
+    json["p99_us"] = us(h.percentile(0.99));
+    json["p999_us"] = us(h.percentile(0.999));
+    json["p9999_us"] = us(h.percentile(0.9999));
+    json["max_us"] = us(h.max());
+    return json;
 }
 
-void Metrics::incLoginFailure(const std::string &reason)
+std::string formatBound(double bound)
 {
-    LOG_INFO << "[METRIC] oauth2_login_failures_total reason=" << reason;
+    std::ostringstream os;
+    os << bound;
+    return os.str();
 }
 
-void Metrics::observeLatency(const std::string &operation,
-                             const std::string &storage,
+class RegistryCollector : public monitoring::CollectorBase
+{
+  public:
+    explicit RegistryCollector(uint32_t family) : family_(family)
+    {
+        const auto &f = MetricsRegistry::instance().family(family);
+        name_ = f.name;
+        help_ = f.help;
+        kind_ = f.kind;
+    }
+
+    std::vector<monitoring::SamplesGroup> collect() const override
+    {
+        auto &registry = MetricsRegistry::instance();
+        const auto &f = registry.family(family_);
+        std::vector<monitoring::SamplesGroup> groups;
+        for (const auto &snap : registry.snapshot(family_))
+        {
+            monitoring::SamplesGroup group;
+            group.metric = std::make_shared<LabelSet>(name_,
+                                                      f.labelNames,
+                                                      snap.series->labelValues);
+            if (kind_ != MetricsRegistry::Kind::kHistogram)
+            {
+                monitoring::Sample s;
+                s.name = name_;
+                s.value = snap.values[0];
+                group.samples.push_back(std::move(s));
+            }
+            else
+            {
+                double cumulative = 0;
+                for (size_t i = 0; i <= f.bounds.size(); ++i)
+                {
+                    cumulative += snap.values[i];
+                    monitoring::Sample s;
+                    s.name = name_ + "_bucket";
+                    s.value = cumulative;
+                    s.exLabels.emplace_back("le",
+                                            i < f.bounds.size()
+                                                ? formatBound(f.bounds[i])
+                                                : "+Inf");
+                    group.samples.push_back(std::move(s));
+                }
+                monitoring::Sample sum;
+                sum.name = name_ + "_sum";
+                sum.value = snap.values[f.bounds.size() + 1];
+                group.samples.push_back(std::move(sum));
+                monitoring::Sample count;
+                count.name = name_ + "_count";
+                count.value = snap.values[f.bounds.size() + 2];
+                group.samples.push_back(std::move(count));
+            }
+            groups.push_back(std::move(group));
+        }
+        return groups;
+    }
+
+    const std::string &name() const override
+    {
+        return name_;
+    }
+    const std::string &help() const override
+    {
+        return help_;
+    }
+    const std::string_view type() const override
+    {
+        switch (kind_)
+        {
+            case MetricsRegistry::Kind::kCounter:
+                return "counter";
+            case MetricsRegistry::Kind::kGauge:
+            case MetricsRegistry::Kind::kFixedPointGauge:
+                return "gauge";
+            default:
+                return "histogram";
+        }
+    }
+
+  private:
+    uint32_t family_;
+    std::string name_;
+    std::string help_;
+    MetricsRegistry::Kind kind_;
+};
+
+}  // namespace
+
+void Metrics::incRequest(std::string_view endpoint, int statusCode)
+{
+    // Format the status without allocating (snprintf alone costs more
+    // than the rest of this call)
+    char buf[12];
+    char *end = buf + sizeof(buf);
+    char *p = end;
+    unsigned v = statusCode < 0 ? 0u : static_cast<unsigned>(statusCode);
+    do
+    {
+        *--p = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v);
+    const auto &f = families();
+    MetricsRegistry::instance().add(cachedSeries(
+        f.requests, endpoint, std::string_view(p, end - p)));
+}
+
+void Metrics::incLoginFailure(std::string_view reason)
+{
+    const auto &f = families();
+    MetricsRegistry::instance().add(
+        cachedSeries(f.loginFailures, reason, {}, 1));
+}
+
+void Metrics::observeLatency(std::string_view operation,
+                             std::string_view storage,
                              double seconds)
 {
-    LOG_INFO << "[METRIC] oauth2_latency_seconds operation=" << operation
-             << " storage=" << storage << " val=" << seconds;
+    const auto &f = families();
+    MetricsRegistry::instance().observe(
+        f.latency, cachedSeries(f.latency, operation, storage), seconds);
 }
 
 void Metrics::updateActiveTokens(int count)
 {
-    LOG_INFO << "[METRIC] oauth2_active_tokens val=" << count;
+    const auto &f = families();
+    MetricsRegistry::instance().add(cachedSeries(f.activeTokens, {}, {}, 0),
+                                    count);
+}
+
+void Metrics::incStorageRejected(std::string_view storage,
+                                 std::string_view reason,
+                                 int count)
+{
+    const auto &f = families();
+    MetricsRegistry::instance().add(
+        cachedSeries(f.storageRejected, storage, reason), count);
 }
 
-OperationTimer::~OperationTimer()
+void Metrics::incStorageDeadlineExceeded(std::string_view operation)
 {
-    auto end = std::chrono::steady_clock::now();
-    std::chrono::duration<double> diff = end - start_;
-    Metrics::observeLatency(operation_, storage_, diff.count());
+    const auto &f = families();
+    MetricsRegistry::instance().add(
+        cachedSeries(f.deadlineExceeded, operation, {}, 1));
+}
+
+void Metrics::incClientCache(bool hit)
+{
+    const auto &f = families();
+    MetricsRegistry::instance().add(
+        cachedSeries(f.clientCache, hit ? "hit" : "miss", {}, 1));
+}
+
+void Metrics::incCredentialCache(bool hit)
+{
+    const auto &f = families();
+    MetricsRegistry::instance().add(
+        cachedSeries(f.credentialCache, hit ? "hit" : "miss", {}, 1));
+}
+
+void Metrics::incCredentialHashRejected(std::string_view reason)
+{
+    const auto &f = families();
+    MetricsRegistry::instance().add(
+        cachedSeries(f.hashRejected, reason, {}, 1));
+}
+
+void Metrics::setCircuitState(std::string_view storage, int from, int to)
+{
+    // Transitions are rare: resolve the series directly
+    static constexpr const char *kStates[] = {"closed", "open", "half_open"};
+    const auto &f = families();
+    auto &registry = MetricsRegistry::instance();
+    registry.add(registry.series(f.circuitState, {std::string(storage)}),
+                 to - from);
+    if (from != to)
+    {
+        registry.add(registry.series(f.circuitTransitions,
+                                     {std::string(storage), kStates[to]}));
+    }
+}
+
+void Metrics::updateStorageInFlight(int delta)
+{
+    MetricsRegistry::instance().add(families().storageInFlightCell, delta);
+}
+
+int64_t Metrics::storageInFlight()
+{
+    const auto &f = families();
+    auto snap = MetricsRegistry::instance().snapshot(f.storageInFlight);
+    return snap.empty() ? 0 : static_cast<int64_t>(snap[0].values[0]);
+}
+
+void Metrics::setEventLoopLag(size_t loop, int64_t nanos)
+{
+    // Gauge cells only accumulate deltas; the single writer remembers
+    // what it last published per loop
+    static std::vector<std::pair<uint32_t, int64_t>> published;
+    const auto &f = families();
+    while (published.size() <= loop)
+    {
+        published.emplace_back(
+            MetricsRegistry::instance().series(
+                f.loopLag, {std::to_string(published.size())}),
+            0);
+    }
+    auto &[cell, last] = published[loop];
+    MetricsRegistry::instance().add(cell, nanos - last);
+    last = nanos;
+}
+
+void Metrics::registerCollectors()
+{
+    static std::atomic<bool> registered{false};
+    auto *prom = app().getPlugin<plugin::PromExporter>();
+    if (!prom || registered.exchange(true))
+        return;
+
+    auto &registry = MetricsRegistry::instance();
+    families();
+    for (uint32_t i = 0; i < registry.familyCount(); ++i)
+        prom->registerCollector(std::make_shared<RegistryCollector>(i));
+    LOG_INFO << "OAuth2 metrics registered with PromExporter";
+}
+
+uint64_t Metrics::observePhase(Phase phase,
+                               uint64_t startTicks,
+                               RequestTiming *timing)
+{
+    auto now = CycleClock::now();
+    auto nanos = CycleClock::toNanos(now - startTicks);
+    LatencyRecorder::instance().record(phaseSlot(phase),
+                                       static_cast<uint64_t>(nanos));
+    if (timing)
+        timing->add(kPhaseNames[static_cast<size_t>(phase)], nanos);
+    return now;
+}
+
+Json::Value Metrics::latencyReport()
+{
+    auto &recorder = LatencyRecorder::instance();
+    Json::Value report(Json::objectValue);
+    Json::Value storage(Json::objectValue);
+    for (size_t b = 0; b < kBackends; ++b)
+    {
+        for (size_t op = 0; op < kOps; ++op)
+        {
+            auto slot = storageSlot(static_cast<StorageOp>(op),
+                                    static_cast<StorageBackend>(b));
+            auto h = recorder.snapshot(slot);
+            if (h.count() == 0)
+                continue;
+            storage[std::string(kStorageBackendNames[b])]
+                   [std::string(kStorageOpNames[op])] = describe(h);
+        }
+    }
+    report["storage"] = storage;
+    Json::Value phases(Json::objectValue);
+    for (size_t p = 0; p < kPhases; ++p)
+    {
+        auto h = recorder.snapshot(phaseSlot(static_cast<Phase>(p)));
+        if (h.count() > 0)
+            phases[std::string(kPhaseNames[p])] = describe(h);
+    }
+    report["phases"] = phases;
+    return report;
+}
+
+void Metrics::resetLatency()
+{
+    LatencyRecorder::instance().reset();
+}
+
+TraceScope OperationTimer::stop() const
+{
+    auto nanos = CycleClock::toNanos(CycleClock::now() - start_);
+    Metrics::updateStorageInFlight(-1);
+    if (parent_.valid())
+    {
+        auto remote = backend_ == StorageBackend::kRedis ||
+                      backend_ == StorageBackend::kPostgres;
+        Span span(kStorageOpNames[static_cast<size_t>(op_)],
+                  remote ? SpanKind::kClient : SpanKind::kInternal,
+                  parent_,
+                  start_);
+        span.setStaticAttribute(
+            "db.system", kStorageBackendNames[static_cast<size_t>(backend_)]);
+        span.end();
+    }
+    const auto &f = families();
+    auto cell = f.storageLatency[static_cast<size_t>(op_)]
+                                [static_cast<size_t>(backend_)];
+    MetricsRegistry::instance().observeScaled(f.latency, cell, nanos);
+    LatencyRecorder::instance().record(storageSlot(op_, backend_),
+                                       static_cast<uint64_t>(nanos));
+    auto site = f.slowSites[static_cast<size_t>(op_)]
+                           [static_cast<size_t>(backend_)];
+    auto &slowLog = SlowOpLog::instance();
+    if (slowLog.exceeds(site, nanos))
+    {
+        // Storage calls have no queue wait of their own to report; pool
+        // waits inside the driver are part of the duration
+        slowLog.report(site, keyHash_, nanos, -1, parent_);
+    }
+    return TraceScope(parent_);
 }
 
 }  // namespace oauth2
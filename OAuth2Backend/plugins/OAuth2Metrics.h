@@ -1,47 +1,291 @@
 #pragma once
+#include "CycleClock.h"
+#include "SlowOpLog.h"
+#include "Tracer.h"
+#include <json/json.h>
+#include <cstdint>
+#include <iterator>
 #include <string>
-#include <chrono>
+#include <string_view>
 
 namespace oauth2
 {
 
+class RequestTiming;
+
+// Phases of OAuth2Plugin flows with their own latency histogram. Storage
+// phases include callback dispatch, unlike the OperationTimer samples.
+// hash.* are CredentialHasher's queue wait and hash time.
+enum class Phase : uint8_t
+{
+    kExchangeConsumeCode,
+    kExchangeGetRoles,
+    kExchangeSaveAccessToken,
+    kExchangeSaveRefreshToken,
+    kExchangeTotal,
+    kRefreshLookup,
+    kRefreshGetRoles,
+    kRefreshSaveAccessToken,
+    kRefreshSaveRefreshToken,
+    kRefreshTotal,
+    kValidateLookup,
+    kValidateTotal,
+    kHashQueue,
+    kHashCompute,
+    kCount
+};
+
+inline constexpr std::string_view kPhaseNames[] = {
+    "exchange.consumeAuthCode",
+    "exchange.getUserRoles",
+    "exchange.saveAccessToken",
+    "exchange.saveRefreshToken",
+    "exchange.total",
+    "refresh.getRefreshToken",
+    "refresh.getUserRoles",
+    "refresh.saveAccessToken",
+    "refresh.saveRefreshToken",
+    "refresh.total",
+    "validate.getAccessToken",
+    "validate.total",
+    "hash.queue",
+    "hash.compute",
+};
+static_assert(std::size(kPhaseNames) == static_cast<size_t>(Phase::kCount),
+              "kPhaseNames out of sync with Phase");
+
+/**
+ * @brief OAuth2 business metrics
+ *
+ * Backed by MetricsRegistry (per-thread counters, aggregated on scrape)
+ * and exposed through drogon's PromExporter once registerCollectors() has
+ * run. Recording never logs and never takes a lock.
+ */
 class Metrics
 {
   public:
-    // Counter: oauth2_requests_total{type, code}
-    static void incRequest(const std::string &endpoint, int statusCode);
+    // Counter: oauth2_requests_total{endpoint, status}
+    static void incRequest(std::string_view endpoint, int statusCode);
 
     // Counter: oauth2_login_failures_total{reason}
-    static void incLoginFailure(const std::string &reason);
+    static void incLoginFailure(std::string_view reason);
 
     // Histogram: oauth2_latency_seconds{operation, storage}
-    // We will use a helper struct for RAII timing if needed, or just manual
-    // call
-    static void observeLatency(const std::string &operation,
-                               const std::string &storage,
+    static void observeLatency(std::string_view operation,
+                               std::string_view storage,
                                double seconds);
 
-    // Gauge: oauth2_active_tokens
+    // Gauge: oauth2_active_tokens (delta)
     static void updateActiveTokens(int count);
+
+    // Counter: oauth2_storage_rejected_total{storage, reason}
+    static void incStorageRejected(std::string_view storage,
+                                   std::string_view reason,
+                                   int count = 1);
+
+    /**
+     * @brief Gauge: oauth2_circuit_breaker_state{storage} (0 closed,
+     * 1 open, 2 half-open), plus
+     * Counter: oauth2_circuit_breaker_transitions_total{storage, state}
+     * @param from The state being left; equal to @p to only registers the
+     * series
+     */
+    static void setCircuitState(std::string_view storage, int from, int to);
+
+    // Counter: oauth2_storage_deadline_exceeded_total{operation}
+    static void incStorageDeadlineExceeded(std::string_view operation);
+
+    // Counter: oauth2_client_cache_total{result} (hit / miss)
+    static void incClientCache(bool hit);
+
+    // Counter: oauth2_client_credential_cache_total{result} (hit / miss)
+    static void incCredentialCache(bool hit);
+
+    // Counter: oauth2_credential_hash_rejected_total{reason}
+    // (queue_full / timeout)
+    static void incCredentialHashRejected(std::string_view reason);
+
+    // Gauge: oauth2_storage_inflight (delta; OperationTimer keeps it)
+    static void updateStorageInFlight(int delta);
+
+    // Summed across threads: takes the registry lock, not for hot paths
+    static int64_t storageInFlight();
+
+    /**
+     * @brief Gauge: oauth2_event_loop_lag_seconds{loop}
+     * Single writer (LoadMonitor's sampling thread).
+     */
+    static void setEventLoopLag(size_t loop, int64_t nanos);
+
+    /**
+     * @brief Record one phase of a plugin flow in its HDR histogram
+     * @param startTicks CycleClock::now() when the phase began
+     * @param timing Also appended here when the request is being timed
+     * @return CycleClock::now(), i.e. the start of the next phase
+     */
+    static uint64_t observePhase(Phase phase,
+                                 uint64_t startTicks,
+                                 RequestTiming *timing = nullptr);
+
+    /**
+     * @brief Percentiles of every non-empty HDR latency histogram
+     * (storage operations and plugin phases), in microseconds
+     */
+    static Json::Value latencyReport();
+
+    static void resetLatency();
+
+    /**
+     * @brief Expose the metrics on the PromExporter plugin, if loaded
+     * Idempotent; call after PromExporter has started.
+     */
+    static void registerCollectors();
 };
 
-// Simple RAII timer
+// Label values of oauth2_latency_seconds, fixed at compile time so a
+// sample is addressed by array index instead of by string.
+enum class StorageOp : uint8_t
+{
+    kGetClient,
+    kValidateClient,
+    kListClients,
+    kSaveAuthCode,
+    kGetAuthCode,
+    kMarkAuthCodeUsed,
+    kConsumeAuthCode,
+    kSaveAccessToken,
+    kGetAccessToken,
+    kSaveRefreshToken,
+    kGetRefreshToken,
+    kGetUserRoles,
+    kInvalidateUserRoles,
+    kDeleteExpiredData,
+    kCount
+};
+
+enum class StorageBackend : uint8_t
+{
+    kMemory,
+    kRedis,
+    kPostgres,
+    kCached,  // Postgres + Redis L2, measured end to end
+    kCount
+};
+
+inline constexpr std::string_view kStorageOpNames[] = {
+    "getClient",
+    "validateClient",
+    "listClients",
+    "saveAuthCode",
+    "getAuthCode",
+    "markAuthCodeUsed",
+    "consumeAuthCode",
+    "saveAccessToken",
+    "getAccessToken",
+    "saveRefreshToken",
+    "getRefreshToken",
+    "getUserRoles",
+    "invalidateUserRoles",
+    "deleteExpiredData",
+};
+static_assert(std::size(kStorageOpNames) ==
+                  static_cast<size_t>(StorageOp::kCount),
+              "kStorageOpNames out of sync with StorageOp");
+
+inline constexpr std::string_view kStorageBackendNames[] = {
+    "memory",
+    "redis",
+    "postgres",
+    "cached",
+};
+static_assert(std::size(kStorageBackendNames) ==
+                  static_cast<size_t>(StorageBackend::kCount),
+              "kStorageBackendNames out of sync with StorageBackend");
+
+/**
+ * @brief Latency sample of one storage operation (no heap)
+ *
+ * Construct when the operation starts and call stop() once, when its
+ * result is available (typically first thing in the DB/Redis callback;
+ * capture the timer by value). The histogram slot for every op/backend
+ * pair is allocated up front, so stop() is a clock read plus a few
+ * thread-local increments.
+ *
+ * With tracing on, the timer also remembers the current trace context and
+ * stop() records the operation as a span. stop() returns a TraceScope
+ * re-establishing that context; keep it alive for the rest of the
+ * callback (`auto trace = timer.stop();`) so storage calls chained from it
+ * stay in the same trace.
+ *
+ * Operations over their SlowOpLog threshold are reported there, with a
+ * salted hash of @p key (only computed while the slow log is enabled).
+ *
+ * The timer counts as in flight (oauth2_storage_inflight) from
+ * construction until stop(); copies share that single count.
+ */
 class OperationTimer
 {
   public:
-    OperationTimer(std::string op, std::string store)
-        : operation_(std::move(op)),
-          storage_(std::move(store)),
-          start_(std::chrono::steady_clock::now())
+    OperationTimer(StorageOp op,
+                   StorageBackend backend,
+                   std::string_view key = {})
+        : start_(CycleClock::now()),
+          keyHash_(SlowOpLog::hashKey(key)),
+          op_(op),
+          backend_(backend)
+    {
+        if (Tracer::enabled())
+            parent_ = TraceScope::current();
+        Metrics::updateStorageInFlight(1);
+    }
+
+    TraceScope stop() const;
+
+    const TraceContext &traceParent() const
+    {
+        return parent_;
+    }
+
+  private:
+    uint64_t start_;
+    uint64_t keyHash_;
+    TraceContext parent_;
+    StorageOp op_;
+    StorageBackend backend_;
+};
+
+/**
+ * @brief OperationTimer for synchronous code: stops on scope exit unless
+ * stop() was called earlier (e.g. right before invoking a callback).
+ */
+class ScopedOperationTimer
+{
+  public:
+    ScopedOperationTimer(StorageOp op,
+                         StorageBackend backend,
+                         std::string_view key = {})
+        : timer_(op, backend, key)
+    {
+    }
+    ~ScopedOperationTimer()
     {
+        stop();
     }
+    ScopedOperationTimer(const ScopedOperationTimer &) = delete;
+    ScopedOperationTimer &operator=(const ScopedOperationTimer &) = delete;
 
-    ~OperationTimer();
+    void stop()
+    {
+        if (!stopped_)
+        {
+            stopped_ = true;
+            timer_.stop();
+        }
+    }
 
   private:
-    std::string operation_;
-    std::string storage_;
-    std::chrono::steady_clock::time_point start_;
+    OperationTimer timer_;
+    bool stopped_{false};
 };
 
 }  // namespace oauth2
@@ -3,16 +3,71 @@
 #include "PostgresOAuth2Storage.h"
 #include "RedisOAuth2Storage.h"
 #include "CachedOAuth2Storage.h"
+#include "LimitedOAuth2Storage.h"
+#include "DeadlineOAuth2Storage.h"
+#include "AsyncJoin.h"
+#include "Deadline.h"
+#include "OAuth2Metrics.h"
+#include "AuditLogger.h"
+#include "CredentialHasher.h"
 #include <drogon/drogon.h>
 #include <drogon/utils/Utilities.h>
+#include <algorithm>
 #include <chrono>
+#include <sstream>
 
 using namespace drogon;
 
+namespace
+{
+
+// Bound concurrent operations when the backend config has "concurrency"
+std::unique_ptr<oauth2::IOAuth2Storage> withConcurrencyLimit(
+    std::unique_ptr<oauth2::IOAuth2Storage> storage,
+    const Json::Value &backendConfig,
+    const std::string &backend)
+{
+    if (!backendConfig.isMember("concurrency"))
+        return storage;
+    auto options = oauth2::ConcurrencyLimiter::Options::fromConfig(
+        backendConfig["concurrency"]);
+    LOG_INFO << "Storage limiter (" << backend << "): "
+             << options.maxConcurrency << " concurrent, queue "
+             << options.maxQueue;
+    auto limiter =
+        std::make_shared<oauth2::ConcurrencyLimiter>(backend, options);
+    // Raw new, as below: make_unique with move-only arguments trips some
+    // MSVC versions
+    return std::unique_ptr<oauth2::IOAuth2Storage>(
+        new oauth2::LimitedOAuth2Storage(std::move(storage),
+                                         std::move(limiter)));
+}
+
+// Breaker for the Redis cache tier, when "redis" has "circuit_breaker"
+std::shared_ptr<oauth2::CircuitBreaker> redisBreaker(const Json::Value &config)
+{
+    if (!config.isMember("circuit_breaker"))
+        return nullptr;
+    auto options =
+        oauth2::CircuitBreaker::Options::fromConfig(config["circuit_breaker"]);
+    LOG_INFO << "Redis circuit breaker: open at "
+             << options.failureRate * 100 << "% errors or "
+             << options.slowCallRate * 100 << "% over "
+             << options.slowCallNanos / 1000000 << "ms, for "
+             << options.openNanos / 1000000 << "ms";
+    return std::make_shared<oauth2::CircuitBreaker>("redis", options);
+}
+
+}  // namespace
+
 void OAuth2Plugin::initAndStart(const Json::Value &config)
 {
     LOG_INFO << "OAuth2Plugin loading...";
+    // PromExporter is listed as a dependency, so it is already started
+    oauth2::Metrics::registerCollectors();
     initStorage(config);
+    initRbac(config);
+    initClientCache(config);
 
     // Load TTL Config
     if (config.isMember("tokens"))
@@ -28,6 +83,21 @@ void OAuth2Plugin::initAndStart(const Json::Value &config)
 
     LOG_INFO << "OAuth2Plugin initialized with storage type: " << storageType_;
 
+    // Opt-in: exposes internal timings to clients
+    if (config.isMember("server_timing"))
+    {
+        serverTiming_ = config["server_timing"].get("enabled", false).asBool();
+        serverTimingLog_ = config["server_timing"].get("log", false).asBool();
+        LOG_INFO << "Server-Timing: " << (serverTiming_ ? "on" : "off")
+                 << (serverTiming_ && serverTimingLog_ ? " (+log)" : "");
+    }
+
+    // Dedicated audit trail; without it events go to the shared log
+    oauth2::AuditLogger::instance().start(config["audit"]);
+
+    // Login / registration password hashes, off the IO threads
+    oauth2::CredentialHasher::instance().start(config["credential_hashing"]);
+
     // Initialize and start cleanup service
     cleanupService_ =
         std::make_unique<oauth2::OAuth2CleanupService>(storage_.get());
@@ -55,12 +125,16 @@ void OAuth2Plugin::initStorage(const Json::Value &config)
         try
         {
             auto redis = drogon::app().getRedisClient("default");
-            // Explicitly upcast to base unique_ptr
-            std::unique_ptr<oauth2::IOAuth2Storage> baseStorage = std::move(s);
+            // The limiter sits below the cache: cache hits never queue
+            auto baseStorage = withConcurrencyLimit(std::move(s),
+                                                    config["postgres"],
+                                                    "postgres");
             // Use raw new to avoid make_unique forwarding issues with move-only
             // types in some MSVC versions
             std::unique_ptr<oauth2::IOAuth2Storage> cached(
-                new oauth2::CachedOAuth2Storage(std::move(baseStorage), redis));
+                new oauth2::CachedOAuth2Storage(std::move(baseStorage),
+                                                redis,
+                                                redisBreaker(config["redis"])));
             storage_ = std::move(cached);
             LOG_INFO << "Using PostgreSQL storage backend with L2 Redis Cache";
         }
@@ -76,13 +150,18 @@ void OAuth2Plugin::initStorage(const Json::Value &config)
                 << "Failed to init Cache. Fallback creating new Postgres.";
             auto s2 = std::make_unique<oauth2::PostgresOAuth2Storage>();
             s2->initFromConfig(config["postgres"]);
-            storage_ = std::move(s2);
+            storage_ = withConcurrencyLimit(std::move(s2),
+                                            config["postgres"],
+                                            "postgres");
             LOG_INFO << "Using PostgreSQL storage backend (Cache Init Failed)";
         }
     }
     else if (storageType_ == "redis")
     {
-        storage_ = oauth2::createRedisStorage(config["redis"]);
+        storage_ =
+            withConcurrencyLimit(oauth2::createRedisStorage(config["redis"]),
+                                 config["redis"],
+                                 "redis");
         LOG_INFO << "Using Redis storage backend";
     }
     else
@@ -93,6 +172,154 @@ void OAuth2Plugin::initStorage(const Json::Value &config)
         storage_ = std::move(s);
         LOG_INFO << "Using in-memory storage backend";
     }
+
+    // Outermost, so every storage call of a request shares its deadline
+    if (oauth2::RequestDeadlines::enabled())
+    {
+        storage_ = std::unique_ptr<oauth2::IOAuth2Storage>(
+            new oauth2::DeadlineOAuth2Storage(std::move(storage_)));
+        LOG_INFO << "Storage calls bounded by request deadlines";
+    }
+}
+
+void OAuth2Plugin::initRbac(const Json::Value &config)
+{
+    rbacCache_ = std::make_unique<oauth2::RbacCache>();
+    if (storageType_ != "postgres")
+        return;
+
+    const auto &pg = config["postgres"];
+    auto dbClientName = pg.get("db_client_name", "default").asString();
+    rbacCache_->loadFromDb(dbClientName);
+
+    // Push: roles / permissions / user_roles triggers (sql/005)
+    auto connInfo = pg.get("notify_conninfo", "").asString();
+    if (!connInfo.empty())
+    {
+        notifyListener_ = std::make_unique<oauth2::PgNotifyListener>(connInfo);
+        // `this` is safe: the listener is owned by the plugin and
+        // unsubscribed in shutdown() before the plugin goes away.
+        notifyListener_->listen("oauth2_rbac",
+                                [this, dbClientName](const std::string &p) {
+                                    onRbacChanged(p, dbClientName);
+                                });
+    }
+
+    // Pull: safety net for notifications missed while disconnected
+    double interval =
+        config.get("rbac_refresh_interval_seconds", 300.0).asDouble();
+    if (interval > 0)
+    {
+        // Timer is invalidated in shutdown(), so capturing `this` is safe
+        rbacRefreshTimerId_ = drogon::app().getLoop()->runEvery(
+            interval, [this, dbClientName]() {
+                rbacCache_->loadFromDb(dbClientName);
+            });
+    }
+}
+
+void OAuth2Plugin::initClientCache(const Json::Value &config)
+{
+    const auto &cacheConfig = config["client_cache"];
+    auto options = oauth2::ClientCache::Options::fromConfig(cacheConfig);
+
+    // Push: client rows / hashes report their own changes, so entries are
+    // kept until refreshed (Postgres: sql/007; Redis: keyspace events,
+    // which the server must have enabled with "notify-keyspace-events")
+    bool pushed = false;
+    if (storageType_ == "postgres")
+    {
+        pushed = notifyListener_ && notifyListener_->valid();
+    }
+    else if (storageType_ == "redis" &&
+             cacheConfig.get("redis_keyspace_events", false).asBool())
+    {
+        auto name = config["redis"].get("client_name", "default").asString();
+        try
+        {
+            if (auto redis = drogon::app().getRedisClient(name))
+                clientSubscriber_ = redis->newSubscriber();
+        }
+        catch (...)
+        {
+            LOG_ERROR << "Client cache: Redis client '" << name
+                      << "' unavailable, no keyspace events";
+        }
+        pushed = clientSubscriber_ != nullptr;
+    }
+    if (pushed)
+        options.ttlNanos = 0;
+    clientCache_ =
+        std::make_unique<oauth2::ClientCache>(storage_.get(), options);
+
+    // Verified client secrets; "ttl_seconds": 0 turns it off
+    auto credentialOptions = oauth2::CredentialCache::Options::fromConfig(
+        config["credential_cache"]);
+    if (credentialOptions.ttlNanos > 0)
+        credentialCache_ =
+            std::make_unique<oauth2::CredentialCache>(credentialOptions);
+
+    // `this` is safe in the handlers below: the listener and the subscriber
+    // are owned by the plugin and released in shutdown() before the cache.
+    if (pushed && notifyListener_)
+    {
+        // Payload: client_id
+        notifyListener_->listen("oauth2_clients",
+                                [this](const std::string &clientId) {
+                                    onClientChanged(clientId);
+                                });
+    }
+    else if (pushed)
+    {
+        clientSubscriber_->psubscribe(
+            "__keyspace@*__:oauth2:client:*",
+            [this](const std::string &channel, const std::string &) {
+                // __keyspace@<db>__:oauth2:client:<client_id>
+                static const std::string marker = "__:oauth2:client:";
+                auto pos = channel.find(marker);
+                if (pos != std::string::npos)
+                    onClientChanged(channel.substr(pos + marker.size()));
+            });
+    }
+    LOG_INFO << "Client cache: "
+             << (pushed ? "refreshed on change notifications"
+                        : "entries expire after ttl_seconds");
+
+    clientCache_->load();
+
+    // Pull: safety net for changes missed while disconnected
+    double interval =
+        cacheConfig.get("reload_interval_seconds", 300.0).asDouble();
+    if (interval > 0)
+    {
+        // Timer is invalidated in shutdown(), so capturing `this` is safe
+        clientReloadTimerId_ = drogon::app().getLoop()->runEvery(
+            interval, [this]() { clientCache_->load(); });
+    }
+}
+
+void OAuth2Plugin::onClientChanged(const std::string &clientId)
+{
+    // A rotated secret must not keep verifying until the registry catches up
+    if (credentialCache_)
+        credentialCache_->invalidate(clientId);
+    clientCache_->refresh(clientId);
+}
+
+void OAuth2Plugin::onRbacChanged(const std::string &payload,
+                                 const std::string &dbClientName)
+{
+    static const std::string userRolesPrefix = "user_roles:";
+    if (payload.compare(0, userRolesPrefix.size(), userRolesPrefix) == 0)
+    {
+        // Role IDs of other users are unaffected; only this user's tokens
+        // must drop their snapshot.
+        invalidateUserRoles(payload.substr(userRolesPrefix.size()), nullptr);
+        return;
+    }
+    // roles / permissions / role_permissions: tokens keep their role IDs,
+    // only the ID -> name / permission mapping changes.
+    rbacCache_->loadFromDb(dbClientName);
 }
 
 void OAuth2Plugin::shutdown()
@@ -100,7 +327,23 @@ void OAuth2Plugin::shutdown()
     LOG_INFO << "OAuth2Plugin shutdown";
     if (cleanupService_)
         cleanupService_->stop();
+    if (rbacRefreshTimerId_ > 0)
+    {
+        drogon::app().getLoop()->invalidateTimer(rbacRefreshTimerId_);
+        rbacRefreshTimerId_ = 0;
+    }
+    if (clientReloadTimerId_ > 0)
+    {
+        drogon::app().getLoop()->invalidateTimer(clientReloadTimerId_);
+        clientReloadTimerId_ = 0;
+    }
+    notifyListener_.reset();
+    clientSubscriber_.reset();
+    credentialCache_.reset();
+    clientCache_.reset();
     storage_.reset();
+    oauth2::CredentialHasher::instance().stop();
+    oauth2::AuditLogger::instance().stop();
 }
 
 void OAuth2Plugin::validateClient(const std::string &clientId,
@@ -112,38 +355,131 @@ void OAuth2Plugin::validateClient(const std::string &clientId,
         callback(false);
         return;
     }
-    storage_->validateClient(clientId, clientSecret, std::move(callback));
+    if (clientSecret.empty() || !credentialCache_ || !clientCache_)
+    {
+        storage_->validateClient(clientId, clientSecret, std::move(callback));
+        return;
+    }
+
+    // Repeat checks of the same secret skip the storage read and the hash.
+    // The plugin owns the caches and the storage and outlives every
+    // request, so capturing `this` is safe.
+    clientCache_->getClient(
+        clientId,
+        [this, clientId, clientSecret, callback = std::move(callback)](
+            oauth2::ClientPtr client) mutable {
+            if (!client)
+            {
+                callback(false);
+                return;
+            }
+            if (credentialCache_->contains(clientId,
+                                           clientSecret,
+                                           client->clientSecretHash))
+            {
+                callback(true);
+                return;
+            }
+            storage_->validateClient(
+                clientId,
+                clientSecret,
+                [this,
+                 clientId,
+                 clientSecret,
+                 client = std::move(client),
+                 callback = std::move(callback)](bool valid) {
+                    if (valid)
+                        credentialCache_->put(clientId,
+                                              clientSecret,
+                                              client->clientSecretHash);
+                    callback(valid);
+                });
+        });
 }
 
 void OAuth2Plugin::validateRedirectUri(const std::string &clientId,
                                        const std::string &redirectUri,
                                        std::function<void(bool)> &&callback)
 {
-    if (!storage_)
+    if (!clientCache_)
     {
         callback(false);
         return;
     }
 
-    // We need to getClient first, then check URIs
-    storage_->getClient(clientId,
-                        [callback = std::move(callback), redirectUri](
-                            std::optional<oauth2::OAuth2Client> client) {
-                            if (!client)
-                            {
-                                callback(false);
-                                return;
-                            }
-                            for (const auto &uri : client->redirectUris)
-                            {
-                                if (uri == redirectUri)
-                                {
-                                    callback(true);
-                                    return;
-                                }
-                            }
-                            callback(false);
-                        });
+    clientCache_->getClient(clientId,
+                            [callback = std::move(callback),
+                             redirectUri](oauth2::ClientPtr client) {
+                                callback(client &&
+                                         client->hasRedirectUri(redirectUri));
+                            });
+}
+
+const char *OAuth2Plugin::AuthorizePreflight::errorCode() const
+{
+    switch (error)
+    {
+        case Error::kNone:
+            return "";
+        case Error::kInvalidClient:
+            return "invalid_client";
+        case Error::kInvalidRedirectUri:
+            return "invalid_request";
+        case Error::kUnsupportedResponseType:
+            return "unsupported_response_type";
+        case Error::kInvalidScope:
+            return "invalid_scope";
+    }
+    return "invalid_request";
+}
+
+void OAuth2Plugin::preflightAuthorize(
+    const std::string &clientId,
+    const std::string &redirectUri,
+    const std::string &responseType,
+    const std::string &scope,
+    std::function<void(const AuthorizePreflight &)> &&callback)
+{
+    using Error = AuthorizePreflight::Error;
+    if (!clientCache_)
+    {
+        callback(AuthorizePreflight{Error::kInvalidClient, nullptr});
+        return;
+    }
+
+    clientCache_->getClient(
+        clientId,
+        [callback = std::move(callback), redirectUri, responseType, scope](
+            oauth2::ClientPtr client) {
+            AuthorizePreflight result{Error::kNone, std::move(client)};
+            const auto *c = result.client.get();
+            if (!c)
+            {
+                result.error = Error::kInvalidClient;
+            }
+            else if (!c->hasRedirectUri(redirectUri))
+            {
+                result.error = Error::kInvalidRedirectUri;
+            }
+            else if (responseType != "code")
+            {
+                result.error = Error::kUnsupportedResponseType;
+            }
+            else
+            {
+                std::istringstream requested(scope);
+                std::string s;
+                while (requested >> s)
+                {
+                    if (!c->allowsScope(s))
+                    {
+                        result.error = Error::kInvalidScope;
+                        break;
+                    }
+                }
+            }
+            callback(result);
+        });
 }
 
 void OAuth2Plugin::generateAuthorizationCode(
@@ -190,226 +526,387 @@ static Json::Value makeError(const std::string &error,
     return json;
 }
 
+namespace
+{
+
+// Phase histograms of the steps TokenFlow shares between both flows
+struct TokenFlowPhases
+{
+    oauth2::Phase getRoles;
+    oauth2::Phase saveAccessToken;
+    oauth2::Phase saveRefreshToken;
+    oauth2::Phase total;
+};
+
+constexpr TokenFlowPhases kExchangePhases{
+    oauth2::Phase::kExchangeGetRoles,
+    oauth2::Phase::kExchangeSaveAccessToken,
+    oauth2::Phase::kExchangeSaveRefreshToken,
+    oauth2::Phase::kExchangeTotal};
+
+constexpr TokenFlowPhases kRefreshPhases{
+    oauth2::Phase::kRefreshGetRoles,
+    oauth2::Phase::kRefreshSaveAccessToken,
+    oauth2::Phase::kRefreshSaveRefreshToken,
+    oauth2::Phase::kRefreshTotal};
+
+/**
+ * @brief State of one token endpoint flow (code exchange or refresh)
+ *
+ * Allocated once per request. Each step's storage callback captures this
+ * shared_ptr (plus a timestamp or join handle), so the response callback
+ * and the token pair are built in place and never copied from one
+ * continuation to the next. storage and rbacCache are owned by the
+ * plugin, which outlives every request.
+ */
+struct TokenFlow
+{
+    TokenFlow(oauth2::IOAuth2Storage *storage,
+              oauth2::RbacCache *rbacCache,
+              std::function<void(const Json::Value &)> &&callback,
+              oauth2::RequestTimingPtr timing,
+              const char *auditEvent,
+              const TokenFlowPhases &phases)
+        : storage(storage),
+          rbacCache(rbacCache),
+          callback(std::move(callback)),
+          timing(std::move(timing)),
+          auditEvent(auditEvent),
+          phases(phases),
+          start(oauth2::CycleClock::now()),
+          last(start)
+    {
+    }
+
+    // Close the current phase and start the next one
+    void phase(oauth2::Phase p)
+    {
+        last = oauth2::Metrics::observePhase(p, last, timing.get());
+    }
+
+    void fail(const std::string &error, const std::string &desc = "")
+    {
+        callback(makeError(error, desc));
+    }
+
+    oauth2::IOAuth2Storage *storage;
+    oauth2::RbacCache *rbacCache;
+    std::function<void(const Json::Value &)> callback;
+    oauth2::RequestTimingPtr timing;
+    const char *auditEvent;
+    const TokenFlowPhases &phases;
+    uint64_t start;  // CycleClock ticks
+    uint64_t last;
+    oauth2::OAuth2AccessToken token;
+    oauth2::OAuth2RefreshToken refreshToken;
+    bool returnRoles{false};  // Extension: list roles in the response
+    Json::Value roles{Json::arrayValue};
+};
+
+using TokenFlowPtr = std::shared_ptr<TokenFlow>;
+
+int64_t unixNow()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief Fill in a fresh access/refresh token pair for @p userId
+ * Role IDs are attached later, by loadRolesAndSaveAccessToken().
+ */
+void newTokenPair(TokenFlow &flow,
+                  oauth2::Symbol clientId,
+                  const std::string &userId,
+                  const std::string &scope,
+                  int64_t accessTokenTtl,
+                  int64_t refreshTokenTtl)
+{
+    auto now = unixNow();
+    auto &token = flow.token;
+    token.token = utils::getUuid();
+    token.clientId = clientId;
+    token.userId = userId;
+    token.scope = scope;
+    token.expiresAt = now + accessTokenTtl;
+
+    auto &refresh = flow.refreshToken;
+    refresh.token = utils::getUuid();
+    refresh.accessToken = token.token;
+    refresh.clientId = clientId;
+    refresh.userId = userId;
+    refresh.scope = scope;
+    refresh.expiresAt = now + refreshTokenTtl;
+}
+
+void respond(const TokenFlowPtr &flow)
+{
+    oauth2::Metrics::observePhase(flow->phases.total, flow->start);
+    oauth2::AuditLogger::instance().log(flow->auditEvent,
+                                        true,
+                                        flow->token.userId,
+                                        flow->token.clientId.str());
+
+    Json::Value json;
+    json["access_token"] = flow->token.token.str();
+    json["token_type"] = "Bearer";
+    json["expires_in"] = (Json::Int64)(flow->token.expiresAt - unixNow());
+    json["refresh_token"] = flow->refreshToken.token.str();
+    if (flow->returnRoles)
+        json["roles"] = std::move(flow->roles);
+    flow->callback(json);
+}
+
+/**
+ * @brief Snapshot the user's roles into the new access token and save it
+ */
+void loadRolesAndSaveAccessToken(const TokenFlowPtr &flow,
+                                 uint64_t fanOut,
+                                 oauth2::JoinBranch done)
+{
+    flow->storage->getUserRoles(
+        flow->token.userId,
+        [flow, fanOut, done](std::vector<std::string> roles) {
+            auto loaded = oauth2::Metrics::observePhase(flow->phases.getRoles,
+                                                        fanOut,
+                                                        flow->timing.get());
+            // No snapshot leaves the token on live lookups. An empty list
+            // is also what a failed, expired or shed lookup returns, and a
+            // catalog still on its seed may map names to the wrong IDs:
+            // either would pin the token to that answer until it expires.
+            std::vector<int32_t> roleIds;
+            if (!roles.empty() && flow->rbacCache->authoritative() &&
+                flow->rbacCache->toRoleIds(roles, roleIds))
+                flow->token.roleIds = std::move(roleIds);
+            if (flow->returnRoles)
+            {
+                for (auto &r : roles)
+                    flow->roles.append(std::move(r));
+            }
+            flow->storage->saveAccessToken(
+                flow->token, [flow, loaded, done]() {
+                    oauth2::Metrics::observePhase(flow->phases.saveAccessToken,
+                                                  loaded,
+                                                  flow->timing.get());
+                    done();
+                });
+        });
+}
+
+/**
+ * @brief Save the new token pair and answer
+ *
+ * The access token waits for the role snapshot; the refresh token depends
+ * on neither, so its save runs alongside and the flow pays for the longer
+ * branch instead of all three round trips. The branches touch disjoint
+ * parts of the flow (token and roles vs. refreshToken).
+ */
+void issueTokens(const TokenFlowPtr &flow)
+{
+    auto fanOut = oauth2::CycleClock::now();
+    // Saves cannot report failure (VoidCallback), so neither branch ever
+    // fails: the join only waits for both
+    oauth2::joinAll(
+        [flow](bool) { respond(flow); },
+        // Branches run before joinAll returns: flow outlives them
+        [&flow, fanOut](oauth2::JoinBranch done) {
+            loadRolesAndSaveAccessToken(flow, fanOut, std::move(done));
+        },
+        [&flow, fanOut](oauth2::JoinBranch done) {
+            flow->storage->saveRefreshToken(
+                flow->refreshToken, [flow, fanOut, done]() {
+                    oauth2::Metrics::observePhase(
+                        flow->phases.saveRefreshToken,
+                        fanOut,
+                        flow->timing.get());
+                    done();
+                });
+        });
+}
+
+}  // namespace
+
 void OAuth2Plugin::exchangeCodeForToken(
     const std::string &code,
     const std::string &clientId,
-    std::function<void(const Json::Value &)> &&callback)
+    std::function<void(const Json::Value &)> &&callback,
+    oauth2::RequestTimingPtr timing)
 {
     if (!storage_)
     {
         callback(makeError("server_error"));
         return;
     }
+    // We only issue values that fit a TokenValue; anything longer is bogus
+    if (!oauth2::TokenValue::fits(code))
+    {
+        callback(makeError("invalid_grant", "Invalid authorization code"));
+        return;
+    }
 
+    auto flow = std::make_shared<TokenFlow>(storage_.get(),
+                                            rbacCache_.get(),
+                                            std::move(callback),
+                                            std::move(timing),
+                                            "IssueToken",
+                                            kExchangePhases);
+    flow->returnRoles = true;
+    // consumeAuthCode marks the code used atomically: no markAuthCodeUsed
     storage_->consumeAuthCode(
         code,
-        [this, callback = std::move(callback), clientId, code](
+        [flow,
+         clientId,
+         code,
+         accessTokenTtl = accessTokenTtl_,
+         refreshTokenTtl = refreshTokenTtl_](
             std::optional<oauth2::OAuth2AuthCode> authCode) {
+            flow->phase(oauth2::Phase::kExchangeConsumeCode);
             if (!authCode)
             {
                 LOG_WARN << "Invalid code (Not Found or Already Used): "
                          << code;
-                callback(
-                    makeError("invalid_grant", "Invalid authorization code"));
+                flow->fail("invalid_grant", "Invalid authorization code");
                 return;
             }
             if (authCode->clientId != clientId)
             {
-                callback(makeError("invalid_client"));
+                oauth2::AuditLogger::instance().log("IssueToken",
+                                                    false,
+                                                    authCode->userId,
+                                                    clientId,
+                                                    {},
+                                                    "client_mismatch");
+                flow->fail("invalid_client");
                 return;
             }
-
-            auto now = std::chrono::duration_cast<std::chrono::seconds>(
-                           std::chrono::system_clock::now().time_since_epoch())
-                           .count();
-
-            if (now > authCode->expiresAt)
+            if (unixNow() > authCode->expiresAt)
             {
                 LOG_WARN << "Code expired: " << code;
-                callback(makeError("invalid_grant", "Code expired"));
+                oauth2::AuditLogger::instance().log("IssueToken",
+                                                    false,
+                                                    authCode->userId,
+                                                    clientId,
+                                                    {},
+                                                    "code_expired");
+                flow->fail("invalid_grant", "Code expired");
                 return;
             }
 
-            // Generate Access Token (Code is already marked used by
-            // consumeAuthCode) No need to call markAuthCodeUsed again.
-            // Generate Access Token (Code is already marked used by
-            // consumeAuthCode)
-
-            // Fetch User Roles to return in response (and potentially bake into
-            // token if we switched to JWT later)
-            storage_->getUserRoles(
-                authCode->userId,
-                [this,
-                 callback,
-                 authCode,
-                 now,
-                 accessTokenTtl = accessTokenTtl_,
-                 refreshTokenTtl =
-                     refreshTokenTtl_](std::vector<std::string> roles) {
-                    // Convert roles vector to string for logs/response
-                    Json::Value rolesJson(Json::arrayValue);
-                    for (const auto &r : roles)
-                        rolesJson.append(r);
-
-                    // Generate Access Token
-                    auto tokenStr = utils::getUuid();
-                    oauth2::OAuth2AccessToken token;
-                    token.token = tokenStr;
-                    token.clientId = authCode->clientId;
-                    token.userId = authCode->userId;
-                    token.scope = authCode->scope;
-                    token.expiresAt = now + accessTokenTtl;
-
-                    // Generate Refresh Token
-                    auto refreshTokenStr = utils::getUuid();
-                    oauth2::OAuth2RefreshToken refreshToken;
-                    refreshToken.token = refreshTokenStr;
-                    refreshToken.accessToken = tokenStr;
-                    refreshToken.clientId = authCode->clientId;
-                    refreshToken.userId = authCode->userId;
-                    refreshToken.scope = authCode->scope;
-                    refreshToken.expiresAt = now + refreshTokenTtl;
-
-                    // Save Access Token
-                    storage_->saveAccessToken(
-                        token,
-                        [this, callback, token, refreshToken, rolesJson]() {
-                            // Save Refresh Token
-                            storage_->saveRefreshToken(
-                                refreshToken,
-                                [this,
-                                 callback,
-                                 token,
-                                 refreshToken,
-                                 rolesJson]() {
-                                    LOG_INFO
-                                        << "[AUDIT] Action=IssueToken User="
-                                        << token.userId
-                                        << " Client=" << token.clientId
-                                        << " Success=True";
-
-                                    Json::Value json;
-                                    json["access_token"] = token.token;
-                                    json["token_type"] = "Bearer";
-                                    json["expires_in"] = (Json::Int64)(
-                                        token.expiresAt -
-                                        std::chrono::duration_cast<
-                                            std::chrono::seconds>(
-                                            std::chrono::system_clock::now()
-                                                .time_since_epoch())
-                                            .count());
-                                    json["refresh_token"] = refreshToken.token;
-                                    json["roles"] =
-                                        rolesJson;  // Extension: Return roles
-                                    callback(json);
-                                });
-                        });
-                });
+            newTokenPair(*flow,
+                         authCode->clientId,
+                         authCode->userId,
+                         authCode->scope,
+                         accessTokenTtl,
+                         refreshTokenTtl);
+            issueTokens(flow);
         });
 }
 
 void OAuth2Plugin::refreshAccessToken(
     const std::string &refreshTokenStr,
     const std::string &clientId,
-    std::function<void(const Json::Value &)> &&callback)
+    std::function<void(const Json::Value &)> &&callback,
+    oauth2::RequestTimingPtr timing)
 {
     if (!storage_)
     {
         callback(makeError("server_error"));
         return;
     }
+    if (!oauth2::TokenValue::fits(refreshTokenStr))
+    {
+        callback(makeError("invalid_grant", "Invalid refresh token"));
+        return;
+    }
 
+    auto flow = std::make_shared<TokenFlow>(storage_.get(),
+                                            rbacCache_.get(),
+                                            std::move(callback),
+                                            std::move(timing),
+                                            "RefreshToken",
+                                            kRefreshPhases);
     storage_->getRefreshToken(
         refreshTokenStr,
-        [this, callback = std::move(callback), clientId](
+        [flow,
+         clientId,
+         accessTokenTtl = accessTokenTtl_,
+         refreshTokenTtl = refreshTokenTtl_](
             std::optional<oauth2::OAuth2RefreshToken> storedRt) {
+            flow->phase(oauth2::Phase::kRefreshLookup);
             if (!storedRt)
             {
-                callback(makeError("invalid_grant", "Invalid refresh token"));
+                flow->fail("invalid_grant", "Invalid refresh token");
                 return;
             }
             if (storedRt->clientId != clientId)
             {
-                callback(makeError("invalid_client"));
+                oauth2::AuditLogger::instance().log("RefreshToken",
+                                                    false,
+                                                    storedRt->userId,
+                                                    clientId,
+                                                    {},
+                                                    "client_mismatch");
+                flow->fail("invalid_client");
                 return;
             }
             if (storedRt->revoked)
             {
                 LOG_WARN << "Refresh token revoked: " << storedRt->token;
-                callback(makeError("invalid_grant", "Token revoked"));
+                oauth2::AuditLogger::instance().log("RefreshToken",
+                                                    false,
+                                                    storedRt->userId,
+                                                    clientId,
+                                                    {},
+                                                    "token_revoked");
+                flow->fail("invalid_grant", "Token revoked");
                 return;
             }
-
-            auto now = std::chrono::duration_cast<std::chrono::seconds>(
-                           std::chrono::system_clock::now().time_since_epoch())
-                           .count();
-
-            if (now > storedRt->expiresAt)
+            if (unixNow() > storedRt->expiresAt)
             {
-                callback(makeError("invalid_grant", "Token expired"));
+                flow->fail("invalid_grant", "Token expired");
                 return;
             }
 
-            // Generate New Tokens (Rolling Refresh Token pattern is safer, but
-            // keeping simple for now? Let's implement Rolling: Revoke old RT,
-            // Issue new RT)
-
-            // 1. Generate New Access Token
-            auto newTokenStr = utils::getUuid();
-            oauth2::OAuth2AccessToken token;
-            token.token = newTokenStr;
-            token.clientId = storedRt->clientId;
-            token.userId = storedRt->userId;
-            token.scope = storedRt->scope;
-            token.scope = storedRt->scope;
-            token.expiresAt = now + accessTokenTtl_;
-
-            // 2. Generate New Refresh Token
-            auto newRefreshTokenStr = utils::getUuid();
-            oauth2::OAuth2RefreshToken newRt;
-            newRt.token = newRefreshTokenStr;
-            newRt.accessToken = newTokenStr;
-            newRt.clientId = storedRt->clientId;
-            newRt.userId = storedRt->userId;
-            newRt.scope = storedRt->scope;
-            newRt.expiresAt = now + refreshTokenTtl_;
-
-            // 3. Save New Access Token
-            storage_->saveAccessToken(token, [this, callback, token, newRt]() {
-                // 4. Save New Refresh Token
-                storage_->saveRefreshToken(
-                    newRt, [this, callback, token, newRt]() {
-                        // We technically should revoke the old one, but
-                        // IOAuth2Storage lacks revoke(). We will skip
-                        // revocation for now as discussed, or rely on simple
-                        // overwriting if supported? Since we can't revoke, we
-                        // just issue new ones. This allows parallel usage which
-                        // is suboptimal but functional. Improving: Does
-                        // saveRefreshToken overwrite? No, UUID is different.
-
-                        Json::Value json;
-                        json["access_token"] = token.token;
-                        json["token_type"] = "Bearer";
-                        json["expires_in"] = (Json::Int64)accessTokenTtl_;
-                        json["refresh_token"] = newRt.token;
-                        callback(json);
-                    });
-            });
+            // Rolling refresh: issue a new pair. The old refresh token is
+            // not revoked, since IOAuth2Storage has no revoke operation;
+            // it stays usable until it expires.
+            newTokenPair(*flow,
+                         storedRt->clientId,
+                         storedRt->userId,
+                         storedRt->scope,
+                         accessTokenTtl,
+                         refreshTokenTtl);
+            issueTokens(flow);
         });
 }
 
+oauth2::RequestTimingPtr OAuth2Plugin::startRequestTiming(
+    const HttpRequestPtr &req,
+    std::string_view endpoint) const
+{
+    if (!serverTiming_)
+        return nullptr;
+    return std::make_shared<oauth2::RequestTiming>(req,
+                                                   endpoint,
+                                                   serverTimingLog_);
+}
+
 void OAuth2Plugin::validateAccessToken(
     const std::string &token,
-    std::function<void(std::shared_ptr<AccessToken>)> &&callback)
+    std::function<void(AccessTokenPtr)> &&callback)
 {
-    if (!storage_)
+    if (!storage_ || !oauth2::TokenValue::fits(token))
     {
         callback(nullptr);
         return;
     }
 
+    auto start = oauth2::CycleClock::now();
     storage_->getAccessToken(
-        token, [callback](std::optional<oauth2::OAuth2AccessToken> t) {
+        token, [callback = std::move(callback), start](AccessTokenPtr t) {
+            oauth2::Metrics::observePhase(oauth2::Phase::kValidateLookup,
+                                          start);
             if (!t)
             {
                 callback(nullptr);
@@ -433,7 +930,9 @@ void OAuth2Plugin::validateAccessToken(
                 return;
             }
 
-            callback(std::make_shared<oauth2::OAuth2AccessToken>(*t));
+            oauth2::Metrics::observePhase(oauth2::Phase::kValidateTotal,
+                                          start);
+            callback(std::move(t));
         });
 }
 
@@ -448,3 +947,54 @@ void OAuth2Plugin::getUserRoles(
     }
     storage_->getUserRoles(userId, std::move(callback));
 }
+
+void OAuth2Plugin::getTokenRoles(
+    const AccessToken &token,
+    std::function<void(std::vector<std::string>)> &&callback)
+{
+    if (token.roleIds)
+    {
+        callback(rbacCache_->toRoleNames(*token.roleIds));
+        return;
+    }
+    getUserRoles(token.userId, std::move(callback));
+}
+
+void OAuth2Plugin::hasPermission(const std::string &userId,
+                                 const std::string &permission,
+                                 std::function<void(bool)> &&callback)
+{
+    getUserRoles(userId,
+                 [this, permission, callback = std::move(callback)](
+                     std::vector<std::string> roles) {
+                     auto bit = rbacCache_->permissionBit(permission);
+                     callback(bit &&
+                              rbacCache_->permissionsOf(roles).test(*bit));
+                 });
+}
+
+void OAuth2Plugin::hasTokenPermission(const AccessToken &token,
+                                      const std::string &permission,
+                                      std::function<void(bool)> &&callback)
+{
+    if (!token.roleIds)
+    {
+        hasPermission(token.userId, permission, std::move(callback));
+        return;
+    }
+    auto bit = rbacCache_->permissionBit(permission);
+    callback(bit && rbacCache_->permissionsOf(*token.roleIds).test(*bit));
+}
+
+void OAuth2Plugin::invalidateUserRoles(const std::string &userId,
+                                       std::function<void()> &&callback)
+{
+    if (!storage_)
+    {
+        if (callback)
+            callback();
+        return;
+    }
+    oauth2::AuditLogger::instance().log("InvalidateRoles", true, userId, {});
+    storage_->invalidateUserRoles(userId, std::move(callback));
+}
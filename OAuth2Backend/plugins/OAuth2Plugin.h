@@ -1,8 +1,14 @@
 #pragma once
 
 #include <drogon/plugins/Plugin.h>
+#include <drogon/nosql/RedisClient.h>
 #include "IOAuth2Storage.h"
+#include "ClientCache.h"
+#include "CredentialCache.h"
 #include "OAuth2CleanupService.h"
+#include "RbacCache.h"
+#include "PgNotifyListener.h"
+#include "RequestTiming.h"
 #include <string>
 #include <memory>
 #include <functional>
@@ -11,8 +17,35 @@ class OAuth2Plugin : public drogon::Plugin<OAuth2Plugin>
 {
   public:
     using AccessToken = oauth2::OAuth2AccessToken;
+    using AccessTokenPtr = oauth2::AccessTokenPtr;
     using Client = oauth2::OAuth2Client;
 
+    /**
+     * @brief Outcome of checking an /oauth2/authorize request
+     */
+    struct AuthorizePreflight
+    {
+        enum class Error : uint8_t
+        {
+            kNone,
+            kInvalidClient,            // Unknown client_id
+            kInvalidRedirectUri,       // Not registered for the client
+            kUnsupportedResponseType,  // Anything but "code"
+            kInvalidScope              // Outside the client's allowed scopes
+        };
+
+        Error error{Error::kNone};
+        oauth2::ClientPtr client;  // Set unless kInvalidClient
+
+        bool ok() const
+        {
+            return error == Error::kNone;
+        }
+
+        // RFC 6749 error code, "" when ok
+        const char *errorCode() const;
+    };
+
     OAuth2Plugin() = default;
     void initAndStart(const Json::Value &config) override;
     void shutdown() override;
@@ -28,13 +61,29 @@ class OAuth2Plugin : public drogon::Plugin<OAuth2Plugin>
 
     /**
      * @brief Validate redirect URI (Async)
+     * Prefer preflightAuthorize() for authorization requests.
      */
     void validateRedirectUri(const std::string &clientId,
                              const std::string &redirectUri,
                              std::function<void(bool)> &&callback);
 
+    /**
+     * @brief Check an authorization request against its client (Async)
+     * One client lookup, served from the client cache when possible; the
+     * redirect URI, response type and scopes are then checked in memory,
+     * in that order, and the first failure is reported.
+     */
+    void preflightAuthorize(
+        const std::string &clientId,
+        const std::string &redirectUri,
+        const std::string &responseType,
+        const std::string &scope,
+        std::function<void(const AuthorizePreflight &)> &&callback);
+
     /**
      * @brief Generate Authorization Code (Async)
+     * @p clientId must have passed preflightAuthorize(): it is interned
+     * (Symbol), and the symbol table never shrinks.
      */
     void generateAuthorizationCode(const std::string &clientId,
                                    const std::string &userId,
@@ -44,27 +93,31 @@ class OAuth2Plugin : public drogon::Plugin<OAuth2Plugin>
     /**
      * @brief Exchange Code for Access Token (Async)
      * Returns JSON with {access_token, refresh_token, expires_in} or {error}
+     * Phases are appended to @p timing when given.
      */
     void exchangeCodeForToken(
         const std::string &code,
         const std::string &clientId,
-        std::function<void(const Json::Value &)> &&callback);
+        std::function<void(const Json::Value &)> &&callback,
+        oauth2::RequestTimingPtr timing = nullptr);
 
     /**
      * @brief Refresh Access Token (Async)
      * Returns JSON with {access_token, refresh_token, expires_in} or {error}
+     * Phases are appended to @p timing when given.
      */
     void refreshAccessToken(
         const std::string &refreshToken,
         const std::string &clientId,
-        std::function<void(const Json::Value &)> &&callback);
+        std::function<void(const Json::Value &)> &&callback,
+        oauth2::RequestTimingPtr timing = nullptr);
 
     /**
      * @brief Validate Access Token (Async)
+     * Passes the storage record through (shared, immutable), or nullptr.
      */
-    void validateAccessToken(
-        const std::string &token,
-        std::function<void(std::shared_ptr<AccessToken>)> &&callback);
+    void validateAccessToken(const std::string &token,
+                             std::function<void(AccessTokenPtr)> &&callback);
 
     /**
      * @brief Get User Roles (Async)
@@ -72,16 +125,81 @@ class OAuth2Plugin : public drogon::Plugin<OAuth2Plugin>
     void getUserRoles(const std::string &userId,
                       std::function<void(std::vector<std::string>)> &&callback);
 
+    /**
+     * @brief Get roles of a validated token's user (Async)
+     * Uses the role snapshot embedded at issue time when present, so no
+     * storage round trip is needed; otherwise falls back to getUserRoles().
+     */
+    void getTokenRoles(
+        const AccessToken &token,
+        std::function<void(std::vector<std::string>)> &&callback);
+
+    /**
+     * @brief Check whether a user holds a permission (Async)
+     * Resolves the user's roles, then tests one bit of their permission set.
+     */
+    void hasPermission(const std::string &userId,
+                       const std::string &permission,
+                       std::function<void(bool)> &&callback);
+
+    /**
+     * @brief Same as hasPermission(), using the token's role snapshot
+     */
+    void hasTokenPermission(const AccessToken &token,
+                            const std::string &permission,
+                            std::function<void(bool)> &&callback);
+
+    /**
+     * @brief Invalidate role snapshots after a user's roles changed (Async)
+     * Existing tokens stay valid and resolve roles live from then on.
+     */
+    void invalidateUserRoles(const std::string &userId,
+                             std::function<void()> &&callback);
+
+    /**
+     * @brief Per-request timing for @p req, or nullptr when the
+     * "server_timing" config block is disabled (the default)
+     */
+    oauth2::RequestTimingPtr startRequestTiming(
+        const drogon::HttpRequestPtr &req,
+        std::string_view endpoint) const;
+
     // ========== Storage Access ==========
     oauth2::IOAuth2Storage *getStorage()
     {
         return storage_.get();
     }
 
+    oauth2::RbacCache *getRbacCache()
+    {
+        return rbacCache_.get();
+    }
+
+    /**
+     * @brief Put a decorator around the storage backend; tests only
+     * Call after initAndStart(): the client cache and the cleanup service
+     * keep using the backend itself, which the decorator must own.
+     */
+    void wrapStorageForTesting(
+        const std::function<std::unique_ptr<oauth2::IOAuth2Storage>(
+            std::unique_ptr<oauth2::IOAuth2Storage>)> &wrap)
+    {
+        storage_ = wrap(std::move(storage_));
+    }
+
   private:
     std::unique_ptr<oauth2::IOAuth2Storage> storage_;
+    std::unique_ptr<oauth2::ClientCache> clientCache_;
+    std::unique_ptr<oauth2::CredentialCache> credentialCache_;
     std::unique_ptr<oauth2::OAuth2CleanupService> cleanupService_;
+    std::unique_ptr<oauth2::RbacCache> rbacCache_;
+    std::unique_ptr<oauth2::PgNotifyListener> notifyListener_;
+    std::shared_ptr<drogon::nosql::RedisSubscriber> clientSubscriber_;
+    uint64_t rbacRefreshTimerId_{0};
+    uint64_t clientReloadTimerId_{0};
     std::string storageType_;
+    bool serverTiming_{false};
+    bool serverTimingLog_{false};
 
     // TTL Configuration (Seconds)
     long authCodeTtl_{600};
@@ -89,4 +207,9 @@ class OAuth2Plugin : public drogon::Plugin<OAuth2Plugin>
     long refreshTokenTtl_{3600 * 24 * 30};
 
     void initStorage(const Json::Value &config);
+    void initRbac(const Json::Value &config);
+    void initClientCache(const Json::Value &config);
+    void onClientChanged(const std::string &clientId);
+    void onRbacChanged(const std::string &payload,
+                       const std::string &dbClientName);
 };
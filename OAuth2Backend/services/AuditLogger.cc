@@ -0,0 +1,245 @@
+#include "AuditLogger.h"
+#include <drogon/drogon.h>
+#include <trantor/net/EventLoopThread.h>
+#include <filesystem>
+
+namespace oauth2
+{
+
+namespace
+{
+
+void appendEscaped(std::string &out, std::string_view s)
+{
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) >= 0x20)
+        {
+            out += c;
+        }
+    }
+}
+
+void appendField(std::string &out, const char *key, std::string_view value)
+{
+    out += ",\"";
+    out += key;
+    out += "\":\"";
+    appendEscaped(out, value);
+    out += '"';
+}
+
+}  // namespace
+
+AuditLogger &AuditLogger::instance()
+{
+    // Leaked on purpose: producers may still log during static destruction
+    static auto *logger = new AuditLogger();
+    return *logger;
+}
+
+void AuditLogger::start(const Json::Value &config)
+{
+    if (running() || !config.get("enabled", false).asBool())
+        return;
+
+    std::lock_guard<std::mutex> lock(flushMutex_);
+    file_ = config.get("file", "./logs/audit.log").asString();
+    maxFileBytes_ = config.get("max_file_mb", 64).asUInt64() << 20;
+    maxFiles_ = std::max(config.get("max_files", 5).asUInt(), 1u);
+    const auto &pg = config["postgres"];
+    pgEnabled_ = pg.get("enabled", false).asBool();
+    pgClientName_ = pg.get("db_client_name", "default").asString();
+    pgBatchSize_ = std::max(pg.get("batch_size", 500).asUInt(), 1u);
+
+    out_.open(file_, std::ios::out | std::ios::app);
+    if (!out_.is_open())
+    {
+        LOG_ERROR << "Audit log disabled: cannot open " << file_;
+        return;
+    }
+    std::error_code ec;
+    auto size = std::filesystem::file_size(file_, ec);
+    fileSize_ = ec ? 0 : size;
+
+    // Created once and never freed, so a producer racing stop() is safe
+    if (!queue_)
+    {
+        queue_ = std::make_unique<MpscQueue<AuditEvent>>(
+            config.get("queue_size", 8192).asUInt());
+    }
+    auto interval = config.get("flush_interval_ms", 200).asDouble() / 1000.0;
+    writer_ = std::make_unique<trantor::EventLoopThread>("AuditWriter");
+    writer_->run();
+    // [this]: the logger is never destroyed (see instance())
+    writer_->getLoop()->runEvery(std::max(interval, 0.01),
+                                 [this]() { flush(); });
+    running_.store(true, std::memory_order_release);
+    LOG_INFO << "Audit log: " << file_ << " (queue " << queue_->capacity()
+             << (pgEnabled_ ? ", +postgres)" : ")");
+}
+
+void AuditLogger::stop()
+{
+    if (!running_.exchange(false))
+        return;
+    writer_.reset();  // Quits and joins the writer loop
+    flush();
+    std::lock_guard<std::mutex> lock(flushMutex_);
+    out_.close();
+}
+
+void AuditLogger::log(std::string_view action,
+                      bool success,
+                      std::string_view userId,
+                      std::string_view clientId,
+                      std::string_view ip,
+                      std::string_view reason)
+{
+    if (!running())
+    {
+        // Not configured: keep the audit trail in the shared log
+        LOG_INFO << "[AUDIT] Action=" << action << " User=" << userId
+                 << " Client=" << clientId
+                 << " Success=" << (success ? "True" : "False")
+                 << (ip.empty() ? "" : " IP=") << ip
+                 << (reason.empty() ? "" : " Reason=") << reason;
+        return;
+    }
+
+    AuditEvent event;
+    event.timestampUs = trantor::Date::now().microSecondsSinceEpoch();
+    event.action = action;
+    event.reason = reason;
+    event.success = success;
+    event.userId.assign(userId);
+    event.clientId.assign(clientId);
+    event.ip.assign(ip);
+    if (!queue_->push(event))
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AuditLogger::flush()
+{
+    std::lock_guard<std::mutex> lock(flushMutex_);
+    if (!queue_)
+        return;
+    std::vector<AuditEvent> batch;
+    AuditEvent event;
+    while (queue_->pop(event))
+        batch.push_back(event);
+
+    auto dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reportedDrops_)
+    {
+        LOG_WARN << "Audit queue full: dropped " << dropped - reportedDrops_
+                 << " events (" << dropped << " total)";
+        reportedDrops_ = dropped;
+    }
+    if (batch.empty())
+        return;
+
+    writeFile(batch);
+    if (pgEnabled_)
+        writePostgres(batch);
+    written_.fetch_add(batch.size(), std::memory_order_relaxed);
+}
+
+void AuditLogger::writeFile(const std::vector<AuditEvent> &batch)
+{
+    if (!out_.is_open())
+        return;
+    std::string buf;
+    buf.reserve(batch.size() * 200);
+    for (const auto &event : batch)
+    {
+        buf += toJson(event);
+        buf += '\n';
+    }
+    out_.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+    out_.flush();
+    fileSize_ += buf.size();
+    rotateIfNeeded();
+}
+
+void AuditLogger::rotateIfNeeded()
+{
+    if (fileSize_ < maxFileBytes_)
+        return;
+    out_.close();
+    // audit.log -> audit.log.1 -> ... -> audit.log.<max_files> (dropped)
+    std::error_code ec;
+    for (auto i = maxFiles_; i > 1; --i)
+    {
+        std::filesystem::rename(file_ + "." + std::to_string(i - 1),
+                                file_ + "." + std::to_string(i),
+                                ec);
+    }
+    std::filesystem::rename(file_, file_ + ".1", ec);
+    if (ec)
+        LOG_ERROR << "Audit log rotation failed: " << ec.message();
+    out_.open(file_, std::ios::out | std::ios::app);
+    fileSize_ = 0;
+}
+
+void AuditLogger::writePostgres(const std::vector<AuditEvent> &batch)
+{
+    auto db = drogon::app().getDbClient(pgClientName_);
+    if (!db)
+        return;
+    for (size_t begin = 0; begin < batch.size(); begin += pgBatchSize_)
+    {
+        auto end = std::min(batch.size(), begin + pgBatchSize_);
+        std::string rows = "[";
+        for (auto i = begin; i < end; ++i)
+        {
+            if (i > begin)
+                rows += ',';
+            rows += toJson(batch[i]);
+        }
+        rows += ']';
+        auto count = end - begin;
+        // Raw SQL: the ORM inserts one row per statement; expanding a JSON
+        // array inserts the whole batch in one round trip with a fixed
+        // statement (and a single bound parameter)
+        db->execSqlAsync(
+            "INSERT INTO oauth2_audit_log "
+            "(occurred_at, action, user_id, client_id, ip, success, reason) "
+            "SELECT to_timestamp((e->>'ts')::double precision / 1e6), "
+            "e->>'action', e->>'user', e->>'client', "
+            "NULLIF(e->>'ip', ''), (e->>'success')::boolean, "
+            "NULLIF(e->>'reason', '') "
+            "FROM json_array_elements($1::json) AS e",
+            [](const drogon::orm::Result &) {},
+            [count](const drogon::orm::DrogonDbException &e) {
+                // The file sink already has these events
+                LOG_ERROR << "Audit Postgres sink failed for " << count
+                          << " events: " << e.base().what();
+            },
+            rows);
+    }
+}
+
+std::string AuditLogger::toJson(const AuditEvent &event)
+{
+    std::string out = "{\"ts\":";
+    out += std::to_string(event.timestampUs);
+    appendField(out, "action", event.action);
+    appendField(out, "user", event.userId.view());
+    appendField(out, "client", event.clientId.view());
+    if (event.ip.size)
+        appendField(out, "ip", event.ip.view());
+    out += ",\"success\":";
+    out += event.success ? "true" : "false";
+    if (!event.reason.empty())
+        appendField(out, "reason", event.reason);
+    out += '}';
+    return out;
+}
+
+}  // namespace oauth2
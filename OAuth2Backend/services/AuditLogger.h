@@ -0,0 +1,141 @@
+#pragma once
+
+#include "MpscQueue.h"
+#include <json/json.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace trantor
+{
+class EventLoopThread;
+}
+
+namespace oauth2
+{
+
+/**
+ * @brief One security-relevant event, fixed size so queueing never
+ * allocates. Longer fields are truncated.
+ */
+struct AuditEvent
+{
+    template <size_t N>
+    struct Field
+    {
+        std::array<char, N> data{};
+        uint8_t size{0};
+
+        void assign(std::string_view s)
+        {
+            size = static_cast<uint8_t>(std::min(s.size(), N));
+            std::copy_n(s.data(), size, data.data());
+        }
+        std::string_view view() const
+        {
+            return {data.data(), size};
+        }
+    };
+
+    int64_t timestampUs{0};
+    std::string_view action;  // Literal, e.g. "IssueToken"
+    std::string_view reason;  // Literal, empty on success
+    Field<64> userId;
+    Field<64> clientId;
+    Field<46> ip;  // Fits an IPv6 address
+    bool success{true};
+};
+
+/**
+ * @brief Dedicated, asynchronous audit trail
+ *
+ * log() copies the event into a bounded lock-free MPSC queue and returns;
+ * a background trantor loop drains it every "flush_interval_ms" into an
+ * append-only JSON-lines file (rotated by size) and, optionally, into the
+ * oauth2_audit_log table in batches (sql/006). When the queue is full the
+ * event is dropped and counted rather than blocking the request thread.
+ *
+ * Until start() succeeds (tests, tools) events go to the shared logger
+ * as "[AUDIT] ..." lines, as before.
+ *
+ * Configured from the OAuth2Plugin config "audit":
+ * {enabled, file, max_file_mb, max_files, queue_size, flush_interval_ms,
+ *  postgres: {enabled, db_client_name, batch_size}}
+ */
+class AuditLogger
+{
+  public:
+    static AuditLogger &instance();
+
+    void start(const Json::Value &config);
+
+    /**
+     * @brief Drain what is queued, then stop the writer
+     */
+    void stop();
+
+    bool running() const
+    {
+        return running_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @param action Literal (must outlive the process)
+     * @param reason Literal; empty for successful actions
+     */
+    void log(std::string_view action,
+             bool success,
+             std::string_view userId,
+             std::string_view clientId,
+             std::string_view ip = {},
+             std::string_view reason = {});
+
+    /**
+     * @brief Write out everything queued so far (writer thread, or tests)
+     */
+    void flush();
+
+    uint64_t dropped() const
+    {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+    uint64_t written() const
+    {
+        return written_.load(std::memory_order_relaxed);
+    }
+
+    // {"ts":...,"action":...,...}, without newline
+    static std::string toJson(const AuditEvent &event);
+
+  private:
+    AuditLogger() = default;
+    void writeFile(const std::vector<AuditEvent> &batch);
+    void writePostgres(const std::vector<AuditEvent> &batch);
+    void rotateIfNeeded();
+
+    std::atomic<bool> running_{false};
+    std::unique_ptr<MpscQueue<AuditEvent>> queue_;
+    std::unique_ptr<trantor::EventLoopThread> writer_;
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> written_{0};
+    uint64_t reportedDrops_{0};
+
+    std::mutex flushMutex_;  // Single consumer; everything below
+    std::string file_;
+    std::ofstream out_;
+    uint64_t fileSize_{0};
+    uint64_t maxFileBytes_{64ULL << 20};
+    uint32_t maxFiles_{5};
+    bool pgEnabled_{false};
+    std::string pgClientName_{"default"};
+    size_t pgBatchSize_{500};
+};
+
+}  // namespace oauth2
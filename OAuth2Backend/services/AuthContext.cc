@@ -0,0 +1,110 @@
+#include "AuthContext.h"
+#include "plugins/OAuth2Plugin.h"
+#include <drogon/drogon.h>
+#include <sstream>
+
+namespace oauth2
+{
+
+bool AuthContext::hasScope(const std::string &scope) const
+{
+    for (const auto &s : scopes)
+    {
+        if (s == scope)
+            return true;
+    }
+    return false;
+}
+
+AuthContextPtr getAuthContext(const drogon::HttpRequestPtr &req)
+{
+    const auto &attrs = req->getAttributes();
+    if (!attrs->find(AuthContext::kAttributeKey))
+        return nullptr;
+    return attrs->get<AuthContextPtr>(AuthContext::kAttributeKey);
+}
+
+static std::string extractToken(const drogon::HttpRequestPtr &req,
+                                bool allowQueryToken)
+{
+    const auto &authHeader = req->getHeader("Authorization");
+    if (authHeader.size() > 7 && authHeader.compare(0, 7, "Bearer ") == 0)
+        return authHeader.substr(7);
+    if (allowQueryToken)
+        return req->getParameter("access_token");
+    return {};
+}
+
+void resolveAuthContext(
+    const drogon::HttpRequestPtr &req,
+    bool allowQueryToken,
+    std::function<void(AuthContextPtr, AuthError)> &&callback)
+{
+    if (auto ctx = getAuthContext(req))
+    {
+        callback(ctx, AuthError::kNone);
+        return;
+    }
+
+    auto token = extractToken(req, allowQueryToken);
+    if (token.empty())
+    {
+        callback(nullptr, AuthError::kMissingToken);
+        return;
+    }
+
+    auto plugin = drogon::app().getPlugin<OAuth2Plugin>();
+    if (!plugin)
+    {
+        LOG_ERROR << "OAuth2Plugin not found!";
+        callback(nullptr, AuthError::kServerError);
+        return;
+    }
+
+    plugin->validateAccessToken(
+        token,
+        [req, token, callback = std::move(callback)](AccessTokenPtr at) {
+            if (!at)
+            {
+                callback(nullptr, AuthError::kInvalidToken);
+                return;
+            }
+
+            auto ctx = std::make_shared<AuthContext>();
+            ctx->token = token;
+            ctx->accessToken = at;
+            std::istringstream scopes(at->scope);
+            std::string scope;
+            while (scopes >> scope)
+                ctx->scopes.push_back(scope);
+
+            auto &attrs = req->getAttributes();
+            attrs->insert(AuthContext::kAttributeKey, ctx);
+            // Legacy attributes, kept for existing handlers
+            attrs->insert("userId", at->userId);
+            attrs->insert("scope", at->scope);
+            attrs->insert("clientId", at->clientId.str());
+
+            callback(ctx, AuthError::kNone);
+        });
+}
+
+void resolveRoles(const AuthContextPtr &ctx,
+                  OAuth2Plugin &plugin,
+                  std::function<void(const std::vector<std::string> &)>
+                      &&callback)
+{
+    if (ctx->roles)
+    {
+        callback(*ctx->roles);
+        return;
+    }
+    plugin.getTokenRoles(*ctx->accessToken,
+                         [ctx, callback = std::move(callback)](
+                             std::vector<std::string> roles) {
+                             ctx->roles = std::move(roles);
+                             callback(*ctx->roles);
+                         });
+}
+
+}  // namespace oauth2
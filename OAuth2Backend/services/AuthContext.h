@@ -0,0 +1,71 @@
+#pragma once
+
+#include <drogon/HttpRequest.h>
+#include "../storage/IOAuth2Storage.h"
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+class OAuth2Plugin;
+
+namespace oauth2
+{
+
+/**
+ * @brief Per-request authentication state, resolved once
+ *
+ * OAuth2Middleware and AuthorizationFilter both need the validated token.
+ * The first one to run stores an AuthContext in the request attributes;
+ * later filters and the controller reuse it instead of parsing the header
+ * and hitting storage again.
+ */
+struct AuthContext
+{
+    static constexpr const char *kAttributeKey = "oauth2.auth_context";
+
+    std::string token;  // Raw bearer token
+    AccessTokenPtr accessToken;
+    std::vector<std::string> scopes;  // accessToken->scope split on spaces
+    std::optional<std::vector<std::string>> roles;  // Resolved on demand
+
+    bool hasScope(const std::string &scope) const;
+};
+
+using AuthContextPtr = std::shared_ptr<AuthContext>;
+
+enum class AuthError
+{
+    kNone,
+    kMissingToken,
+    kInvalidToken,
+    kServerError
+};
+
+/**
+ * @brief AuthContext already stored on this request, or nullptr
+ */
+AuthContextPtr getAuthContext(const drogon::HttpRequestPtr &req);
+
+/**
+ * @brief Get or build the request's AuthContext (Async)
+ * Takes the token from "Authorization: Bearer", or from the access_token
+ * parameter when @p allowQueryToken is set. On success the context and the
+ * legacy userId / scope / clientId attributes are stored on the request.
+ */
+void resolveAuthContext(
+    const drogon::HttpRequestPtr &req,
+    bool allowQueryToken,
+    std::function<void(AuthContextPtr, AuthError)> &&callback);
+
+/**
+ * @brief Resolve the context's roles once (Async)
+ * Uses the token's embedded role snapshot when present.
+ */
+void resolveRoles(const AuthContextPtr &ctx,
+                  OAuth2Plugin &plugin,
+                  std::function<void(const std::vector<std::string> &)>
+                      &&callback);
+
+}  // namespace oauth2
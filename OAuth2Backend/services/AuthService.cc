@@ -1,9 +1,9 @@
 #include "AuthService.h"
 #include "../models/Users.h"
-#include "../models/Roles.h"
-#include "../models/UserRoles.h"
+#include "CredentialHasher.h"
+#include "plugins/OAuth2Plugin.h"
 #include <drogon/utils/Utilities.h>
-#include <algorithm>
+#include <trantor/net/EventLoop.h>
 
 using namespace drogon;
 using namespace drogon::orm;
@@ -11,11 +11,32 @@ using namespace drogon::orm;
 namespace services
 {
 
+namespace
+{
+
+// ID of the role every new user gets, from the plugin's RBAC catalog.
+// Only trusted once the catalog was loaded from the database users are
+// written to: the built-in seed's IDs need not match its roles table.
+std::optional<int32_t> defaultRoleId()
+{
+    auto plugin = app().getPlugin<OAuth2Plugin>();
+    if (!plugin || !plugin->getRbacCache())
+        return std::nullopt;
+    auto rbac = plugin->getRbacCache();
+    if (!rbac->loadedFrom("default"))
+        return std::nullopt;
+    return rbac->roleId("user");
+}
+
+}  // namespace
+
 void AuthService::validateUser(
     const std::string &username,
     const std::string &password,
-    std::function<void(std::optional<int> userId)> &&callback)
+    std::function<void(std::optional<int> userId, bool busy)> &&callback)
 {
+    // The DB answers on its own loop: hash results go back to this one
+    auto *loop = trantor::EventLoop::getEventLoopOfCurrentThread();
     try
     {
         auto mapper =
@@ -26,47 +47,37 @@ void AuthService::validateUser(
             {drogon_model::oauth_test::Users::Cols::_username,
              CompareOperator::EQ,
              username},
-            [callback = std::move(callback),
-             password](const drogon_model::oauth_test::Users &user) {
-                // Compute Hash
-                std::string salt = user.getValueOfSalt();
-                std::string dbHash = user.getValueOfPasswordHash();
-                std::string inputHash = utils::getSha256(password + salt);
-
-                // Compare (Case insensitive for Hex)
-                bool valid = false;
-                if (inputHash.length() == dbHash.length())
-                {
-                    std::string inputLower = inputHash;
-                    std::string dbLower = dbHash;
-
-                    std::transform(inputLower.begin(),
-                                   inputLower.end(),
-                                   inputLower.begin(),
-                                   ::tolower);
-                    std::transform(dbLower.begin(),
-                                   dbLower.end(),
-                                   dbLower.begin(),
-                                   ::tolower);
-
-                    if (inputLower == dbLower)
-                        valid = true;
-                }
-
-                if (valid)
-                    callback(user.getValueOfId());
-                else
-                    callback(std::nullopt);
+            [callback, password, loop](
+                const drogon_model::oauth_test::Users &user) {
+                using Status = oauth2::CredentialHasher::Status;
+                oauth2::CredentialHasher::instance().verify(
+                    password,
+                    user.getValueOfSalt(),
+                    user.getValueOfPasswordHash(),
+                    [callback, userId = user.getValueOfId()](Status status,
+                                                             bool match) {
+                        if (status != Status::kOk)
+                        {
+                            LOG_WARN << "Validate User: password hasher busy";
+                            callback(std::nullopt, true);
+                            return;
+                        }
+                        if (match)
+                            callback(userId, false);
+                        else
+                            callback(std::nullopt, false);
+                    },
+                    loop);
             },
             [callback](const DrogonDbException &e) {
                 LOG_WARN << "Validate User Failed: " << e.base().what();
-                callback(std::nullopt);
+                callback(std::nullopt, false);
             });
     }
     catch (const DrogonDbException &e)
     {
         LOG_WARN << "Validate User Init Failed: " << e.base().what();
-        callback(std::nullopt);
+        callback(std::nullopt, false);
     }
 }
 
@@ -76,83 +87,112 @@ void AuthService::registerUser(
     const std::string &email,
     std::function<void(const std::string &error)> &&callback)
 {
-    // Hash Password
-    std::string salt = utils::getUuid();
-    std::string passwordHash = utils::getSha256(password + salt);
-
-    drogon_model::oauth_test::Users newUser;
-    newUser.setUsername(username);
-    newUser.setPasswordHash(passwordHash);
-    newUser.setSalt(salt);
-    if (!email.empty())
-        newUser.setEmail(email);
+    // Hash off the IO thread; the insert continues on this loop
+    auto salt = utils::getUuid();
+    oauth2::CredentialHasher::instance().hash(
+        password,
+        salt,
+        [username, email, salt, callback = std::move(callback)](
+            oauth2::CredentialHasher::Status status,
+            std::string passwordHash) {
+            if (status != oauth2::CredentialHasher::Status::kOk)
+            {
+                LOG_WARN << "Register: password hasher busy";
+                callback(kBusyError);
+                return;
+            }
+            insertUser(username,
+                       email,
+                       salt,
+                       passwordHash,
+                       defaultRoleId(),
+                       callback);
+        });
+}
 
+void AuthService::insertUser(
+    const std::string &username,
+    const std::string &email,
+    const std::string &salt,
+    const std::string &passwordHash,
+    std::optional<int32_t> roleId,
+    const std::function<void(const std::string &error)> &callback)
+{
     try
     {
         auto db = app().getDbClient();
-        // Start Transaction? For now, just chain.
+        auto onInserted = [callback](const Result &) {
+            callback("");  // Success
+        };
+        auto onError = [username, email, salt, passwordHash, roleId, callback](
+                           const DrogonDbException &e) {
+            // A role ID cached before the role was recreated: the statement
+            // rolled back whole, so retry it once resolving the name
+            auto *sqlError = dynamic_cast<const SqlError *>(&e.base());
+            if (roleId && sqlError && sqlError->sqlState() == "23503")
+            {
+                LOG_WARN << "Cached role ID " << *roleId
+                         << " for 'user' is stale, retrying by name";
+                insertUser(username,
+                           email,
+                           salt,
+                           passwordHash,
+                           std::nullopt,
+                           callback);
+                return;
+            }
+            // No "user" role: the subselect gave NULL and nothing was written
+            if (sqlError && sqlError->sqlState() == "23502")
+            {
+                LOG_ERROR << "Default Role 'user' not found, cannot register "
+                          << username;
+                callback("Internal Server Error");
+                return;
+            }
+            LOG_ERROR << "Register Failed: " << e.base().what();
+            // Usually duplicate username
+            callback("Registration Failed (Username likely exists)");
+        };
 
-        auto mapper = Mapper<drogon_model::oauth_test::Users>(db);
-
-        // Async Insert
-        mapper.insert(
-            newUser,
-            [db, callback](const drogon_model::oauth_test::Users &u) {
-                // Assign Default Role "user"
-                try
-                {
-                    auto roleMapper =
-                        Mapper<drogon_model::oauth_test::Roles>(db);
-                    roleMapper.findOne(
-                        Criteria(drogon_model::oauth_test::Roles::Cols::_name,
-                                 CompareOperator::EQ,
-                                 "user"),
-                        [db, callback, userId = u.getValueOfId()](
-                            const drogon_model::oauth_test::Roles &role) {
-                            try
-                            {
-                                auto urMapper =
-                                    Mapper<drogon_model::oauth_test::UserRoles>(
-                                        db);
-                                drogon_model::oauth_test::UserRoles ur;
-                                ur.setUserId(userId);
-                                ur.setRoleId(role.getValueOfId());
-
-                                urMapper.insert(
-                                    ur,
-                                    [callback](const drogon_model::oauth_test::
-                                                   UserRoles &) {
-                                        callback("");  // Success
-                                    },
-                                    [callback](const DrogonDbException &e) {
-                                        LOG_ERROR << "Assign Role Failed: "
-                                                  << e.base().what();
-                                        callback("");  // Treat as success for
-                                                       // now (User created),
-                                                       // but log error
-                                    });
-                            }
-                            catch (...)
-                            {
-                                callback("");
-                            }
-                        },
-                        [callback](const DrogonDbException &e) {
-                            LOG_ERROR << "Default Role 'user' not found: "
-                                      << e.base().what();
-                            callback("");  // User created w/o role
-                        });
-                }
-                catch (...)
-                {
-                    callback("");
-                }
-            },
-            [callback](const DrogonDbException &e) {
-                LOG_ERROR << "Register Failed: " << e.base().what();
-                // Usually duplicate username
-                callback("Registration Failed (Username likely exists)");
-            });
+        // Raw SQL: the ORM needs a round trip each to insert the user, look
+        // up the role and insert user_roles, and a failure between them
+        // leaves a user without a role. One statement does all of it
+        // atomically.
+        if (roleId)
+        {
+            db->execSqlAsync(
+                "WITH u AS (INSERT INTO users "
+                "(username, password_hash, salt, email) "
+                "VALUES ($1, $2, $3, NULLIF($4, '')) RETURNING id) "
+                "INSERT INTO user_roles (user_id, role_id) "
+                "SELECT id, $5 FROM u RETURNING user_id",
+                std::move(onInserted),
+                std::move(onError),
+                username,
+                passwordHash,
+                salt,
+                email,
+                *roleId);
+        }
+        else
+        {
+            // Role catalog not loaded from this DB: resolve the name in the
+            // same query. A missing role yields NULL, which role_id's NOT
+            // NULL rejects, so the user is not written either.
+            db->execSqlAsync(
+                "WITH u AS (INSERT INTO users "
+                "(username, password_hash, salt, email) "
+                "VALUES ($1, $2, $3, NULLIF($4, '')) RETURNING id) "
+                "INSERT INTO user_roles (user_id, role_id) "
+                "SELECT u.id, (SELECT id FROM roles WHERE name = 'user') "
+                "FROM u RETURNING user_id",
+                std::move(onInserted),
+                std::move(onError),
+                username,
+                passwordHash,
+                salt,
+                email);
+        }
     }
     catch (const DrogonDbException &e)
     {
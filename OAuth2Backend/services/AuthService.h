@@ -10,20 +10,38 @@ namespace services
 class AuthService
 {
   public:
+    // 注册时密码哈希线程池繁忙的错误消息 (可重试)
+    static constexpr const char *kBusyError = "Server Busy, Retry Later";
+
     // 异步验证用户凭据
-    // callback: 成功返回 true，失败返回 false
+    // callback: 成功返回 userId，失败返回 std::nullopt；
+    // busy 为 true 表示哈希线程池繁忙，未校验 (可重试)
+    // 哈希在 CredentialHasher 线程池中计算，回调回到调用方
     static void validateUser(
         const std::string &username,
         const std::string &password,
-        std::function<void(std::optional<int> userId)> &&callback);
+        std::function<void(std::optional<int> userId, bool busy)> &&callback);
 
     // 异步注册用户
     // callback: 成功返回空字符串，失败返回错误消息
+    // (线程池繁忙时为 kBusyError)
     static void registerUser(
         const std::string &username,
         const std::string &password,
         const std::string &email,
         std::function<void(const std::string &error)> &&callback);
+
+  private:
+    // 写入已哈希的新用户并分配默认角色 (单条 SQL，原子执行)
+    // roleId: 从同一数据库加载的 RbacCache 中 "user" 角色的 ID；
+    // 为空时在 SQL 中按名称查找，角色不存在则注册失败
+    static void insertUser(
+        const std::string &username,
+        const std::string &email,
+        const std::string &salt,
+        const std::string &passwordHash,
+        std::optional<int32_t> roleId,
+        const std::function<void(const std::string &error)> &callback);
 };
 
 }  // namespace services
@@ -0,0 +1,175 @@
+#include "CircuitBreaker.h"
+#include "plugins/OAuth2Metrics.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+#include <chrono>
+
+namespace oauth2
+{
+
+namespace
+{
+
+constexpr uint8_t kFailed = 1;
+constexpr uint8_t kSlow = 2;
+
+int64_t steadyNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+}  // namespace
+
+const char *toString(CircuitBreaker::State state)
+{
+    switch (state)
+    {
+        case CircuitBreaker::State::kClosed:
+            return "closed";
+        case CircuitBreaker::State::kOpen:
+            return "open";
+        case CircuitBreaker::State::kHalfOpen:
+            return "half_open";
+    }
+    return "unknown";
+}
+
+CircuitBreaker::Options CircuitBreaker::Options::fromConfig(
+    const Json::Value &config)
+{
+    Options options;
+    options.window = std::max(config.get("window", 50).asUInt(), 1u);
+    options.minCalls =
+        std::min<size_t>(config.get("min_calls", 20).asUInt(), options.window);
+    options.failureRate = config.get("failure_rate", 0.5).asDouble();
+    options.slowCallNanos = static_cast<int64_t>(
+        config.get("slow_call_ms", 250).asDouble() * 1e6);
+    options.slowCallRate = config.get("slow_call_rate", 0.8).asDouble();
+    options.openNanos =
+        static_cast<int64_t>(config.get("open_ms", 5000).asDouble() * 1e6);
+    options.halfOpenProbes =
+        std::max(config.get("half_open_probes", 3).asUInt(), 1u);
+    return options;
+}
+
+CircuitBreaker::CircuitBreaker(std::string backend, Options options)
+    : backend_(std::move(backend)),
+      options_(options),
+      outcomes_(options.window, 0)
+{
+    Metrics::setCircuitState(backend_,
+                             static_cast<int>(State::kClosed),
+                             static_cast<int>(State::kClosed));
+}
+
+bool CircuitBreaker::allow()
+{
+    if (state() == State::kClosed)
+        return true;
+
+    auto now = steadyNanos();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto current = state_.load(std::memory_order_relaxed);
+    if (current == State::kClosed)
+        return true;
+    if (current == State::kOpen)
+    {
+        if (now - openedAt_ < options_.openNanos)
+            return false;
+        transition(State::kHalfOpen, now);
+    }
+    if (probesInFlight_ >= options_.halfOpenProbes)
+        return false;
+    ++probesInFlight_;
+    return true;
+}
+
+void CircuitBreaker::record(bool ok, int64_t latencyNanos)
+{
+    bool slow = latencyNanos >= options_.slowCallNanos;
+    std::lock_guard<std::mutex> lock(mutex_);
+    switch (state_.load(std::memory_order_relaxed))
+    {
+        case State::kClosed:
+        {
+            uint8_t outcome = (ok ? 0 : kFailed) | (slow ? kSlow : 0);
+            auto &slot = outcomes_[next_];
+            if (filled_ == outcomes_.size())
+            {
+                failures_ -= (slot & kFailed) ? 1 : 0;
+                slow_ -= (slot & kSlow) ? 1 : 0;
+            }
+            else
+            {
+                ++filled_;
+            }
+            slot = outcome;
+            failures_ += ok ? 0 : 1;
+            slow_ += slow ? 1 : 0;
+            next_ = (next_ + 1) % outcomes_.size();
+
+            if (filled_ < options_.minCalls)
+                return;
+            auto calls = static_cast<double>(filled_);
+            if (failures_ / calls >= options_.failureRate ||
+                slow_ / calls >= options_.slowCallRate)
+            {
+                transition(State::kOpen, steadyNanos());
+            }
+            return;
+        }
+        case State::kOpen:
+            // Admitted before the breaker opened; nothing left to decide
+            return;
+        case State::kHalfOpen:
+            if (probesInFlight_ > 0)
+                --probesInFlight_;
+            if (!ok || slow)
+            {
+                transition(State::kOpen, steadyNanos());
+            }
+            else if (++probeSuccesses_ >= options_.halfOpenProbes)
+            {
+                transition(State::kClosed, 0);
+            }
+            return;
+    }
+}
+
+void CircuitBreaker::transition(State to, int64_t now)
+{
+    auto from = state_.load(std::memory_order_relaxed);
+    if (to == State::kOpen)
+    {
+        LOG_WARN << "Circuit breaker (" << backend_ << ") " << toString(from)
+                 << " -> open: " << failures_ << " failed, " << slow_
+                 << " slow of last " << filled_ << " calls";
+        openedAt_ = now;
+    }
+    else
+    {
+        LOG_INFO << "Circuit breaker (" << backend_ << ") " << toString(from)
+                 << " -> " << toString(to);
+    }
+    if (to != State::kHalfOpen)
+        resetWindow();
+    probesInFlight_ = 0;
+    probeSuccesses_ = 0;
+    state_.store(to, std::memory_order_release);
+    Metrics::setCircuitState(backend_,
+                             static_cast<int>(from),
+                             static_cast<int>(to));
+}
+
+void CircuitBreaker::resetWindow()
+{
+    std::fill(outcomes_.begin(), outcomes_.end(), 0);
+    next_ = 0;
+    filled_ = 0;
+    failures_ = 0;
+    slow_ = 0;
+}
+
+}  // namespace oauth2
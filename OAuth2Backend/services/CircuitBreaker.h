@@ -0,0 +1,110 @@
+#pragma once
+
+#include <json/json.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace oauth2
+{
+
+/**
+ * @brief Closed / open / half-open breaker in front of one backend
+ *
+ * Closed: every call goes through and its outcome lands in a sliding
+ * window of the last "window" calls. Once the window holds "min_calls"
+ * outcomes and either the error rate reaches "failure_rate" or the share
+ * of calls slower than "slow_call_ms" reaches "slow_call_rate", the
+ * breaker opens.
+ *
+ * Open: allow() refuses every call for "open_ms", then the breaker turns
+ * half-open.
+ *
+ * Half-open: up to "half_open_probes" calls are let through at a time.
+ * Any failed or slow probe re-opens the breaker; that many successful
+ * probes in a row close it with an empty window.
+ *
+ * Transitions are logged and exported as oauth2_circuit_breaker_state /
+ * oauth2_circuit_breaker_transitions_total. Thread-safe; allow() on a
+ * closed breaker is a single atomic load.
+ */
+class CircuitBreaker
+{
+  public:
+    enum class State : uint8_t
+    {
+        kClosed,
+        kOpen,
+        kHalfOpen
+    };
+
+    struct Options
+    {
+        size_t window{50};
+        size_t minCalls{20};
+        double failureRate{0.5};
+        int64_t slowCallNanos{250'000'000};
+        double slowCallRate{0.8};
+        int64_t openNanos{5'000'000'000};
+        size_t halfOpenProbes{3};
+
+        /**
+         * {window, min_calls, failure_rate, slow_call_ms, slow_call_rate,
+         *  open_ms, half_open_probes}
+         */
+        static Options fromConfig(const Json::Value &config);
+    };
+
+    CircuitBreaker(std::string backend, Options options);
+
+    /**
+     * @brief Whether to send a call to the backend now
+     *
+     * Every true answer must be followed by exactly one record() once the
+     * call completes; false means skip the backend (degraded path).
+     */
+    bool allow();
+
+    /**
+     * @param ok false for errors and timeouts; a well-formed "not found"
+     * is a success
+     * @param latencyNanos time from issuing the call to its completion
+     */
+    void record(bool ok, int64_t latencyNanos);
+
+    State state() const
+    {
+        return state_.load(std::memory_order_acquire);
+    }
+
+    const std::string &backend() const
+    {
+        return backend_;
+    }
+
+  private:
+    // mutex_ held
+    void transition(State to, int64_t now);
+    void resetWindow();
+
+    const std::string backend_;
+    const Options options_;
+    std::atomic<State> state_{State::kClosed};
+
+    mutable std::mutex mutex_;
+    // Ring of the last options_.window outcomes (kFailed | kSlow bits)
+    std::vector<uint8_t> outcomes_;
+    size_t next_{0};
+    size_t filled_{0};
+    size_t failures_{0};
+    size_t slow_{0};
+    int64_t openedAt_{0};  // steady_clock nanoseconds
+    size_t probesInFlight_{0};
+    size_t probeSuccesses_{0};
+};
+
+const char *toString(CircuitBreaker::State state);
+
+}  // namespace oauth2
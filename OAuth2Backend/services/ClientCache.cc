@@ -0,0 +1,234 @@
+#include "ClientCache.h"
+#include "plugins/OAuth2Metrics.h"
+#include <trantor/utils/Logger.h>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <mutex>
+
+namespace oauth2
+{
+
+namespace
+{
+
+int64_t steadyNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+}  // namespace
+
+ClientRecord::ClientRecord(OAuth2Client client)
+    : OAuth2Client(std::move(client)),
+      redirectUriSet(redirectUris.begin(), redirectUris.end()),
+      scopeSet(allowedScopes.begin(), allowedScopes.end())
+{
+}
+
+ClientCache::Options ClientCache::Options::fromConfig(
+    const Json::Value &config)
+{
+    Options options;
+    options.ttlNanos = static_cast<int64_t>(
+        config.get("ttl_seconds", 60).asDouble() * 1e9);
+    options.maxEntries =
+        std::max(config.get("max_entries", 10000).asUInt(), 1u);
+    return options;
+}
+
+ClientCache::ClientCache(IOAuth2Storage *storage, Options options)
+    : storage_(storage), options_(options)
+{
+}
+
+void ClientCache::getClient(const std::string &clientId, Callback &&cb)
+{
+    if (auto client = find(clientId))
+    {
+        Metrics::incClientCache(true);
+        cb(std::move(client));
+        return;
+    }
+    Metrics::incClientCache(false);
+    // The plugin owns both the cache and the storage, and outlives every
+    // request: capturing this is safe
+    storage_->getClient(
+        clientId,
+        [this, cb = std::move(cb)](std::optional<OAuth2Client> client) {
+            if (!client)
+            {
+                cb(nullptr);
+                return;
+            }
+            auto shared =
+                std::make_shared<const ClientRecord>(std::move(*client));
+            put(shared);
+            cb(std::move(shared));
+        });
+}
+
+void ClientCache::load(LoadCallback &&cb)
+{
+    // A refresh applied while the list is in flight may be newer than it
+    auto since = refreshGeneration();
+    // Same ownership as getClient(): capturing this is safe
+    storage_->listClients(
+        [this, since, cb = std::move(cb)](std::vector<OAuth2Client> clients) {
+            bool ok = !clients.empty();
+            if (ok)
+            {
+                LOG_INFO << "ClientCache: loaded " << clients.size()
+                         << " clients";
+                replaceAll(std::move(clients), since);
+            }
+            else
+            {
+                // Empty reads as failure: never wipe a working registry
+                LOG_WARN << "ClientCache: no clients loaded, keeping "
+                         << size() << " cached";
+            }
+            if (cb)
+                cb(ok);
+        });
+}
+
+void ClientCache::refresh(const std::string &clientId)
+{
+    // Same ownership as getClient(): capturing this is safe
+    storage_->getClient(
+        clientId, [this, clientId](std::optional<OAuth2Client> client) {
+            ClientPtr record;
+            if (client)
+                record =
+                    std::make_shared<const ClientRecord>(std::move(*client));
+            auto now = steadyNanos();
+            // Stored and marked together, so replaceAll() sees both or
+            // neither
+            std::unique_lock lock(mutex_);
+            refreshed_[clientId] = ++generation_;
+            if (record)
+                store(std::move(record), now);
+            else
+                entries_.erase(clientId);
+        });
+}
+
+ClientPtr ClientCache::find(const std::string &clientId) const
+{
+    std::shared_lock lock(mutex_);
+    auto it = entries_.find(clientId);
+    if (it == entries_.end() || it->second.expiresAt <= steadyNanos())
+        return nullptr;
+    return it->second.client;
+}
+
+void ClientCache::put(ClientPtr client)
+{
+    auto now = steadyNanos();
+    std::unique_lock lock(mutex_);
+    store(std::move(client), now);
+}
+
+void ClientCache::store(ClientPtr client, int64_t now)
+{
+    if (entries_.size() >= options_.maxEntries &&
+        !entries_.count(client->clientId))
+    {
+        // Full: drop what has expired, or else everything. Only existing
+        // clients are cached, so this takes an unusually large client table.
+        for (auto it = entries_.begin(); it != entries_.end();)
+        {
+            if (it->second.expiresAt <= now)
+                it = entries_.erase(it);
+            else
+                ++it;
+        }
+        if (entries_.size() >= options_.maxEntries)
+            entries_.clear();
+    }
+    auto &entry = entries_[client->clientId];
+    entry.expiresAt = expiryFrom(now);
+    entry.client = std::move(client);
+}
+
+void ClientCache::replaceAll(std::vector<OAuth2Client> clients,
+                             uint64_t readSince)
+{
+    // Built outside the lock: lookups keep hitting the old registry
+    auto expiresAt = expiryFrom(steadyNanos());
+    std::unordered_map<std::string, Entry> entries;
+    entries.reserve(clients.size());
+    for (auto &client : clients)
+    {
+        if (entries.size() >= options_.maxEntries)
+        {
+            LOG_WARN << "ClientCache: more than " << options_.maxEntries
+                     << " clients, the rest read through";
+            break;
+        }
+        auto id = client.clientId;
+        entries[id] = Entry{
+            std::make_shared<const ClientRecord>(std::move(client)),
+            expiresAt};
+    }
+    std::unique_lock lock(mutex_);
+    if (readSince < loadedSince_)
+    {
+        LOG_DEBUG << "ClientCache: dropping a list older than the registry";
+        return;
+    }
+    // Refreshed after the list was read: the cached entry (or its absence)
+    // is newer than the list
+    for (auto it = refreshed_.begin(); it != refreshed_.end();)
+    {
+        if (it->second <= readSince)
+        {
+            it = refreshed_.erase(it);
+            continue;
+        }
+        auto current = entries_.find(it->first);
+        if (current != entries_.end())
+            entries[it->first] = current->second;
+        else
+            entries.erase(it->first);
+        ++it;
+    }
+    loadedSince_ = readSince;
+    entries_.swap(entries);
+}
+
+uint64_t ClientCache::refreshGeneration() const
+{
+    std::shared_lock lock(mutex_);
+    return generation_;
+}
+
+void ClientCache::invalidate(const std::string &clientId)
+{
+    std::unique_lock lock(mutex_);
+    entries_.erase(clientId);
+}
+
+void ClientCache::clear()
+{
+    std::unique_lock lock(mutex_);
+    entries_.clear();
+}
+
+size_t ClientCache::size() const
+{
+    std::shared_lock lock(mutex_);
+    return entries_.size();
+}
+
+int64_t ClientCache::expiryFrom(int64_t now) const
+{
+    if (options_.ttlNanos <= 0)
+        return std::numeric_limits<int64_t>::max();
+    return now + options_.ttlNanos;
+}
+
+}  // namespace oauth2
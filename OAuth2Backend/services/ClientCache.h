@@ -0,0 +1,140 @@
+#pragma once
+
+#include "../storage/IOAuth2Storage.h"
+#include <json/json.h>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace oauth2
+{
+
+/**
+ * @brief Client record with its redirect URIs and scopes pre-parsed into
+ * hashed sets, so request checks are lookups rather than scans
+ */
+struct ClientRecord : OAuth2Client
+{
+    explicit ClientRecord(OAuth2Client client);
+
+    bool hasRedirectUri(const std::string &uri) const
+    {
+        return redirectUriSet.count(uri) != 0;
+    }
+
+    // A client that lists no scopes may request any
+    bool allowsScope(const std::string &scope) const
+    {
+        return scopeSet.empty() || scopeSet.count(scope) != 0;
+    }
+
+    std::unordered_set<std::string> redirectUriSet;
+    std::unordered_set<std::string> scopeSet;
+};
+
+using ClientPtr = std::shared_ptr<const ClientRecord>;
+
+/**
+ * @brief In-process client registry in front of IOAuth2Storage
+ *
+ * Clients change rarely but are looked up on nearly every request. load()
+ * fills the registry with every client at startup; a hit is answered
+ * inline, without a storage round trip, and a miss (a client added since)
+ * reads through and keeps the record. Records are shared and immutable,
+ * like access tokens. Misses are not cached: storage reports errors and
+ * deadline expiries as "not found" too, and a cached one would lock a
+ * valid client out.
+ *
+ * Entries expire after "ttl_seconds". When the backend pushes changes
+ * (Postgres NOTIFY, Redis keyspace events; see OAuth2Plugin) the owner
+ * passes ttl 0 instead, keeps entries until refresh() is called for them,
+ * and in steady state never touches storage.
+ *
+ * Lookups are counted in oauth2_client_cache_total{result}.
+ */
+class ClientCache
+{
+  public:
+    struct Options
+    {
+        int64_t ttlNanos{60'000'000'000};  // 0 = until refreshed
+        size_t maxEntries{10000};
+
+        // {ttl_seconds, max_entries}
+        static Options fromConfig(const Json::Value &config);
+    };
+
+    using Callback = UniqueFunction<void(ClientPtr)>;
+    using LoadCallback = UniqueFunction<void(bool)>;
+
+    /**
+     * @param storage Owned by the caller and must outlive the cache
+     */
+    ClientCache(IOAuth2Storage *storage, Options options);
+
+    /**
+     * @brief The client record, or nullptr if unknown (Async; inline on a
+     * hit)
+     */
+    void getClient(const std::string &clientId, Callback &&cb);
+
+    /**
+     * @brief Replace the registry with every client in storage (Async)
+     * @param cb Receives false, with the registry kept as it was, when
+     * storage returned no clients
+     */
+    void load(LoadCallback &&cb = nullptr);
+
+    /**
+     * @brief Re-read one client after a change notification (Async)
+     * Drops the entry when the client is gone or cannot be read; the next
+     * lookup then reads through. A load() already in flight does not undo
+     * the result.
+     */
+    void refresh(const std::string &clientId);
+
+    // Cached record, if present and fresh; never touches storage
+    ClientPtr find(const std::string &clientId) const;
+
+    void put(ClientPtr client);
+
+    /**
+     * @brief Swap in a full client list
+     * @param readSince refreshGeneration() before the list was read:
+     * clients refreshed after that keep their newer entry, and a list read
+     * before the last one applied is dropped
+     */
+    void replaceAll(std::vector<OAuth2Client> clients, uint64_t readSince);
+
+    // Counts applied refresh() results
+    uint64_t refreshGeneration() const;
+    void invalidate(const std::string &clientId);
+    void clear();
+    size_t size() const;
+
+  private:
+    struct Entry
+    {
+        ClientPtr client;
+        int64_t expiresAt;  // steady clock, ns
+    };
+
+    int64_t expiryFrom(int64_t now) const;
+    // mutex_ held
+    void store(ClientPtr client, int64_t now);
+
+    IOAuth2Storage *storage_;
+    Options options_;
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    // Refreshes not yet covered by a full load: client ID -> generation
+    std::unordered_map<std::string, uint64_t> refreshed_;
+    uint64_t generation_{0};
+    uint64_t loadedSince_{0};  // readSince of the last applied load
+};
+
+}  // namespace oauth2
@@ -0,0 +1,203 @@
+#include "ConcurrencyLimiter.h"
+#include "plugins/OAuth2Metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace oauth2
+{
+
+namespace
+{
+
+constexpr size_t kPriorities = static_cast<size_t>(StoragePriority::kCount);
+
+int64_t steadyNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+}  // namespace
+
+ConcurrencyLimiter::Options ConcurrencyLimiter::Options::fromConfig(
+    const Json::Value &config)
+{
+    Options options;
+    options.maxConcurrency =
+        std::max(config.get("max_concurrency", 16).asUInt(), 1u);
+    options.maxQueue = config.get("max_queue", 1024).asUInt();
+    const auto &timeouts = config["queue_timeout_ms"];
+    const char *names[kPriorities] = {"validate", "issue", "cleanup"};
+    const double defaults[kPriorities] = {200, 1000, 5000};
+    for (size_t i = 0; i < kPriorities; ++i)
+    {
+        options.queueTimeoutNanos[i] = static_cast<int64_t>(
+            timeouts.get(names[i], defaults[i]).asDouble() * 1e6);
+    }
+    return options;
+}
+
+ConcurrencyLimiter::ConcurrencyLimiter(std::string backend, Options options)
+    : backend_(std::move(backend)), options_(options)
+{
+}
+
+void ConcurrencyLimiter::submit(StoragePriority priority,
+                                Task start,
+                                Task reject,
+                                bool rejectable,
+                                int64_t deadline)
+{
+    auto cls = static_cast<size_t>(priority);
+    auto now = steadyNanos();
+    std::vector<Task> expired;
+    Task evicted;
+    bool admitted = false;
+    bool full = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        expire(now, expired);
+        if (inFlight_ < options_.maxConcurrency && queued_ == 0)
+        {
+            ++inFlight_;
+            admitted = true;
+        }
+        else
+        {
+            if (queued_ >= options_.maxQueue && rejectable)
+            {
+                // Make room by dropping the newest waiter of a lower class
+                for (auto low = kPriorities - 1; low > cls && !evicted; --low)
+                {
+                    auto &queue = queues_[low];
+                    auto it = std::find_if(queue.rbegin(),
+                                           queue.rend(),
+                                           [](const Waiter &w) {
+                                               return w.rejectable;
+                                           });
+                    if (it == queue.rend())
+                        continue;
+                    evicted = std::move(it->reject);
+                    queue.erase(std::next(it).base());
+                    --queued_;
+                }
+                full = queued_ >= options_.maxQueue;
+            }
+            if (!full)
+            {
+                auto timeout = options_.queueTimeoutNanos[cls];
+                int64_t giveUp = timeout > 0 ? now + timeout : 0;
+                if (deadline > 0 && (giveUp == 0 || deadline < giveUp))
+                    giveUp = deadline;
+                if (!rejectable)
+                    giveUp = 0;
+                queues_[cls].push_back(Waiter{std::move(start),
+                                              std::move(reject),
+                                              giveUp,
+                                              rejectable});
+                ++queued_;
+                auto &earliest = earliestDeadline_[cls];
+                if (giveUp != 0 && (earliest == 0 || giveUp < earliest))
+                    earliest = giveUp;
+            }
+        }
+    }
+
+    countRejected("deadline", expired.size());
+    for (auto &task : expired)
+        task();
+    if (evicted || full)
+        countRejected("queue_full", 1);
+    if (evicted)
+        evicted();
+    if (full)
+        reject();
+    else if (admitted)
+        start();
+}
+
+void ConcurrencyLimiter::release()
+{
+    auto now = steadyNanos();
+    std::vector<Task> expired;
+    Task next;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        expire(now, expired);
+        // The slot passes straight to the next waiter, if any
+        for (auto &queue : queues_)
+        {
+            if (queue.empty())
+                continue;
+            next = std::move(queue.front().start);
+            queue.pop_front();
+            --queued_;
+            break;
+        }
+        if (!next && inFlight_ > 0)
+            --inFlight_;
+    }
+
+    countRejected("deadline", expired.size());
+    for (auto &task : expired)
+        task();
+    if (next)
+        next();
+}
+
+void ConcurrencyLimiter::expire(int64_t now, std::vector<Task> &out)
+{
+    // Caller deadlines and unbounded writes share a class, so deadlines
+    // are not in FIFO order: an expired waiter may sit behind a live one.
+    // Scan the whole queue, but only once something in it is due.
+    for (size_t cls = 0; cls < kPriorities; ++cls)
+    {
+        auto &earliest = earliestDeadline_[cls];
+        if (earliest == 0 || earliest > now)
+            continue;
+        auto &queue = queues_[cls];
+        int64_t next = 0;
+        auto kept = queue.begin();
+        for (auto it = queue.begin(); it != queue.end(); ++it)
+        {
+            if (it->deadline != 0 && it->deadline <= now)
+            {
+                out.push_back(std::move(it->reject));
+                continue;
+            }
+            if (it->deadline != 0 && (next == 0 || it->deadline < next))
+                next = it->deadline;
+            if (kept != it)
+                *kept = std::move(*it);
+            ++kept;
+        }
+        queued_ -= static_cast<size_t>(std::distance(kept, queue.end()));
+        queue.erase(kept, queue.end());
+        earliest = next;
+    }
+}
+
+void ConcurrencyLimiter::countRejected(std::string_view reason,
+                                       size_t n) const
+{
+    if (n == 0)
+        return;
+    // Counted, not logged: rejections come in bursts under overload
+    Metrics::incStorageRejected(backend_, reason, static_cast<int>(n));
+}
+
+size_t ConcurrencyLimiter::inFlight() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return inFlight_;
+}
+
+size_t ConcurrencyLimiter::queued() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queued_;
+}
+
+}  // namespace oauth2
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <json/json.h>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace oauth2
+{
+
+/**
+ * @brief Admission classes, highest first: token validation must keep
+ * flowing while issuing waits, and cleanup only runs on spare capacity.
+ */
+enum class StoragePriority : uint8_t
+{
+    kValidate,
+    kIssue,
+    kCleanup,
+    kCount
+};
+
+/**
+ * @brief Caps concurrent operations against one storage backend
+ *
+ * At most "max_concurrency" operations run at once; the rest wait in one
+ * FIFO per priority class, "max_queue" in total. Freed slots go to the
+ * highest class first. A waiter carries a deadline ("queue_timeout_ms"
+ * per class) and is rejected, never started, once it has passed; a full
+ * queue rejects the newcomer or, if it outranks them, the newest
+ * rejectable waiter of the lowest class.
+ *
+ * Thread-safe. start/reject callbacks run outside the lock, on the thread
+ * that submitted or released.
+ */
+class ConcurrencyLimiter
+{
+  public:
+    using Task = std::function<void()>;
+
+    struct Options
+    {
+        size_t maxConcurrency{16};
+        size_t maxQueue{1024};
+        // Per StoragePriority; 0 = wait indefinitely
+        std::array<int64_t, static_cast<size_t>(StoragePriority::kCount)>
+            queueTimeoutNanos{};
+
+        /**
+         * {max_concurrency, max_queue,
+         *  queue_timeout_ms: {validate, issue, cleanup}}
+         */
+        static Options fromConfig(const Json::Value &config);
+    };
+
+    ConcurrencyLimiter(std::string backend, Options options);
+
+    /**
+     * @brief Run @p start now if a slot is free, otherwise queue it
+     *
+     * The started operation must call release() exactly once when it
+     * completes. @p reject runs instead of @p start (never both) when the
+     * queue is full or the deadline passes while waiting.
+     *
+     * @param rejectable false for operations that cannot report failure to
+     * their caller (writes): they wait for a slot however long it takes,
+     * are never evicted, and may exceed max_queue (they follow a read that
+     * was admitted, so they stay bounded by it)
+     * @param deadline The caller's own deadline (steady_clock nanoseconds,
+     * 0 = none); a rejectable waiter gives up at the earlier of this and
+     * its class timeout
+     */
+    void submit(StoragePriority priority,
+                Task start,
+                Task reject,
+                bool rejectable = true,
+                int64_t deadline = 0);
+
+    void release();
+
+    size_t inFlight() const;
+    size_t queued() const;
+
+    const std::string &backend() const
+    {
+        return backend_;
+    }
+
+  private:
+    struct Waiter
+    {
+        Task start;
+        Task reject;
+        int64_t deadline;  // steady_clock nanoseconds, 0 = none
+        bool rejectable;
+    };
+
+    // mutex_ held; moves expired waiters to @p out
+    void expire(int64_t now, std::vector<Task> &out);
+    void countRejected(std::string_view reason, size_t n) const;
+
+    const std::string backend_;
+    const Options options_;
+
+    mutable std::mutex mutex_;
+    size_t inFlight_{0};
+    size_t queued_{0};
+    std::array<std::deque<Waiter>, static_cast<size_t>(StoragePriority::kCount)>
+        queues_;
+    // Per class: no waiter expires before this (0 = none can); a lower
+    // bound, so expire() skips classes with nothing due
+    std::array<int64_t, static_cast<size_t>(StoragePriority::kCount)>
+        earliestDeadline_{};
+};
+
+}  // namespace oauth2
@@ -0,0 +1,182 @@
+#include "CredentialCache.h"
+#include "plugins/OAuth2Metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <random>
+
+namespace oauth2
+{
+
+namespace
+{
+
+int64_t steadyNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+inline uint64_t rotl(uint64_t x, int b)
+{
+    return (x << b) | (x >> (64 - b));
+}
+
+inline void sipRound(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3)
+{
+    v0 += v1;
+    v1 = rotl(v1, 13);
+    v1 ^= v0;
+    v0 = rotl(v0, 32);
+    v2 += v3;
+    v3 = rotl(v3, 16);
+    v3 ^= v2;
+    v0 += v3;
+    v3 = rotl(v3, 21);
+    v3 ^= v0;
+    v2 += v1;
+    v1 = rotl(v1, 17);
+    v1 ^= v2;
+    v2 = rotl(v2, 32);
+}
+
+// Little-endian load, whatever the host order
+inline uint64_t load64(const unsigned char *p, size_t n)
+{
+    uint64_t x = 0;
+    for (size_t i = 0; i < n; ++i)
+        x |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return x;
+}
+
+void appendField(std::string &out, std::string_view field)
+{
+    // Length-prefixed, so ("ab", "c") and ("a", "bc") differ
+    auto n = static_cast<uint32_t>(field.size());
+    for (int i = 0; i < 4; ++i)
+        out.push_back(static_cast<char>((n >> (8 * i)) & 0xff));
+    out.append(field.data(), field.size());
+}
+
+}  // namespace
+
+CredentialCache::Options CredentialCache::Options::fromConfig(
+    const Json::Value &config)
+{
+    Options options;
+    options.ttlNanos = static_cast<int64_t>(
+        config.get("ttl_seconds", 60).asDouble() * 1e9);
+    options.maxEntries =
+        std::max(config.get("max_entries", 10000).asUInt(), 1u);
+    return options;
+}
+
+CredentialCache::CredentialCache(Options options) : options_(options)
+{
+    std::random_device rd;
+    for (auto &k : key_)
+        k = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+}
+
+uint64_t CredentialCache::sipHash(uint64_t k0,
+                                  uint64_t k1,
+                                  std::string_view data)
+{
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+    const auto *p = reinterpret_cast<const unsigned char *>(data.data());
+    size_t n = data.size();
+    size_t full = n & ~size_t(7);
+    for (size_t i = 0; i < full; i += 8)
+    {
+        uint64_t m = load64(p + i, 8);
+        v3 ^= m;
+        sipRound(v0, v1, v2, v3);
+        sipRound(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+    uint64_t last =
+        (static_cast<uint64_t>(n) << 56) | load64(p + full, n - full);
+    v3 ^= last;
+    sipRound(v0, v1, v2, v3);
+    sipRound(v0, v1, v2, v3);
+    v0 ^= last;
+
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; ++i)
+        sipRound(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+uint64_t CredentialCache::mac(const std::string &clientId,
+                              std::string_view secret,
+                              std::string_view storedHash) const
+{
+    // Reused per thread: no allocation once it has grown
+    thread_local std::string buffer;
+    buffer.clear();
+    appendField(buffer, clientId);
+    appendField(buffer, secret);
+    appendField(buffer, storedHash);
+    auto result = sipHash(key_[0], key_[1], buffer);
+    // The secret must not linger in the buffer
+    std::fill(buffer.begin(), buffer.end(), '\0');
+    return result;
+}
+
+bool CredentialCache::contains(const std::string &clientId,
+                               std::string_view secret,
+                               std::string_view storedHash) const
+{
+    auto expected = mac(clientId, secret, storedHash);
+    bool hit = false;
+    {
+        std::shared_lock lock(mutex_);
+        auto it = entries_.find(clientId);
+        hit = it != entries_.end() && it->second.mac == expected &&
+              it->second.expiresAt > steadyNanos();
+    }
+    Metrics::incCredentialCache(hit);
+    return hit;
+}
+
+void CredentialCache::put(const std::string &clientId,
+                          std::string_view secret,
+                          std::string_view storedHash)
+{
+    auto entryMac = mac(clientId, secret, storedHash);
+    auto now = steadyNanos();
+    std::unique_lock lock(mutex_);
+    if (entries_.size() >= options_.maxEntries && !entries_.count(clientId))
+    {
+        // Full: drop what has expired, or else everything
+        for (auto it = entries_.begin(); it != entries_.end();)
+        {
+            if (it->second.expiresAt <= now)
+                it = entries_.erase(it);
+            else
+                ++it;
+        }
+        if (entries_.size() >= options_.maxEntries)
+            entries_.clear();
+    }
+    entries_[clientId] = Entry{entryMac, now + options_.ttlNanos};
+}
+
+void CredentialCache::invalidate(const std::string &clientId)
+{
+    std::unique_lock lock(mutex_);
+    entries_.erase(clientId);
+}
+
+void CredentialCache::clear()
+{
+    std::unique_lock lock(mutex_);
+    entries_.clear();
+}
+
+}  // namespace oauth2
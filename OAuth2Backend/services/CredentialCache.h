@@ -0,0 +1,80 @@
+#pragma once
+
+#include <json/json.h>
+#include <array>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace oauth2
+{
+
+/**
+ * @brief Client credentials that verified recently
+ *
+ * Confidential clients send their secret on every /oauth2/token call, and
+ * checking it costs a storage read plus a SHA-256. After one successful
+ * check the cache keeps a keyed MAC (SipHash-2-4 under a random
+ * per-process key) of (client_id, secret, stored secret hash) for
+ * "ttl_seconds"; a repeat presents the same pair and is answered from
+ * memory. The secret itself is never kept.
+ *
+ * The stored hash is part of the MAC, so once the client registry sees a
+ * rotated secret the old entry no longer matches; invalidate() drops it
+ * sooner on a change notification. Failed checks are not cached.
+ *
+ * Checks are counted in oauth2_client_credential_cache_total{result}.
+ */
+class CredentialCache
+{
+  public:
+    struct Options
+    {
+        int64_t ttlNanos{60'000'000'000};
+        size_t maxEntries{10000};
+
+        // {ttl_seconds, max_entries}
+        static Options fromConfig(const Json::Value &config);
+    };
+
+    explicit CredentialCache(Options options);
+
+    /**
+     * @brief Whether this secret verified for the client within the TTL,
+     * against the same stored secret hash
+     */
+    bool contains(const std::string &clientId,
+                  std::string_view secret,
+                  std::string_view storedHash) const;
+
+    // Record a successful check
+    void put(const std::string &clientId,
+             std::string_view secret,
+             std::string_view storedHash);
+
+    void invalidate(const std::string &clientId);
+    void clear();
+
+    // SipHash-2-4 of @p data under the 128-bit key (k0, k1)
+    static uint64_t sipHash(uint64_t k0, uint64_t k1, std::string_view data);
+
+  private:
+    struct Entry
+    {
+        uint64_t mac;
+        int64_t expiresAt;  // steady clock, ns
+    };
+
+    uint64_t mac(const std::string &clientId,
+                 std::string_view secret,
+                 std::string_view storedHash) const;
+
+    Options options_;
+    std::array<uint64_t, 2> key_;
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+}  // namespace oauth2
@@ -0,0 +1,192 @@
+#include "CredentialHasher.h"
+#include "CycleClock.h"
+#include "Deadline.h"
+#include "plugins/OAuth2Metrics.h"
+#include <drogon/utils/Utilities.h>
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/ConcurrentTaskQueue.h>
+#include <trantor/utils/Logger.h>
+#include <algorithm>
+#include <cctype>
+
+namespace oauth2
+{
+
+namespace
+{
+
+// Run @p fn on @p loop, or right here when there is none
+void deliver(trantor::EventLoop *loop, UniqueFunction<void()> &&fn)
+{
+    if (!loop || loop->isInLoopThread())
+    {
+        fn();
+        return;
+    }
+    // queueInLoop takes a copyable std::function
+    auto shared = std::make_shared<UniqueFunction<void()>>(std::move(fn));
+    loop->queueInLoop([shared]() { (*shared)(); });
+}
+
+}  // namespace
+
+CredentialHasher::Options CredentialHasher::Options::fromConfig(
+    const Json::Value &config)
+{
+    Options options;
+    options.threads = std::max(config.get("threads", 2).asUInt(), 1u);
+    options.maxQueue = config.get("max_queue", 256).asUInt();
+    options.timeoutNanos = static_cast<int64_t>(
+        config.get("timeout_ms", 2000).asDouble() * 1e6);
+    return options;
+}
+
+CredentialHasher &CredentialHasher::instance()
+{
+    static CredentialHasher hasher;
+    return hasher;
+}
+
+void CredentialHasher::start(const Json::Value &config)
+{
+    auto options = Options::fromConfig(config);
+    auto pool = std::make_shared<trantor::ConcurrentTaskQueue>(
+        options.threads, "CredentialHasher");
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pool_)
+        return;
+    options_ = options;
+    pool_ = std::move(pool);
+    LOG_INFO << "CredentialHasher: " << options_.threads << " threads, queue "
+             << options_.maxQueue << ", timeout "
+             << options_.timeoutNanos / 1000000 << "ms";
+}
+
+void CredentialHasher::stop()
+{
+    std::shared_ptr<trantor::ConcurrentTaskQueue> pool;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pool.swap(pool_);
+    }
+    // Joined outside the lock, so submit() never waits for it. Hashes
+    // still queued are dropped: this runs at shutdown only.
+    if (pool)
+        pool->stop();
+}
+
+std::string CredentialHasher::hashPassword(std::string_view password,
+                                           std::string_view salt)
+{
+    std::string input;
+    input.reserve(password.size() + salt.size());
+    input.append(password).append(salt);
+    auto hash = drogon::utils::getSha256(input.data(), input.size());
+    // The plain password must not linger in freed memory
+    std::fill(input.begin(), input.end(), '\0');
+    return hash;
+}
+
+bool CredentialHasher::hashesMatch(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (std::tolower(static_cast<unsigned char>(a[i])) !=
+            std::tolower(static_cast<unsigned char>(b[i])))
+            return false;
+    }
+    return true;
+}
+
+void CredentialHasher::verify(std::string password,
+                              std::string salt,
+                              std::string storedHash,
+                              VerifyCallback &&cb,
+                              trantor::EventLoop *loop)
+{
+    if (!loop)
+        loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    submit([password = std::move(password),
+            salt = std::move(salt),
+            storedHash = std::move(storedHash),
+            cb = std::move(cb),
+            loop](Status status) mutable {
+        bool match = status == Status::kOk &&
+                     hashesMatch(hashPassword(password, salt), storedHash);
+        deliver(loop, [cb = std::move(cb), status, match]() {
+            cb(status, match);
+        });
+    });
+}
+
+void CredentialHasher::hash(std::string password,
+                            std::string salt,
+                            HashCallback &&cb,
+                            trantor::EventLoop *loop)
+{
+    if (!loop)
+        loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    submit([password = std::move(password),
+            salt = std::move(salt),
+            cb = std::move(cb),
+            loop](Status status) mutable {
+        std::string hash;
+        if (status == Status::kOk)
+            hash = hashPassword(password, salt);
+        deliver(loop,
+                [cb = std::move(cb), status, hash = std::move(hash)]() mutable {
+                    cb(status, std::move(hash));
+                });
+    });
+}
+
+void CredentialHasher::submit(Task &&task)
+{
+    std::shared_ptr<trantor::ConcurrentTaskQueue> pool;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pool = pool_;
+    }
+    auto queuedAt = CycleClock::now();
+    if (!pool)
+    {
+        task(Status::kOk);
+        Metrics::observePhase(Phase::kHashCompute, queuedAt);
+        return;
+    }
+    if (queued_.fetch_add(1, std::memory_order_relaxed) >= options_.maxQueue)
+    {
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        Metrics::incCredentialHashRejected("queue_full");
+        task(Status::kRejected);
+        return;
+    }
+
+    // The request's own deadline, when sooner, bounds the wait too
+    int64_t deadline = 0;
+    if (options_.timeoutNanos > 0)
+        deadline = DeadlineScope::now() + options_.timeoutNanos;
+    if (auto request = DeadlineScope::current(); request > 0)
+        deadline = deadline > 0 ? std::min(deadline, request) : request;
+
+    // The hasher is a process-wide singleton that is never destroyed
+    // before the workers are joined, so capturing `this` is safe.
+    // runTaskInQueue takes a copyable std::function.
+    auto shared = std::make_shared<Task>(std::move(task));
+    pool->runTaskInQueue([this, shared, queuedAt, deadline]() {
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        auto started = Metrics::observePhase(Phase::kHashQueue, queuedAt);
+        if (deadline > 0 && DeadlineScope::now() > deadline)
+        {
+            Metrics::incCredentialHashRejected("timeout");
+            (*shared)(Status::kTimedOut);
+            return;
+        }
+        (*shared)(Status::kOk);
+        Metrics::observePhase(Phase::kHashCompute, started);
+    });
+}
+
+}  // namespace oauth2
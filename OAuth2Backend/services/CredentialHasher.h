@@ -0,0 +1,108 @@
+#pragma once
+
+#include "../storage/UniqueFunction.h"
+#include <json/json.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace trantor
+{
+class ConcurrentTaskQueue;
+class EventLoop;
+}  // namespace trantor
+
+namespace oauth2
+{
+
+/**
+ * @brief Password hashing off the IO threads
+ *
+ * Login and registration hash the password; with a memory-hard KDF that
+ * takes tens of milliseconds and would stall every connection of the IO
+ * loop running it. Hashes run on a dedicated pool of "threads" workers
+ * instead, and the result is queued back to the caller's event loop.
+ *
+ * At most "max_queue" hashes wait for a worker; beyond that a request is
+ * rejected at once (kRejected). One that waited longer than "timeout_ms",
+ * or past the request deadline, is dropped unhashed (kTimedOut): its
+ * client has likely given up. Queue wait and hash time are recorded as
+ * the "hash.queue" / "hash.compute" latency phases, and rejections in
+ * oauth2_credential_hash_rejected_total{reason}.
+ *
+ * Until start() (tests, tools) hashes run inline on the caller's thread.
+ */
+class CredentialHasher
+{
+  public:
+    struct Options
+    {
+        size_t threads{2};
+        size_t maxQueue{256};
+        int64_t timeoutNanos{2'000'000'000};  // 0 = request deadline only
+
+        // {threads, max_queue, timeout_ms}
+        static Options fromConfig(const Json::Value &config);
+    };
+
+    enum class Status : uint8_t
+    {
+        kOk,
+        kRejected,  // Queue full
+        kTimedOut,  // Waited past its timeout or deadline
+    };
+
+    using VerifyCallback = UniqueFunction<void(Status, bool match)>;
+    using HashCallback = UniqueFunction<void(Status, std::string hash)>;
+
+    static CredentialHasher &instance();
+
+    void start(const Json::Value &config);
+
+    // Joins the workers; hashes still queued are dropped (shutdown only)
+    void stop();
+
+    /**
+     * @brief Whether @p password hashes to @p storedHash (Async)
+     * @param loop Where @p cb runs; nullptr = the calling thread's loop
+     * (inline on a worker if it has none)
+     */
+    void verify(std::string password,
+                std::string salt,
+                std::string storedHash,
+                VerifyCallback &&cb,
+                trantor::EventLoop *loop = nullptr);
+
+    /**
+     * @brief Hash of @p password for storage (Async)
+     * @param loop As for verify()
+     */
+    void hash(std::string password,
+              std::string salt,
+              HashCallback &&cb,
+              trantor::EventLoop *loop = nullptr);
+
+    // The password hash itself (hex); the one place that picks the KDF
+    static std::string hashPassword(std::string_view password,
+                                    std::string_view salt);
+
+    // Case-insensitive hex comparison, without copies
+    static bool hashesMatch(std::string_view a, std::string_view b);
+
+  private:
+    // Runs on a worker with kOk / kTimedOut, or inline with kRejected
+    using Task = UniqueFunction<void(Status)>;
+
+    CredentialHasher() = default;
+    void submit(Task &&task);
+
+    Options options_;
+    std::mutex mutex_;  // Guards pool_ across start() / stop()
+    std::shared_ptr<trantor::ConcurrentTaskQueue> pool_;
+    std::atomic<size_t> queued_{0};
+};
+
+}  // namespace oauth2
@@ -0,0 +1,60 @@
+#include "CycleClock.h"
+#include <thread>
+
+#if defined(OAUTH2_HAS_RDTSC) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+namespace oauth2
+{
+
+static bool hasInvariantTsc()
+{
+#ifdef OAUTH2_HAS_RDTSC
+    // CPUID.80000007H:EDX[8] = invariant TSC (constant rate, never stops)
+#ifdef _MSC_VER
+    int regs[4] = {0};
+    __cpuid(regs, 0x80000000);
+    if (static_cast<unsigned>(regs[0]) < 0x80000007u)
+        return false;
+    __cpuid(regs, 0x80000007);
+    return (regs[3] & (1 << 8)) != 0;
+#else
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(0x80000000u, &eax, &ebx, &ecx, &edx) ||
+        eax < 0x80000007u)
+        return false;
+    __get_cpuid(0x80000007u, &eax, &ebx, &ecx, &edx);
+    return (edx & (1u << 8)) != 0;
+#endif
+#else
+    return false;
+#endif
+}
+
+const CycleClock::Calibration &CycleClock::calibration()
+{
+    static const Calibration c = [] {
+        Calibration out{false, 1.0};
+#ifdef OAUTH2_HAS_RDTSC
+        if (!hasInvariantTsc())
+            return out;
+        // ~10 ms against steady_clock gives well under 0.1% error
+        auto t0 = std::chrono::steady_clock::now();
+        auto c0 = __rdtsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto t1 = std::chrono::steady_clock::now();
+        auto c1 = __rdtsc();
+        auto ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        if (c1 > c0 && ns > 0)
+        {
+            out.tsc = true;
+            out.nanosPerTick = ns / static_cast<double>(c1 - c0);
+        }
+#endif
+        return out;
+    }();
+    return c;
+}
+
+}  // namespace oauth2
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define OAUTH2_HAS_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define OAUTH2_HAS_RDTSC 1
+#endif
+
+namespace oauth2
+{
+
+/**
+ * @brief Cheapest monotonic timestamp available, for latency samples
+ *
+ * Uses the TSC on x86 when the CPU reports an invariant TSC (calibrated
+ * once against steady_clock), otherwise steady_clock. Ticks are only
+ * meaningful as differences; convert with toNanos().
+ */
+class CycleClock
+{
+  public:
+    static uint64_t now()
+    {
+#ifdef OAUTH2_HAS_RDTSC
+        if (useTsc())
+            return __rdtsc();
+#endif
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+    }
+
+    static int64_t toNanos(uint64_t ticks)
+    {
+        return static_cast<int64_t>(static_cast<double>(ticks) *
+                                    calibration().nanosPerTick);
+    }
+
+    /**
+     * @brief Run the one-off calibration now rather than on first use
+     */
+    static void init()
+    {
+        calibration();
+    }
+
+  private:
+    struct Calibration
+    {
+        bool tsc;
+        double nanosPerTick;
+    };
+    static const Calibration &calibration();
+    static bool useTsc()
+    {
+        return calibration().tsc;
+    }
+};
+
+}  // namespace oauth2
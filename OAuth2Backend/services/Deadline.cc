@@ -0,0 +1,96 @@
+#include "Deadline.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+
+namespace oauth2
+{
+
+namespace
+{
+
+constexpr const char *kDeadlineAttributeKey = "oauth2.deadline";
+
+thread_local int64_t g_deadline = 0;
+
+}  // namespace
+
+// ========== DeadlineScope ==========
+
+DeadlineScope::DeadlineScope(int64_t deadline) : previous_(g_deadline)
+{
+    g_deadline = deadline;
+}
+
+DeadlineScope::~DeadlineScope()
+{
+    g_deadline = previous_;
+}
+
+int64_t DeadlineScope::current()
+{
+    return g_deadline;
+}
+
+// ========== RequestDeadlines ==========
+
+std::atomic<bool> RequestDeadlines::enabled_{false};
+
+RequestDeadlines &RequestDeadlines::instance()
+{
+    static RequestDeadlines deadlines;
+    return deadlines;
+}
+
+void RequestDeadlines::configure(const Json::Value &config)
+{
+    defaultNanos_ =
+        static_cast<int64_t>(config.get("default_ms", 0).asDouble() * 1e6);
+    routes_.clear();
+    const auto &routes = config["routes"];
+    for (const auto &prefix : routes.getMemberNames())
+    {
+        routes_.emplace_back(
+            prefix, static_cast<int64_t>(routes[prefix].asDouble() * 1e6));
+    }
+    std::sort(routes_.begin(), routes_.end(), [](auto &a, auto &b) {
+        return a.first.size() > b.first.size();
+    });
+    enabled_.store(config.get("enabled", false).asBool(),
+                   std::memory_order_relaxed);
+}
+
+int64_t RequestDeadlines::budgetNanos(std::string_view path) const
+{
+    for (const auto &[prefix, budget] : routes_)
+    {
+        if (path.substr(0, prefix.size()) == prefix)
+            return budget;
+    }
+    return defaultNanos_;
+}
+
+// ========== Request integration ==========
+
+int64_t requestDeadline(const drogon::HttpRequestPtr &req)
+{
+    const auto &attrs = req->getAttributes();
+    if (!attrs->find(kDeadlineAttributeKey))
+        return 0;
+    return attrs->get<int64_t>(kDeadlineAttributeKey);
+}
+
+void registerDeadlineAdvice()
+{
+    drogon::app().registerPreRoutingAdvice(
+        [](const drogon::HttpRequestPtr &req) {
+            auto budget =
+                RequestDeadlines::instance().budgetNanos(req->path());
+            if (budget > 0)
+            {
+                req->getAttributes()->insert(kDeadlineAttributeKey,
+                                             DeadlineScope::now() + budget);
+            }
+        });
+}
+
+}  // namespace oauth2
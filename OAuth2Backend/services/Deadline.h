@@ -0,0 +1,93 @@
+#pragma once
+
+#include <drogon/HttpRequest.h>
+#include <json/json.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace oauth2
+{
+
+/**
+ * @brief Makes a deadline current on this thread for the scope's lifetime
+ *
+ * Same model as TraceScope: handlers open one from requestDeadline(req),
+ * DeadlineOAuth2Storage reads it when a storage call starts and re-opens
+ * it around the completion callback, so chained calls inherit it.
+ * Deadlines are steady_clock nanoseconds (see now()); 0 means none.
+ */
+class DeadlineScope
+{
+  public:
+    explicit DeadlineScope(int64_t deadline);
+    ~DeadlineScope();
+    DeadlineScope(const DeadlineScope &) = delete;
+    DeadlineScope &operator=(const DeadlineScope &) = delete;
+
+    // Innermost deadline on this thread (0 if none)
+    static int64_t current();
+
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+  private:
+    int64_t previous_;
+};
+
+/**
+ * @brief Per-route latency budgets
+ *
+ * A request's deadline is its arrival (PreRouting) plus the budget of the
+ * longest matching path prefix in "routes", or "default_ms" when none
+ * matches (0 = no deadline).
+ *
+ * Configured from custom_config "request_deadlines":
+ * {enabled, default_ms, routes: {"<prefix>": ms, ...}}
+ */
+class RequestDeadlines
+{
+  public:
+    static RequestDeadlines &instance();
+
+    void configure(const Json::Value &config);
+
+    static bool enabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Budget for @p path in nanoseconds, 0 for none
+    int64_t budgetNanos(std::string_view path) const;
+
+  private:
+    RequestDeadlines() = default;
+
+    static std::atomic<bool> enabled_;
+    // Set by configure() before traffic, read-only afterwards; longest
+    // prefix first
+    std::vector<std::pair<std::string, int64_t>> routes_;
+    int64_t defaultNanos_{0};
+};
+
+/**
+ * @brief Deadline of the request (0 when deadlines are off or the route
+ * has no budget)
+ */
+int64_t requestDeadline(const drogon::HttpRequestPtr &req);
+
+/**
+ * @brief Stamp each request with its deadline on arrival; call once
+ * before app().run() when deadlines are on
+ */
+void registerDeadlineAdvice();
+
+}  // namespace oauth2
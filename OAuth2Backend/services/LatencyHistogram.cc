@@ -0,0 +1,191 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace oauth2
+{
+
+static int highestBit(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(v);
+#else
+    int bit = 0;
+    for (int step = 32; step > 0; step /= 2)
+    {
+        if (v >> step)
+        {
+            v >>= step;
+            bit += step;
+        }
+    }
+    return bit;
+#endif
+}
+
+size_t LatencyHistogram::bucketOf(uint64_t nanos)
+{
+    if (nanos < kSubBuckets)
+        return static_cast<size_t>(nanos);
+    nanos = std::min(nanos, kMaxValue);
+    // Top kSubBucketBits + 1 bits: the leading 1 picks the magnitude, the
+    // bits below it the linear sub-bucket
+    int shift = highestBit(nanos) - kSubBucketBits;
+    auto sub = (nanos >> shift) - kSubBuckets;
+    return static_cast<size_t>(kSubBuckets + shift * kSubBuckets + sub);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t bucket)
+{
+    if (bucket < kSubBuckets)
+        return bucket;
+    auto shift = (bucket - kSubBuckets) / kSubBuckets;
+    auto sub = (bucket - kSubBuckets) % kSubBuckets;
+    return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::min() const
+{
+    for (size_t i = 0; i < kBuckets; ++i)
+    {
+        if (counts_[i])
+            return i == 0 ? 0 : bucketUpperBound(i - 1) + 1;
+    }
+    return 0;
+}
+
+uint64_t LatencyHistogram::max() const
+{
+    for (size_t i = kBuckets; i-- > 0;)
+    {
+        if (counts_[i])
+            return bucketUpperBound(i);
+    }
+    return 0;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const
+{
+    if (count_ == 0)
+        return 0;
+    q = std::clamp(q, 0.0, 1.0);
+    auto rank = static_cast<uint64_t>(std::ceil(q * count_));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i)
+    {
+        seen += counts_[i];
+        if (seen >= rank)
+            return bucketUpperBound(i);
+    }
+    return max();
+}
+
+LatencyRecorder &LatencyRecorder::instance()
+{
+    // Leaked on purpose, see MetricsRegistry::instance()
+    static auto *recorder = new LatencyRecorder();
+    return *recorder;
+}
+
+void LatencyRecorder::record(size_t slot, uint64_t nanos)
+{
+    if (slot >= kMaxSlots)
+        return;
+    auto &shard = localShard();
+    auto *block = shard.blocks[slot].load(std::memory_order_relaxed);
+    if (!block)
+    {
+        block = new Block();
+        shard.blocks[slot].store(block, std::memory_order_release);
+    }
+    // Single writer per shard: no read-modify-write needed
+    auto &c = block->counts[LatencyHistogram::bucketOf(nanos)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    block->sum.store(block->sum.load(std::memory_order_relaxed) + nanos,
+                     std::memory_order_relaxed);
+}
+
+void LatencyRecorder::merge(const Block &block, LatencyHistogram &out)
+{
+    for (size_t i = 0; i < LatencyHistogram::kBuckets; ++i)
+    {
+        auto n = block.counts[i].load(std::memory_order_relaxed);
+        if (n)
+            out.add(i, n);
+    }
+    out.addSum(block.sum.load(std::memory_order_relaxed));
+}
+
+LatencyHistogram LatencyRecorder::snapshot(size_t slot) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slot >= kMaxSlots)
+        return {};
+    LatencyHistogram out = retired_[slot];
+    for (auto *shard : shards_)
+    {
+        if (auto *block = shard->blocks[slot].load(std::memory_order_acquire))
+            merge(*block, out);
+    }
+    return out;
+}
+
+void LatencyRecorder::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired_.fill(LatencyHistogram());
+    for (auto *shard : shards_)
+    {
+        for (auto &slot : shard->blocks)
+        {
+            auto *block = slot.load(std::memory_order_acquire);
+            if (!block)
+                continue;
+            for (auto &c : block->counts)
+                c.store(0, std::memory_order_relaxed);
+            block->sum.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+LatencyRecorder::Shard &LatencyRecorder::localShard()
+{
+    thread_local ShardHolder holder;
+    if (!holder.shard)
+    {
+        holder.shard = new Shard();
+        std::lock_guard<std::mutex> lock(mutex_);
+        shards_.push_back(holder.shard);
+    }
+    return *holder.shard;
+}
+
+LatencyRecorder::Shard::~Shard()
+{
+    for (auto &slot : blocks)
+        delete slot.load(std::memory_order_relaxed);
+}
+
+LatencyRecorder::ShardHolder::~ShardHolder()
+{
+    if (shard)
+        LatencyRecorder::instance().retire(shard);
+}
+
+void LatencyRecorder::retire(Shard *shard)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < kMaxSlots; ++i)
+        {
+            if (auto *block = shard->blocks[i].load(std::memory_order_relaxed))
+                merge(*block, retired_[i]);
+        }
+        shards_.erase(std::remove(shards_.begin(), shards_.end(), shard),
+                      shards_.end());
+    }
+    delete shard;
+}
+
+}  // namespace oauth2
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace oauth2
+{
+
+/**
+ * @brief Log-linear (HDR-style) latency histogram, in nanoseconds
+ *
+ * Every power of two is split into kSubBuckets linear buckets, so any
+ * recorded value is reported within 1/kSubBuckets (~3%) of its true value
+ * from 1 ns up to kMaxValue (~137 s); larger values are clamped. This is
+ * the plain value type used for snapshots; recording goes through
+ * LatencyRecorder.
+ */
+class LatencyHistogram
+{
+  public:
+    static constexpr int kSubBucketBits = 5;
+    static constexpr uint64_t kSubBuckets = 1u << kSubBucketBits;
+    static constexpr int kMagnitudes = 37;  // 2^37 ns
+    static constexpr uint64_t kMaxValue = (uint64_t(1) << kMagnitudes) - 1;
+    static constexpr size_t kBuckets =
+        kSubBuckets + (kMagnitudes - kSubBucketBits) * kSubBuckets;
+
+    static size_t bucketOf(uint64_t nanos);
+    // Highest value that maps to @p bucket
+    static uint64_t bucketUpperBound(size_t bucket);
+
+    void add(size_t bucket, uint64_t n)
+    {
+        counts_[bucket] += n;
+        count_ += n;
+    }
+    void addSum(uint64_t nanos)
+    {
+        sum_ += nanos;
+    }
+
+    uint64_t count() const
+    {
+        return count_;
+    }
+    double mean() const
+    {
+        return count_ ? static_cast<double>(sum_) / count_ : 0.0;
+    }
+    uint64_t min() const;
+    uint64_t max() const;
+
+    /**
+     * @brief Value at quantile @p q (0..1), as its bucket's upper bound
+     */
+    uint64_t percentile(double q) const;
+
+  private:
+    std::array<uint64_t, kBuckets> counts_{};
+    uint64_t count_{0};
+    uint64_t sum_{0};
+};
+
+/**
+ * @brief Set of LatencyHistograms addressed by slot, per-thread sharded
+ *
+ * Same scheme as MetricsRegistry: each thread writes its own buckets
+ * (single writer, relaxed atomics, no lock), and snapshot() sums the
+ * threads. A thread allocates a slot's buckets (~8 KB) the first time it
+ * records into that slot, so unused slots cost nothing.
+ */
+class LatencyRecorder
+{
+  public:
+    static constexpr size_t kMaxSlots = 80;
+
+    static LatencyRecorder &instance();
+
+    void record(size_t slot, uint64_t nanos);
+    LatencyHistogram snapshot(size_t slot) const;
+
+    /**
+     * @brief Zero every slot (samples racing with the reset may be lost)
+     */
+    void reset();
+
+  private:
+    struct Block
+    {
+        std::array<std::atomic<uint64_t>, LatencyHistogram::kBuckets>
+            counts{};
+        std::atomic<uint64_t> sum{0};
+    };
+    struct Shard
+    {
+        std::array<std::atomic<Block *>, kMaxSlots> blocks{};
+        ~Shard();
+    };
+    struct ShardHolder
+    {
+        Shard *shard{nullptr};
+        ~ShardHolder();
+    };
+
+    LatencyRecorder() = default;
+    Shard &localShard();
+    void retire(Shard *shard);
+    static void merge(const Block &block, LatencyHistogram &out);
+
+    mutable std::mutex mutex_;
+    std::vector<Shard *> shards_;
+    std::array<LatencyHistogram, kMaxSlots> retired_{};  // Exited threads
+};
+
+}  // namespace oauth2
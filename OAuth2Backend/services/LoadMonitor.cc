@@ -0,0 +1,207 @@
+#include "LoadMonitor.h"
+#include "CycleClock.h"
+#include "plugins/OAuth2Metrics.h"
+#include <drogon/drogon.h>
+#include <trantor/net/EventLoopThread.h>
+#include <algorithm>
+
+namespace oauth2
+{
+
+namespace
+{
+
+// 503 body, per RFC 6749 section 4.1.2.1
+constexpr const char *kOverloadedBody =
+    "{\"error\":\"temporarily_unavailable\","
+    "\"error_description\":\"Server is overloaded, retry later\"}";
+
+drogon::HttpResponsePtr overloadedResponse(int retryAfterSeconds)
+{
+    // Built once per IO thread and sent as is; expiredTime 0 lets drogon
+    // reuse the rendered response (as it does for its own 404 page)
+    thread_local drogon::HttpResponsePtr resp = [retryAfterSeconds] {
+        auto r = drogon::HttpResponse::newHttpResponse();
+        r->setStatusCode(drogon::k503ServiceUnavailable);
+        r->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+        r->setBody(kOverloadedBody);
+        r->addHeader("Retry-After", std::to_string(retryAfterSeconds));
+        r->addHeader("Cache-Control", "no-store");
+        r->setExpiredTime(0);
+        return r;
+    }();
+    return resp;
+}
+
+}  // namespace
+
+std::atomic<bool> LoadMonitor::enabled_{false};
+
+LoadMonitor &LoadMonitor::instance()
+{
+    // Leaked on purpose: probes may still be queued on IO loops at exit
+    static auto *monitor = new LoadMonitor();
+    return *monitor;
+}
+
+void LoadMonitor::configure(const Json::Value &config)
+{
+    intervalSeconds_ = std::max(
+        config.get("sample_interval_ms", 50).asDouble() / 1000.0, 0.005);
+    maxLagNanos_ = static_cast<int64_t>(
+        config.get("max_loop_lag_ms", 200).asDouble() * 1e6);
+    maxInFlight_ = config.get("max_storage_inflight", 1000).asInt64();
+    retryAfterSeconds_ =
+        std::max(config.get("retry_after_seconds", 1).asInt(), 1);
+    lowPriorityPaths_.clear();
+    for (const auto &path : config["low_priority_paths"])
+        lowPriorityPaths_.push_back(path.asString());
+    enabled_.store(config.get("enabled", false).asBool(),
+                   std::memory_order_relaxed);
+}
+
+void LoadMonitor::start(std::vector<trantor::EventLoop *> loops)
+{
+    if (sampler_ || !enabled())
+        return;
+    if (loops.size() > kMaxLoops)
+    {
+        LOG_WARN << "LoadMonitor: sampling the first " << kMaxLoops << " of "
+                 << loops.size() << " IO loops";
+        loops.resize(kMaxLoops);
+    }
+    CycleClock::init();
+    for (auto &probe : probes_)
+    {
+        probe.pending.store(false, std::memory_order_relaxed);
+        probe.lagNanos.store(0, std::memory_order_relaxed);
+    }
+    loops_ = std::move(loops);
+    loopCount_.store(loops_.size(), std::memory_order_release);
+
+    sampler_ = std::make_unique<trantor::EventLoopThread>("LoadMonitor");
+    sampler_->run();
+    // [this]: the monitor is never destroyed (see instance())
+    sampler_->getLoop()->runEvery(intervalSeconds_, [this]() { sample(); });
+    LOG_INFO << "Load shedding: " << loops_.size() << " loops, lag limit "
+             << maxLagNanos_ / 1000000 << " ms, in-flight limit "
+             << maxInFlight_;
+}
+
+void LoadMonitor::stop()
+{
+    sampler_.reset();  // Quits and joins the sampling loop
+    loopCount_.store(0, std::memory_order_release);
+}
+
+void LoadMonitor::sample()
+{
+    auto now = CycleClock::now();
+    auto count = loopCount_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto &probe = probes_[i];
+        if (probe.pending.load(std::memory_order_acquire))
+        {
+            // Still waiting: the loop is at least this far behind
+            auto age = CycleClock::toNanos(
+                now - probe.postedAt.load(std::memory_order_relaxed));
+            if (age > probe.lagNanos.load(std::memory_order_relaxed))
+                probe.lagNanos.store(age, std::memory_order_relaxed);
+        }
+        else
+        {
+            probe.postedAt.store(now, std::memory_order_relaxed);
+            probe.pending.store(true, std::memory_order_release);
+            loops_[i]->queueInLoop([&probe]() {
+                auto lag = CycleClock::toNanos(
+                    CycleClock::now() -
+                    probe.postedAt.load(std::memory_order_relaxed));
+                probe.lagNanos.store(lag, std::memory_order_relaxed);
+                probe.pending.store(false, std::memory_order_release);
+            });
+        }
+        Metrics::setEventLoopLag(
+            i, probe.lagNanos.load(std::memory_order_relaxed));
+    }
+    inFlight_.store(Metrics::storageInFlight(), std::memory_order_relaxed);
+}
+
+int64_t LoadMonitor::loopLagNanos(size_t loop) const
+{
+    if (loop >= loopCount_.load(std::memory_order_acquire))
+        return 0;
+    return probes_[loop].lagNanos.load(std::memory_order_relaxed);
+}
+
+int64_t LoadMonitor::currentLoopLagNanos() const
+{
+    auto count = loopCount_.load(std::memory_order_acquire);
+    if (count == 0)
+        return 0;
+    // Resolved once per thread; threads that are not IO loops cache "none"
+    thread_local size_t index = SIZE_MAX - 1;
+    if (index == SIZE_MAX - 1)
+    {
+        auto *current = trantor::EventLoop::getEventLoopOfCurrentThread();
+        auto it = std::find(loops_.begin(), loops_.end(), current);
+        index = (current && it != loops_.end())
+                    ? static_cast<size_t>(it - loops_.begin())
+                    : SIZE_MAX;
+    }
+    return index < count ? loopLagNanos(index) : 0;
+}
+
+std::string_view LoadMonitor::shouldShed(std::string_view path) const
+{
+    if (!enabled())
+        return {};
+    for (const auto &prefix : lowPriorityPaths_)
+    {
+        if (path.substr(0, prefix.size()) != prefix)
+            continue;
+        if (storageInFlight() > maxInFlight_ ||
+            currentLoopLagNanos() > maxLagNanos_)
+            return prefix;
+        return {};
+    }
+    return {};
+}
+
+Json::Value LoadMonitor::toJson() const
+{
+    Json::Value json;
+    json["enabled"] = enabled();
+    json["storage_inflight"] = static_cast<Json::Int64>(storageInFlight());
+    json["shed"] = static_cast<Json::UInt64>(shedCount());
+    json["max_loop_lag_ms"] = static_cast<double>(maxLagNanos_) / 1e6;
+    json["max_storage_inflight"] = static_cast<Json::Int64>(maxInFlight_);
+    Json::Value loops(Json::arrayValue);
+    auto count = loopCount_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i)
+        loops.append(static_cast<double>(loopLagNanos(i)) / 1e6);
+    json["loop_lag_ms"] = loops;
+    return json;
+}
+
+void registerLoadSheddingAdvices()
+{
+    drogon::app().registerSyncAdvice(
+        [](const drogon::HttpRequestPtr &req) -> drogon::HttpResponsePtr {
+            auto &monitor = LoadMonitor::instance();
+            auto prefix = monitor.shouldShed(req->path());
+            if (prefix.empty())
+                return nullptr;
+            monitor.countShed();
+            Metrics::incRequest(prefix, 503);
+            return overloadedResponse(monitor.retryAfterSeconds());
+        });
+    drogon::app().registerBeginningAdvice([]() {
+        std::vector<trantor::EventLoop *> loops;
+        for (size_t i = 0; i < drogon::app().getThreadNum(); ++i)
+            loops.push_back(drogon::app().getIOLoop(i));
+        LoadMonitor::instance().start(std::move(loops));
+    });
+}
+
+}  // namespace oauth2
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <json/json.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace trantor
+{
+class EventLoop;
+class EventLoopThread;
+}  // namespace trantor
+
+namespace oauth2
+{
+
+/**
+ * @brief Event-loop lag sampler and admission control
+ *
+ * Every "sample_interval_ms" a background trantor loop posts a probe into
+ * each IO loop and measures how long it waits to run; a probe that has not
+ * run yet counts its age, so a stalled loop shows up while it is stalled.
+ * The same tick caches the number of storage operations in flight
+ * (oauth2_storage_inflight, kept by OperationTimer). Lag is exported as
+ * oauth2_event_loop_lag_seconds{loop}.
+ *
+ * shouldShed() rejects requests to the configured low-priority path
+ * prefixes while the loop serving them lags more than "max_loop_lag_ms"
+ * or more than "max_storage_inflight" operations are outstanding; other
+ * routes (token issue and validation) are never shed.
+ *
+ * Configured from custom_config "load_shedding":
+ * {enabled, sample_interval_ms, max_loop_lag_ms, max_storage_inflight,
+ *  retry_after_seconds, low_priority_paths: [...]}
+ */
+class LoadMonitor
+{
+  public:
+    static constexpr size_t kMaxLoops = 128;
+
+    static LoadMonitor &instance();
+
+    void configure(const Json::Value &config);
+
+    /**
+     * @brief Start sampling @p loops (the app's IO loops, once running)
+     */
+    void start(std::vector<trantor::EventLoop *> loops);
+
+    /**
+     * @brief Stop sampling; the loops are no longer referenced afterwards
+     */
+    void stop();
+
+    static bool enabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Take one sample (sampling thread, or tests while no sampling
+     * thread runs: lag gauges expect a single writer)
+     */
+    void sample();
+
+    int64_t loopLagNanos(size_t loop) const;
+
+    // 0 when not called from a sampled loop
+    int64_t currentLoopLagNanos() const;
+
+    int64_t storageInFlight() const
+    {
+        return inFlight_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @return The matched low-priority prefix when the request should be
+     * rejected, otherwise empty
+     */
+    std::string_view shouldShed(std::string_view path) const;
+
+    int retryAfterSeconds() const
+    {
+        return retryAfterSeconds_;
+    }
+
+    uint64_t shedCount() const
+    {
+        return shed_.load(std::memory_order_relaxed);
+    }
+    void countShed()
+    {
+        shed_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Json::Value toJson() const;
+
+  private:
+    struct alignas(64) Probe
+    {
+        std::atomic<uint64_t> postedAt{0};  // CycleClock ticks
+        std::atomic<bool> pending{false};
+        std::atomic<int64_t> lagNanos{0};
+    };
+
+    LoadMonitor() = default;
+
+    static std::atomic<bool> enabled_;
+    std::array<Probe, kMaxLoops> probes_;
+    // Written by start() before sampling begins, read-only afterwards
+    std::vector<trantor::EventLoop *> loops_;
+    std::atomic<size_t> loopCount_{0};
+    std::unique_ptr<trantor::EventLoopThread> sampler_;
+    std::atomic<int64_t> inFlight_{0};
+    std::atomic<uint64_t> shed_{0};
+
+    // Set by configure() before traffic, read-only afterwards
+    double intervalSeconds_{0.05};
+    int64_t maxLagNanos_{200'000'000};
+    int64_t maxInFlight_{1000};
+    int retryAfterSeconds_{1};
+    std::vector<std::string> lowPriorityPaths_;
+};
+
+/**
+ * @brief Answer shed requests with a precomputed 503 + Retry-After before
+ * routing, and start sampling once the IO loops are up
+ */
+void registerLoadSheddingAdvices();
+
+}  // namespace oauth2
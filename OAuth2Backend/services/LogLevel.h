@@ -0,0 +1,45 @@
+#pragma once
+
+#include <trantor/utils/Logger.h>
+
+/**
+ * Compile-time log level floor for the storage and plugin layers
+ *
+ * LOG_DEBUG / LOG_TRACE only check the runtime level, so the statement
+ * (and the branch) stays in the binary. OAUTH2_LOG_DEBUG / OAUTH2_LOG_TRACE
+ * are discarded entirely when the floor is above their level: the stream
+ * expression is still type-checked but never emitted or evaluated.
+ *
+ * OAUTH2_MIN_LOG_LEVEL uses trantor's numbering (0 trace, 1 debug, 2 info).
+ * It is set by the OAUTH2_LOG_LEVEL CMake option; otherwise release builds
+ * (NDEBUG) drop debug and trace, and debug builds keep everything.
+ */
+#ifndef OAUTH2_MIN_LOG_LEVEL
+#ifdef NDEBUG
+#define OAUTH2_MIN_LOG_LEVEL 2
+#else
+#define OAUTH2_MIN_LOG_LEVEL 0
+#endif
+#endif
+
+// The stream expression lands in the discarded branch when below the floor
+#define OAUTH2_LOG_TRACE                                          \
+    if constexpr (OAUTH2_MIN_LOG_LEVEL > trantor::Logger::kTrace) \
+    {                                                             \
+    }                                                             \
+    else                                                          \
+        LOG_TRACE
+#define OAUTH2_LOG_DEBUG                                          \
+    if constexpr (OAUTH2_MIN_LOG_LEVEL > trantor::Logger::kDebug) \
+    {                                                             \
+    }                                                             \
+    else                                                          \
+        LOG_DEBUG
+
+namespace oauth2
+{
+
+constexpr bool kDebugLogCompiledIn =
+    OAUTH2_MIN_LOG_LEVEL <= trantor::Logger::kDebug;
+
+}  // namespace oauth2
@@ -0,0 +1,193 @@
+#include "MetricsRegistry.h"
+#include <algorithm>
+
+namespace oauth2
+{
+
+MetricsRegistry &MetricsRegistry::instance()
+{
+    // Leaked on purpose: thread_local shard holders retire into it while
+    // threads exit, possibly after static destructors have started.
+    static auto *registry = new MetricsRegistry();
+    return *registry;
+}
+
+uint32_t MetricsRegistry::addFamily(std::string name,
+                                    std::string help,
+                                    Kind kind,
+                                    std::vector<std::string> labelNames,
+                                    std::vector<double> bounds)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t i = 0; i < families_.size(); ++i)
+    {
+        if (families_[i]->name == name)
+            return i;
+    }
+    if (families_.size() >= familyTable_.size())
+        return kInvalidCell;
+
+    std::sort(bounds.begin(), bounds.end());
+    std::vector<int64_t> scaled;
+    for (auto b : bounds)
+        scaled.push_back(static_cast<int64_t>(b * kSumScale));
+    families_.push_back(std::make_unique<Family>(Family{std::move(name),
+                                                        std::move(help),
+                                                        kind,
+                                                        std::move(labelNames),
+                                                        std::move(bounds),
+                                                        std::move(scaled)}));
+    auto id = static_cast<uint32_t>(families_.size() - 1);
+    familyTable_[id].store(families_.back().get(), std::memory_order_release);
+    return id;
+}
+
+uint32_t MetricsRegistry::series(uint32_t family,
+                                 const std::vector<std::string> &values)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (family >= families_.size())
+        return kInvalidCell;
+    for (const auto &s : series_)
+    {
+        if (s->family == family && s->labelValues == values)
+            return s->firstCell;
+    }
+
+    const auto &f = *families_[family];
+    // Histogram: buckets + "+Inf" + sum + count
+    size_t width = f.kind == Kind::kHistogram ? f.bounds.size() + 3 : 1;
+    if (nextCell_ + width > kMaxCells)
+        return kInvalidCell;
+
+    series_.push_back(
+        std::make_unique<Series>(Series{family, values, nextCell_}));
+    nextCell_ += static_cast<uint32_t>(width);
+    return series_.back()->firstCell;
+}
+
+void MetricsRegistry::observe(uint32_t family, uint32_t firstCell, double v)
+{
+    observeScaled(family, firstCell, static_cast<int64_t>(v * kSumScale));
+}
+
+void MetricsRegistry::observeScaled(uint32_t family,
+                                    uint32_t firstCell,
+                                    int64_t v)
+{
+    if (firstCell == kInvalidCell || family >= familyTable_.size())
+        return;
+    auto *f = familyTable_[family].load(std::memory_order_acquire);
+    if (!f)
+        return;
+    const auto &bounds = f->scaledBounds;
+    // Buckets are few (~12); a linear scan beats binary search here
+    uint32_t bucket = 0;
+    while (bucket < bounds.size() && v > bounds[bucket])
+        ++bucket;
+    auto buckets = static_cast<uint32_t>(bounds.size()) + 1;
+    auto &shard = localShard();
+    bump(shard, firstCell + bucket, 1);
+    bump(shard, firstCell + buckets, v);
+    bump(shard, firstCell + buckets + 1, 1);
+}
+
+const MetricsRegistry::Family &MetricsRegistry::family(uint32_t id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return *families_.at(id);
+}
+
+size_t MetricsRegistry::familyCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return families_.size();
+}
+
+int64_t MetricsRegistry::cellTotal(uint32_t cell) const
+{
+    int64_t total = retired_[cell];
+    for (auto *shard : shards_)
+        total += shard->cells[cell].load(std::memory_order_relaxed);
+    return total;
+}
+
+std::vector<MetricsRegistry::SeriesSnapshot> MetricsRegistry::snapshot(
+    uint32_t family) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<SeriesSnapshot> out;
+    if (family >= families_.size())
+        return out;
+    const auto &f = *families_[family];
+    for (const auto &s : series_)
+    {
+        if (s->family != family)
+            continue;
+        SeriesSnapshot snap{s.get(), {}};
+        if (f.kind == Kind::kHistogram)
+        {
+            auto buckets = f.bounds.size() + 1;
+            for (size_t i = 0; i < buckets; ++i)
+                snap.values.push_back(static_cast<double>(
+                    cellTotal(s->firstCell + static_cast<uint32_t>(i))));
+            auto sumCell = s->firstCell + static_cast<uint32_t>(buckets);
+            snap.values.push_back(static_cast<double>(cellTotal(sumCell)) /
+                                  kSumScale);
+            snap.values.push_back(
+                static_cast<double>(cellTotal(sumCell + 1)));
+        }
+        else
+        {
+            auto value = static_cast<double>(cellTotal(s->firstCell));
+            if (f.kind == Kind::kFixedPointGauge)
+                value /= kSumScale;
+            snap.values.push_back(value);
+        }
+        out.push_back(std::move(snap));
+    }
+    return out;
+}
+
+void MetricsRegistry::resetForTesting()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired_.fill(0);
+    for (auto *shard : shards_)
+    {
+        for (auto &c : shard->cells)
+            c.store(0, std::memory_order_relaxed);
+    }
+}
+
+MetricsRegistry::Shard &MetricsRegistry::localShard()
+{
+    thread_local ShardHolder holder;
+    if (!holder.shard)
+    {
+        holder.shard = new Shard();
+        std::lock_guard<std::mutex> lock(mutex_);
+        shards_.push_back(holder.shard);
+    }
+    return *holder.shard;
+}
+
+MetricsRegistry::ShardHolder::~ShardHolder()
+{
+    if (shard)
+        MetricsRegistry::instance().retire(shard);
+}
+
+void MetricsRegistry::retire(Shard *shard)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < kMaxCells; ++i)
+            retired_[i] += shard->cells[i].load(std::memory_order_relaxed);
+        shards_.erase(std::remove(shards_.begin(), shards_.end(), shard),
+                      shards_.end());
+    }
+    delete shard;
+}
+
+}  // namespace oauth2
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace oauth2
+{
+
+/**
+ * @brief In-process metric store with per-thread shards
+ *
+ * Every thread writes into its own cache-line aligned array of cells, so
+ * recording a sample is a couple of relaxed loads/stores with no locking
+ * and no shared cache lines. Cells are only summed across threads when
+ * the metrics are scraped (snapshot()).
+ *
+ * Families and series are registered on a slow path (mutex) and addressed
+ * by cell index afterwards. Capacity is fixed (kMaxCells); registering past
+ * it yields kInvalidCell and the samples are dropped.
+ */
+class MetricsRegistry
+{
+  public:
+    static constexpr size_t kMaxCells = 2048;
+    static constexpr uint32_t kInvalidCell = UINT32_MAX;
+
+    enum class Kind
+    {
+        kCounter,
+        kGauge,
+        kFixedPointGauge,  // Stored * kSumScale, e.g. seconds as nanoseconds
+        kHistogram
+    };
+
+    struct Family
+    {
+        std::string name;
+        std::string help;
+        Kind kind;
+        std::vector<std::string> labelNames;
+        std::vector<double> bounds;  // Histogram upper bounds, ascending
+        std::vector<int64_t> scaledBounds;  // bounds * kSumScale
+    };
+
+    struct Series
+    {
+        uint32_t family;
+        std::vector<std::string> labelValues;
+        uint32_t firstCell;
+    };
+
+    /**
+     * @brief Aggregated values of one series at scrape time
+     * Counter/gauge: values[0] (fixed-point gauges already divided by
+     * kSumScale). Histogram: one non-cumulative count per
+     * bucket (the last is +Inf), then sum, then count.
+     */
+    struct SeriesSnapshot
+    {
+        const Series *series;
+        std::vector<double> values;
+    };
+
+    static MetricsRegistry &instance();
+
+    uint32_t addFamily(std::string name,
+                       std::string help,
+                       Kind kind,
+                       std::vector<std::string> labelNames,
+                       std::vector<double> bounds = {});
+
+    /**
+     * @brief Cell range for a label combination, created on first use
+     */
+    uint32_t series(uint32_t family, const std::vector<std::string> &values);
+
+    void add(uint32_t cell, int64_t n = 1)
+    {
+        if (cell < kMaxCells)
+            bump(localShard(), cell, n);
+    }
+
+    /**
+     * @brief Record a histogram sample into the series at @p firstCell
+     */
+    void observe(uint32_t family, uint32_t firstCell, double value);
+
+    /**
+     * @brief Same, with the value already multiplied by kSumScale
+     * (nanoseconds for a histogram in seconds): integer compares only.
+     */
+    void observeScaled(uint32_t family, uint32_t firstCell, int64_t scaled);
+
+    const Family &family(uint32_t id) const;
+    size_t familyCount() const;
+    std::vector<SeriesSnapshot> snapshot(uint32_t family) const;
+
+    /**
+     * @brief Zero all cells (tests only; racing writers may be lost)
+     */
+    void resetForTesting();
+
+    // Histogram sums are kept as fixed-point integers
+    static constexpr double kSumScale = 1e9;
+
+  private:
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<int64_t>, kMaxCells> cells{};
+    };
+    struct ShardHolder
+    {
+        Shard *shard{nullptr};
+        ~ShardHolder();
+    };
+
+    MetricsRegistry() = default;
+    Shard &localShard();
+    static void bump(Shard &shard, uint32_t cell, int64_t n)
+    {
+        auto &c = shard.cells[cell];
+        // Single writer per shard: no read-modify-write needed
+        c.store(c.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+    }
+    void retire(Shard *shard);
+    int64_t cellTotal(uint32_t cell) const;  // mutex_ held
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Family>> families_;
+    std::vector<std::unique_ptr<Series>> series_;
+    // Published family pointers, readable without the mutex from observe()
+    std::array<std::atomic<const Family *>, 64> familyTable_{};
+    uint32_t nextCell_{0};
+    std::vector<Shard *> shards_;
+    std::array<int64_t, kMaxCells> retired_{};  // Exited threads' totals
+};
+
+}  // namespace oauth2
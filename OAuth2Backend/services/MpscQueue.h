@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace oauth2
+{
+
+/**
+ * @brief Bounded lock-free multi-producer / single-consumer queue
+ *
+ * Fixed ring of cells with per-cell sequence numbers (Vyukov): producers
+ * claim a slot with one CAS and publish it with a release store; push()
+ * fails instead of blocking or allocating when the ring is full. pop()
+ * must only ever be called from one thread at a time.
+ *
+ * T should be cheap to copy (fixed-size records); it is copied in and out.
+ */
+template <typename T>
+class MpscQueue
+{
+  public:
+    /**
+     * @param capacity Rounded up to a power of two (minimum 2)
+     */
+    explicit MpscQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        mask_ = size - 1;
+        cells_ = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; ++i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+    bool push(const T &value)
+    {
+        auto pos = tail_.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;)
+        {
+            cell = &cells_[pos & mask_];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(pos,
+                                                pos + 1,
+                                                std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;  // Full
+            }
+            else
+            {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &out)
+    {
+        auto &cell = cells_[head_ & mask_];
+        if (cell.sequence.load(std::memory_order_acquire) != head_ + 1)
+            return false;  // Empty, or the producer has not published yet
+        out = cell.value;
+        cell.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+  private:
+    struct Cell
+    {
+        std::atomic<uint64_t> sequence{0};
+        T value{};
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_{0};
+    alignas(64) std::atomic<uint64_t> tail_{0};  // Producers
+    alignas(64) uint64_t head_{0};               // Consumer only
+};
+
+}  // namespace oauth2
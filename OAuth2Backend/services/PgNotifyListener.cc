@@ -0,0 +1,47 @@
+#include "PgNotifyListener.h"
+#include <drogon/drogon.h>
+
+namespace oauth2
+{
+
+PgNotifyListener::PgNotifyListener(const std::string &connInfo)
+{
+    try
+    {
+        listener_ = drogon::orm::DbListener::newPgListener(connInfo);
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR << "PgNotifyListener: failed to connect: " << e.what();
+        listener_ = nullptr;
+    }
+}
+
+PgNotifyListener::~PgNotifyListener()
+{
+    if (!listener_)
+        return;
+    for (const auto &channel : channels_)
+        listener_->unlisten(channel);
+}
+
+void PgNotifyListener::listen(const std::string &channel, Handler &&handler)
+{
+    if (!listener_)
+    {
+        LOG_WARN << "PgNotifyListener: not connected, ignoring channel "
+                 << channel;
+        return;
+    }
+    channels_.push_back(channel);
+    listener_->listen(
+        channel,
+        [handler = std::move(handler)](const std::string &channel,
+                                       const std::string &payload) {
+            LOG_DEBUG << "NOTIFY " << channel << ": " << payload;
+            handler(payload);
+        });
+    LOG_INFO << "PgNotifyListener: listening on " << channel;
+}
+
+}  // namespace oauth2
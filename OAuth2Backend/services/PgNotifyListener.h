@@ -0,0 +1,41 @@
+#pragma once
+
+#include <drogon/orm/DbListener.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace oauth2
+{
+
+/**
+ * @brief Postgres LISTEN/NOTIFY subscription shared by the in-process caches
+ *
+ * Wraps drogon's DbListener. It holds its own connection (DbClient pools
+ * cannot LISTEN), so it needs a libpq conninfo string rather than a
+ * db_clients name. Handlers run on the listener's event loop.
+ */
+class PgNotifyListener
+{
+  public:
+    using Handler = std::function<void(const std::string &payload)>;
+
+    explicit PgNotifyListener(const std::string &connInfo);
+    ~PgNotifyListener();
+
+    bool valid() const
+    {
+        return listener_ != nullptr;
+    }
+
+    /**
+     * @brief Subscribe to a NOTIFY channel (one handler per channel)
+     */
+    void listen(const std::string &channel, Handler &&handler);
+
+  private:
+    drogon::orm::DbListenerPtr listener_;
+    std::vector<std::string> channels_;
+};
+
+}  // namespace oauth2
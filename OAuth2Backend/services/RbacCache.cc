@@ -0,0 +1,250 @@
+#include "RbacCache.h"
+#include <drogon/drogon.h>
+#include <drogon/orm/Mapper.h>
+#include "../models/Roles.h"
+#include "../models/Permissions.h"
+#include "../models/RolePermissions.h"
+#include <mutex>
+
+using namespace drogon;
+using namespace drogon::orm;
+using namespace drogon_model::oauth_test;
+
+namespace oauth2
+{
+
+RbacCache::RbacCache()
+{
+    // Seed from sql/003_rbac_schema.sql, so the memory and redis backends
+    // (which have no RBAC tables) behave like a freshly migrated database.
+    replace({{"admin", 1}, {"user", 2}},
+            {"user:read", "user:write", "user:delete", "admin:access"},
+            {{"admin",
+              {"user:read", "user:write", "user:delete", "admin:access"}},
+             {"user", {"user:read"}}});
+}
+
+void RbacCache::loadFromDb(const std::string &dbClientName)
+{
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        source_ = dbClientName;
+    }
+    DbClientPtr db;
+    try
+    {
+        db = app().getDbClient(dbClientName);
+    }
+    catch (...)
+    {
+        db = nullptr;
+    }
+    if (!db)
+    {
+        LOG_WARN << "RbacCache: DB client '" << dbClientName
+                 << "' unavailable, keeping built-in catalog";
+        return;
+    }
+
+    auto onError = [](const DrogonDbException &e) {
+        LOG_ERROR << "RbacCache: failed to load RBAC tables: "
+                  << e.base().what();
+    };
+
+    // `this` is safe: the cache is owned by OAuth2Plugin, which outlives
+    // every DB callback issued while the app is running.
+    Mapper<Roles>(db).findAll(
+        [this, db, dbClientName, onError](const std::vector<Roles> &roles) {
+            Mapper<Permissions>(db).findAll(
+                [this, db, dbClientName, onError, roles](
+                    const std::vector<Permissions> &permissions) {
+                    Mapper<RolePermissions>(db).findAll(
+                        [this, dbClientName, roles, permissions](
+                            const std::vector<RolePermissions> &links) {
+                            std::unordered_map<std::string, int32_t> ids;
+                            std::unordered_map<int32_t, std::string> roleNames;
+                            for (const auto &r : roles)
+                            {
+                                ids[r.getValueOfName()] = r.getValueOfId();
+                                roleNames[r.getValueOfId()] =
+                                    r.getValueOfName();
+                            }
+
+                            std::vector<std::string> permNames;
+                            std::unordered_map<int32_t, std::string> permById;
+                            for (const auto &p : permissions)
+                            {
+                                permNames.push_back(p.getValueOfName());
+                                permById[p.getValueOfId()] = p.getValueOfName();
+                            }
+
+                            Grants grants;
+                            for (const auto &link : links)
+                            {
+                                auto r =
+                                    roleNames.find(link.getValueOfRoleId());
+                                auto p = permById.find(
+                                    link.getValueOfPermissionId());
+                                if (r != roleNames.end() && p != permById.end())
+                                    grants[r->second].push_back(p->second);
+                            }
+
+                            LOG_INFO << "RbacCache: loaded " << ids.size()
+                                     << " roles, " << permNames.size()
+                                     << " permissions";
+                            replace(std::move(ids),
+                                    permNames,
+                                    grants,
+                                    dbClientName);
+                        },
+                        onError);
+                },
+                onError);
+        },
+        onError);
+}
+
+void RbacCache::replace(std::unordered_map<std::string, int32_t> &&idsByName,
+                        const std::vector<std::string> &permissions,
+                        const Grants &grants,
+                        const std::string &source)
+{
+    std::unordered_map<int32_t, std::string> namesById;
+    for (const auto &[name, id] : idsByName)
+        namesById[id] = name;
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    // Bits are only ever appended, so an index handed out earlier keeps
+    // meaning the same permission after a reload.
+    for (const auto &perm : permissions)
+    {
+        if (permissionBits_.count(perm))
+            continue;
+        if (permissionBits_.size() >= kMaxPermissions)
+        {
+            LOG_ERROR << "RbacCache: more than " << kMaxPermissions
+                      << " permissions, ignoring " << perm;
+            continue;
+        }
+        permissionBits_.emplace(perm, permissionBits_.size());
+    }
+
+    std::unordered_map<int32_t, PermissionSet> rolePermissions;
+    for (const auto &[role, perms] : grants)
+    {
+        auto id = idsByName.find(role);
+        if (id == idsByName.end())
+            continue;
+        auto &set = rolePermissions[id->second];
+        for (const auto &perm : perms)
+        {
+            auto bit = permissionBits_.find(perm);
+            if (bit != permissionBits_.end())
+                set.set(bit->second);
+        }
+    }
+
+    idsByName_ = std::move(idsByName);
+    namesById_ = std::move(namesById);
+    rolePermissions_ = std::move(rolePermissions);
+    loadedFrom_ = source;
+}
+
+bool RbacCache::loadedFrom(const std::string &dbClientName) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return !loadedFrom_.empty() && loadedFrom_ == dbClientName;
+}
+
+bool RbacCache::authoritative() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return source_.empty() || loadedFrom_ == source_;
+}
+
+bool RbacCache::toRoleIds(const std::vector<std::string> &names,
+                          std::vector<int32_t> &ids) const
+{
+    std::vector<int32_t> result;
+    result.reserve(names.size());
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (const auto &name : names)
+    {
+        auto it = idsByName_.find(name);
+        if (it == idsByName_.end())
+            return false;
+        result.push_back(it->second);
+    }
+    ids = std::move(result);
+    return true;
+}
+
+std::vector<std::string> RbacCache::toRoleNames(
+    const std::vector<int32_t> &ids) const
+{
+    std::vector<std::string> names;
+    names.reserve(ids.size());
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (auto id : ids)
+    {
+        auto it = namesById_.find(id);
+        if (it != namesById_.end())
+            names.push_back(it->second);
+    }
+    return names;
+}
+
+std::optional<int32_t> RbacCache::roleId(const std::string &name) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = idsByName_.find(name);
+    if (it == idsByName_.end())
+        return std::nullopt;
+    return it->second;
+}
+
+std::optional<size_t> RbacCache::permissionBit(
+    const std::string &permission) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = permissionBits_.find(permission);
+    if (it == permissionBits_.end())
+        return std::nullopt;
+    return it->second;
+}
+
+RbacCache::PermissionSet RbacCache::permissionsOf(
+    const std::vector<int32_t> &roleIds) const
+{
+    PermissionSet set;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (auto id : roleIds)
+    {
+        auto it = rolePermissions_.find(id);
+        if (it != rolePermissions_.end())
+            set |= it->second;
+    }
+    return set;
+}
+
+RbacCache::PermissionSet RbacCache::permissionsOf(
+    const std::vector<std::string> &roles) const
+{
+    PermissionSet set;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (const auto &role : roles)
+    {
+        auto id = idsByName_.find(role);
+        if (id == idsByName_.end())
+            continue;
+        auto it = rolePermissions_.find(id->second);
+        if (it != rolePermissions_.end())
+            set |= it->second;
+    }
+    return set;
+}
+
+}  // namespace oauth2
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace oauth2
+{
+
+/**
+ * @brief In-process catalog of RBAC roles and permissions
+ *
+ * Access tokens carry a compact snapshot of role IDs taken at issue time.
+ * This catalog translates between those IDs and the role names used by
+ * rbac_rules, and holds each role's permissions as a bitset so that a
+ * permission check is a single bit test.
+ *
+ * It starts with the data seeded by sql/003_rbac_schema.sql and, for the
+ * Postgres backend, is reloaded from the roles / permissions /
+ * role_permissions tables at startup and on change notifications.
+ */
+class RbacCache
+{
+  public:
+    static constexpr size_t kMaxPermissions = 256;
+    using PermissionSet = std::bitset<kMaxPermissions>;
+
+    RbacCache();
+
+    /**
+     * @brief Reload the catalog from the RBAC tables (Async)
+     * Keeps the current catalog if any query fails.
+     */
+    void loadFromDb(const std::string &dbClientName);
+
+    /**
+     * @brief Map role names to IDs
+     * @return false if any name is unknown; @p ids is left untouched then.
+     */
+    bool toRoleIds(const std::vector<std::string> &names,
+                   std::vector<int32_t> &ids) const;
+
+    /**
+     * @brief Map role IDs back to names (unknown IDs are skipped)
+     */
+    std::vector<std::string> toRoleNames(const std::vector<int32_t> &ids) const;
+
+    std::optional<int32_t> roleId(const std::string &name) const;
+
+    /**
+     * @brief Whether the catalog was read from @p dbClientName's tables
+     * Until then it holds the built-in seed, whose role IDs need not match
+     * any real database.
+     */
+    bool loadedFrom(const std::string &dbClientName) const;
+
+    /**
+     * @brief Whether role IDs from this catalog match the backend's
+     * True for the seed until loadFromDb() is first called; from then on
+     * only once a load from that database has succeeded.
+     */
+    bool authoritative() const;
+
+    /**
+     * @brief Bit index of a permission; stable across reloads
+     */
+    std::optional<size_t> permissionBit(const std::string &permission) const;
+
+    /**
+     * @brief Union of the permissions granted by the given roles
+     */
+    PermissionSet permissionsOf(const std::vector<int32_t> &roleIds) const;
+    PermissionSet permissionsOf(const std::vector<std::string> &roles) const;
+
+  private:
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, int32_t> idsByName_;
+    std::unordered_map<int32_t, std::string> namesById_;
+    std::unordered_map<std::string, size_t> permissionBits_;
+    std::unordered_map<int32_t, PermissionSet> rolePermissions_;
+    std::string loadedFrom_;  // DB client of the last load; "" = seed
+    std::string source_;      // DB client loadFromDb() was asked for
+
+    // role name -> permission names
+    using Grants =
+        std::unordered_map<std::string, std::vector<std::string>>;
+
+    void replace(std::unordered_map<std::string, int32_t> &&idsByName,
+                 const std::vector<std::string> &permissions,
+                 const Grants &grants,
+                 const std::string &source = "");
+};
+
+}  // namespace oauth2
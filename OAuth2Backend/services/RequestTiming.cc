@@ -0,0 +1,63 @@
+#include "RequestTiming.h"
+#include "CycleClock.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+#include <cstdio>
+
+namespace oauth2
+{
+
+RequestTiming::RequestTiming(const drogon::HttpRequestPtr &req,
+                             std::string_view endpoint,
+                             bool logRecord)
+    : endpoint_(endpoint), logRecord_(logRecord), start_(CycleClock::now())
+{
+    // Time between the request being parsed and the handler running:
+    // event-loop queueing plus filters
+    auto queuedUs = trantor::Date::now().microSecondsSinceEpoch() -
+                    req->creationDate().microSecondsSinceEpoch();
+    add("queue", std::max<int64_t>(queuedUs, 0) * 1000);
+}
+
+void RequestTiming::add(std::string_view name, int64_t nanos)
+{
+    // Parallel branches of a flow may add at the same time: each claims
+    // its own slot. finish() runs after they have joined.
+    auto i = size_.fetch_add(1, std::memory_order_relaxed);
+    if (i < kMaxEntries)
+        entries_[i] = Entry{name, nanos};
+}
+
+void RequestTiming::finish(const drogon::HttpResponsePtr &resp)
+{
+    add("total", CycleClock::toNanos(CycleClock::now() - start_));
+    auto value = headerValue();
+    resp->addHeader("Server-Timing", value);
+    if (logRecord_)
+    {
+        LOG_INFO << "[TIMING] Endpoint=" << endpoint_
+                 << " Status=" << static_cast<int>(resp->statusCode())
+                 << " Phases=\"" << value << "\"";
+    }
+}
+
+std::string RequestTiming::headerValue() const
+{
+    std::string out;
+    char dur[32];
+    auto size = std::min(size_.load(std::memory_order_relaxed), kMaxEntries);
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (i > 0)
+            out += ", ";
+        out.append(entries_[i].name.data(), entries_[i].name.size());
+        std::snprintf(dur,
+                      sizeof(dur),
+                      ";dur=%.3f",
+                      static_cast<double>(entries_[i].nanos) / 1e6);
+        out += dur;
+    }
+    return out;
+}
+
+}  // namespace oauth2
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace oauth2
+{
+
+/**
+ * @brief Phase breakdown of one request, for the Server-Timing header
+ *
+ * Only created when server timing is enabled; the plugin flows take a
+ * RequestTimingPtr that is null otherwise, so the disabled cost is one
+ * null check per phase. Phases of one request may be added from parallel
+ * branches on different threads; add() claims slots atomically, without
+ * locking.
+ */
+class RequestTiming
+{
+  public:
+    static constexpr size_t kMaxEntries = 12;
+
+    /**
+     * @param logRecord Also log a [TIMING] line when the response is sent
+     */
+    RequestTiming(const drogon::HttpRequestPtr &req,
+                  std::string_view endpoint,
+                  bool logRecord);
+
+    /**
+     * @brief Append a phase; @p name must outlive this object
+     * (a string literal or one of the constexpr name tables)
+     */
+    void add(std::string_view name, int64_t nanos);
+
+    /**
+     * @brief Add "total" and set the Server-Timing header on @p resp
+     */
+    void finish(const drogon::HttpResponsePtr &resp);
+
+    // "queue;dur=0.120, exchange.consumeAuthCode;dur=1.402, ..." (ms)
+    std::string headerValue() const;
+
+  private:
+    struct Entry
+    {
+        std::string_view name;
+        int64_t nanos;
+    };
+
+    std::string_view endpoint_;
+    bool logRecord_;
+    uint64_t start_;  // CycleClock ticks at handler entry
+    std::array<Entry, kMaxEntries> entries_{};
+    std::atomic<size_t> size_{0};
+};
+
+using RequestTimingPtr = std::shared_ptr<RequestTiming>;
+
+}  // namespace oauth2
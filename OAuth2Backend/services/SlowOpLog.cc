@@ -0,0 +1,319 @@
+#include "SlowOpLog.h"
+#include "CycleClock.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <random>
+
+namespace oauth2
+{
+
+namespace
+{
+
+constexpr const char *kHandlerStartKey = "oauth2.handler_start";
+constexpr int64_t kInfinite = std::numeric_limits<int64_t>::max();
+
+uint64_t keySalt()
+{
+    static const uint64_t salt = [] {
+        std::random_device rd;
+        return (static_cast<uint64_t>(rd()) << 32) ^ rd();
+    }();
+    return salt;
+}
+
+int64_t queuedSince(const drogon::HttpRequestPtr &req)
+{
+    auto us = trantor::Date::now().microSecondsSinceEpoch() -
+              req->creationDate().microSecondsSinceEpoch();
+    return std::max<int64_t>(us, 0) * 1000;
+}
+
+std::string hex(uint64_t v)
+{
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016" PRIx64, v);
+    return buf;
+}
+
+}  // namespace
+
+std::atomic<bool> SlowOpLog::enabled_{false};
+
+SlowOpLog::SlowOpLog()
+{
+    for (auto &t : thresholds_)
+        t.store(kInfinite, std::memory_order_relaxed);
+}
+
+SlowOpLog &SlowOpLog::instance()
+{
+    static SlowOpLog log;
+    return log;
+}
+
+void SlowOpLog::configure(const Json::Value &config)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool enabled = config.get("enabled", false).asBool();
+    thresholdConfig_.clear();
+    defaultThreshold_ = kInfinite;
+    if (enabled)
+    {
+        const auto &thresholds = config["thresholds_ms"];
+        for (const auto &name : thresholds.getMemberNames())
+        {
+            auto nanos =
+                static_cast<int64_t>(thresholds[name].asDouble() * 1e6);
+            if (name == "default")
+                defaultThreshold_ = nanos;
+            else
+                thresholdConfig_[name] = nanos;
+        }
+    }
+    log_ = config.get("log", true).asBool();
+    sampleRatio_ =
+        std::clamp(config.get("sample_ratio", 1.0).asDouble(), 0.0, 1.0);
+    maxPerSecond_ = config.get("max_per_second", 20).asUInt();
+    ringSize_ = std::max(config.get("ring_size", 256).asUInt(), 1u);
+    ring_.clear();
+    next_ = 0;
+
+    for (size_t i = 0; i < sites_.size(); ++i)
+        thresholds_[i].store(resolveThreshold(sites_[i]),
+                             std::memory_order_relaxed);
+    // The overflow slot only ever uses the default
+    thresholds_[kMaxSites - 1].store(defaultThreshold_,
+                                     std::memory_order_relaxed);
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+int64_t SlowOpLog::resolveThreshold(const Site &site) const
+{
+    for (const auto &key : {site.backend + "." + site.operation,
+                            site.operation,
+                            site.backend})
+    {
+        auto it = thresholdConfig_.find(key);
+        if (it != thresholdConfig_.end())
+            return it->second;
+    }
+    return defaultThreshold_;
+}
+
+uint32_t SlowOpLog::site(std::string_view operation, std::string_view backend)
+{
+    std::string key;
+    key.reserve(backend.size() + operation.size() + 1);
+    key.append(backend).append(".").append(operation);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = siteIndex_.find(key);
+    if (it != siteIndex_.end())
+        return it->second;
+    if (sites_.size() >= kMaxSites - 1)
+        return kMaxSites - 1;
+    auto id = static_cast<uint32_t>(sites_.size());
+    sites_.push_back(Site{std::string(operation), std::string(backend)});
+    thresholds_[id].store(enabled() ? resolveThreshold(sites_.back())
+                                    : kInfinite,
+                          std::memory_order_relaxed);
+    siteIndex_.emplace(std::move(key), id);
+    return id;
+}
+
+bool SlowOpLog::admit()
+{
+    // Caller holds mutex_
+    if (sampleRatio_ < 1.0)
+    {
+        thread_local std::mt19937_64 rng{std::random_device{}()};
+        if (std::uniform_real_distribution<double>(0, 1)(rng) >= sampleRatio_)
+            return false;
+    }
+    auto second = trantor::Date::now().secondsSinceEpoch();
+    if (second != windowSecond_)
+    {
+        windowSecond_ = second;
+        windowCount_ = 0;
+    }
+    return windowCount_++ < maxPerSecond_;
+}
+
+void SlowOpLog::report(uint32_t site,
+                       uint64_t keyHash,
+                       int64_t nanos,
+                       int64_t queueNanos,
+                       const TraceContext &trace)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!admit())
+    {
+        ++suppressed_;
+        return;
+    }
+    ++reported_;
+
+    SlowOpRecord record;
+    record.timestampUs = trantor::Date::now().microSecondsSinceEpoch();
+    if (site < sites_.size())
+    {
+        record.operation = sites_[site].operation;
+        record.backend = sites_[site].backend;
+    }
+    else
+    {
+        record.operation = "(overflow)";
+    }
+    record.keyHash = keyHash;
+    record.durationNanos = nanos;
+    record.queueNanos = queueNanos;
+    record.trace = trace;
+
+    if (log_)
+    {
+        LOG_WARN << "[SLOW] Op=" << record.operation
+                 << " Backend=" << record.backend
+                 << " KeyHash=" << (keyHash ? hex(keyHash) : "-")
+                 << " DurationMs=" << static_cast<double>(nanos) / 1e6
+                 << " QueueMs="
+                 << (queueNanos < 0 ? -1.0
+                                    : static_cast<double>(queueNanos) / 1e6);
+    }
+
+    if (ring_.size() < ringSize_)
+        ring_.push_back(std::move(record));
+    else
+        ring_[next_] = std::move(record);
+    next_ = (next_ + 1) % ringSize_;
+}
+
+std::vector<SlowOpRecord> SlowOpLog::recent(size_t limit) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<SlowOpRecord> out;
+    auto n = std::min(limit, ring_.size());
+    out.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto idx = (next_ + ring_.size() - 1 - i) % ring_.size();
+        out.push_back(ring_[idx]);
+    }
+    return out;
+}
+
+Json::Value SlowOpLog::toJson(size_t limit) const
+{
+    Json::Value json;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        json["reported"] = static_cast<Json::UInt64>(reported_);
+        json["suppressed"] = static_cast<Json::UInt64>(suppressed_);
+    }
+    Json::Value ops(Json::arrayValue);
+    for (const auto &r : recent(limit))
+    {
+        Json::Value item;
+        item["timestamp_us"] = static_cast<Json::Int64>(r.timestampUs);
+        item["operation"] = r.operation;
+        item["backend"] = r.backend;
+        if (r.keyHash)
+            item["key_hash"] = hex(r.keyHash);
+        item["duration_ms"] = static_cast<double>(r.durationNanos) / 1e6;
+        if (r.queueNanos >= 0)
+            item["queue_ms"] = static_cast<double>(r.queueNanos) / 1e6;
+        if (r.trace.valid())
+            item["trace_id"] = hex(r.trace.traceHi) + hex(r.trace.traceLo);
+        ops.append(item);
+    }
+    json["operations"] = ops;
+    return json;
+}
+
+void SlowOpLog::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ring_.clear();
+    next_ = 0;
+    reported_ = 0;
+    suppressed_ = 0;
+}
+
+uint64_t SlowOpLog::hashKey(std::string_view key)
+{
+    if (key.empty() || !enabled())
+        return 0;
+    // FNV-1a over a per-process salt: stable within a run, meaningless
+    // outside it
+    uint64_t h = 14695981039346656037ULL ^ keySalt();
+    for (unsigned char c : key)
+    {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+// ========== SlowOpTimer ==========
+
+SlowOpTimer::SlowOpTimer(uint32_t site, const drogon::HttpRequestPtr &req)
+    : site_(site)
+{
+    if (!SlowOpLog::enabled())
+        return;
+    start_ = CycleClock::now();
+    queueNanos_ = queuedSince(req);
+    trace_ = requestTrace(req);
+}
+
+void SlowOpTimer::stop(std::string_view key) const
+{
+    if (start_ == 0)
+        return;
+    auto nanos = CycleClock::toNanos(CycleClock::now() - start_);
+    auto &log = SlowOpLog::instance();
+    if (log.exceeds(site_, nanos))
+        log.report(site_, SlowOpLog::hashKey(key), nanos, queueNanos_, trace_);
+}
+
+// ========== Handler advices ==========
+
+void registerSlowOpAdvices()
+{
+    drogon::app().registerPreHandlingAdvice(
+        [](const drogon::HttpRequestPtr &req) {
+            if (SlowOpLog::enabled())
+                req->getAttributes()->insert(kHandlerStartKey,
+                                             CycleClock::now());
+        });
+    drogon::app().registerPostHandlingAdvice(
+        [](const drogon::HttpRequestPtr &req, const drogon::HttpResponsePtr &) {
+            const auto &attrs = req->getAttributes();
+            if (!attrs->find(kHandlerStartKey))
+                return;
+            auto start = attrs->get<uint64_t>(kHandlerStartKey);
+            auto nanos = CycleClock::toNanos(CycleClock::now() - start);
+            // Cache sites per thread; paths with IDs in them fall into the
+            // shared overflow site once the table is full
+            thread_local std::unordered_map<std::string, uint32_t> sites;
+            auto &log = SlowOpLog::instance();
+            uint32_t site = SlowOpLog::kMaxSites - 1;
+            auto it = sites.find(req->path());
+            if (it != sites.end())
+                site = it->second;
+            else if (sites.size() < SlowOpLog::kMaxSites)
+                site = sites[req->path()] = log.site(req->path(), "handler");
+            if (!log.exceeds(site, nanos))
+                return;
+            // Queue wait: request parsed -> handler start (incl. filters)
+            log.report(site,
+                       0,
+                       nanos,
+                       std::max<int64_t>(queuedSince(req) - nanos, 0),
+                       requestTrace(req));
+        });
+}
+
+}  // namespace oauth2
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Tracer.h"
+#include <drogon/HttpRequest.h>
+#include <json/json.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace oauth2
+{
+
+/**
+ * @brief One operation that exceeded its threshold
+ */
+struct SlowOpRecord
+{
+    int64_t timestampUs{0};  // Unix time at completion
+    std::string operation;
+    std::string backend;  // Storage backend, "filter" or "handler"
+    uint64_t keyHash{0};  // 0 when the operation has no key
+    int64_t durationNanos{0};
+    int64_t queueNanos{-1};  // Request parse -> start; -1 if not measured
+    TraceContext trace;
+};
+
+/**
+ * @brief Slow-operation detector with a bounded history
+ *
+ * Every timed site (storage op x backend, filter, handler) registers once
+ * and gets a dense ID; its threshold lives in an atomic, so the check on
+ * the hot path is one relaxed load and a compare. Only operations over
+ * the threshold touch the rest: sampling, a per-second rate limit, an
+ * optional [SLOW] log line and a mutex-protected ring of recent records.
+ *
+ * Configured from custom_config "slow_ops":
+ * {enabled, log, ring_size, max_per_second, sample_ratio,
+ *  thresholds_ms: {default, <backend>, <operation>, <backend>.<operation>}}
+ * with the most specific threshold winning. Disabled means every
+ * threshold is infinite.
+ */
+class SlowOpLog
+{
+  public:
+    static constexpr size_t kMaxSites = 256;
+
+    static SlowOpLog &instance();
+
+    /**
+     * @brief Apply a configuration; sites registered before and after
+     * both pick it up
+     */
+    void configure(const Json::Value &config);
+
+    static bool enabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Dense ID of (operation, backend); callers cache it
+     * Sites beyond kMaxSites share the last slot (default threshold).
+     */
+    uint32_t site(std::string_view operation, std::string_view backend);
+
+    bool exceeds(uint32_t site, int64_t nanos) const
+    {
+        return nanos >= thresholds_[site].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Record a slow operation, subject to sampling and rate limit
+     */
+    void report(uint32_t site,
+                uint64_t keyHash,
+                int64_t nanos,
+                int64_t queueNanos,
+                const TraceContext &trace);
+
+    /**
+     * @brief Newest first, at most @p limit records
+     */
+    std::vector<SlowOpRecord> recent(size_t limit) const;
+
+    // {"reported", "suppressed", "operations": [...]}
+    Json::Value toJson(size_t limit) const;
+
+    void clear();
+
+    /**
+     * @brief Salted 64-bit hash of a key (token, client id, ...), so
+     * records can be correlated without exposing the key itself; 0 for
+     * an empty key or when disabled
+     */
+    static uint64_t hashKey(std::string_view key);
+
+  private:
+    struct Site
+    {
+        std::string operation;
+        std::string backend;
+    };
+
+    SlowOpLog();
+    int64_t resolveThreshold(const Site &site) const;
+    bool admit();
+
+    static std::atomic<bool> enabled_;
+
+    std::array<std::atomic<int64_t>, kMaxSites> thresholds_;
+
+    mutable std::mutex mutex_;  // Everything below
+    std::vector<Site> sites_;
+    std::unordered_map<std::string, uint32_t> siteIndex_;
+    std::unordered_map<std::string, int64_t> thresholdConfig_;  // nanos
+    int64_t defaultThreshold_{std::numeric_limits<int64_t>::max()};
+    std::vector<SlowOpRecord> ring_;
+    size_t ringSize_{256};
+    size_t next_{0};
+    bool log_{true};
+    double sampleRatio_{1.0};
+    uint32_t maxPerSecond_{20};
+    int64_t windowSecond_{0};
+    uint32_t windowCount_{0};
+    uint64_t reported_{0};
+    uint64_t suppressed_{0};
+};
+
+/**
+ * @brief Times a filter (or any request-scoped step) against its site
+ * Copyable, so it can be captured into the filter's async callbacks.
+ */
+class SlowOpTimer
+{
+  public:
+    SlowOpTimer(uint32_t site, const drogon::HttpRequestPtr &req);
+
+    void stop(std::string_view key = {}) const;
+
+  private:
+    uint32_t site_;
+    uint64_t start_{0};  // CycleClock; 0 when disabled
+    int64_t queueNanos_{-1};
+    TraceContext trace_;
+};
+
+/**
+ * @brief Time every handler (pre- to post-handling advice) against its
+ * "handler" site; call once before app().run() when enabled
+ */
+void registerSlowOpAdvices();
+
+}  // namespace oauth2
@@ -0,0 +1,481 @@
+#include "Tracer.h"
+#include "CycleClock.h"
+#include <drogon/drogon.h>
+#include <trantor/net/EventLoopThread.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <thread>
+
+namespace oauth2
+{
+
+namespace
+{
+
+constexpr const char *kTraceAttributeKey = "oauth2.trace";
+
+thread_local TraceContext g_current;
+
+// splitmix64 over a per-thread random seed: cheap, and unique enough for
+// span IDs
+uint64_t randomId()
+{
+    thread_local uint64_t state = [] {
+        std::random_device rd;
+        return (static_cast<uint64_t>(rd()) << 32) ^ rd() ^
+               std::hash<std::thread::id>{}(std::this_thread::get_id());
+    }();
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return z ? z : 1;
+}
+
+bool sampleNewTrace(double ratio)
+{
+    if (ratio >= 1.0)
+        return true;
+    // Top 53 bits as a uniform double in [0, 1)
+    return static_cast<double>(randomId() >> 11) * 0x1.0p-53 < ratio;
+}
+
+void appendHex(std::string &out, uint64_t v)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (int shift = 60; shift >= 0; shift -= 4)
+        out += digits[(v >> shift) & 0xf];
+}
+
+bool parseHex(std::string_view s, uint64_t &out)
+{
+    out = 0;
+    for (char c : s)
+    {
+        out <<= 4;
+        if (c >= '0' && c <= '9')
+            out |= static_cast<uint64_t>(c - '0');
+        else if (c >= 'a' && c <= 'f')
+            out |= static_cast<uint64_t>(c - 'a' + 10);
+        else
+            return false;
+    }
+    return true;
+}
+
+void appendEscaped(std::string &out, std::string_view s)
+{
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            out += ' ';
+        }
+        else
+        {
+            out += c;
+        }
+    }
+}
+
+void appendAttribute(std::string &out,
+                     bool &first,
+                     std::string_view key,
+                     std::string_view value)
+{
+    if (!first)
+        out += ',';
+    first = false;
+    out += R"({"key":")";
+    appendEscaped(out, key);
+    out += R"(","value":{"stringValue":")";
+    appendEscaped(out, value);
+    out += R"("}})";
+}
+
+std::string_view methodName(drogon::HttpMethod method)
+{
+    switch (method)
+    {
+        case drogon::Get:
+            return "GET";
+        case drogon::Post:
+            return "POST";
+        case drogon::Put:
+            return "PUT";
+        case drogon::Delete:
+            return "DELETE";
+        case drogon::Options:
+            return "OPTIONS";
+        case drogon::Patch:
+            return "PATCH";
+        case drogon::Head:
+            return "HEAD";
+        default:
+            return "HTTP";
+    }
+}
+
+}  // namespace
+
+// ========== TraceContext ==========
+
+std::string TraceContext::traceparent() const
+{
+    std::string out = "00-";
+    out.reserve(55);
+    appendHex(out, traceHi);
+    appendHex(out, traceLo);
+    out += '-';
+    appendHex(out, spanId);
+    out += sampled ? "-01" : "-00";
+    return out;
+}
+
+TraceContext TraceContext::parse(std::string_view header)
+{
+    TraceContext ctx;
+    // version(2)-traceid(32)-parentid(16)-flags(2); version ff is invalid
+    if (header.size() < 55 || header[2] != '-' || header[35] != '-' ||
+        header[52] != '-' || header.substr(0, 2) == "ff" ||
+        (header.size() > 55 && header[55] != '-'))
+        return {};
+    uint64_t version = 0, flags = 0;
+    if (!parseHex(header.substr(0, 2), version) ||
+        !parseHex(header.substr(3, 16), ctx.traceHi) ||
+        !parseHex(header.substr(19, 16), ctx.traceLo) ||
+        !parseHex(header.substr(36, 16), ctx.spanId) ||
+        !parseHex(header.substr(53, 2), flags))
+        return {};
+    ctx.sampled = (flags & 0x01) != 0;
+    if (!ctx.valid())
+        return {};
+    return ctx;
+}
+
+// ========== Span ==========
+
+Span::Span(std::string_view name, SpanKind kind, const TraceContext &parent)
+{
+    if (!Tracer::enabled() || !parent.valid())
+        return;
+    record_.context = TraceContext{parent.traceHi,
+                                   parent.traceLo,
+                                   randomId(),
+                                   parent.sampled};
+    record_.parentSpanId = parent.spanId;
+    record_.name = name;
+    record_.kind = kind;
+    record_.startTicks = CycleClock::now();
+    recording_ = parent.sampled;
+}
+
+Span::Span(std::string_view name,
+           SpanKind kind,
+           const TraceContext &parent,
+           uint64_t startTicks)
+    : Span(name, kind, parent)
+{
+    record_.startTicks = startTicks;
+}
+
+Span::Span(std::string_view name, SpanKind kind)
+    : Span(name, kind, TraceScope::current())
+{
+}
+
+Span Span::forRequest(const drogon::HttpRequestPtr &req)
+{
+    auto name = methodName(req->method());
+    auto incoming = TraceContext::parse(req->getHeader("traceparent"));
+    if (incoming.valid())
+        return Span(name, SpanKind::kServer, incoming);
+
+    Span span;
+    if (!Tracer::enabled())
+        return span;
+    // New trace; a root span has no parent span ID
+    span.record_.context =
+        TraceContext{randomId(),
+                     randomId(),
+                     randomId(),
+                     sampleNewTrace(Tracer::instance().sampleRatio())};
+    span.record_.name = name;
+    span.record_.kind = SpanKind::kServer;
+    span.record_.startTicks = CycleClock::now();
+    span.recording_ = span.record_.context.sampled;
+    return span;
+}
+
+void Span::setAttribute(std::string_view key, std::string_view value)
+{
+    if (!recording_)
+        return;
+    auto len = std::min(value.size(), record_.attrValue.size());
+    std::copy_n(value.data(), len, record_.attrValue.data());
+    record_.attrKey = key;
+    record_.attrLen = static_cast<uint8_t>(len);
+}
+
+void Span::setStaticAttribute(std::string_view key, std::string_view value)
+{
+    record_.staticKey = key;
+    record_.staticValue = value;
+}
+
+void Span::end(bool ok) const
+{
+    if (!recording_)
+        return;
+    SpanRecord r = record_;
+    r.endTicks = CycleClock::now();
+    r.error = !ok;
+    Tracer::instance().record(r);
+}
+
+// ========== TraceScope ==========
+
+TraceScope::TraceScope(const TraceContext &context)
+    : active_(Tracer::enabled())
+{
+    if (!active_)
+        return;
+    previous_ = g_current;
+    g_current = context;
+}
+
+TraceScope::~TraceScope()
+{
+    if (active_)
+        g_current = previous_;
+}
+
+TraceContext TraceScope::current()
+{
+    return g_current;
+}
+
+// ========== Tracer ==========
+
+std::atomic<bool> Tracer::enabled_{false};
+
+Tracer::Tracer() = default;
+
+Tracer &Tracer::instance()
+{
+    // Leaked on purpose: ring holders retire into it while threads exit
+    static auto *tracer = new Tracer();
+    return *tracer;
+}
+
+void Tracer::start(const Json::Value &config)
+{
+    if (enabled() || !config.get("enabled", false).asBool())
+        return;
+
+    auto file = config.get("file", "./logs/traces.jsonl").asString();
+    out_.open(file, std::ios::out | std::ios::app);
+    if (!out_.is_open())
+    {
+        LOG_ERROR << "Tracing disabled: cannot open " << file;
+        return;
+    }
+
+    // Power of two, so a slot is head & mask
+    auto requested = std::max<uint64_t>(
+        config.get("ring_size", 1024).asUInt64(), 64);
+    ringSize_ = 64;
+    while (ringSize_ < requested)
+        ringSize_ <<= 1;
+    sampleRatio_ =
+        std::clamp(config.get("sample_ratio", 1.0).asDouble(), 0.0, 1.0);
+    serviceName_ = config.get("service_name", serviceName_).asString();
+
+    CycleClock::init();
+    baseTicks_ = CycleClock::now();
+    baseUnixNanos_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+
+    auto interval = config.get("flush_interval_ms", 1000).asDouble() / 1000.0;
+    flusher_ = std::make_unique<trantor::EventLoopThread>("TraceFlusher");
+    flusher_->run();
+    // [this]: the Tracer is never destroyed (see instance())
+    flusher_->getLoop()->runEvery(std::max(interval, 0.05),
+                                  [this]() { flush(); });
+    enabled_.store(true, std::memory_order_relaxed);
+    LOG_INFO << "Tracing enabled: " << file << " (sample ratio "
+             << sampleRatio_ << ", ring " << ringSize_ << ")";
+}
+
+void Tracer::stop()
+{
+    if (!enabled_.exchange(false))
+        return;
+    flusher_.reset();  // Quits and joins the flush loop
+    flush();
+    std::lock_guard<std::mutex> lock(mutex_);
+    out_.close();
+    if (dropped() > 0)
+        LOG_WARN << "Tracing dropped " << dropped() << " spans (ring full)";
+}
+
+void Tracer::record(const SpanRecord &span)
+{
+    if (!enabled())
+        return;
+    auto &ring = localRing();
+    auto head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) > ring.mask)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring.slots[head & ring.mask] = span;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+Tracer::Ring &Tracer::localRing()
+{
+    thread_local RingHolder holder;
+    if (!holder.ring)
+    {
+        holder.ring = new Ring(ringSize_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.push_back(holder.ring);
+    }
+    return *holder.ring;
+}
+
+Tracer::RingHolder::~RingHolder()
+{
+    // flush() frees the ring once it has drained it
+    if (ring)
+        ring->retired.store(true, std::memory_order_release);
+}
+
+void Tracer::flush()
+{
+    std::vector<SpanRecord> batch;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = rings_.begin(); it != rings_.end();)
+    {
+        auto *ring = *it;
+        // Read before head: a retired ring has published all its spans
+        bool retired = ring->retired.load(std::memory_order_acquire);
+        auto tail = ring->tail.load(std::memory_order_relaxed);
+        auto head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail)
+            batch.push_back(ring->slots[tail & ring->mask]);
+        ring->tail.store(tail, std::memory_order_release);
+        if (retired)
+        {
+            delete ring;
+            it = rings_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    if (!batch.empty() && out_.is_open())
+    {
+        out_ << toOtlpJson(batch) << '\n';
+        out_.flush();
+    }
+}
+
+std::string Tracer::toOtlpJson(const std::vector<SpanRecord> &spans) const
+{
+    auto unixNanos = [this](uint64_t ticks) {
+        auto since = ticks > baseTicks_ ? ticks - baseTicks_ : 0;
+        return std::to_string(baseUnixNanos_ + CycleClock::toNanos(since));
+    };
+
+    std::string out;
+    out.reserve(256 + spans.size() * 320);
+    out += R"({"resourceSpans":[{"resource":{"attributes":[)";
+    bool first = true;
+    appendAttribute(out, first, "service.name", serviceName_);
+    out += R"(]},"scopeSpans":[{"scope":{"name":"oauth2"},"spans":[)";
+    for (size_t i = 0; i < spans.size(); ++i)
+    {
+        const auto &s = spans[i];
+        if (i > 0)
+            out += ',';
+        out += R"({"traceId":")";
+        appendHex(out, s.context.traceHi);
+        appendHex(out, s.context.traceLo);
+        out += R"(","spanId":")";
+        appendHex(out, s.context.spanId);
+        out += R"(","parentSpanId":")";
+        if (s.parentSpanId)
+            appendHex(out, s.parentSpanId);
+        out += R"(","name":")";
+        appendEscaped(out, s.name);
+        out += R"(","kind":)";
+        out += std::to_string(static_cast<int>(s.kind));
+        out += R"(,"startTimeUnixNano":")";
+        out += unixNanos(s.startTicks);
+        out += R"(","endTimeUnixNano":")";
+        out += unixNanos(s.endTicks);
+        out += R"(","attributes":[)";
+        bool firstAttr = true;
+        if (!s.staticKey.empty())
+            appendAttribute(out, firstAttr, s.staticKey, s.staticValue);
+        if (!s.attrKey.empty())
+            appendAttribute(out,
+                            firstAttr,
+                            s.attrKey,
+                            std::string_view(s.attrValue.data(), s.attrLen));
+        // Status code: 0 = unset, 2 = error
+        out += R"(],"status":{"code":)";
+        out += s.error ? '2' : '0';
+        out += "}}";
+    }
+    out += "]}]}]}";
+    return out;
+}
+
+// ========== Request integration ==========
+
+TraceContext requestTrace(const drogon::HttpRequestPtr &req)
+{
+    const auto &attrs = req->getAttributes();
+    if (!attrs->find(kTraceAttributeKey))
+        return {};
+    const auto &span = attrs->get<std::shared_ptr<Span>>(kTraceAttributeKey);
+    return span ? span->context() : TraceContext{};
+}
+
+void registerTracingAdvices()
+{
+    drogon::app().registerPreRoutingAdvice(
+        [](const drogon::HttpRequestPtr &req) {
+            if (!Tracer::enabled())
+                return;
+            auto span = std::make_shared<Span>(Span::forRequest(req));
+            span->setAttribute("http.target", req->path());
+            req->getAttributes()->insert(kTraceAttributeKey, span);
+        });
+    drogon::app().registerPreSendingAdvice(
+        [](const drogon::HttpRequestPtr &req,
+           const drogon::HttpResponsePtr &resp) {
+            const auto &attrs = req->getAttributes();
+            if (!attrs->find(kTraceAttributeKey))
+                return;
+            const auto &span =
+                attrs->get<std::shared_ptr<Span>>(kTraceAttributeKey);
+            if (span)
+                span->end(static_cast<int>(resp->statusCode()) < 500);
+        });
+}
+
+}  // namespace oauth2
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <drogon/HttpRequest.h>
+#include <json/json.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace trantor
+{
+class EventLoopThread;
+}
+
+namespace oauth2
+{
+
+/**
+ * @brief W3C trace context of one span, as carried by "traceparent"
+ */
+struct TraceContext
+{
+    uint64_t traceHi{0};
+    uint64_t traceLo{0};
+    uint64_t spanId{0};
+    bool sampled{false};
+
+    bool valid() const
+    {
+        return (traceHi | traceLo) != 0 && spanId != 0;
+    }
+
+    // "00-<32 hex trace id>-<16 hex span id>-<01|00>"
+    std::string traceparent() const;
+
+    /**
+     * @brief Parse a traceparent header; !valid() if malformed
+     */
+    static TraceContext parse(std::string_view header);
+};
+
+// Values are the OTLP SpanKind numbers
+enum class SpanKind : uint8_t
+{
+    kInternal = 1,
+    kServer = 2,
+    kClient = 3
+};
+
+/**
+ * @brief Finished span, as stored in the per-thread ring buffers
+ * Names and the static attribute must point at storage that lives for the
+ * whole process (literals or constexpr tables); the dynamic attribute
+ * value is copied and truncated to fit.
+ */
+struct SpanRecord
+{
+    TraceContext context;
+    uint64_t parentSpanId{0};
+    uint64_t startTicks{0};  // CycleClock
+    uint64_t endTicks{0};
+    std::string_view name;
+    std::string_view staticKey;
+    std::string_view staticValue;
+    std::string_view attrKey;
+    std::array<char, 64> attrValue{};
+    uint8_t attrLen{0};
+    SpanKind kind{SpanKind::kInternal};
+    bool error{false};
+};
+
+/**
+ * @brief Span being timed; recorded by end()
+ *
+ * Copyable, so it can be captured by value into async callbacks (call
+ * end() from exactly one of them). Inert when tracing is disabled, when
+ * there is no parent to attach to, or when the trace is not sampled.
+ */
+class Span
+{
+  public:
+    Span() = default;
+
+    /**
+     * @brief Child of @p parent; internal/client spans without a valid
+     * parent are not recorded
+     */
+    Span(std::string_view name, SpanKind kind, const TraceContext &parent);
+
+    /**
+     * @brief Same, for an operation that started at @p startTicks
+     * (CycleClock) and is only now known to belong to @p parent
+     */
+    Span(std::string_view name,
+         SpanKind kind,
+         const TraceContext &parent,
+         uint64_t startTicks);
+
+    /**
+     * @brief Child of the current TraceScope
+     */
+    Span(std::string_view name, SpanKind kind);
+
+    /**
+     * @brief Server span continuing the request's traceparent, or a new
+     * trace (sampled per "sample_ratio") when it has none
+     */
+    static Span forRequest(const drogon::HttpRequestPtr &req);
+
+    void setAttribute(std::string_view key, std::string_view value);
+    void setStaticAttribute(std::string_view key, std::string_view value);
+    void end(bool ok = true) const;
+
+    const TraceContext &context() const
+    {
+        return record_.context;
+    }
+
+  private:
+    SpanRecord record_;
+    bool recording_{false};
+};
+
+/**
+ * @brief Makes a context current on this thread for its lifetime
+ *
+ * Spans created without an explicit parent (storage operations) attach to
+ * the current context. Async callbacks run on other threads, so code that
+ * continues a traced flow in a callback re-establishes it with a
+ * TraceScope (OperationTimer::stop() returns one).
+ */
+class TraceScope
+{
+  public:
+    explicit TraceScope(const TraceContext &context);
+    ~TraceScope();
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    /**
+     * @brief Innermost context on this thread (invalid if none)
+     */
+    static TraceContext current();
+
+  private:
+    TraceContext previous_;
+    bool active_{false};
+};
+
+/**
+ * @brief In-process span collection with asynchronous file export
+ *
+ * Each thread records finished spans into its own ring buffer (single
+ * producer, no lock; spans are dropped and counted when it is full). A
+ * background trantor loop drains the rings every "flush_interval_ms" and
+ * appends one OTLP/JSON ExportTraceServiceRequest per line to "file", so
+ * traces can be inspected without a collector.
+ *
+ * Configured from custom_config "tracing":
+ * {enabled, file, flush_interval_ms, ring_size, sample_ratio, service_name}
+ */
+class Tracer
+{
+  public:
+    static Tracer &instance();
+
+    void start(const Json::Value &config);
+
+    /**
+     * @brief Stop exporting and write out what is still buffered
+     */
+    void stop();
+
+    static bool enabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void record(const SpanRecord &span);
+
+    /**
+     * @brief Drain all rings into the export file
+     */
+    void flush();
+
+    uint64_t dropped() const
+    {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+    double sampleRatio() const
+    {
+        return sampleRatio_;
+    }
+
+    /**
+     * @brief One OTLP/JSON ExportTraceServiceRequest, without newline
+     */
+    std::string toOtlpJson(const std::vector<SpanRecord> &spans) const;
+
+  private:
+    struct Ring
+    {
+        explicit Ring(size_t size) : slots(size), mask(size - 1)
+        {
+        }
+        std::vector<SpanRecord> slots;
+        size_t mask;
+        std::atomic<uint64_t> head{0};  // Written by the owning thread
+        std::atomic<uint64_t> tail{0};  // Written by flush()
+        std::atomic<bool> retired{false};
+    };
+    struct RingHolder
+    {
+        Ring *ring{nullptr};
+        ~RingHolder();
+    };
+
+    Tracer();
+    Ring &localRing();
+
+    static std::atomic<bool> enabled_;
+
+    std::mutex mutex_;  // rings_, out_
+    std::vector<Ring *> rings_;
+    std::ofstream out_;
+    std::unique_ptr<trantor::EventLoopThread> flusher_;
+    size_t ringSize_{1024};
+    double sampleRatio_{1.0};
+    std::string serviceName_{"oauth2-backend"};
+    // CycleClock ticks <-> Unix time, captured at start()
+    uint64_t baseTicks_{0};
+    int64_t baseUnixNanos_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+/**
+ * @brief Context of the request's server span (invalid when untraced)
+ */
+TraceContext requestTrace(const drogon::HttpRequestPtr &req);
+
+/**
+ * @brief Start/end a server span per request and honour incoming
+ * traceparent headers; call once before app().run() when tracing is on
+ */
+void registerTracingAdvices();
+
+}  // namespace oauth2
@@ -0,0 +1,12 @@
+-- Access Token Role Snapshot
+-- Role IDs captured at issue time, so authorization needs a single token
+-- lookup instead of token lookup + user_roles join.
+--   NULL     : no snapshot (legacy token, or roles invalidated) -> live lookup
+--   ''       : snapshot of "no roles"
+--   '1,2'    : comma separated roles.id values
+
+ALTER TABLE oauth2_access_tokens ADD COLUMN IF NOT EXISTS role_ids TEXT;
+
+-- invalidateUserRoles() clears snapshots per user
+CREATE INDEX IF NOT EXISTS idx_oauth2_access_tokens_user_id
+    ON oauth2_access_tokens(user_id);
@@ -0,0 +1,44 @@
+-- RBAC Change Notifications
+-- OAuth2Plugin LISTENs on channel 'oauth2_rbac' to refresh its in-process
+-- role/permission cache (RbacCache) and to invalidate the role snapshot
+-- embedded in access tokens.
+--   payload 'roles' / 'permissions' / 'role_permissions' : reload catalog
+--   payload 'user_roles:<user_id>'                        : invalidate user
+
+CREATE OR REPLACE FUNCTION oauth2_notify_rbac() RETURNS trigger AS $$
+BEGIN
+    IF TG_TABLE_NAME = 'user_roles' THEN
+        IF TG_OP = 'DELETE' THEN
+            PERFORM pg_notify('oauth2_rbac', 'user_roles:' || OLD.user_id);
+        ELSE
+            PERFORM pg_notify('oauth2_rbac', 'user_roles:' || NEW.user_id);
+            IF TG_OP = 'UPDATE' AND OLD.user_id <> NEW.user_id THEN
+                PERFORM pg_notify('oauth2_rbac', 'user_roles:' || OLD.user_id);
+            END IF;
+        END IF;
+    ELSE
+        PERFORM pg_notify('oauth2_rbac', TG_TABLE_NAME);
+    END IF;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+DROP TRIGGER IF EXISTS trg_roles_notify ON roles;
+CREATE TRIGGER trg_roles_notify
+    AFTER INSERT OR UPDATE OR DELETE ON roles
+    FOR EACH STATEMENT EXECUTE FUNCTION oauth2_notify_rbac();
+
+DROP TRIGGER IF EXISTS trg_permissions_notify ON permissions;
+CREATE TRIGGER trg_permissions_notify
+    AFTER INSERT OR UPDATE OR DELETE ON permissions
+    FOR EACH STATEMENT EXECUTE FUNCTION oauth2_notify_rbac();
+
+DROP TRIGGER IF EXISTS trg_role_permissions_notify ON role_permissions;
+CREATE TRIGGER trg_role_permissions_notify
+    AFTER INSERT OR UPDATE OR DELETE ON role_permissions
+    FOR EACH STATEMENT EXECUTE FUNCTION oauth2_notify_rbac();
+
+DROP TRIGGER IF EXISTS trg_user_roles_notify ON user_roles;
+CREATE TRIGGER trg_user_roles_notify
+    AFTER INSERT OR UPDATE OR DELETE ON user_roles
+    FOR EACH ROW EXECUTE FUNCTION oauth2_notify_rbac();
@@ -0,0 +1,20 @@
+-- Audit Trail
+-- Optional Postgres sink of AuditLogger (OAuth2Plugin config
+-- "audit.postgres.enabled"). Rows arrive in batches from a background
+-- thread; the JSON-lines file remains the primary record.
+
+CREATE TABLE IF NOT EXISTS oauth2_audit_log (
+    id BIGSERIAL PRIMARY KEY,
+    occurred_at TIMESTAMPTZ NOT NULL,
+    action VARCHAR(32) NOT NULL,
+    user_id VARCHAR(64) NOT NULL,
+    client_id VARCHAR(64) NOT NULL,
+    ip VARCHAR(46),
+    success BOOLEAN NOT NULL,
+    reason VARCHAR(64)
+);
+
+CREATE INDEX IF NOT EXISTS idx_oauth2_audit_log_occurred_at
+    ON oauth2_audit_log(occurred_at);
+CREATE INDEX IF NOT EXISTS idx_oauth2_audit_log_user_id
+    ON oauth2_audit_log(user_id);
@@ -0,0 +1,23 @@
+-- Client Change Notifications
+-- OAuth2Plugin LISTENs on channel 'oauth2_clients' to refresh its
+-- in-process client registry (ClientCache) without polling.
+--   payload '<client_id>' : re-read that client (gone = drop it)
+
+CREATE OR REPLACE FUNCTION oauth2_notify_client() RETURNS trigger AS $$
+BEGIN
+    IF TG_OP = 'DELETE' THEN
+        PERFORM pg_notify('oauth2_clients', OLD.client_id);
+    ELSE
+        PERFORM pg_notify('oauth2_clients', NEW.client_id);
+        IF TG_OP = 'UPDATE' AND OLD.client_id <> NEW.client_id THEN
+            PERFORM pg_notify('oauth2_clients', OLD.client_id);
+        END IF;
+    END IF;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+DROP TRIGGER IF EXISTS trg_oauth2_clients_notify ON oauth2_clients;
+CREATE TRIGGER trg_oauth2_clients_notify
+    AFTER INSERT OR UPDATE OR DELETE ON oauth2_clients
+    FOR EACH ROW EXECUTE FUNCTION oauth2_notify_client();
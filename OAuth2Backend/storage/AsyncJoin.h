@@ -0,0 +1,87 @@
+#pragma once
+
+#include "UniqueFunction.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace oauth2
+{
+
+namespace detail
+{
+
+struct JoinState
+{
+    JoinState(size_t branches, UniqueFunction<void(bool)> &&done)
+        : pending(branches), done(std::move(done))
+    {
+    }
+
+    void arrive(bool ok)
+    {
+        // acq_rel: whoever completes the join sees every branch's writes
+        if (ok && pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        if (finished.exchange(true, std::memory_order_acq_rel))
+            return;
+        auto cb = std::move(done);
+        if (cb)
+            cb(ok);
+    }
+
+    std::atomic<size_t> pending;
+    std::atomic<bool> finished{false};
+    UniqueFunction<void(bool)> done;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Completion handle of one joinAll() branch
+ *
+ * Copyable, so it can be captured by both of Drogon's success and error
+ * continuations; a branch reports once, with false on failure.
+ */
+class JoinBranch
+{
+  public:
+    explicit JoinBranch(std::shared_ptr<detail::JoinState> state)
+        : state_(std::move(state))
+    {
+    }
+
+    void operator()(bool ok = true) const
+    {
+        state_->arrive(ok);
+    }
+
+  private:
+    std::shared_ptr<detail::JoinState> state_;
+};
+
+/**
+ * @brief Start independent async operations together and join them
+ *
+ * Each branch is called in order with its JoinBranch and starts its
+ * operation. @p done runs once: with true after every branch reported
+ * success, or with false on the first failure, without waiting for the
+ * rest. Branches not yet started by then are skipped; ones in flight still
+ * complete, but their reports are ignored. @p done runs on the thread of
+ * the last (or failing) branch, which may be any backend's.
+ */
+template <typename... Branches>
+void joinAll(UniqueFunction<void(bool)> &&done, Branches &&...branches)
+{
+    static_assert(sizeof...(Branches) > 0, "nothing to join");
+    auto state = std::make_shared<detail::JoinState>(sizeof...(Branches),
+                                                     std::move(done));
+    auto start = [&state](auto &&branch) {
+        if (!state->finished.load(std::memory_order_acquire))
+            branch(JoinBranch(state));
+    };
+    (start(std::forward<Branches>(branches)), ...);
+}
+
+}  // namespace oauth2
@@ -1,17 +1,28 @@
 #include "CachedOAuth2Storage.h"
 #include <drogon/drogon.h>
 #include <drogon/utils/Utilities.h>
+#include "plugins/OAuth2Metrics.h"
 
 namespace oauth2
 {
 
 CachedOAuth2Storage::CachedOAuth2Storage(
     std::unique_ptr<IOAuth2Storage> impl,
-    drogon::nosql::RedisClientPtr redisClient)
-    : impl_(std::move(impl)), redisClient_(std::move(redisClient))
+    drogon::nosql::RedisClientPtr redisClient,
+    std::shared_ptr<CircuitBreaker> breaker)
+    : impl_(std::move(impl)),
+      redisClient_(std::move(redisClient)),
+      breaker_(std::move(breaker))
 {
 }
 
+void CachedOAuth2Storage::recordRedis(bool ok, uint64_t startTicks) const
+{
+    if (breaker_)
+        breaker_->record(ok,
+                         CycleClock::toNanos(CycleClock::now() - startTicks));
+}
+
 void CachedOAuth2Storage::getClient(const std::string &clientId,
                                     ClientCallback &&cb)
 {
@@ -25,6 +36,11 @@ void CachedOAuth2Storage::validateClient(const std::string &clientId,
     impl_->validateClient(clientId, clientSecret, std::move(cb));
 }
 
+void CachedOAuth2Storage::listClients(ClientListCallback &&cb)
+{
+    impl_->listClients(std::move(cb));
+}
+
 void CachedOAuth2Storage::saveAuthCode(const OAuth2AuthCode &code,
                                        VoidCallback &&cb)
 {
@@ -49,6 +65,98 @@ void CachedOAuth2Storage::consumeAuthCode(const std::string &code,
     impl_->consumeAuthCode(code, std::move(cb));
 }
 
+static Json::Value toCacheJson(const OAuth2AccessToken &token)
+{
+    Json::Value json;
+    json["token"] = token.token.str();
+    json["client_id"] = token.clientId.str();
+    json["user_id"] = token.userId;
+    json["scope"] = token.scope;
+    json["expires_at"] = (Json::Int64)token.expiresAt;
+    json["revoked"] = token.revoked;
+    if (token.roleIds)
+    {
+        Json::Value ids(Json::arrayValue);
+        for (auto id : *token.roleIds)
+            ids.append(id);
+        json["role_ids"] = ids;
+    }
+    return json;
+}
+
+static AccessTokenPtr fromCacheJson(const Json::Value &json)
+{
+    if (!TokenValue::fits(json["token"].asString()))
+        return nullptr;
+    auto t = std::make_shared<OAuth2AccessToken>();
+    t->token = json["token"].asString();
+    t->clientId = json["client_id"].asString();
+    t->userId = json["user_id"].asString();
+    t->scope = json["scope"].asString();
+    t->expiresAt = json["expires_at"].asInt64();
+    t->revoked = json["revoked"].asBool();
+    if (json["role_ids"].isArray())
+    {
+        std::vector<int32_t> ids;
+        for (const auto &id : json["role_ids"])
+            ids.push_back(id.asInt());
+        t->roleIds = std::move(ids);
+    }
+    return t;
+}
+
+void CachedOAuth2Storage::writeCache(const OAuth2AccessToken &token,
+                                     VoidCallback &&cb)
+{
+    if (!redisAvailable())
+    {
+        // Nothing to undo: the next read misses and refills
+        if (cb)
+            cb();
+        return;
+    }
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+                   .count();
+    long ttl = token.expiresAt - now;
+    if (ttl <= 0)
+        ttl = 1;
+
+    std::string key = "oauth2:token:" + token.token;
+    std::string indexKey = "oauth2:user_tokens:" + token.userId;
+    std::string ttlStr = std::to_string(ttl);
+
+    // Cache the token and index it under its user so that
+    // invalidateUserRoles() can evict every cached snapshot of that user.
+    static const std::string script = R"(
+        redis.call('SET', KEYS[1], ARGV[1], 'EX', ARGV[2])
+        redis.call('SADD', KEYS[2], KEYS[1])
+        if redis.call('TTL', KEYS[2]) < tonumber(ARGV[2]) then
+            redis.call('EXPIRE', KEYS[2], ARGV[2])
+        end
+        return 1
+    )";
+
+    auto start = CycleClock::now();
+    auto done = singleShot(std::move(cb));
+    redisClient_->execCommandAsync(
+        [this, done, start](const drogon::nosql::RedisResult &) {
+            recordRedis(true, start);
+            done();
+        },
+        [this, done, start](const std::exception &e) {
+            recordRedis(false, start);
+            LOG_ERROR << "Redis Write Error: " << e.what();
+            done();
+        },
+        "EVAL %s 2 %s %s %s %s",
+        script.c_str(),
+        key.c_str(),
+        indexKey.c_str(),
+        toCacheJson(token).toStyledString().c_str(),
+        ttlStr.c_str());
+}
+
 // Access Token - Write Side (Cache Invalidation or Write-Through)
 void CachedOAuth2Storage::saveAccessToken(const OAuth2AccessToken &token,
                                           VoidCallback &&cb)
@@ -63,37 +171,7 @@ void CachedOAuth2Storage::saveAccessToken(const OAuth2AccessToken &token,
         }
 
         // Write-Through to Redis
-        Json::Value json;
-        json["token"] = token.token;
-        json["client_id"] = token.clientId;
-        json["user_id"] = token.userId;
-        json["scope"] = token.scope;
-        json["expires_at"] = (Json::Int64)token.expiresAt;
-        json["revoked"] = token.revoked;
-
-        // Calculate TTL
-        auto now = std::chrono::duration_cast<std::chrono::seconds>(
-                       std::chrono::system_clock::now().time_since_epoch())
-                       .count();
-        long ttl = token.expiresAt - now;
-        if (ttl <= 0)
-            ttl = 1;
-
-        std::string key = "oauth2:token:" + token.token;
-        redisClient_->execCommandAsync(
-            [cb](const drogon::nosql::RedisResult &r) {
-                if (cb)
-                    cb();
-            },
-            [cb](const std::exception &e) {
-                LOG_ERROR << "Redis Write Error: " << e.what();
-                if (cb)
-                    cb();
-            },
-            "SET %s %s EX %d",
-            key.c_str(),
-            json.toStyledString().c_str(),
-            ttl);
+        writeCache(token, std::move(cb));
     });
 }
 
@@ -101,55 +179,52 @@ void CachedOAuth2Storage::saveAccessToken(const OAuth2AccessToken &token,
 void CachedOAuth2Storage::getAccessToken(const std::string &token,
                                          AccessTokenCallback &&cb)
 {
-    if (!redisClient_)
+    if (!TokenValue::fits(token))
     {
+        cb(nullptr);  // Longer than anything we issue
+        return;
+    }
+    if (!redisAvailable())
+    {
+        // No cache, or its breaker is open: straight to the database
         impl_->getAccessToken(token, std::move(cb));
         return;
     }
 
+    // End to end, so hits and misses (Redis + Postgres) show up in one
+    // series; the fallback's own Postgres sample is recorded separately.
+    OperationTimer timer(StorageOp::kGetAccessToken,
+                         StorageBackend::kCached,
+                         token);
     std::string key = "oauth2:token:" + token;
-    auto sharedCb = std::make_shared<AccessTokenCallback>(std::move(cb));
+    auto done = singleShot(std::move(cb));
+    auto start = CycleClock::now();
 
     redisClient_->execCommandAsync(
-        [this, token, sharedCb](const drogon::nosql::RedisResult &r) {
+        [this, token, done, timer, start](
+            const drogon::nosql::RedisResult &r) {
+            recordRedis(true, start);
+            // Keep the Postgres fallback in the caller's trace
+            TraceScope resumed(timer.traceParent());
             if (r.type() == drogon::nosql::RedisResultType::kNil)
             {
                 // Cache Miss -> Load from DB
                 impl_->getAccessToken(
                     token,
-                    [this, token, sharedCb](
-                        const std::optional<OAuth2AccessToken> &optToken) {
-                        if (optToken)
+                    [this, done, timer](AccessTokenPtr dbToken) {
+                        auto trace = timer.stop();
+                        if (dbToken)
                         {
                             // Cache Fill
-                            Json::Value json;
-                            json["token"] = optToken->token;
-                            json["client_id"] = optToken->clientId;
-                            json["user_id"] = optToken->userId;
-                            json["scope"] = optToken->scope;
-                            json["expires_at"] =
-                                (Json::Int64)optToken->expiresAt;
-                            json["revoked"] = optToken->revoked;
-
                             auto now = std::chrono::duration_cast<
                                            std::chrono::seconds>(
                                            std::chrono::system_clock::now()
                                                .time_since_epoch())
                                            .count();
-                            long ttl = optToken->expiresAt - now;
-                            if (ttl > 0)
-                            {
-                                std::string key = "oauth2:token:" + token;
-                                redisClient_->execCommandAsync(
-                                    [](const drogon::nosql::RedisResult &) {},
-                                    [](const std::exception &) {},
-                                    "SET %s %s EX %d",
-                                    key.c_str(),
-                                    json.toStyledString().c_str(),
-                                    ttl);
-                            }
+                            if (dbToken->expiresAt - now > 0)
+                                writeCache(*dbToken, nullptr);
                         }
-                        (*sharedCb)(optToken);
+                        done(dbToken);
                     });
             }
             else if (r.type() == drogon::nosql::RedisResultType::kString)
@@ -160,34 +235,34 @@ void CachedOAuth2Storage::getAccessToken(const std::string &token,
                 Json::Reader reader;
                 if (reader.parse(jsonStr, json))
                 {
-                    OAuth2AccessToken t;
-                    t.token = json["token"].asString();
-                    t.clientId = json["client_id"].asString();
-                    t.userId = json["user_id"].asString();
-                    t.scope = json["scope"].asString();
-                    t.expiresAt = json["expires_at"].asInt64();
-                    t.revoked = json["revoked"].asBool();
-                    (*sharedCb)(t);
+                    auto trace = timer.stop();
+                    done(fromCacheJson(json));
                 }
                 else
                 {
                     // Parse Error -> Fallback to DB
-                    impl_->getAccessToken(token, [sharedCb](auto val) {
-                        (*sharedCb)(val);
+                    impl_->getAccessToken(token, [done, timer](auto val) {
+                        auto trace = timer.stop();
+                        done(val);
                     });
                 }
             }
             else
             {
-                impl_->getAccessToken(token, [sharedCb](auto val) {
-                    (*sharedCb)(val);
+                impl_->getAccessToken(token, [done, timer](auto val) {
+                    auto trace = timer.stop();
+                    done(val);
                 });
             }
         },
-        [this, token, sharedCb](const std::exception &e) {
+        [this, token, done, timer, start](const std::exception &e) {
+            recordRedis(false, start);
+            TraceScope resumed(timer.traceParent());
             LOG_ERROR << "Redis Read Error: " << e.what();
-            impl_->getAccessToken(token,
-                                  [sharedCb](auto val) { (*sharedCb)(val); });
+            impl_->getAccessToken(token, [done, timer](auto val) {
+                auto trace = timer.stop();
+                done(val);
+            });
         },
         "GET %s",
         key.c_str());
@@ -219,4 +294,43 @@ void CachedOAuth2Storage::getUserRoles(const std::string &userId,
     impl_->getUserRoles(userId, std::move(cb));
 }
 
+void CachedOAuth2Storage::invalidateUserRoles(const std::string &userId,
+                                              VoidCallback &&cb)
+{
+    // Clear the snapshot in the source of truth first, then evict the cached
+    // copies so the next read refills from it without role_ids. Attempted
+    // even with the breaker open: a skipped eviction would leave stale
+    // snapshots to be served once Redis is back.
+    impl_->invalidateUserRoles(
+        userId, [this, userId, cb = std::move(cb)]() mutable {
+            if (!redisClient_)
+            {
+                if (cb)
+                    cb();
+                return;
+            }
+            std::string indexKey = "oauth2:user_tokens:" + userId;
+            static const std::string script = R"(
+                local keys = redis.call('SMEMBERS', KEYS[1])
+                for _, key in ipairs(keys) do
+                    redis.call('DEL', key)
+                end
+                redis.call('DEL', KEYS[1])
+                return #keys
+            )";
+            auto done = singleShot(std::move(cb));
+            redisClient_->execCommandAsync(
+                [done](const drogon::nosql::RedisResult &) {
+                    done();
+                },
+                [done](const std::exception &e) {
+                    LOG_ERROR << "Redis Evict Error: " << e.what();
+                    done();
+                },
+                "EVAL %s 1 %s",
+                script.c_str(),
+                indexKey.c_str());
+        });
+}
+
 }  // namespace oauth2
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "IOAuth2Storage.h"
+#include "../services/CircuitBreaker.h"
 #include <drogon/nosql/RedisClient.h>
 #include <memory>
 
@@ -9,18 +10,24 @@ namespace oauth2
 
 /**
  * @brief Decorator for IOAuth2Storage that adds L2 Redis Caching
+ *
+ * With a circuit breaker, cache reads and writes skip Redis while it is
+ * open and go straight to the wrapped storage, instead of waiting for the
+ * Redis timeout on every call.
  */
 class CachedOAuth2Storage : public IOAuth2Storage
 {
   public:
     CachedOAuth2Storage(std::unique_ptr<IOAuth2Storage> impl,
-                        drogon::nosql::RedisClientPtr redisClient);
+                        drogon::nosql::RedisClientPtr redisClient,
+                        std::shared_ptr<CircuitBreaker> breaker = nullptr);
 
     // Client Operations - Pass through or Cache if needed
     void getClient(const std::string &clientId, ClientCallback &&cb) override;
     void validateClient(const std::string &clientId,
                         const std::string &clientSecret,
                         BoolCallback &&cb) override;
+    void listClients(ClientListCallback &&cb) override;
 
     // Authorization Code Operations - Pass through
     void saveAuthCode(const OAuth2AuthCode &code, VoidCallback &&cb) override;
@@ -47,10 +54,24 @@ class CachedOAuth2Storage : public IOAuth2Storage
     // RBAC
     void getUserRoles(const std::string &userId,
                       StringListCallback &&cb) override;
+    void invalidateUserRoles(const std::string &userId,
+                             VoidCallback &&cb) override;
 
   private:
     std::unique_ptr<IOAuth2Storage> impl_;
     drogon::nosql::RedisClientPtr redisClient_;
+    std::shared_ptr<CircuitBreaker> breaker_;
+
+    // Whether to try Redis for this call; see CircuitBreaker::allow()
+    bool redisAvailable() const
+    {
+        return redisClient_ && (!breaker_ || breaker_->allow());
+    }
+    // Outcome of a call admitted by redisAvailable()
+    void recordRedis(bool ok, uint64_t startTicks) const;
+
+    // SET oauth2:token:<t> + index it under oauth2:user_tokens:<userId>
+    void writeCache(const OAuth2AccessToken &token, VoidCallback &&cb);
 };
 
 }  // namespace oauth2
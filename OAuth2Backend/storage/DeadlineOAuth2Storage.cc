@@ -0,0 +1,273 @@
+#include "DeadlineOAuth2Storage.h"
+#include "../services/Deadline.h"
+#include "plugins/OAuth2Metrics.h"
+#include <trantor/net/EventLoop.h>
+#include <atomic>
+
+namespace oauth2
+{
+
+namespace
+{
+
+void countExpired(StorageOp op)
+{
+    Metrics::incStorageDeadlineExceeded(
+        kStorageOpNames[static_cast<size_t>(op)]);
+}
+
+/**
+ * @brief Run a read with the caller's callback, completed by the backend
+ * or by the deadline timer, whichever comes first
+ * @param call Runs before withDeadline returns, so it may capture the
+ * caller's arguments by reference
+ * @param expire Completes the callback without the backend's answer
+ */
+template <typename Callback, typename Call, typename Expire>
+void withDeadline(StorageOp op, Callback &&cb, Call &&call, Expire &&expire)
+{
+    auto deadline = DeadlineScope::current();
+    if (deadline == 0)
+    {
+        call(std::move(cb));
+        return;
+    }
+    auto remaining = deadline - DeadlineScope::now();
+    if (remaining <= 0)
+    {
+        // Nobody waits for the answer: don't load the backend with it
+        countExpired(op);
+        if (cb)
+            expire(cb);
+        return;
+    }
+    auto *loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    if (!loop)
+    {
+        call(std::move(cb));
+        return;
+    }
+
+    struct State
+    {
+        std::atomic<bool> done{false};
+        std::atomic<trantor::TimerId> timer{0};
+        Callback cb;
+    };
+    auto state = std::make_shared<State>();
+    state->cb = std::move(cb);
+    state->timer = loop->runAfter(
+        static_cast<double>(remaining) / 1e9,
+        [state, op, deadline, expire = std::forward<Expire>(expire)]() {
+            if (state->done.exchange(true))
+                return;
+            countExpired(op);
+            // Chained calls see the expired deadline and fail fast
+            DeadlineScope scope(deadline);
+            auto cb = std::move(state->cb);
+            if (cb)
+                expire(cb);
+        });
+    call(Callback([state, loop, deadline](auto... args) {
+        if (state->done.exchange(true))
+            return;  // Expired: the caller has moved on
+        // Best effort: a timer that still fires finds done set
+        loop->invalidateTimer(state->timer.load());
+        DeadlineScope scope(deadline);
+        auto cb = std::move(state->cb);
+        if (cb)
+            cb(std::move(args)...);
+    }));
+}
+
+/**
+ * @brief Run a write without a timer: it always reaches the backend and
+ * completes when the backend answers, still inside the caller's deadline
+ * so that chained reads share it
+ */
+template <typename Callback, typename Call>
+void unbounded(Callback &&cb, Call &&call)
+{
+    auto deadline = DeadlineScope::current();
+    if (deadline == 0)
+    {
+        call(std::move(cb));
+        return;
+    }
+    call(Callback([deadline, cb = std::move(cb)](auto... args) {
+        DeadlineScope scope(deadline);
+        if (cb)
+            cb(std::move(args)...);
+    }));
+}
+
+}  // namespace
+
+DeadlineOAuth2Storage::DeadlineOAuth2Storage(
+    std::unique_ptr<IOAuth2Storage> impl)
+    : impl_(std::move(impl))
+{
+}
+
+// ========== Client Operations ==========
+
+void DeadlineOAuth2Storage::getClient(const std::string &clientId,
+                                      ClientCallback &&cb)
+{
+    withDeadline(
+        StorageOp::kGetClient,
+        std::move(cb),
+        [this, &clientId](ClientCallback &&done) {
+            impl_->getClient(clientId, std::move(done));
+        },
+        [](ClientCallback &cb) { cb(std::nullopt); });
+}
+
+void DeadlineOAuth2Storage::validateClient(const std::string &clientId,
+                                           const std::string &clientSecret,
+                                           BoolCallback &&cb)
+{
+    withDeadline(
+        StorageOp::kValidateClient,
+        std::move(cb),
+        [this, &clientId, &clientSecret](BoolCallback &&done) {
+            impl_->validateClient(clientId, clientSecret, std::move(done));
+        },
+        [](BoolCallback &cb) { cb(false); });
+}
+
+void DeadlineOAuth2Storage::listClients(ClientListCallback &&cb)
+{
+    withDeadline(
+        StorageOp::kListClients,
+        std::move(cb),
+        [this](ClientListCallback &&done) {
+            impl_->listClients(std::move(done));
+        },
+        [](ClientListCallback &cb) { cb({}); });
+}
+
+// ========== Authorization Code Operations ==========
+
+// Writes are unbounded: VoidCallback cannot report failure, so an expired
+// write could only be reported as done while nothing was stored (a token
+// issued that fails validation, a refresh token lost)
+void DeadlineOAuth2Storage::saveAuthCode(const OAuth2AuthCode &code,
+                                         VoidCallback &&cb)
+{
+    unbounded(std::move(cb), [this, &code](VoidCallback &&done) {
+        impl_->saveAuthCode(code, std::move(done));
+    });
+}
+
+void DeadlineOAuth2Storage::getAuthCode(const std::string &code,
+                                        AuthCodeCallback &&cb)
+{
+    withDeadline(
+        StorageOp::kGetAuthCode,
+        std::move(cb),
+        [this, &code](AuthCodeCallback &&done) {
+            impl_->getAuthCode(code, std::move(done));
+        },
+        [](AuthCodeCallback &cb) { cb(std::nullopt); });
+}
+
+void DeadlineOAuth2Storage::markAuthCodeUsed(const std::string &code,
+                                             VoidCallback &&cb)
+{
+    unbounded(std::move(cb), [this, &code](VoidCallback &&done) {
+        impl_->markAuthCodeUsed(code, std::move(done));
+    });
+}
+
+void DeadlineOAuth2Storage::consumeAuthCode(const std::string &code,
+                                            AuthCodeCallback &&cb)
+{
+    // Reports "not found" on expiry. Past the deadline the code is left
+    // untouched; expired in flight, the backend may still have marked it
+    // used, and the client has to restart the flow: the safe outcome, as
+    // no token is issued for it either way
+    withDeadline(
+        StorageOp::kConsumeAuthCode,
+        std::move(cb),
+        [this, &code](AuthCodeCallback &&done) {
+            impl_->consumeAuthCode(code, std::move(done));
+        },
+        [](AuthCodeCallback &cb) { cb(std::nullopt); });
+}
+
+// ========== Access Token Operations ==========
+
+void DeadlineOAuth2Storage::saveAccessToken(const OAuth2AccessToken &token,
+                                            VoidCallback &&cb)
+{
+    unbounded(std::move(cb), [this, &token](VoidCallback &&done) {
+        impl_->saveAccessToken(token, std::move(done));
+    });
+}
+
+void DeadlineOAuth2Storage::getAccessToken(const std::string &token,
+                                           AccessTokenCallback &&cb)
+{
+    withDeadline(
+        StorageOp::kGetAccessToken,
+        std::move(cb),
+        [this, &token](AccessTokenCallback &&done) {
+            impl_->getAccessToken(token, std::move(done));
+        },
+        [](AccessTokenCallback &cb) { cb(nullptr); });
+}
+
+// ========== Refresh Token Operations ==========
+
+void DeadlineOAuth2Storage::saveRefreshToken(const OAuth2RefreshToken &token,
+                                             VoidCallback &&cb)
+{
+    unbounded(std::move(cb), [this, &token](VoidCallback &&done) {
+        impl_->saveRefreshToken(token, std::move(done));
+    });
+}
+
+void DeadlineOAuth2Storage::getRefreshToken(const std::string &token,
+                                            RefreshTokenCallback &&cb)
+{
+    withDeadline(
+        StorageOp::kGetRefreshToken,
+        std::move(cb),
+        [this, &token](RefreshTokenCallback &&done) {
+            impl_->getRefreshToken(token, std::move(done));
+        },
+        [](RefreshTokenCallback &cb) { cb(std::nullopt); });
+}
+
+// ========== User/Role Operations ==========
+
+void DeadlineOAuth2Storage::getUserRoles(const std::string &userId,
+                                         StringListCallback &&cb)
+{
+    withDeadline(
+        StorageOp::kGetUserRoles,
+        std::move(cb),
+        [this, &userId](StringListCallback &&done) {
+            impl_->getUserRoles(userId, std::move(done));
+        },
+        [](StringListCallback &cb) { cb({}); });
+}
+
+void DeadlineOAuth2Storage::invalidateUserRoles(const std::string &userId,
+                                                VoidCallback &&cb)
+{
+    unbounded(std::move(cb), [this, &userId](VoidCallback &&done) {
+        impl_->invalidateUserRoles(userId, std::move(done));
+    });
+}
+
+// ========== Cleanup ==========
+
+void DeadlineOAuth2Storage::deleteExpiredData()
+{
+    // Background job, no request deadline
+    impl_->deleteExpiredData();
+}
+
+}  // namespace oauth2
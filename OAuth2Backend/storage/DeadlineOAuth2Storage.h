@@ -0,0 +1,65 @@
+#pragma once
+
+#include "IOAuth2Storage.h"
+#include <memory>
+
+namespace oauth2
+{
+
+/**
+ * @brief Decorator for IOAuth2Storage that enforces the caller's deadline
+ * (DeadlineScope)
+ *
+ * Each read made under a deadline arms a timer on the calling event loop
+ * for the time remaining. Whichever comes first, the backend's answer or
+ * the timer, completes the callback, exactly once; the other is dropped.
+ * On expiry reads complete as "not found"; reads made after the deadline
+ * never reach the backend. Without a deadline, or off an event loop,
+ * reads pass straight through.
+ *
+ * Writes (save*, markAuthCodeUsed, invalidateUserRoles) always pass
+ * through: their callbacks have no error outcome, so an expired write
+ * would look stored when it was not. consumeAuthCode counts as a read;
+ * if it expires in flight the code may already be used up.
+ *
+ * Expiries are counted in oauth2_storage_deadline_exceeded_total.
+ */
+class DeadlineOAuth2Storage : public IOAuth2Storage
+{
+  public:
+    explicit DeadlineOAuth2Storage(std::unique_ptr<IOAuth2Storage> impl);
+
+    void getClient(const std::string &clientId, ClientCallback &&cb) override;
+    void validateClient(const std::string &clientId,
+                        const std::string &clientSecret,
+                        BoolCallback &&cb) override;
+    void listClients(ClientListCallback &&cb) override;
+
+    void saveAuthCode(const OAuth2AuthCode &code, VoidCallback &&cb) override;
+    void getAuthCode(const std::string &code, AuthCodeCallback &&cb) override;
+    void markAuthCodeUsed(const std::string &code, VoidCallback &&cb) override;
+    void consumeAuthCode(const std::string &code,
+                         AuthCodeCallback &&cb) override;
+
+    void saveAccessToken(const OAuth2AccessToken &token,
+                         VoidCallback &&cb) override;
+    void getAccessToken(const std::string &token,
+                        AccessTokenCallback &&cb) override;
+
+    void saveRefreshToken(const OAuth2RefreshToken &token,
+                          VoidCallback &&cb) override;
+    void getRefreshToken(const std::string &token,
+                         RefreshTokenCallback &&cb) override;
+
+    void getUserRoles(const std::string &userId,
+                      StringListCallback &&cb) override;
+    void invalidateUserRoles(const std::string &userId,
+                             VoidCallback &&cb) override;
+
+    void deleteExpiredData() override;
+
+  private:
+    std::unique_ptr<IOAuth2Storage> impl_;
+};
+
+}  // namespace oauth2
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <optional>
 #include <memory>
-#include <functional>
+#include "Symbol.h"
+#include "TokenValue.h"
+#include "UniqueFunction.h"
 
 namespace oauth2
 {
@@ -21,13 +24,21 @@ struct OAuth2Client
     std::vector<std::string> allowedScopes;
 };
 
+/*
+ * Token records below are compact: code/token values live inline
+ * (TokenValue) and the client ID is an interned Symbol, since millions of
+ * live tokens repeat a handful of clients. Only registered clients are
+ * interned (the table never shrinks); user IDs, scopes and redirect URIs
+ * come from users and requests, so they stay plain strings.
+ */
+
 /**
  * @brief Authorization Code data structure
  */
 struct OAuth2AuthCode
 {
-    std::string code;
-    std::string clientId;
+    TokenValue code;
+    Symbol clientId;
     std::string userId;
     std::string scope;
     std::string redirectUri;
@@ -39,25 +50,34 @@ struct OAuth2AuthCode
 
 /**
  * @brief Access Token data structure
+ *
+ * Storage hands these out as immutable, shared records (AccessTokenPtr), so
+ * a validated token reaches filters and handlers without being copied.
  */
 struct OAuth2AccessToken
 {
-    std::string token;
-    std::string clientId;
+    TokenValue token;
+    Symbol clientId;
     std::string userId;
     std::string scope;
     int64_t expiresAt;  // Unix timestamp (seconds)
     bool revoked = false;
+    // Role IDs snapshotted at issue time (see RbacCache). std::nullopt means
+    // "not embedded": either a legacy token or one whose roles were
+    // invalidated, so callers must resolve roles via getUserRoles().
+    std::optional<std::vector<int32_t>> roleIds;
 };
 
+using AccessTokenPtr = std::shared_ptr<const OAuth2AccessToken>;
+
 /**
  * @brief Refresh Token data structure
  */
 struct OAuth2RefreshToken
 {
-    std::string token;
-    std::string accessToken;
-    std::string clientId;
+    TokenValue token;
+    TokenValue accessToken;
+    Symbol clientId;
     std::string userId;
     std::string scope;
     int64_t expiresAt;
@@ -68,7 +88,9 @@ struct OAuth2RefreshToken
  * @brief Abstract storage interface for OAuth2 data
  *
  * Implementations use ASYNCHRONOUS CALLBACKS.
- * Callbacks are invoked when the operation completes.
+ * Callbacks are invoked exactly once when the operation completes. They
+ * are move-only (UniqueFunction); implementations that hand one to both a
+ * success and an error continuation wrap it in singleShot().
  */
 class IOAuth2Storage
 {
@@ -76,14 +98,18 @@ class IOAuth2Storage
     virtual ~IOAuth2Storage() = default;
 
     // Callback types
-    using ClientCallback = std::function<void(std::optional<OAuth2Client>)>;
-    using AuthCodeCallback = std::function<void(std::optional<OAuth2AuthCode>)>;
-    using AccessTokenCallback =
-        std::function<void(std::optional<OAuth2AccessToken>)>;
+    using ClientCallback =
+        UniqueFunction<void(std::optional<OAuth2Client>)>;
+    using ClientListCallback =
+        UniqueFunction<void(std::vector<OAuth2Client>)>;
+    using AuthCodeCallback =
+        UniqueFunction<void(std::optional<OAuth2AuthCode>)>;
+    // nullptr = not found
+    using AccessTokenCallback = UniqueFunction<void(AccessTokenPtr)>;
     using RefreshTokenCallback =
-        std::function<void(std::optional<OAuth2RefreshToken>)>;
-    using VoidCallback = std::function<void()>;
-    using BoolCallback = std::function<void(bool)>;
+        UniqueFunction<void(std::optional<OAuth2RefreshToken>)>;
+    using VoidCallback = UniqueFunction<void()>;
+    using BoolCallback = UniqueFunction<void(bool)>;
 
     // ========== Client Operations ==========
 
@@ -100,6 +126,12 @@ class IOAuth2Storage
                                 const std::string &clientSecret,
                                 BoolCallback &&cb) = 0;
 
+    /**
+     * @brief Every registered client, for preloading ClientCache
+     * An empty list also reports a failed read.
+     */
+    virtual void listClients(ClientListCallback &&cb) = 0;
+
     // ========== Authorization Code Operations ==========
 
     /**
@@ -155,7 +187,8 @@ class IOAuth2Storage
     virtual void getRefreshToken(const std::string &token,
                                  RefreshTokenCallback &&cb) = 0;
 
-    using StringListCallback = std::function<void(std::vector<std::string>)>;
+    using StringListCallback =
+        UniqueFunction<void(std::vector<std::string>)>;
 
     // ========== User/Role Operations ==========
 
@@ -167,6 +200,14 @@ class IOAuth2Storage
     virtual void getUserRoles(const std::string &userId,
                               StringListCallback &&cb) = 0;
 
+    /**
+     * @brief Drop the role snapshot embedded in a user's access tokens
+     * Call after the user's role assignments change. Tokens stay valid;
+     * their next authorization check falls back to getUserRoles().
+     */
+    virtual void invalidateUserRoles(const std::string &userId,
+                                     VoidCallback &&cb) = 0;
+
     /**
      * @brief Delete expired data (codes, tokens)
      * Implementations should remove all expired entries.
@@ -0,0 +1,263 @@
+#include "LimitedOAuth2Storage.h"
+#include "../services/Deadline.h"
+
+namespace oauth2
+{
+
+namespace
+{
+
+/**
+ * @brief Queue @p call behind the limiter
+ * @param call Receives the caller's callback, wrapped to release the slot
+ * before it runs
+ * @param reject Completes the caller's callback without touching the
+ * backend
+ */
+template <typename Callback, typename Call, typename Reject>
+void limited(const std::shared_ptr<ConcurrencyLimiter> &limiter,
+             StoragePriority priority,
+             bool rejectable,
+             Callback &&cb,
+             Call &&call,
+             Reject &&reject)
+{
+    // start and reject are exclusive; both need the callback
+    auto shared = std::make_shared<Callback>(std::move(cb));
+    limiter->submit(
+        priority,
+        [limiter, shared, call = std::forward<Call>(call)]() {
+            call(Callback([limiter, cb = std::move(*shared)](auto... args) {
+                limiter->release();
+                if (cb)
+                    cb(std::move(args)...);
+            }));
+        },
+        [shared, reject = std::forward<Reject>(reject)]() {
+            if (*shared)
+                reject(*shared);
+        },
+        rejectable,
+        DeadlineScope::current());
+}
+
+}  // namespace
+
+LimitedOAuth2Storage::LimitedOAuth2Storage(
+    std::unique_ptr<IOAuth2Storage> impl,
+    std::shared_ptr<ConcurrencyLimiter> limiter)
+    : impl_(std::move(impl)), limiter_(std::move(limiter))
+{
+}
+
+// ========== Client Operations ==========
+
+void LimitedOAuth2Storage::getClient(const std::string &clientId,
+                                     ClientCallback &&cb)
+{
+    limited(
+        limiter_,
+        StoragePriority::kIssue,
+        true,
+        std::move(cb),
+        [impl = impl_, clientId](ClientCallback &&done) {
+            impl->getClient(clientId, std::move(done));
+        },
+        [](ClientCallback &cb) { cb(std::nullopt); });
+}
+
+void LimitedOAuth2Storage::validateClient(const std::string &clientId,
+                                          const std::string &clientSecret,
+                                          BoolCallback &&cb)
+{
+    limited(
+        limiter_,
+        StoragePriority::kIssue,
+        true,
+        std::move(cb),
+        [impl = impl_, clientId, clientSecret](BoolCallback &&done) {
+            impl->validateClient(clientId, clientSecret, std::move(done));
+        },
+        [](BoolCallback &cb) { cb(false); });
+}
+
+void LimitedOAuth2Storage::listClients(ClientListCallback &&cb)
+{
+    // Background reload of the client registry: yields to requests
+    limited(
+        limiter_,
+        StoragePriority::kCleanup,
+        true,
+        std::move(cb),
+        [impl = impl_](ClientListCallback &&done) {
+            impl->listClients(std::move(done));
+        },
+        [](ClientListCallback &cb) { cb({}); });
+}
+
+// ========== Authorization Code Operations ==========
+
+void LimitedOAuth2Storage::saveAuthCode(const OAuth2AuthCode &code,
+                                        VoidCallback &&cb)
+{
+    limited(
+        limiter_,
+        StoragePriority::kIssue,
+        false,
+        std::move(cb),
+        [impl = impl_, code](VoidCallback &&done) {
+            impl->saveAuthCode(code, std::move(done));
+        },
+        [](VoidCallback &cb) { cb(); });
+}
+
+void LimitedOAuth2Storage::getAuthCode(const std::string &code,
+                                       AuthCodeCallback &&cb)
+{
+    limited(
+        limiter_,
+        StoragePriority::kIssue,
+        true,
+        std::move(cb),
+        [impl = impl_, code](AuthCodeCallback &&done) {
+            impl->getAuthCode(code, std::move(done));
+        },
+        [](AuthCodeCallback &cb) { cb(std::nullopt); });
+}
+
+void LimitedOAuth2Storage::markAuthCodeUsed(const std::string &code,
+                                            VoidCallback &&cb)
+{
+    limited(
+        limiter_,
+        StoragePriority::kIssue,
+        false,
+        std::move(cb),
+        [impl = impl_, code](VoidCallback &&done) {
+            impl->markAuthCodeUsed(code, std::move(done));
+        },
+        [](VoidCallback &cb) { cb(); });
+}
+
+void LimitedOAuth2Storage::consumeAuthCode(const std::string &code,
+                                           AuthCodeCallback &&cb)
+{
+    // A rejected consume leaves the code unused: the client may retry
+    limited(
+        limiter_,
+        StoragePriority::kIssue,
+        true,
+        std::move(cb),
+        [impl = impl_, code](AuthCodeCallback &&done) {
+            impl->consumeAuthCode(code, std::move(done));
+        },
+        [](AuthCodeCallback &cb) { cb(std::nullopt); });
+}
+
+// ========== Access Token Operations ==========
+
+void LimitedOAuth2Storage::saveAccessToken(const OAuth2AccessToken &token,
+                                           VoidCallback &&cb)
+{
+    limited(
+        limiter_,
+        StoragePriority::kIssue,
+        false,
+        std::move(cb),
+        [impl = impl_, token](VoidCallback &&done) {
+            impl->saveAccessToken(token, std::move(done));
+        },
+        [](VoidCallback &cb) { cb(); });
+}
+
+void LimitedOAuth2Storage::getAccessToken(const std::string &token,
+                                          AccessTokenCallback &&cb)
+{
+    limited(
+        limiter_,
+        StoragePriority::kValidate,
+        true,
+        std::move(cb),
+        [impl = impl_, token](AccessTokenCallback &&done) {
+            impl->getAccessToken(token, std::move(done));
+        },
+        [](AccessTokenCallback &cb) { cb(nullptr); });
+}
+
+// ========== Refresh Token Operations ==========
+
+void LimitedOAuth2Storage::saveRefreshToken(const OAuth2RefreshToken &token,
+                                            VoidCallback &&cb)
+{
+    limited(
+        limiter_,
+        StoragePriority::kIssue,
+        false,
+        std::move(cb),
+        [impl = impl_, token](VoidCallback &&done) {
+            impl->saveRefreshToken(token, std::move(done));
+        },
+        [](VoidCallback &cb) { cb(); });
+}
+
+void LimitedOAuth2Storage::getRefreshToken(const std::string &token,
+                                           RefreshTokenCallback &&cb)
+{
+    limited(
+        limiter_,
+        StoragePriority::kIssue,
+        true,
+        std::move(cb),
+        [impl = impl_, token](RefreshTokenCallback &&done) {
+            impl->getRefreshToken(token, std::move(done));
+        },
+        [](RefreshTokenCallback &cb) { cb(std::nullopt); });
+}
+
+// ========== User/Role Operations ==========
+
+void LimitedOAuth2Storage::getUserRoles(const std::string &userId,
+                                        StringListCallback &&cb)
+{
+    limited(
+        limiter_,
+        StoragePriority::kValidate,
+        true,
+        std::move(cb),
+        [impl = impl_, userId](StringListCallback &&done) {
+            impl->getUserRoles(userId, std::move(done));
+        },
+        [](StringListCallback &cb) { cb({}); });
+}
+
+void LimitedOAuth2Storage::invalidateUserRoles(const std::string &userId,
+                                               VoidCallback &&cb)
+{
+    limited(
+        limiter_,
+        StoragePriority::kIssue,
+        false,
+        std::move(cb),
+        [impl = impl_, userId](VoidCallback &&done) {
+            impl->invalidateUserRoles(userId, std::move(done));
+        },
+        [](VoidCallback &cb) { cb(); });
+}
+
+// ========== Cleanup ==========
+
+void LimitedOAuth2Storage::deleteExpiredData()
+{
+    // Synchronous interface: the slot covers issuing the deletes. Skipped
+    // when it cannot start in time; the next cleanup run catches up.
+    auto limiter = limiter_;
+    limiter_->submit(
+        StoragePriority::kCleanup,
+        [impl = impl_, limiter]() {
+            impl->deleteExpiredData();
+            limiter->release();
+        },
+        []() {});
+}
+
+}  // namespace oauth2
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "IOAuth2Storage.h"
+#include "../services/ConcurrencyLimiter.h"
+#include <memory>
+
+namespace oauth2
+{
+
+/**
+ * @brief Decorator for IOAuth2Storage that bounds concurrent operations
+ * against the wrapped backend (see ConcurrencyLimiter)
+ *
+ * Priorities: access token lookups and role checks are kValidate, the
+ * authorize/token flows kIssue, deleteExpiredData kCleanup. A rejected
+ * read completes as "not found" (the flows answer with an OAuth2 error);
+ * writes have no failure channel, so they are queued but never rejected.
+ */
+class LimitedOAuth2Storage : public IOAuth2Storage
+{
+  public:
+    LimitedOAuth2Storage(std::unique_ptr<IOAuth2Storage> impl,
+                         std::shared_ptr<ConcurrencyLimiter> limiter);
+
+    void getClient(const std::string &clientId, ClientCallback &&cb) override;
+    void validateClient(const std::string &clientId,
+                        const std::string &clientSecret,
+                        BoolCallback &&cb) override;
+    void listClients(ClientListCallback &&cb) override;
+
+    void saveAuthCode(const OAuth2AuthCode &code, VoidCallback &&cb) override;
+    void getAuthCode(const std::string &code, AuthCodeCallback &&cb) override;
+    void markAuthCodeUsed(const std::string &code, VoidCallback &&cb) override;
+    void consumeAuthCode(const std::string &code,
+                         AuthCodeCallback &&cb) override;
+
+    void saveAccessToken(const OAuth2AccessToken &token,
+                         VoidCallback &&cb) override;
+    void getAccessToken(const std::string &token,
+                        AccessTokenCallback &&cb) override;
+
+    void saveRefreshToken(const OAuth2RefreshToken &token,
+                          VoidCallback &&cb) override;
+    void getRefreshToken(const std::string &token,
+                         RefreshTokenCallback &&cb) override;
+
+    void getUserRoles(const std::string &userId,
+                      StringListCallback &&cb) override;
+    void invalidateUserRoles(const std::string &userId,
+                             VoidCallback &&cb) override;
+
+    void deleteExpiredData() override;
+
+    const std::shared_ptr<ConcurrencyLimiter> &limiter() const
+    {
+        return limiter_;
+    }
+
+  private:
+    // Shared with queued operations, which may start after a caller that
+    // dropped this decorator
+    std::shared_ptr<IOAuth2Storage> impl_;
+    std::shared_ptr<ConcurrencyLimiter> limiter_;
+};
+
+}  // namespace oauth2
@@ -1,5 +1,7 @@
 #include "MemoryOAuth2Storage.h"
+#include "plugins/OAuth2Metrics.h"
 #include <chrono>
+#include <sstream>
 
 namespace oauth2
 {
@@ -44,6 +46,21 @@ void MemoryOAuth2Storage::initFromConfig(const Json::Value &clientsConfig)
                 clientData["redirect_uri"].asString());
         }
 
+        // Optional allowed_scopes (array or space separated); none = any
+        const auto &scopes = clientData["allowed_scopes"];
+        if (scopes.isArray())
+        {
+            for (const auto &scope : scopes)
+                client.allowedScopes.push_back(scope.asString());
+        }
+        else if (scopes.isString())
+        {
+            std::istringstream in(scopes.asString());
+            std::string scope;
+            while (in >> scope)
+                client.allowedScopes.push_back(scope);
+        }
+
         clients_[clientId] = client;
     }
 }
@@ -51,14 +68,19 @@ void MemoryOAuth2Storage::initFromConfig(const Json::Value &clientsConfig)
 void MemoryOAuth2Storage::getClient(const std::string &clientId,
                                     ClientCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kGetClient,
+                               StorageBackend::kMemory,
+                               clientId);
     std::lock_guard<std::recursive_mutex> lock(mutex_);
     auto it = clients_.find(clientId);
     if (it != clients_.end())
     {
+        timer.stop();
         cb(it->second);
     }
     else
     {
+        timer.stop();
         cb(std::nullopt);
     }
 }
@@ -67,30 +89,55 @@ void MemoryOAuth2Storage::validateClient(const std::string &clientId,
                                          const std::string &clientSecret,
                                          BoolCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kValidateClient,
+                               StorageBackend::kMemory,
+                               clientId);
     std::lock_guard<std::recursive_mutex> lock(mutex_);
     auto it = clients_.find(clientId);
     if (it == clients_.end())
     {
+        timer.stop();
         cb(false);
         return;
     }
 
     if (clientSecret.empty())
     {
+        timer.stop();
         cb(true);  // Public client or just ID check
         return;
     }
 
     // Simple equality check for memory storage
     bool valid = (it->second.clientSecretHash == clientSecret);
+    timer.stop();
     cb(valid);
 }
 
+void MemoryOAuth2Storage::listClients(ClientListCallback &&cb)
+{
+    ScopedOperationTimer timer(StorageOp::kListClients,
+                               StorageBackend::kMemory);
+    std::vector<OAuth2Client> clients;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        clients.reserve(clients_.size());
+        for (const auto &entry : clients_)
+            clients.push_back(entry.second);
+    }
+    timer.stop();
+    cb(std::move(clients));
+}
+
 void MemoryOAuth2Storage::saveAuthCode(const OAuth2AuthCode &code,
                                        VoidCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kSaveAuthCode,
+                               StorageBackend::kMemory,
+                               code.code);
     std::lock_guard<std::recursive_mutex> lock(mutex_);
     authCodes_[code.code] = code;
+    timer.stop();
     if (cb)
         cb();
 }
@@ -98,6 +145,15 @@ void MemoryOAuth2Storage::saveAuthCode(const OAuth2AuthCode &code,
 void MemoryOAuth2Storage::getAuthCode(const std::string &code,
                                       AuthCodeCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kGetAuthCode,
+                               StorageBackend::kMemory,
+                               code);
+    if (!TokenValue::fits(code))
+    {
+        timer.stop();
+        cb(std::nullopt);  // Longer than anything we issue
+        return;
+    }
     std::lock_guard<std::recursive_mutex> lock(mutex_);
     // Clean up expired codes lazily or just check expiry
     auto it = authCodes_.find(code);
@@ -105,6 +161,7 @@ void MemoryOAuth2Storage::getAuthCode(const std::string &code,
     {
         if (it->second.expiresAt > getCurrentTimestamp())
         {
+            timer.stop();
             cb(it->second);
             return;
         }
@@ -113,18 +170,23 @@ void MemoryOAuth2Storage::getAuthCode(const std::string &code,
             authCodes_.erase(it);
         }
     }
+    timer.stop();
     cb(std::nullopt);
 }
 
 void MemoryOAuth2Storage::markAuthCodeUsed(const std::string &code,
                                            VoidCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kMarkAuthCodeUsed,
+                               StorageBackend::kMemory,
+                               code);
     std::lock_guard<std::recursive_mutex> lock(mutex_);
-    auto it = authCodes_.find(code);
+    auto it = TokenValue::fits(code) ? authCodes_.find(code) : authCodes_.end();
     if (it != authCodes_.end())
     {
         it->second.used = true;
     }
+    timer.stop();
     if (cb)
         cb();
 }
@@ -132,6 +194,15 @@ void MemoryOAuth2Storage::markAuthCodeUsed(const std::string &code,
 void MemoryOAuth2Storage::consumeAuthCode(const std::string &code,
                                           AuthCodeCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kConsumeAuthCode,
+                               StorageBackend::kMemory,
+                               code);
+    if (!TokenValue::fits(code))
+    {
+        timer.stop();
+        cb(std::nullopt);
+        return;
+    }
     std::lock_guard<std::recursive_mutex> lock(mutex_);
     auto it = authCodes_.find(code);
     if (it != authCodes_.end())
@@ -139,18 +210,27 @@ void MemoryOAuth2Storage::consumeAuthCode(const std::string &code,
         if (!it->second.used)
         {
             it->second.used = true;
+            timer.stop();
             cb(it->second);
             return;
         }
     }
+    timer.stop();
     cb(std::nullopt);
 }
 
 void MemoryOAuth2Storage::saveAccessToken(const OAuth2AccessToken &token,
                                           VoidCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kSaveAccessToken,
+                               StorageBackend::kMemory,
+                               token.token);
+    auto record = std::make_shared<const OAuth2AccessToken>(token);
     std::lock_guard<std::recursive_mutex> lock(mutex_);
-    accessTokens_[token.token] = token;
+    // Erase first: an existing key would keep viewing the old record
+    accessTokens_.erase(record->token.view());
+    accessTokens_.emplace(record->token.view(), std::move(record));
+    timer.stop();
     if (cb)
         cb();
 }
@@ -158,24 +238,34 @@ void MemoryOAuth2Storage::saveAccessToken(const OAuth2AccessToken &token,
 void MemoryOAuth2Storage::getAccessToken(const std::string &token,
                                          AccessTokenCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kGetAccessToken,
+                               StorageBackend::kMemory,
+                               token);
     std::lock_guard<std::recursive_mutex> lock(mutex_);
     auto it = accessTokens_.find(token);
     if (it != accessTokens_.end())
     {
-        if (it->second.expiresAt > getCurrentTimestamp() && !it->second.revoked)
+        if (it->second->expiresAt > getCurrentTimestamp() &&
+            !it->second->revoked)
         {
-            cb(it->second);
+            timer.stop();
+            cb(it->second);  // Shared, not copied
             return;
         }
     }
-    cb(std::nullopt);
+    timer.stop();
+    cb(nullptr);
 }
 
 void MemoryOAuth2Storage::saveRefreshToken(const OAuth2RefreshToken &token,
                                            VoidCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kSaveRefreshToken,
+                               StorageBackend::kMemory,
+                               token.token);
     std::lock_guard<std::recursive_mutex> lock(mutex_);
     refreshTokens_[token.token] = token;
+    timer.stop();
     if (cb)
         cb();
 }
@@ -183,22 +273,83 @@ void MemoryOAuth2Storage::saveRefreshToken(const OAuth2RefreshToken &token,
 void MemoryOAuth2Storage::getRefreshToken(const std::string &token,
                                           RefreshTokenCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kGetRefreshToken,
+                               StorageBackend::kMemory,
+                               token);
+    if (!TokenValue::fits(token))
+    {
+        timer.stop();
+        cb(std::nullopt);
+        return;
+    }
     std::lock_guard<std::recursive_mutex> lock(mutex_);
     auto it = refreshTokens_.find(token);
     if (it != refreshTokens_.end())
     {
         if (it->second.expiresAt > getCurrentTimestamp() && !it->second.revoked)
         {
+            timer.stop();
             cb(it->second);
             return;
         }
     }
+    timer.stop();
     cb(std::nullopt);
 }
 
+void MemoryOAuth2Storage::getUserRoles(const std::string &userId,
+                                       StringListCallback &&cb)
+{
+    ScopedOperationTimer timer(StorageOp::kGetUserRoles,
+                               StorageBackend::kMemory,
+                               userId);
+    // Mock Admin for ID "1" or "admin"
+    if (userId == "1" || userId == "admin")
+    {
+        timer.stop();
+        cb({"admin", "user"});
+    }
+    else
+    {
+        timer.stop();
+        cb({"user"});
+    }
+}
+
+void MemoryOAuth2Storage::invalidateUserRoles(const std::string &userId,
+                                              VoidCallback &&cb)
+{
+    ScopedOperationTimer timer(StorageOp::kInvalidateUserRoles,
+                               StorageBackend::kMemory,
+                               userId);
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::vector<std::string_view> keys;
+    for (const auto &[key, token] : accessTokens_)
+    {
+        if (token->userId == userId && token->roleIds)
+            keys.push_back(key);
+    }
+    for (auto key : keys)
+    {
+        // Records are immutable once shared; swap in a new one and re-point
+        // the key at it before the old record can be released
+        auto node = accessTokens_.extract(key);
+        auto updated = std::make_shared<OAuth2AccessToken>(*node.mapped());
+        updated->roleIds.reset();
+        node.key() = updated->token.view();
+        node.mapped() = std::move(updated);
+        accessTokens_.insert(std::move(node));
+    }
+    timer.stop();
+    if (cb)
+        cb();
+}
+
 // Manual cleanup for Memory Storage
 void MemoryOAuth2Storage::deleteExpiredData()
 {
+    ScopedOperationTimer timer(StorageOp::kDeleteExpiredData,
+                               StorageBackend::kMemory);
     std::lock_guard<std::recursive_mutex> lock(mutex_);
     int64_t now = getCurrentTimestamp();
     size_t count = 0;
@@ -220,7 +371,7 @@ void MemoryOAuth2Storage::deleteExpiredData()
     // 2. Access Tokens
     for (auto it = accessTokens_.begin(); it != accessTokens_.end();)
     {
-        if (it->second.expiresAt < now)
+        if (it->second->expiresAt < now)
         {
             it = accessTokens_.erase(it);
             count++;
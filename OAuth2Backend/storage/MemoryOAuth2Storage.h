@@ -2,6 +2,7 @@
 
 #include "IOAuth2Storage.h"
 #include <mutex>
+#include <string_view>
 #include <unordered_map>
 #include <json/json.h>
 
@@ -28,6 +29,7 @@ class MemoryOAuth2Storage : public IOAuth2Storage
     void validateClient(const std::string &clientId,
                         const std::string &clientSecret,
                         BoolCallback &&cb) override;
+    void listClients(ClientListCallback &&cb) override;
 
     // Authorization Code Operations
     void saveAuthCode(const OAuth2AuthCode &code, VoidCallback &&cb) override;
@@ -53,25 +55,19 @@ class MemoryOAuth2Storage : public IOAuth2Storage
 
     // RBAC
     void getUserRoles(const std::string &userId,
-                      StringListCallback &&cb) override
-    {
-        // Mock Admin for ID "1" or "admin"
-        if (userId == "1" || userId == "admin")
-        {
-            cb({"admin", "user"});
-        }
-        else
-        {
-            cb({"user"});
-        }
-    }
+                      StringListCallback &&cb) override;
+    void invalidateUserRoles(const std::string &userId,
+                             VoidCallback &&cb) override;
 
   private:
     std::recursive_mutex mutex_;
     std::unordered_map<std::string, OAuth2Client> clients_;
-    std::unordered_map<std::string, OAuth2AuthCode> authCodes_;
-    std::unordered_map<std::string, OAuth2AccessToken> accessTokens_;
-    std::unordered_map<std::string, OAuth2RefreshToken> refreshTokens_;
+    // Keyed by the inline token value: no per-entry heap string
+    std::unordered_map<TokenValue, OAuth2AuthCode> authCodes_;
+    // Key views the token inside the (immutable) record it maps to, so the
+    // value is stored once. Replacing a record must re-key its entry.
+    std::unordered_map<std::string_view, AccessTokenPtr> accessTokens_;
+    std::unordered_map<TokenValue, OAuth2RefreshToken> refreshTokens_;
 
     int64_t getCurrentTimestamp() const;
 };
@@ -2,6 +2,9 @@
 #include <drogon/drogon.h>
 #include <drogon/utils/Utilities.h>
 #include "plugins/OAuth2Metrics.h"
+#include "services/LogLevel.h"
+#include <algorithm>
+#include <sstream>
 
 #include "../models/Oauth2Clients.h"
 #include "../models/Oauth2Codes.h"
@@ -14,6 +17,37 @@ namespace oauth2
 using namespace drogon::orm;
 using namespace drogon_model::oauth_test;
 
+namespace
+{
+
+OAuth2Client clientFromRow(const Oauth2Clients &row)
+{
+    OAuth2Client client;
+    client.clientId = row.getValueOfClientId();
+    client.clientSecretHash = row.getValueOfClientSecret();
+    client.salt = row.getValueOfSalt();
+
+    std::stringstream ss(row.getValueOfRedirectUris());
+    std::string uri;
+    while (std::getline(ss, uri, ','))
+    {
+        client.redirectUris.push_back(uri);
+    }
+
+    // Space separated, like the scope parameter; commas too
+    std::string scopes = row.getValueOfAllowedScopes();
+    std::replace(scopes.begin(), scopes.end(), ',', ' ');
+    std::istringstream scopeStream(scopes);
+    std::string scope;
+    while (scopeStream >> scope)
+    {
+        client.allowedScopes.push_back(scope);
+    }
+    return client;
+}
+
+}  // namespace
+
 void PostgresOAuth2Storage::initFromConfig(const Json::Value &config)
 {
     dbClientName_ = config.get("db_client_name", "default").asString();
@@ -35,7 +69,7 @@ void PostgresOAuth2Storage::initFromConfig(const Json::Value &config)
 void PostgresOAuth2Storage::getClient(const std::string &clientId,
                                       ClientCallback &&cb)
 {
-    LOG_DEBUG << "Postgres getClient: " << clientId;
+    OAUTH2_LOG_DEBUG << "Postgres getClient: " << clientId;
     if (!dbClientReader_)
     {
         LOG_ERROR << "Postgres DB Client Reader is null!";
@@ -43,34 +77,28 @@ void PostgresOAuth2Storage::getClient(const std::string &clientId,
         return;
     }
 
-    auto sharedCb = std::make_shared<ClientCallback>(std::move(cb));
+    auto done = singleShot(std::move(cb));
     try
     {
         Mapper<Oauth2Clients> mapper(dbClientReader_);
+        OperationTimer timer(StorageOp::kGetClient,
+                             StorageBackend::kPostgres,
+                             clientId);
         mapper.findOne(
             Criteria(Oauth2Clients::Cols::_client_id,
                      CompareOperator::EQ,
                      clientId),
-            [sharedCb, clientId](const Oauth2Clients &row) {
-                OAuth2Client client;
-                client.clientId = row.getValueOfClientId();
-                LOG_DEBUG << "Postgres getClient: Found -> " << client.clientId;
-                client.clientSecretHash = row.getValueOfClientSecret();
-                client.salt = row.getValueOfSalt();
-
-                std::string uris = row.getValueOfRedirectUris();
-                LOG_DEBUG << "Postgres getClient: Redirect URIs -> " << uris;
-                std::stringstream ss(uris);
-                std::string uri;
-                while (std::getline(ss, uri, ','))
-                {
-                    client.redirectUris.push_back(uri);
-                }
-                (*sharedCb)(client);
+            [done, clientId, timer](const Oauth2Clients &row) {
+                auto trace = timer.stop();
+                auto client = clientFromRow(row);
+                OAUTH2_LOG_DEBUG << "Postgres getClient: Found -> "
+                                 << client.clientId;
+                done(std::move(client));
             },
-            [sharedCb, clientId](const DrogonDbException &e) {
-                LOG_DEBUG << "Postgres getClient: Not found or Error -> "
-                          << clientId << " (" << e.base().what() << ")";
+            [done, clientId, timer](const DrogonDbException &e) {
+                auto trace = timer.stop();
+                OAUTH2_LOG_DEBUG << "Postgres getClient: Not found or Error -> "
+                                 << clientId << " (" << e.base().what() << ")";
                 // FindOne throws or calls unexpected error callback if not
                 // found? Actually generated findOne typically throws if 0 rows
                 // in sync. Async: Exception callback is called for DB errors.
@@ -79,33 +107,32 @@ void PostgresOAuth2Storage::getClient(const std::string &clientId,
                 // found, it often calls exception callback with specific
                 // UnexpectedRows or similar. Wait, standard Mapper findOne
                 // calls exception callback if row count != 1.
-                (*sharedCb)(std::nullopt);
+                done(std::nullopt);
             });
     }
     catch (...)
     {
         LOG_ERROR << "Postgres getClient Exception";
-        (*sharedCb)(std::nullopt);
+        done(std::nullopt);
     }
 }
 
-// To fix the "move callback" issue in async calls with multiple branches
-// (success/error): We will simply ignore Postgres impl details for now and use
-// a simpler pattern: Capture by copy since std::function is copyable. Redefine
-// 'cb' as lvalue in body.
+// Callbacks are move-only but Drogon's success and error continuations must
+// be copyable: each call wraps its callback in singleShot() and both
+// continuations capture the same handle.
 
 void PostgresOAuth2Storage::validateClient(const std::string &clientId,
                                            const std::string &clientSecret,
                                            IOAuth2Storage::BoolCallback &&cb)
 {
-    LOG_DEBUG << "Postgres validateClient: " << clientId;
+    OAUTH2_LOG_DEBUG << "Postgres validateClient: " << clientId;
     if (!dbClientReader_)
     {
         cb(false);
         return;
     }
 
-    auto sharedCb = std::make_shared<BoolCallback>(std::move(cb));
+    auto done = singleShot(std::move(cb));
     try
     {
         Mapper<Oauth2Clients> mapper(dbClientReader_);
@@ -114,31 +141,42 @@ void PostgresOAuth2Storage::validateClient(const std::string &clientId,
         // If clientSecret is empty, we just check if client exists.
         if (clientSecret.empty())
         {
+            OperationTimer timer(StorageOp::kValidateClient,
+                                 StorageBackend::kPostgres,
+                                 clientId);
             mapper.findOne(
                 Criteria(Oauth2Clients::Cols::_client_id,
                          CompareOperator::EQ,
                          clientId),
-                [sharedCb, clientId](const Oauth2Clients &) {
-                    LOG_DEBUG
+                [done, clientId, timer](const Oauth2Clients &) {
+                    auto trace = timer.stop();
+                    OAUTH2_LOG_DEBUG
                         << "Postgres validateClient (no secret): Found -> "
                         << clientId;
-                    (*sharedCb)(true);
+                    done(true);
                 },
-                [sharedCb, clientId](const DrogonDbException &e) {
-                    LOG_DEBUG << "Postgres validateClient (no secret): Not "
-                                 "found/Error -> "
-                              << clientId << " " << e.base().what();
-                    (*sharedCb)(false);
+                [done, clientId, timer](const DrogonDbException &e) {
+                    auto trace = timer.stop();
+                    OAUTH2_LOG_DEBUG
+                        << "Postgres validateClient (no secret): Not "
+                           "found/Error -> "
+                        << clientId << " " << e.base().what();
+                    done(false);
                 });
             return;
         }
 
         // Case 2: Validate Secret
+        OperationTimer timer(StorageOp::kValidateClient,
+                             StorageBackend::kPostgres,
+                             clientId);
         mapper.findOne(
             Criteria(Oauth2Clients::Cols::_client_id,
                      CompareOperator::EQ,
                      clientId),
-            [sharedCb, clientId, clientSecret](const Oauth2Clients &row) {
+            [done, clientId, clientSecret, timer](
+                const Oauth2Clients &row) {
+                auto trace = timer.stop();
                 std::string storedHash = row.getValueOfClientSecret();
                 std::string salt = row.getValueOfSalt();
 
@@ -146,8 +184,9 @@ void PostgresOAuth2Storage::validateClient(const std::string &clientId,
                 std::string computedHash =
                     drogon::utils::getSha256(clientSecret + salt);
 
-                LOG_DEBUG << "Postgres validateClient: storedHash="
-                          << storedHash << ", computedHash=" << computedHash;
+                OAUTH2_LOG_DEBUG << "Postgres validateClient: storedHash="
+                                 << storedHash
+                                 << ", computedHash=" << computedHash;
 
                 if (computedHash.length() == storedHash.length())
                 {
@@ -161,26 +200,28 @@ void PostgresOAuth2Storage::validateClient(const std::string &clientId,
                             break;
                         }
                     }
-                    LOG_DEBUG << "Postgres validateClient match result: "
-                              << match;
-                    (*sharedCb)(match);
+                    OAUTH2_LOG_DEBUG << "Postgres validateClient match result: "
+                                     << match;
+                    done(match);
                 }
                 else
                 {
-                    LOG_DEBUG << "Postgres validateClient length mismatch";
-                    (*sharedCb)(false);
+                    OAUTH2_LOG_DEBUG
+                        << "Postgres validateClient length mismatch";
+                    done(false);
                 }
             },
-            [sharedCb, clientId](const DrogonDbException &e) {
+            [done, clientId, timer](const DrogonDbException &e) {
+                auto trace = timer.stop();
                 LOG_ERROR << "Postgres validateClient Error for " << clientId
                           << ": " << e.base().what();
-                (*sharedCb)(false);
+                done(false);
             });
     }
     catch (...)
     {
         LOG_ERROR << "Postgres validateClient Exception";
-        (*sharedCb)(false);
+        done(false);
     }
 }
 
@@ -189,6 +230,33 @@ void PostgresOAuth2Storage::validateClient(const std::string &clientId,
 // accept, as the user is prioritizing Redis. I will implement them properly to
 // avoid link errors.
 
+void PostgresOAuth2Storage::listClients(ClientListCallback &&cb)
+{
+    if (!dbClientReader_)
+    {
+        cb({});
+        return;
+    }
+
+    auto done = singleShot(std::move(cb));
+    OperationTimer timer(StorageOp::kListClients, StorageBackend::kPostgres);
+    Mapper<Oauth2Clients>(dbClientReader_)
+        .findAll(
+            [done, timer](const std::vector<Oauth2Clients> &rows) {
+                auto trace = timer.stop();
+                std::vector<OAuth2Client> clients;
+                clients.reserve(rows.size());
+                for (const auto &row : rows)
+                    clients.push_back(clientFromRow(row));
+                done(std::move(clients));
+            },
+            [done, timer](const DrogonDbException &e) {
+                auto trace = timer.stop();
+                LOG_ERROR << "Postgres listClients error: " << e.base().what();
+                done({});
+            });
+}
+
 void PostgresOAuth2Storage::saveAuthCode(const oauth2::OAuth2AuthCode &code,
                                          IOAuth2Storage::VoidCallback &&cb)
 {
@@ -198,12 +266,12 @@ void PostgresOAuth2Storage::saveAuthCode(const oauth2::OAuth2AuthCode &code,
             cb();
         return;
     }
-    auto sharedCb = std::make_shared<VoidCallback>(std::move(cb));
+    auto done = singleShot(std::move(cb));
     try
     {
         Mapper<Oauth2Codes> mapper(dbClientMaster_);
         Oauth2Codes newCode;
-        newCode.setCode(code.code);
+        newCode.setCode(code.code.str());
         newCode.setClientId(code.clientId);
         newCode.setUserId(code.userId);
         newCode.setScope(code.scope);
@@ -211,41 +279,48 @@ void PostgresOAuth2Storage::saveAuthCode(const oauth2::OAuth2AuthCode &code,
         newCode.setExpiresAt(code.expiresAt);
         newCode.setUsed(code.used);
 
+        OperationTimer timer(StorageOp::kSaveAuthCode,
+                             StorageBackend::kPostgres,
+                             code.code);
         mapper.insert(
             newCode,
-            [sharedCb](const Oauth2Codes &) {
-                if (*sharedCb)
-                    (*sharedCb)();
+            [done, timer](const Oauth2Codes &) {
+                auto trace = timer.stop();
+                done();
             },
-            [sharedCb](const DrogonDbException &e) {
+            [done, timer](const DrogonDbException &e) {
+                auto trace = timer.stop();
                 LOG_ERROR << "saveAuthCode Error: " << e.base().what();
-                if (*sharedCb)
-                    (*sharedCb)();
+                done();
             });
     }
     catch (...)
     {
         LOG_ERROR << "saveAuthCode Exception";
-        if (*sharedCb)
-            (*sharedCb)();
+        done();
     }
 }
 
 void PostgresOAuth2Storage::getAuthCode(const std::string &code,
                                         IOAuth2Storage::AuthCodeCallback &&cb)
 {
-    if (!dbClientReader_)
+    // Longer than anything we issue: it cannot be stored as a TokenValue
+    if (!dbClientReader_ || !TokenValue::fits(code))
     {
         cb(std::nullopt);
         return;
     }
-    auto sharedCb = std::make_shared<AuthCodeCallback>(std::move(cb));
+    auto done = singleShot(std::move(cb));
     try
     {
         Mapper<Oauth2Codes> mapper(dbClientReader_);
+        OperationTimer timer(StorageOp::kGetAuthCode,
+                             StorageBackend::kPostgres,
+                             code);
         mapper.findOne(
             Criteria(Oauth2Codes::Cols::_code, CompareOperator::EQ, code),
-            [sharedCb](const Oauth2Codes &row) {
+            [done, timer](const Oauth2Codes &row) {
+                auto trace = timer.stop();
                 OAuth2AuthCode c;
                 c.code = row.getValueOfCode();
                 c.clientId = row.getValueOfClientId();
@@ -254,19 +329,20 @@ void PostgresOAuth2Storage::getAuthCode(const std::string &code,
                 c.redirectUri = row.getValueOfRedirectUri();
                 c.expiresAt = row.getValueOfExpiresAt();  // int64_t
                 c.used = row.getValueOfUsed();
-                (*sharedCb)(c);
+                done(c);
             },
-            [sharedCb](const DrogonDbException &e) {
+            [done, timer](const DrogonDbException &e) {
+                auto trace = timer.stop();
                 // Not found or error
-                LOG_DEBUG << "getAuthCode not found or error: "
-                          << e.base().what();
-                (*sharedCb)(std::nullopt);
+                OAUTH2_LOG_DEBUG << "getAuthCode not found or error: "
+                                 << e.base().what();
+                done(std::nullopt);
             });
     }
     catch (...)
     {
         LOG_ERROR << "getAuthCode Exception";
-        (*sharedCb)(std::nullopt);
+        done(std::nullopt);
     }
 }
 
@@ -279,7 +355,7 @@ void PostgresOAuth2Storage::markAuthCodeUsed(const std::string &code,
             cb();
         return;
     }
-    auto sharedCb = std::make_shared<VoidCallback>(std::move(cb));
+    auto done = singleShot(std::move(cb));
     try
     {
         Mapper<Oauth2Codes> mapper(dbClientMaster_);
@@ -287,23 +363,25 @@ void PostgresOAuth2Storage::markAuthCodeUsed(const std::string &code,
         updateObj.setCode(code);
         updateObj.setUsed(true);
 
+        OperationTimer timer(StorageOp::kMarkAuthCodeUsed,
+                             StorageBackend::kPostgres,
+                             code);
         mapper.update(
             updateObj,
-            [sharedCb](const size_t count) {
-                if (*sharedCb)
-                    (*sharedCb)();
+            [done, timer](const size_t) {
+                auto trace = timer.stop();
+                done();
             },
-            [sharedCb](const DrogonDbException &e) {
+            [done, timer](const DrogonDbException &e) {
+                auto trace = timer.stop();
                 LOG_ERROR << "markAuthCodeUsed Error: " << e.base().what();
-                if (*sharedCb)
-                    (*sharedCb)();
+                done();
             });
     }
     catch (...)
     {
         LOG_ERROR << "markAuthCodeUsed Exception";
-        if (*sharedCb)
-            (*sharedCb)();
+        done();
     }
 }
 
@@ -311,25 +389,29 @@ void PostgresOAuth2Storage::consumeAuthCode(
     const std::string &code,
     IOAuth2Storage::AuthCodeCallback &&cb)
 {
-    if (!dbClientMaster_)
+    if (!dbClientMaster_ || !TokenValue::fits(code))
     {
         cb(std::nullopt);
         return;
     }
-    auto sharedCb = std::make_shared<AuthCodeCallback>(std::move(cb));
+    auto done = singleShot(std::move(cb));
 
     // Atomic Check-and-Set via UPDATE RETURNING
     // We only update if used=false.
     // If used=true already, WHERE clause fails, returns 0 rows -> cb(nullopt).
+    OperationTimer timer(StorageOp::kConsumeAuthCode,
+                         StorageBackend::kPostgres,
+                         code);
     dbClientMaster_->execSqlAsync(
         "UPDATE oauth2_codes SET used = true WHERE code = $1 AND used = false "
         "RETURNING client_id, user_id, scope, redirect_uri, expires_at",
-        [sharedCb, code](const Result &r) {
+        [done, code, timer](const Result &r) {
+            auto trace = timer.stop();
             if (r.empty())
             {
                 // Either didn't exist OR was already used.
                 // We treat both as failure to consume.
-                (*sharedCb)(std::nullopt);
+                done(std::nullopt);
                 return;
             }
             auto row = r[0];
@@ -341,15 +423,57 @@ void PostgresOAuth2Storage::consumeAuthCode(
             c.redirectUri = row["redirect_uri"].as<std::string>();
             c.expiresAt = row["expires_at"].as<int64_t>();
             c.used = true;
-            (*sharedCb)(c);
+            done(c);
         },
-        [sharedCb](const DrogonDbException &e) {
+        [done, timer](const DrogonDbException &e) {
+            auto trace = timer.stop();
             LOG_ERROR << "consumeAuthCode Postgres Error: " << e.base().what();
-            (*sharedCb)(std::nullopt);
+            done(std::nullopt);
         },
         code);
 }
 
+// role_ids is stored as a comma separated list ("1,2"), like redirect_uris.
+// NULL means the token carries no role snapshot; "" means "no roles".
+static std::optional<std::string> encodeRoleIds(
+    const std::optional<std::vector<int32_t>> &roleIds)
+{
+    if (!roleIds)
+        return std::nullopt;
+    std::string out;
+    for (auto id : *roleIds)
+    {
+        if (!out.empty())
+            out += ',';
+        out += std::to_string(id);
+    }
+    return out;
+}
+
+static std::vector<int32_t> decodeRoleIds(const std::string &csv)
+{
+    std::vector<int32_t> ids;
+    std::stringstream ss(csv);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item.empty())
+            continue;
+        try
+        {
+            ids.push_back(std::stoi(item));
+        }
+        catch (...)
+        {
+            LOG_WARN << "Ignoring malformed role id: " << item;
+        }
+    }
+    return ids;
+}
+
+// Access tokens use raw SQL: the generated Oauth2AccessTokens model has no
+// role_ids column (added by sql/004_access_token_roles.sql). Switch back to
+// Mapper<Oauth2AccessTokens> once the model is regenerated with drogon_ctl.
 void PostgresOAuth2Storage::saveAccessToken(
     const oauth2::OAuth2AccessToken &token,
     IOAuth2Storage::VoidCallback &&cb)
@@ -360,76 +484,73 @@ void PostgresOAuth2Storage::saveAccessToken(
             cb();
         return;
     }
-    auto sharedCb = std::make_shared<VoidCallback>(std::move(cb));
-    try
-    {
-        Mapper<Oauth2AccessTokens> mapper(dbClientMaster_);
-        Oauth2AccessTokens newToken;
-        newToken.setToken(token.token);
-        newToken.setClientId(token.clientId);
-        newToken.setUserId(token.userId);
-        newToken.setScope(token.scope);
-        newToken.setExpiresAt(token.expiresAt);
-        newToken.setRevoked(token.revoked);
-
-        mapper.insert(
-            newToken,
-            [sharedCb](const Oauth2AccessTokens &) {
-                if (*sharedCb)
-                    (*sharedCb)();
-            },
-            [sharedCb](const DrogonDbException &e) {
-                LOG_ERROR << "saveAccessToken Error: " << e.base().what();
-                if (*sharedCb)
-                    (*sharedCb)();
-            });
-    }
-    catch (...)
-    {
-        LOG_ERROR << "saveAccessToken Exception";
-        if (*sharedCb)
-            (*sharedCb)();
-    }
+    auto done = singleShot(std::move(cb));
+    OperationTimer timer(StorageOp::kSaveAccessToken,
+                         StorageBackend::kPostgres,
+                         token.token);
+    dbClientMaster_->execSqlAsync(
+        "INSERT INTO oauth2_access_tokens "
+        "(token, client_id, user_id, scope, expires_at, revoked, role_ids) "
+        "VALUES ($1, $2, $3, $4, $5, $6, $7)",
+        [done, timer](const Result &) {
+            auto trace = timer.stop();
+            done();
+        },
+        [done, timer](const DrogonDbException &e) {
+            auto trace = timer.stop();
+            LOG_ERROR << "saveAccessToken Error: " << e.base().what();
+            done();
+        },
+        token.token,
+        token.clientId.str(),
+        token.userId,
+        token.scope,
+        token.expiresAt,
+        token.revoked,
+        encodeRoleIds(token.roleIds));
 }
 
 void PostgresOAuth2Storage::getAccessToken(
     const std::string &token,
     IOAuth2Storage::AccessTokenCallback &&cb)
 {
-    if (!dbClientReader_)
+    if (!dbClientReader_ || !TokenValue::fits(token))
     {
-        cb(std::nullopt);
+        cb(nullptr);
         return;
     }
-    auto sharedCb = std::make_shared<AccessTokenCallback>(std::move(cb));
-    try
-    {
-        Mapper<Oauth2AccessTokens> mapper(dbClientReader_);
-        mapper.findOne(
-            Criteria(Oauth2AccessTokens::Cols::_token,
-                     CompareOperator::EQ,
-                     token),
-            [sharedCb](const Oauth2AccessTokens &row) {
-                OAuth2AccessToken t;
-                t.token = row.getValueOfToken();
-                t.clientId = row.getValueOfClientId();
-                t.userId = row.getValueOfUserId();
-                t.scope = row.getValueOfScope();
-                t.expiresAt = row.getValueOfExpiresAt();
-                t.revoked = row.getValueOfRevoked();
-                (*sharedCb)(t);
-            },
-            [sharedCb](const DrogonDbException &e) {
-                LOG_DEBUG << "getAccessToken not found/error: "
-                          << e.base().what();
-                (*sharedCb)(std::nullopt);
-            });
-    }
-    catch (...)
-    {
-        LOG_ERROR << "getAccessToken Exception";
-        (*sharedCb)(std::nullopt);
-    }
+    auto done = singleShot(std::move(cb));
+    OperationTimer timer(StorageOp::kGetAccessToken,
+                         StorageBackend::kPostgres,
+                         token);
+    dbClientReader_->execSqlAsync(
+        "SELECT token, client_id, user_id, scope, expires_at, revoked, "
+        "role_ids FROM oauth2_access_tokens WHERE token = $1",
+        [done, timer](const Result &r) {
+            auto trace = timer.stop();
+            if (r.empty())
+            {
+                done(nullptr);
+                return;
+            }
+            auto row = r[0];
+            auto t = std::make_shared<OAuth2AccessToken>();
+            t->token = row["token"].as<std::string>();
+            t->clientId = row["client_id"].as<std::string>();
+            t->userId = row["user_id"].as<std::string>();
+            t->scope = row["scope"].as<std::string>();
+            t->expiresAt = row["expires_at"].as<int64_t>();
+            t->revoked = row["revoked"].as<bool>();
+            if (!row["role_ids"].isNull())
+                t->roleIds = decodeRoleIds(row["role_ids"].as<std::string>());
+            done(std::move(t));
+        },
+        [done, timer](const DrogonDbException &e) {
+            auto trace = timer.stop();
+            LOG_ERROR << "getAccessToken Error: " << e.base().what();
+            done(nullptr);
+        },
+        token);
 }
 
 void PostgresOAuth2Storage::saveRefreshToken(
@@ -442,36 +563,38 @@ void PostgresOAuth2Storage::saveRefreshToken(
             cb();
         return;
     }
-    auto sharedCb = std::make_shared<VoidCallback>(std::move(cb));
+    auto done = singleShot(std::move(cb));
     try
     {
         Mapper<Oauth2RefreshTokens> mapper(dbClientMaster_);
         Oauth2RefreshTokens newToken;
-        newToken.setToken(token.token);
-        newToken.setAccessToken(token.accessToken);
+        newToken.setToken(token.token.str());
+        newToken.setAccessToken(token.accessToken.str());
         newToken.setClientId(token.clientId);
         newToken.setUserId(token.userId);
         newToken.setScope(token.scope);
         newToken.setExpiresAt(token.expiresAt);
         newToken.setRevoked(token.revoked);
 
+        OperationTimer timer(StorageOp::kSaveRefreshToken,
+                             StorageBackend::kPostgres,
+                             token.token);
         mapper.insert(
             newToken,
-            [sharedCb](const Oauth2RefreshTokens &) {
-                if (*sharedCb)
-                    (*sharedCb)();
+            [done, timer](const Oauth2RefreshTokens &) {
+                auto trace = timer.stop();
+                done();
             },
-            [sharedCb](const DrogonDbException &e) {
+            [done, timer](const DrogonDbException &e) {
+                auto trace = timer.stop();
                 LOG_ERROR << "saveRefreshToken Error: " << e.base().what();
-                if (*sharedCb)
-                    (*sharedCb)();
+                done();
             });
     }
     catch (...)
     {
         LOG_ERROR << "saveRefreshToken Exception";
-        if (*sharedCb)
-            (*sharedCb)();
+        done();
     }
 }
 
@@ -479,20 +602,30 @@ void PostgresOAuth2Storage::getRefreshToken(
     const std::string &token,
     IOAuth2Storage::RefreshTokenCallback &&cb)
 {
-    if (!dbClientReader_)
+    if (!dbClientReader_ || !TokenValue::fits(token))
     {
         cb(std::nullopt);
         return;
     }
-    auto sharedCb = std::make_shared<RefreshTokenCallback>(std::move(cb));
+    auto done = singleShot(std::move(cb));
     try
     {
         Mapper<Oauth2RefreshTokens> mapper(dbClientReader_);
+        OperationTimer timer(StorageOp::kGetRefreshToken,
+                             StorageBackend::kPostgres,
+                             token);
         mapper.findOne(
             Criteria(Oauth2RefreshTokens::Cols::_token,
                      CompareOperator::EQ,
                      token),
-            [sharedCb](const Oauth2RefreshTokens &row) {
+            [done, timer](const Oauth2RefreshTokens &row) {
+                auto trace = timer.stop();
+                if (!TokenValue::fits(row.getValueOfAccessToken()))
+                {
+                    LOG_WARN << "getRefreshToken: access_token too long";
+                    done(std::nullopt);
+                    return;
+                }
                 OAuth2RefreshToken t;
                 t.token = row.getValueOfToken();
                 t.accessToken = row.getValueOfAccessToken();
@@ -501,18 +634,19 @@ void PostgresOAuth2Storage::getRefreshToken(
                 t.scope = row.getValueOfScope();
                 t.expiresAt = row.getValueOfExpiresAt();
                 t.revoked = row.getValueOfRevoked();
-                (*sharedCb)(t);
+                done(t);
             },
-            [sharedCb](const DrogonDbException &e) {
-                LOG_DEBUG << "getRefreshToken not found/error: "
-                          << e.base().what();
-                (*sharedCb)(std::nullopt);
+            [done, timer](const DrogonDbException &e) {
+                auto trace = timer.stop();
+                OAUTH2_LOG_DEBUG << "getRefreshToken not found/error: "
+                                 << e.base().what();
+                done(std::nullopt);
             });
     }
     catch (...)
     {
         LOG_ERROR << "getRefreshToken Exception";
-        (*sharedCb)(std::nullopt);
+        done(std::nullopt);
     }
 }
 
@@ -529,42 +663,54 @@ void PostgresOAuth2Storage::deleteExpiredData()
     {
         // 1. Codes
         Mapper<Oauth2Codes> codeMapper(dbClientMaster_);
+        OperationTimer codeTimer(StorageOp::kDeleteExpiredData,
+                                 StorageBackend::kPostgres);
         codeMapper.deleteBy(
             Criteria(Oauth2Codes::Cols::_expires_at, CompareOperator::LT, now),
-            [](const size_t count) {
+            [codeTimer](const size_t count) {
+                codeTimer.stop();
                 if (count > 0)
                     LOG_INFO << "Cleaned " << count << " expired auth codes";
             },
-            [](const DrogonDbException &e) {
+            [codeTimer](const DrogonDbException &e) {
+                codeTimer.stop();
                 LOG_ERROR << "Cleanup Codes Error: " << e.base().what();
             });
 
         // 2. Access Tokens
         Mapper<Oauth2AccessTokens> atMapper(dbClientMaster_);
+        OperationTimer atTimer(StorageOp::kDeleteExpiredData,
+                               StorageBackend::kPostgres);
         atMapper.deleteBy(
             Criteria(Oauth2AccessTokens::Cols::_expires_at,
                      CompareOperator::LT,
                      now),
-            [](const size_t count) {
+            [atTimer](const size_t count) {
+                atTimer.stop();
                 if (count > 0)
                     LOG_INFO << "Cleaned " << count << " expired access tokens";
             },
-            [](const DrogonDbException &e) {
+            [atTimer](const DrogonDbException &e) {
+                atTimer.stop();
                 LOG_ERROR << "Cleanup AccessTokens Error: " << e.base().what();
             });
 
         // 3. Refresh Tokens
         Mapper<Oauth2RefreshTokens> rtMapper(dbClientMaster_);
+        OperationTimer rtTimer(StorageOp::kDeleteExpiredData,
+                               StorageBackend::kPostgres);
         rtMapper.deleteBy(
             Criteria(Oauth2RefreshTokens::Cols::_expires_at,
                      CompareOperator::LT,
                      now),
-            [](const size_t count) {
+            [rtTimer](const size_t count) {
+                rtTimer.stop();
                 if (count > 0)
                     LOG_INFO << "Cleaned " << count
                              << " expired refresh tokens";
             },
-            [](const DrogonDbException &e) {
+            [rtTimer](const DrogonDbException &e) {
+                rtTimer.stop();
                 LOG_ERROR << "Cleanup RefreshTokens Error: " << e.base().what();
             });
     }
@@ -603,21 +749,57 @@ void PostgresOAuth2Storage::getUserRoles(const std::string &userId,
         "JOIN user_roles ur ON r.id = ur.role_id "
         "WHERE ur.user_id = $1";
 
+    OperationTimer timer(StorageOp::kGetUserRoles,
+                         StorageBackend::kPostgres,
+                         userId);
+    auto done = singleShot(std::move(cb));
     dbClientReader_->execSqlAsync(
         sql,
-        [cb](const Result &r) {
+        [done, timer](const Result &r) {
+            auto trace = timer.stop();
             std::vector<std::string> roles;
             for (const auto &row : r)
             {
                 roles.push_back(row["name"].as<std::string>());
             }
-            cb(roles);
+            done(roles);
         },
-        [cb](const DrogonDbException &e) {
+        [done, timer](const DrogonDbException &e) {
+            auto trace = timer.stop();
             LOG_ERROR << "getUserRoles failed: " << e.base().what();
-            cb({});
+            done({});
         },
         uid);
 }
 
+void PostgresOAuth2Storage::invalidateUserRoles(const std::string &userId,
+                                                VoidCallback &&cb)
+{
+    if (!dbClientMaster_)
+    {
+        if (cb)
+            cb();
+        return;
+    }
+    auto done = singleShot(std::move(cb));
+    OperationTimer timer(StorageOp::kInvalidateUserRoles,
+                         StorageBackend::kPostgres,
+                         userId);
+    dbClientMaster_->execSqlAsync(
+        "UPDATE oauth2_access_tokens SET role_ids = NULL "
+        "WHERE user_id = $1 AND role_ids IS NOT NULL",
+        [done, userId, timer](const Result &r) {
+            auto trace = timer.stop();
+            LOG_INFO << "Invalidated role snapshot of " << r.affectedRows()
+                     << " access tokens for user " << userId;
+            done();
+        },
+        [done, timer](const DrogonDbException &e) {
+            auto trace = timer.stop();
+            LOG_ERROR << "invalidateUserRoles Error: " << e.base().what();
+            done();
+        },
+        userId);
+}
+
 }  // namespace oauth2
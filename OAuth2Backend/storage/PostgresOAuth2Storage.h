@@ -21,6 +21,7 @@ class PostgresOAuth2Storage : public IOAuth2Storage
     void validateClient(const std::string &clientId,
                         const std::string &clientSecret,
                         BoolCallback &&cb) override;
+    void listClients(ClientListCallback &&cb) override;
 
     // Authorization Code Operations
     void saveAuthCode(const OAuth2AuthCode &code, VoidCallback &&cb) override;
@@ -47,6 +48,8 @@ class PostgresOAuth2Storage : public IOAuth2Storage
     // RBAC
     void getUserRoles(const std::string &userId,
                       StringListCallback &&cb) override;
+    void invalidateUserRoles(const std::string &userId,
+                             VoidCallback &&cb) override;
 
   private:
     drogon::orm::DbClientPtr dbClientMaster_;
@@ -3,7 +3,10 @@
 #include <json/json.h>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 #include "plugins/OAuth2Metrics.h"
+#include "services/LogLevel.h"
 
 namespace oauth2
 {
@@ -26,6 +29,135 @@ static Json::Value parseJson(const std::string &jsonStr)
     return root;
 }
 
+static const std::string kClientKeyPrefix = "oauth2:client:";
+
+// HGETALL reply of oauth2:client:{id} -> record
+static OAuth2Client clientFromHash(const std::string &clientId,
+                                   const std::vector<RedisResult> &arr)
+{
+    OAuth2Client client;
+    client.clientId = clientId;
+    for (size_t i = 0; i + 1 < arr.size(); i += 2)
+    {
+        std::string key = arr[i].asString();
+        std::string val = arr[i + 1].asString();
+        if (key == "secret")
+            client.clientSecretHash = val;
+        else if (key == "salt")
+            client.salt = val;
+        else if (key == "redirect_uris")
+        {
+            auto json = parseJson(val);
+            if (json.isArray())
+            {
+                for (const auto &uri : json)
+                    client.redirectUris.push_back(uri.asString());
+            }
+        }
+        else if (key == "allowed_scopes")
+        {
+            auto json = parseJson(val);
+            if (json.isArray())
+            {
+                for (const auto &scope : json)
+                    client.allowedScopes.push_back(scope.asString());
+            }
+        }
+    }
+    return client;
+}
+
+namespace
+{
+
+// listClients in progress: one SCAN chain plus one HGETALL per client
+struct ClientListState
+{
+    explicit ClientListState(IOAuth2Storage::ClientListCallback &&cb)
+        : cb(std::move(cb))
+    {
+    }
+
+    void add(OAuth2Client client)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        clients.push_back(std::move(client));
+    }
+
+    // A failed read reports an empty list, like the other backends
+    void finish(bool ok = true)
+    {
+        if (!ok)
+            failed = true;
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        std::vector<OAuth2Client> result;
+        if (!failed)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            result = std::move(clients);
+        }
+        auto trace = timer.stop();
+        cb(std::move(result));
+    }
+
+    OperationTimer timer{StorageOp::kListClients, StorageBackend::kRedis};
+    std::atomic<size_t> pending{1};  // The SCAN chain
+    std::atomic<bool> failed{false};
+    std::mutex mutex;
+    std::vector<OAuth2Client> clients;
+    IOAuth2Storage::ClientListCallback cb;
+};
+
+void scanClients(const RedisClientPtr &redis,
+                 const std::string &cursor,
+                 std::shared_ptr<ClientListState> state)
+{
+    redis->execCommandAsync(
+        [redis, state](const RedisResult &result) {
+            if (result.type() != RedisResultType::kArray ||
+                result.asArray().size() != 2)
+            {
+                state->finish(false);
+                return;
+            }
+            auto reply = result.asArray();
+            for (const auto &key : reply[1].asArray())
+            {
+                auto clientId = key.asString().substr(kClientKeyPrefix.size());
+                state->pending.fetch_add(1, std::memory_order_relaxed);
+                redis->execCommandAsync(
+                    [state, clientId](const RedisResult &hash) {
+                        // Deleted since the SCAN: skip it
+                        if (hash.type() == RedisResultType::kArray &&
+                            !hash.asArray().empty())
+                            state->add(clientFromHash(clientId,
+                                                      hash.asArray()));
+                        state->finish();
+                    },
+                    [state](const RedisException &e) {
+                        LOG_ERROR << "Redis listClients error: " << e.what();
+                        state->finish(false);
+                    },
+                    "HGETALL %s",
+                    key.asString().c_str());
+            }
+            auto next = reply[0].asString();
+            if (next == "0")
+                state->finish();
+            else
+                scanClients(redis, next, state);
+        },
+        [state](const RedisException &e) {
+            LOG_ERROR << "Redis listClients SCAN error: " << e.what();
+            state->finish(false);
+        },
+        "SCAN %s MATCH oauth2:client:* COUNT 500",
+        cursor.c_str());
+}
+
+}  // namespace
+
 std::unique_ptr<IOAuth2Storage> createRedisStorage(const Json::Value &config)
 {
     std::string clientName = config.get("client_name", "default").asString();
@@ -42,49 +174,32 @@ void RedisOAuth2Storage::getClient(const std::string &clientId,
         return;
     }
     std::string cmd = "HGETALL oauth2:client:" + clientId;
-    auto timer = std::make_shared<OperationTimer>("getClient", "redis");
+    OperationTimer timer(StorageOp::kGetClient,
+                         StorageBackend::kRedis,
+                         clientId);
+    auto done = singleShot(std::move(cb));
     redisClient_->execCommandAsync(
-        [cb, clientId, timer](const RedisResult &result) {
+        [done, clientId, timer](const RedisResult &result) {
+            auto trace = timer.stop();
             if (result.type() == RedisResultType::kNil ||
                 result.type() != RedisResultType::kArray)
             {
-                cb(std::nullopt);
+                done(std::nullopt);
                 return;
             }
             auto arr = result.asArray();
             if (arr.empty())
             {
-                cb(std::nullopt);
+                done(std::nullopt);
                 return;
             }
 
-            OAuth2Client client;
-            client.clientId = clientId;
-            for (size_t i = 0; i < arr.size(); i += 2)
-            {
-                if (i + 1 >= arr.size())
-                    break;
-                std::string key = arr[i].asString();
-                std::string val = arr[i + 1].asString();
-                if (key == "secret")
-                    client.clientSecretHash = val;
-                else if (key == "salt")
-                    client.salt = val;
-                else if (key == "redirect_uris")
-                {
-                    auto json = parseJson(val);
-                    if (json.isArray())
-                    {
-                        for (const auto &uri : json)
-                            client.redirectUris.push_back(uri.asString());
-                    }
-                }
-            }
-            cb(client);
+            done(clientFromHash(clientId, arr));
         },
-        [cb](const RedisException &e) {
+        [done, timer](const RedisException &e) {
+            auto trace = timer.stop();
             LOG_ERROR << "Redis getClient error: " << e.what();
-            cb(std::nullopt);
+            done(std::nullopt);
         },
         cmd.c_str());
 }
@@ -99,34 +214,48 @@ void RedisOAuth2Storage::validateClient(const std::string &clientId,
         cb(false);
         return;
     }
-    LOG_DEBUG << "validateClient called for: " << clientId;
+    OAUTH2_LOG_DEBUG << "validateClient called for: " << clientId;
     if (clientSecret.empty())
     {
         std::string cmd = "EXISTS oauth2:client:" + clientId;
+        OperationTimer timer(StorageOp::kValidateClient,
+                             StorageBackend::kRedis,
+                             clientId);
+        auto done = singleShot(std::move(cb));
         redisClient_->execCommandAsync(
-            [cb](const RedisResult &result) { cb(result.asInteger() == 1); },
-            [cb](const RedisException &e) {
+            [done, timer](const RedisResult &result) {
+                auto trace = timer.stop();
+                done(result.asInteger() == 1);
+            },
+            [done, timer](const RedisException &e) {
+                auto trace = timer.stop();
                 LOG_ERROR << "Redis EXISTS error: " << e.what();
-                cb(false);
+                done(false);
             },
             cmd.c_str());
     }
     else
     {
         std::string cmd = "HMGET oauth2:client:" + clientId + " secret salt";
+        OperationTimer timer(StorageOp::kValidateClient,
+                             StorageBackend::kRedis,
+                             clientId);
+        auto done = singleShot(std::move(cb));
         redisClient_->execCommandAsync(
-            [cb, inputSecret = clientSecret](const RedisResult &result) {
-                LOG_DEBUG << "validateClient HMGET result received";
+            [done, inputSecret = clientSecret, timer](
+                const RedisResult &result) {
+                auto trace = timer.stop();
+                OAUTH2_LOG_DEBUG << "validateClient HMGET result received";
                 if (result.type() == RedisResultType::kNil ||
                     result.type() != RedisResultType::kArray)
                 {
-                    cb(false);
+                    done(false);
                     return;
                 }
                 auto arr = result.asArray();
                 if (arr.size() < 2)
                 {
-                    cb(false);
+                    done(false);
                     return;
                 }
 
@@ -146,18 +275,33 @@ void RedisOAuth2Storage::validateClient(const std::string &clientId,
                                storedHash.begin(),
                                ::tolower);
 
-                LOG_DEBUG << "validateClient match result: "
-                          << (calculatedHash == storedHash);
-                cb(calculatedHash == storedHash);
+                OAUTH2_LOG_DEBUG << "validateClient match result: "
+                                 << (calculatedHash == storedHash);
+                done(calculatedHash == storedHash);
             },
-            [cb](const RedisException &e) {
+            [done, timer](const RedisException &e) {
+                auto trace = timer.stop();
                 LOG_ERROR << "Redis validateClient HMGET error: " << e.what();
-                cb(false);
+                done(false);
             },
             cmd.c_str());
     }
 }
 
+void RedisOAuth2Storage::listClients(ClientListCallback &&cb)
+{
+    if (!redisClient_)
+    {
+        LOG_ERROR << "Redis client is not initialized!";
+        cb({});
+        return;
+    }
+    // SCAN, not KEYS: it does not block Redis on a large keyspace
+    scanClients(redisClient_,
+                "0",
+                std::make_shared<ClientListState>(std::move(cb)));
+}
+
 void RedisOAuth2Storage::saveAuthCode(const OAuth2AuthCode &code,
                                       VoidCallback &&cb)
 {
@@ -168,7 +312,7 @@ void RedisOAuth2Storage::saveAuthCode(const OAuth2AuthCode &code,
         return;
     }
     Json::Value val;
-    val["client_id"] = code.clientId;
+    val["client_id"] = code.clientId.str();
     val["user_id"] = code.userId;
     val["scope"] = code.scope;
     val["redirect_uri"] = code.redirectUri;
@@ -187,21 +331,25 @@ void RedisOAuth2Storage::saveAuthCode(const OAuth2AuthCode &code,
     std::string key = "oauth2:code:" + code.code;
     std::string ttlStr = std::to_string(ttl);
 
-    LOG_DEBUG << "saveAuthCode CMD: SETEX " << key << " " << ttlStr << " "
-              << jsonStr;
+    OAUTH2_LOG_DEBUG << "saveAuthCode CMD: SETEX " << key << " " << ttlStr
+                     << " " << jsonStr;
 
+    OperationTimer timer(StorageOp::kSaveAuthCode,
+                         StorageBackend::kRedis,
+                         code.code);
+    auto done = singleShot(std::move(cb));
     redisClient_->execCommandAsync(
-        [cb, codeStr = code.code](const RedisResult &result) {
-            LOG_DEBUG << "saveAuthCode SUCCESS for: " << codeStr
-                      << " Result: " << result.asString();
-            if (cb)
-                cb();
+        [done, codeStr = code.code, timer](const RedisResult &result) {
+            auto trace = timer.stop();
+            OAUTH2_LOG_DEBUG << "saveAuthCode SUCCESS for: " << codeStr
+                             << " Result: " << result.asString();
+            done();
         },
-        [cb, codeStr = code.code](const RedisException &e) {
+        [done, codeStr = code.code, timer](const RedisException &e) {
+            auto trace = timer.stop();
             LOG_ERROR << "saveAuthCode ERROR for: " << codeStr
                       << " Error: " << e.what();
-            if (cb)
-                cb();
+            done();
         },
         "SETEX %s %s %s",
         key.c_str(),
@@ -212,30 +360,34 @@ void RedisOAuth2Storage::saveAuthCode(const OAuth2AuthCode &code,
 void RedisOAuth2Storage::getAuthCode(const std::string &code,
                                      AuthCodeCallback &&cb)
 {
-    if (!redisClient_)
+    // Longer than anything we issue: it cannot be stored as a TokenValue
+    if (!redisClient_ || !TokenValue::fits(code))
     {
         cb(std::nullopt);
         return;
     }
     std::string key = "oauth2:code:" + code;
-    LOG_DEBUG << "getAuthCode CMD: GET " << key;
+    OAUTH2_LOG_DEBUG << "getAuthCode CMD: GET " << key;
 
+    OperationTimer timer(StorageOp::kGetAuthCode, StorageBackend::kRedis, code);
+    auto done = singleShot(std::move(cb));
     redisClient_->execCommandAsync(
-        [cb, codeStr = code](const RedisResult &result) {
+        [done, codeStr = code, timer](const RedisResult &result) {
+            auto trace = timer.stop();
             if (result.type() == RedisResultType::kNil)
             {
                 LOG_WARN << "getAuthCode: Key not found for: " << codeStr;
-                cb(std::nullopt);
+                done(std::nullopt);
                 return;
             }
             std::string jsonStr = result.asString();
-            LOG_DEBUG << "getAuthCode Result: " << jsonStr;
+            OAUTH2_LOG_DEBUG << "getAuthCode Result: " << jsonStr;
 
             auto json = parseJson(jsonStr);
             if (json.isNull())
             {
                 LOG_ERROR << "getAuthCode: Failed to parse JSON";
-                cb(std::nullopt);
+                done(std::nullopt);
                 return;
             }
 
@@ -247,12 +399,13 @@ void RedisOAuth2Storage::getAuthCode(const std::string &code,
             authCode.redirectUri = json["redirect_uri"].asString();
             authCode.expiresAt = json["expires_at"].asInt64();
             authCode.used = json["used"].asBool();
-            cb(authCode);
+            done(authCode);
         },
-        [cb, codeStr = code](const RedisException &e) {
+        [done, codeStr = code, timer](const RedisException &e) {
+            auto trace = timer.stop();
             LOG_ERROR << "getAuthCode ERROR for: " << codeStr
                       << " Error: " << e.what();
-            cb(std::nullopt);
+            done(std::nullopt);
         },
         "GET %s",
         key.c_str());
@@ -287,14 +440,18 @@ void RedisOAuth2Storage::markAuthCodeUsed(const std::string &code,
         return 1
     )";
 
+    OperationTimer timer(StorageOp::kMarkAuthCodeUsed,
+                         StorageBackend::kRedis,
+                         code);
+    auto done = singleShot(std::move(cb));
     redisClient_->execCommandAsync(
-        [cb](const RedisResult &) {
-            if (cb)
-                cb();
+        [done, timer](const RedisResult &) {
+            auto trace = timer.stop();
+            done();
         },
-        [cb](const RedisException &) {
-            if (cb)
-                cb();
+        [done, timer](const RedisException &) {
+            auto trace = timer.stop();
+            done();
         },
         "EVAL %s 1 %s",
         script.c_str(),
@@ -304,7 +461,7 @@ void RedisOAuth2Storage::markAuthCodeUsed(const std::string &code,
 void RedisOAuth2Storage::consumeAuthCode(const std::string &code,
                                          AuthCodeCallback &&cb)
 {
-    if (!redisClient_)
+    if (!redisClient_ || !TokenValue::fits(code))
     {
         cb(std::nullopt);
         return;
@@ -328,11 +485,16 @@ void RedisOAuth2Storage::consumeAuthCode(const std::string &code,
         return newVal
     )";
 
+    OperationTimer timer(StorageOp::kConsumeAuthCode,
+                         StorageBackend::kRedis,
+                         code);
+    auto done = singleShot(std::move(cb));
     redisClient_->execCommandAsync(
-        [cb, codeStr = code](const RedisResult &result) {
+        [done, codeStr = code, timer](const RedisResult &result) {
+            auto trace = timer.stop();
             if (result.type() == RedisResultType::kNil)
             {
-                cb(std::nullopt);
+                done(std::nullopt);
                 return;
             }
             std::string jsonStr = result.asString();
@@ -342,7 +504,7 @@ void RedisOAuth2Storage::consumeAuthCode(const std::string &code,
             if (json.isNull())
             {
                 LOG_ERROR << "consumeAuthCode: Failed to parse JSON result";
-                cb(std::nullopt);
+                done(std::nullopt);
                 return;
             }
 
@@ -355,11 +517,12 @@ void RedisOAuth2Storage::consumeAuthCode(const std::string &code,
             authCode.expiresAt = json["expires_at"].asInt64();
             authCode.used = true;  // We just marked it
 
-            cb(authCode);
+            done(authCode);
         },
-        [cb](const RedisException &e) {
+        [done, timer](const RedisException &e) {
+            auto trace = timer.stop();
             LOG_ERROR << "consumeAuthCode Redis Error: " << e.what();
-            cb(std::nullopt);
+            done(std::nullopt);
         },
         "EVAL %s 1 %s",
         script.c_str(),
@@ -376,11 +539,18 @@ void RedisOAuth2Storage::saveAccessToken(const OAuth2AccessToken &token,
         return;
     }
     Json::Value val;
-    val["client_id"] = token.clientId;
+    val["client_id"] = token.clientId.str();
     val["user_id"] = token.userId;
     val["scope"] = token.scope;
     val["expires_at"] = (Json::Int64)token.expiresAt;
     val["revoked"] = token.revoked;
+    if (token.roleIds)
+    {
+        Json::Value ids(Json::arrayValue);
+        for (auto id : *token.roleIds)
+            ids.append(id);
+        val["role_ids"] = ids;
+    }
     Json::FastWriter writer;
     std::string jsonStr = writer.write(val);
 
@@ -392,56 +562,90 @@ void RedisOAuth2Storage::saveAccessToken(const OAuth2AccessToken &token,
         (token.expiresAt > (int64_t)nowSec) ? (token.expiresAt - nowSec) : 1;
 
     std::string key = "oauth2:token:" + token.token;
+    std::string indexKey = "oauth2:user_tokens:" + token.userId;
     std::string ttlStr = std::to_string(ttl);
 
+    // Store the token and index it under its user, so invalidateUserRoles()
+    // can find every token carrying a role snapshot. The index lives as long
+    // as the longest-lived token in it.
+    std::string script = R"(
+        redis.call('SETEX', KEYS[1], ARGV[2], ARGV[1])
+        redis.call('SADD', KEYS[2], KEYS[1])
+        if redis.call('TTL', KEYS[2]) < tonumber(ARGV[2]) then
+            redis.call('EXPIRE', KEYS[2], ARGV[2])
+        end
+        return 1
+    )";
+
+    OperationTimer timer(StorageOp::kSaveAccessToken,
+                         StorageBackend::kRedis,
+                         token.token);
+    auto done = singleShot(std::move(cb));
     redisClient_->execCommandAsync(
-        [cb](const RedisResult &) {
-            if (cb)
-                cb();
+        [done, timer](const RedisResult &) {
+            auto trace = timer.stop();
+            done();
         },
-        [cb](const RedisException &) {
-            if (cb)
-                cb();
+        [done, timer](const RedisException &) {
+            auto trace = timer.stop();
+            done();
         },
-        "SETEX %s %s %s",
+        "EVAL %s 2 %s %s %s %s",
+        script.c_str(),
         key.c_str(),
-        ttlStr.c_str(),
-        jsonStr.c_str());
+        indexKey.c_str(),
+        jsonStr.c_str(),
+        ttlStr.c_str());
 }
 
 void RedisOAuth2Storage::getAccessToken(const std::string &token,
                                         AccessTokenCallback &&cb)
 {
-    if (!redisClient_)
+    if (!redisClient_ || !TokenValue::fits(token))
     {
-        cb(std::nullopt);
+        cb(nullptr);
         return;
     }
     std::string key = "oauth2:token:" + token;
+    OperationTimer timer(StorageOp::kGetAccessToken,
+                         StorageBackend::kRedis,
+                         token);
+    auto done = singleShot(std::move(cb));
     redisClient_->execCommandAsync(
-        [cb, tokenStr = token](const RedisResult &result) {
+        [done, tokenStr = token, timer](const RedisResult &result) {
+            auto trace = timer.stop();
             if (result.type() == RedisResultType::kNil)
             {
-                cb(std::nullopt);
+                done(nullptr);
                 return;
             }
             std::string jsonStr = result.asString();
             auto json = parseJson(jsonStr);
             if (json.isNull())
             {
-                cb(std::nullopt);
+                done(nullptr);
                 return;
             }
-            OAuth2AccessToken accessToken;
-            accessToken.token = tokenStr;
-            accessToken.clientId = json["client_id"].asString();
-            accessToken.userId = json["user_id"].asString();
-            accessToken.scope = json["scope"].asString();
-            accessToken.expiresAt = json["expires_at"].asInt64();
-            accessToken.revoked = json["revoked"].asBool();
-            cb(accessToken);
+            auto accessToken = std::make_shared<OAuth2AccessToken>();
+            accessToken->token = tokenStr;
+            accessToken->clientId = json["client_id"].asString();
+            accessToken->userId = json["user_id"].asString();
+            accessToken->scope = json["scope"].asString();
+            accessToken->expiresAt = json["expires_at"].asInt64();
+            accessToken->revoked = json["revoked"].asBool();
+            if (json["role_ids"].isArray())
+            {
+                std::vector<int32_t> ids;
+                for (const auto &id : json["role_ids"])
+                    ids.push_back(id.asInt());
+                accessToken->roleIds = std::move(ids);
+            }
+            done(std::move(accessToken));
+        },
+        [done, timer](const RedisException &) {
+            auto trace = timer.stop();
+            done(nullptr);
         },
-        [cb](const RedisException &) { cb(std::nullopt); },
         "GET %s",
         key.c_str());
 }
@@ -449,6 +653,10 @@ void RedisOAuth2Storage::getAccessToken(const std::string &token,
 void RedisOAuth2Storage::saveRefreshToken(const OAuth2RefreshToken &token,
                                           VoidCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kSaveRefreshToken,
+                               StorageBackend::kRedis,
+                               token.token);
+    timer.stop();
     if (cb)
         cb();
 }
@@ -456,6 +664,10 @@ void RedisOAuth2Storage::saveRefreshToken(const OAuth2RefreshToken &token,
 void RedisOAuth2Storage::getRefreshToken(const std::string &token,
                                          RefreshTokenCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kGetRefreshToken,
+                               StorageBackend::kRedis,
+                               token);
+    timer.stop();
     if (cb)
         cb(std::nullopt);
 }
@@ -463,14 +675,71 @@ void RedisOAuth2Storage::getRefreshToken(const std::string &token,
 // Redis handles expiration via TTL automatically.
 void RedisOAuth2Storage::deleteExpiredData()
 {
-    LOG_DEBUG << "Redis deleteExpiredData called (No-op, relying on Redis TTL)";
+    ScopedOperationTimer timer(StorageOp::kDeleteExpiredData,
+                               StorageBackend::kRedis);
+    OAUTH2_LOG_DEBUG
+        << "Redis deleteExpiredData called (No-op, relying on Redis TTL)";
 }
 
 void RedisOAuth2Storage::getUserRoles(const std::string &userId,
                                       StringListCallback &&cb)
 {
+    ScopedOperationTimer timer(StorageOp::kGetUserRoles,
+                               StorageBackend::kRedis,
+                               userId);
     // Default role for redis (until we implement role storage in redis)
+    timer.stop();
     cb({"user"});
 }
 
+void RedisOAuth2Storage::invalidateUserRoles(const std::string &userId,
+                                             VoidCallback &&cb)
+{
+    if (!redisClient_)
+    {
+        if (cb)
+            cb();
+        return;
+    }
+    std::string indexKey = "oauth2:user_tokens:" + userId;
+
+    // Strip role_ids from every indexed token, keeping its remaining TTL.
+    std::string script = R"(
+        local keys = redis.call('SMEMBERS', KEYS[1])
+        for _, key in ipairs(keys) do
+            local val = redis.call('GET', key)
+            if val then
+                local json = cjson.decode(val)
+                json.role_ids = nil
+                local ttl = redis.call('TTL', key)
+                if ttl > 0 then
+                    redis.call('SETEX', key, ttl, cjson.encode(json))
+                end
+            end
+        end
+        redis.call('DEL', KEYS[1])
+        return #keys
+    )";
+
+    OperationTimer timer(StorageOp::kInvalidateUserRoles,
+                         StorageBackend::kRedis,
+                         userId);
+    auto done = singleShot(std::move(cb));
+    redisClient_->execCommandAsync(
+        [done, userId, timer](const RedisResult &result) {
+            auto trace = timer.stop();
+            LOG_INFO << "Invalidated role snapshot of " << result.asInteger()
+                     << " access tokens for user " << userId;
+            done();
+        },
+        [done, timer](const RedisException &e) {
+            auto trace = timer.stop();
+            LOG_ERROR << "invalidateUserRoles Redis Error: " << e.what();
+            done();
+        },
+        "EVAL %s 1 %s",
+        script.c_str(),
+        indexKey.c_str());
+}
+
 }  // namespace oauth2
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "IOAuth2Storage.h"
+#include "../services/LogLevel.h"
 #include <drogon/drogon.h>
 
 namespace oauth2
@@ -15,8 +16,8 @@ class RedisOAuth2Storage : public IOAuth2Storage
         if (redisClient_)
         {
             redisClient_->setTimeout(3.0);
-            LOG_DEBUG << "RedisOAuth2Storage initialized with client: "
-                      << redisClientName;
+            OAUTH2_LOG_DEBUG << "RedisOAuth2Storage initialized with client: "
+                             << redisClientName;
         }
         else
         {
@@ -30,6 +31,7 @@ class RedisOAuth2Storage : public IOAuth2Storage
     void validateClient(const std::string &clientId,
                         const std::string &clientSecret,
                         BoolCallback &&cb) override;
+    void listClients(ClientListCallback &&cb) override;
 
     // Authorization Code Operations
     void saveAuthCode(const OAuth2AuthCode &code, VoidCallback &&cb) override;
@@ -56,6 +58,8 @@ class RedisOAuth2Storage : public IOAuth2Storage
     // RBAC
     void getUserRoles(const std::string &userId,
                       StringListCallback &&cb) override;
+    void invalidateUserRoles(const std::string &userId,
+                             VoidCallback &&cb) override;
 
   private:
     drogon::nosql::RedisClientPtr redisClient_;
@@ -0,0 +1,109 @@
+#include "Symbol.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace oauth2
+{
+
+namespace
+{
+
+// Strings live in fixed-size chunks that are never moved or freed, so a
+// reader only needs the chunk pointer (published with release/acquire)
+// and no lock. Writers serialize on the index mutex.
+class SymbolTable
+{
+  public:
+    static constexpr uint32_t kChunkBits = 12;
+    static constexpr uint32_t kChunkSize = 1u << kChunkBits;
+    static constexpr uint32_t kMaxChunks = 4096;  // 16M symbols
+
+    static SymbolTable &instance()
+    {
+        static SymbolTable table;
+        return table;
+    }
+
+    uint32_t intern(std::string_view s)
+    {
+        if (s.empty())
+            return 0;
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            auto it = index_.find(s);
+            if (it != index_.end())
+                return it->second;
+        }
+
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto it = index_.find(s);
+        if (it != index_.end())
+            return it->second;
+
+        uint32_t id = size_.load(std::memory_order_relaxed);
+        uint32_t chunk = id >> kChunkBits;
+        if (chunk >= kMaxChunks)
+            throw std::length_error("Symbol table full");
+        auto *strings = chunks_[chunk].load(std::memory_order_relaxed);
+        if (!strings)
+        {
+            strings = new std::string[kChunkSize];
+            chunks_[chunk].store(strings, std::memory_order_release);
+        }
+        auto &slot = strings[id & (kChunkSize - 1)];
+        slot.assign(s.data(), s.size());
+        index_.emplace(std::string_view(slot), id);
+        size_.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    const std::string &lookup(uint32_t id) const
+    {
+        auto *strings =
+            chunks_[id >> kChunkBits].load(std::memory_order_acquire);
+        return strings[id & (kChunkSize - 1)];
+    }
+
+    size_t size() const
+    {
+        return size_.load(std::memory_order_acquire);
+    }
+
+  private:
+    SymbolTable()
+    {
+        for (auto &c : chunks_)
+            c.store(nullptr, std::memory_order_relaxed);
+        auto *first = new std::string[kChunkSize];  // id 0 = ""
+        chunks_[0].store(first, std::memory_order_release);
+        size_.store(1, std::memory_order_release);
+    }
+
+    std::array<std::atomic<std::string *>, kMaxChunks> chunks_;
+    std::atomic<uint32_t> size_{0};
+    std::shared_mutex mutex_;
+    std::unordered_map<std::string_view, uint32_t> index_;
+};
+
+}  // namespace
+
+Symbol::Symbol(std::string_view s) : id_(SymbolTable::instance().intern(s))
+{
+}
+
+const std::string &Symbol::str() const
+{
+    return SymbolTable::instance().lookup(id_);
+}
+
+size_t Symbol::tableSize()
+{
+    return SymbolTable::instance().size();
+}
+
+}  // namespace oauth2
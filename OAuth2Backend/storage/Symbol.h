@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace oauth2
+{
+
+/**
+ * @brief Interned string handle (4 bytes)
+ *
+ * Client IDs repeat across every token a client holds. A Symbol stores
+ * them once in a process-wide, append-only table and refers to them by ID,
+ * so copying or comparing one is an integer operation and str() is a
+ * lock-free array read.
+ *
+ * The table never shrinks: only intern values from a small, bounded
+ * domain that requests cannot grow (registered, already checked client
+ * IDs). Never intern user IDs, request parameters or token values.
+ */
+class Symbol
+{
+  public:
+    Symbol() = default;  // ""
+    Symbol(std::string_view s);
+    Symbol(const std::string &s) : Symbol(std::string_view(s))
+    {
+    }
+    Symbol(const char *s) : Symbol(std::string_view(s))
+    {
+    }
+
+    const std::string &str() const;
+    operator const std::string &() const
+    {
+        return str();
+    }
+
+    uint32_t id() const
+    {
+        return id_;
+    }
+    bool empty() const
+    {
+        return id_ == 0;
+    }
+
+    friend bool operator==(Symbol a, Symbol b)
+    {
+        return a.id_ == b.id_;
+    }
+    friend bool operator!=(Symbol a, Symbol b)
+    {
+        return a.id_ != b.id_;
+    }
+    // Comparing with plain strings never interns the other side
+    friend bool operator==(Symbol a, const std::string &b)
+    {
+        return a.str() == b;
+    }
+    friend bool operator==(const std::string &a, Symbol b)
+    {
+        return b == a;
+    }
+    friend bool operator!=(Symbol a, const std::string &b)
+    {
+        return !(a == b);
+    }
+    friend bool operator!=(const std::string &a, Symbol b)
+    {
+        return !(b == a);
+    }
+    friend bool operator==(Symbol a, const char *b)
+    {
+        return a.str() == b;
+    }
+    friend bool operator!=(Symbol a, const char *b)
+    {
+        return !(a == b);
+    }
+
+    /**
+     * @brief Number of interned strings (including "")
+     */
+    static size_t tableSize();
+
+  private:
+    uint32_t id_{0};
+};
+
+inline std::ostream &operator<<(std::ostream &os, Symbol s)
+{
+    return os << s.str();
+}
+
+}  // namespace oauth2
+
+namespace std
+{
+template <>
+struct hash<oauth2::Symbol>
+{
+    size_t operator()(oauth2::Symbol s) const noexcept
+    {
+        return std::hash<uint32_t>()(s.id());
+    }
+};
+}  // namespace std
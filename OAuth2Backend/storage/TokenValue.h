@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace oauth2
+{
+
+/**
+ * @brief Token value stored inline (48 bytes, no heap)
+ *
+ * Codes and tokens are generated by the plugin as 32-char UUIDs, so a
+ * fixed inline buffer holds them without the separate heap block a
+ * std::string needs past its SSO limit. Values longer than kCapacity
+ * cannot be represented: check fits() on untrusted input, the constructor
+ * throws std::length_error.
+ */
+class TokenValue
+{
+  public:
+    static constexpr size_t kCapacity = 46;
+
+    TokenValue() = default;
+    TokenValue(std::string_view s)
+    {
+        if (s.size() > kCapacity)
+            throw std::length_error("TokenValue: value too long");
+        std::memcpy(data_, s.data(), s.size());
+        data_[s.size()] = '\0';
+        size_ = static_cast<uint8_t>(s.size());
+    }
+    TokenValue(const std::string &s) : TokenValue(std::string_view(s))
+    {
+    }
+    TokenValue(const char *s) : TokenValue(std::string_view(s))
+    {
+    }
+
+    static bool fits(std::string_view s)
+    {
+        return s.size() <= kCapacity;
+    }
+
+    std::string_view view() const
+    {
+        return std::string_view(data_, size_);
+    }
+    operator std::string_view() const
+    {
+        return view();
+    }
+    std::string str() const
+    {
+        return std::string(data_, size_);
+    }
+    const char *c_str() const
+    {
+        return data_;
+    }
+    size_t size() const
+    {
+        return size_;
+    }
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    friend bool operator==(const TokenValue &a, const TokenValue &b)
+    {
+        return a.view() == b.view();
+    }
+    friend bool operator!=(const TokenValue &a, const TokenValue &b)
+    {
+        return !(a == b);
+    }
+    friend bool operator==(const TokenValue &a, const std::string &b)
+    {
+        return a.view() == b;
+    }
+    friend bool operator==(const std::string &a, const TokenValue &b)
+    {
+        return b == a;
+    }
+    friend bool operator!=(const TokenValue &a, const std::string &b)
+    {
+        return !(a == b);
+    }
+    friend bool operator!=(const std::string &a, const TokenValue &b)
+    {
+        return !(b == a);
+    }
+    friend bool operator==(const TokenValue &a, const char *b)
+    {
+        return a.view() == b;
+    }
+    friend bool operator!=(const TokenValue &a, const char *b)
+    {
+        return !(a == b);
+    }
+
+  private:
+    char data_[kCapacity + 1]{};  // NUL-terminated for c_str()
+    uint8_t size_{0};
+};
+
+static_assert(sizeof(TokenValue) == 48, "TokenValue should stay compact");
+
+inline std::ostream &operator<<(std::ostream &os, const TokenValue &t)
+{
+    return os << t.view();
+}
+
+inline std::string operator+(const std::string &a, const TokenValue &b)
+{
+    std::string out;
+    out.reserve(a.size() + b.size());
+    out.append(a).append(b.view());
+    return out;
+}
+
+}  // namespace oauth2
+
+namespace std
+{
+template <>
+struct hash<oauth2::TokenValue>
+{
+    size_t operator()(const oauth2::TokenValue &t) const noexcept
+    {
+        return std::hash<std::string_view>()(t.view());
+    }
+};
+}  // namespace std
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace oauth2
+{
+
+template <typename Signature>
+class UniqueFunction;
+
+/**
+ * @brief Move-only std::function replacement for storage callbacks
+ *
+ * Callables of up to kInlineSize bytes (nothrow-movable) live inside the
+ * object, so the usual storage callback (a lambda holding the caller's
+ * std::function plus a few values) costs no allocation; std::function's
+ * buffer holds 16 bytes. Larger callables go to the heap. Being
+ * move-only, it also accepts lambdas that capture move-only state.
+ *
+ * Constructing from an empty std::function or a null pointer gives an
+ * empty UniqueFunction, so `if (cb)` keeps its meaning.
+ */
+template <typename R, typename... Args>
+class UniqueFunction<R(Args...)>
+{
+  public:
+    static constexpr size_t kInlineSize = 64;
+
+    UniqueFunction() noexcept = default;
+    UniqueFunction(std::nullptr_t) noexcept
+    {
+    }
+
+    template <typename F,
+              typename Fn = std::decay_t<F>,
+              typename = std::enable_if_t<
+                  !std::is_same_v<Fn, UniqueFunction> &&
+                  std::is_invocable_r_v<R, Fn &, Args...>>>
+    UniqueFunction(F &&f)
+    {
+        if constexpr (std::is_constructible_v<bool, const Fn &>)
+        {
+            if (!static_cast<bool>(f))
+                return;
+        }
+        if constexpr (fitsInline<Fn>())
+        {
+            ::new (static_cast<void *>(buffer_)) Fn(std::forward<F>(f));
+            ops_ = &kInlineOps<Fn>;
+        }
+        else
+        {
+            *reinterpret_cast<Fn **>(buffer_) = new Fn(std::forward<F>(f));
+            ops_ = &kHeapOps<Fn>;
+        }
+    }
+
+    UniqueFunction(UniqueFunction &&other) noexcept
+    {
+        moveFrom(other);
+    }
+
+    UniqueFunction &operator=(UniqueFunction &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    UniqueFunction &operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    UniqueFunction(const UniqueFunction &) = delete;
+    UniqueFunction &operator=(const UniqueFunction &) = delete;
+
+    ~UniqueFunction()
+    {
+        reset();
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return ops_ != nullptr;
+    }
+
+    // const like std::function's: the target itself may be mutable
+    R operator()(Args... args) const
+    {
+        return ops_->invoke(buffer_, std::forward<Args>(args)...);
+    }
+
+  private:
+    struct Ops
+    {
+        R (*invoke)(void *, Args &&...);
+        void (*move)(void *from, void *to) noexcept;
+        void (*destroy)(void *) noexcept;
+    };
+
+    template <typename Fn>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(Fn) <= kInlineSize &&
+               alignof(Fn) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible_v<Fn>;
+    }
+
+    template <typename Fn>
+    static constexpr Ops kInlineOps{
+        [](void *p, Args &&...args) -> R {
+            return (*static_cast<Fn *>(p))(std::forward<Args>(args)...);
+        },
+        [](void *from, void *to) noexcept {
+            ::new (to) Fn(std::move(*static_cast<Fn *>(from)));
+            static_cast<Fn *>(from)->~Fn();
+        },
+        [](void *p) noexcept { static_cast<Fn *>(p)->~Fn(); }};
+
+    template <typename Fn>
+    static constexpr Ops kHeapOps{
+        [](void *p, Args &&...args) -> R {
+            return (**static_cast<Fn **>(p))(std::forward<Args>(args)...);
+        },
+        [](void *from, void *to) noexcept {
+            *static_cast<Fn **>(to) = *static_cast<Fn **>(from);
+        },
+        [](void *p) noexcept { delete *static_cast<Fn **>(p); }};
+
+    void moveFrom(UniqueFunction &other) noexcept
+    {
+        if (!other.ops_)
+            return;
+        other.ops_->move(other.buffer_, buffer_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+    }
+
+    void reset() noexcept
+    {
+        if (ops_)
+        {
+            ops_->destroy(buffer_);
+            ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) mutable unsigned char buffer_[kInlineSize];
+    const Ops *ops_{nullptr};
+};
+
+/**
+ * @brief Copyable handle that runs a callback at most once
+ *
+ * For APIs with separate success and error continuations (drogon's
+ * execSqlAsync, Mapper, RedisClient), which must be copyable: both
+ * capture the same handle and the first to run consumes the callback, so
+ * the caller sees exactly one invocation whichever path fires. An empty
+ * callback is simply consumed.
+ */
+template <typename Signature>
+class SingleShot;
+
+template <typename... Args>
+class SingleShot<void(Args...)>
+{
+  public:
+    explicit SingleShot(UniqueFunction<void(Args...)> &&cb)
+        : state_(std::make_shared<State>(std::move(cb)))
+    {
+    }
+
+    void operator()(Args... args) const
+    {
+        if (state_->done.exchange(true, std::memory_order_acq_rel))
+            return;
+        auto cb = std::move(state_->cb);
+        if (cb)
+            cb(std::forward<Args>(args)...);
+    }
+
+  private:
+    struct State
+    {
+        explicit State(UniqueFunction<void(Args...)> &&cb) : cb(std::move(cb))
+        {
+        }
+        UniqueFunction<void(Args...)> cb;
+        std::atomic<bool> done{false};
+    };
+    std::shared_ptr<State> state_;
+};
+
+template <typename... Args>
+SingleShot<void(Args...)> singleShot(UniqueFunction<void(Args...)> &&cb)
+{
+    return SingleShot<void(Args...)>(std::move(cb));
+}
+
+}  // namespace oauth2
@@ -35,9 +35,9 @@ DROGON_TEST(AdvancedStorageTest)
         pSave.get_future().get();
 
         // Validate via Plugin
-        std::promise<std::shared_ptr<OAuth2AccessToken>> pVal;
+        std::promise<AccessTokenPtr> pVal;
         plugin->validateAccessToken("revoked_token_123",
-                                    [&](std::shared_ptr<OAuth2AccessToken> t) {
+                                    [&](AccessTokenPtr t) {
                                         pVal.set_value(t);
                                     });
         auto t = pVal.get_future().get();
@@ -62,9 +62,9 @@ DROGON_TEST(AdvancedStorageTest)
         pSave.get_future().get();
 
         // Validate via Plugin
-        std::promise<std::shared_ptr<OAuth2AccessToken>> pVal;
+        std::promise<AccessTokenPtr> pVal;
         plugin->validateAccessToken("expired_token_123",
-                                    [&](std::shared_ptr<OAuth2AccessToken> t) {
+                                    [&](AccessTokenPtr t) {
                                         pVal.set_value(t);
                                     });
         auto t = pVal.get_future().get();
@@ -87,9 +87,9 @@ DROGON_TEST(AdvancedStorageTest)
         storage->saveAccessToken(validToken, [&]() { pSave.set_value(); });
         pSave.get_future().get();
 
-        std::promise<std::shared_ptr<OAuth2AccessToken>> pVal;
+        std::promise<AccessTokenPtr> pVal;
         plugin->validateAccessToken("valid_token_123",
-                                    [&](std::shared_ptr<OAuth2AccessToken> t) {
+                                    [&](AccessTokenPtr t) {
                                         pVal.set_value(t);
                                     });
         auto t = pVal.get_future().get();
@@ -118,9 +118,9 @@ DROGON_TEST(AdvancedStorageTest)
         storage->deleteExpiredData();
 
         // Verify via validation (Should definitely be gone)
-        std::promise<std::shared_ptr<OAuth2AccessToken>> pVal;
+        std::promise<AccessTokenPtr> pVal;
         plugin->validateAccessToken("expired_token_456",
-                                    [&](std::shared_ptr<OAuth2AccessToken> t) {
+                                    [&](AccessTokenPtr t) {
                                         pVal.set_value(t);
                                     });
         auto t = pVal.get_future().get();
@@ -0,0 +1,60 @@
+#include <drogon/drogon_test.h>
+#include "AsyncJoin.h"
+#include <optional>
+#include <vector>
+
+using namespace oauth2;
+
+DROGON_TEST(AsyncJoinTest)
+{
+    // 1. Completes once, after the last branch, whatever the order
+    {
+        std::vector<JoinBranch> pending;
+        int calls = 0;
+        std::optional<bool> result;
+        joinAll(
+            [&](bool ok) {
+                ++calls;
+                result = ok;
+            },
+            [&](JoinBranch done) { pending.push_back(done); },
+            [&](JoinBranch done) { pending.push_back(done); },
+            [&](JoinBranch done) { done(); });  // Synchronous branch
+        REQUIRE(pending.size() == 2);
+        pending[1]();
+        CHECK(calls == 0);
+        pending[0]();
+        CHECK(calls == 1);
+        CHECK(result == true);
+    }
+
+    // 2. The first failure completes it; later reports are ignored
+    {
+        std::vector<JoinBranch> pending;
+        int calls = 0;
+        std::optional<bool> result;
+        joinAll(
+            [&](bool ok) {
+                ++calls;
+                result = ok;
+            },
+            [&](JoinBranch done) { pending.push_back(done); },
+            [&](JoinBranch done) { pending.push_back(done); });
+        pending[0](false);
+        CHECK(calls == 1);
+        CHECK(result == false);
+        pending[1]();
+        CHECK(calls == 1);
+    }
+
+    // 3. After a synchronous failure the remaining branches don't start
+    {
+        bool started = false;
+        std::optional<bool> result;
+        joinAll([&](bool ok) { result = ok; },
+                [](JoinBranch done) { done(false); },
+                [&](JoinBranch) { started = true; });
+        CHECK(result == false);
+        CHECK(started == false);
+    }
+}
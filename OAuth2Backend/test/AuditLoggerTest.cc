@@ -0,0 +1,136 @@
+#include <drogon/drogon_test.h>
+#include "AuditLogger.h"
+#include "MpscQueue.h"
+#include <json/json.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace oauth2;
+
+DROGON_TEST(MpscQueueTest)
+{
+    // 1. Bounded: push fails when full, capacity rounds up
+    MpscQueue<int> small(3);
+    CHECK(small.capacity() == 4);
+    for (int i = 0; i < 4; ++i)
+        CHECK(small.push(i));
+    CHECK(!small.push(4));
+    int v = -1;
+    REQUIRE(small.pop(v));
+    CHECK(v == 0);
+    CHECK(small.push(4));  // Slot reused after pop
+
+    // 2. Several producers, one consumer: nothing lost or duplicated
+    MpscQueue<uint64_t> queue(1024);
+    constexpr uint64_t kPerThread = 20000;
+    constexpr int kThreads = 4;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        producers.emplace_back([&queue, t]() {
+            for (uint64_t i = 0; i < kPerThread; ++i)
+            {
+                while (!queue.push(t * kPerThread + i))
+                    std::this_thread::yield();
+            }
+        });
+    }
+    std::vector<uint64_t> lastSeen(kThreads, 0);
+    uint64_t received = 0, sum = 0;
+    bool ordered = true;
+    while (received < kPerThread * kThreads)
+    {
+        uint64_t item;
+        if (!queue.pop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        auto producer = item / kPerThread;
+        // FIFO per producer
+        if (item % kPerThread + 1 <= lastSeen[producer] &&
+            lastSeen[producer] != 0)
+            ordered = false;
+        lastSeen[producer] = item % kPerThread + 1;
+        sum += item;
+        ++received;
+    }
+    for (auto &p : producers)
+        p.join();
+    uint64_t n = kPerThread * kThreads;
+    CHECK(sum == n * (n - 1) / 2);
+    CHECK(ordered);
+    uint64_t extra;
+    CHECK(!queue.pop(extra));
+}
+
+DROGON_TEST(AuditLoggerTest)
+{
+    // 1. Event serialization
+    AuditEvent event;
+    event.timestampUs = 1700000000000000;
+    event.action = "Login";
+    event.reason = "bad_credentials";
+    event.success = false;
+    event.userId.assign("ad\"min");
+    event.clientId.assign(std::string(100, 'c'));  // Truncated to 64
+    event.ip.assign("10.0.0.8");
+    Json::Value json;
+    Json::Reader reader;
+    REQUIRE(reader.parse(AuditLogger::toJson(event), json));
+    CHECK(json["ts"].asInt64() == 1700000000000000);
+    CHECK(json["action"].asString() == "Login");
+    CHECK(json["user"].asString() == "ad\"min");
+    CHECK(json["client"].asString().size() == 64);
+    CHECK(json["ip"].asString() == "10.0.0.8");
+    CHECK(!json["success"].asBool());
+    CHECK(json["reason"].asString() == "bad_credentials");
+
+    auto &audit = AuditLogger::instance();
+    if (audit.running())
+        return;  // Started by OAuth2Plugin; leave its file alone
+
+    // 2. Events reach the file asynchronously, in order
+    const std::string file = "./audit_test.log";
+    std::remove(file.c_str());
+    std::remove((file + ".1").c_str());
+    Json::Value config;
+    config["enabled"] = true;
+    config["file"] = file;
+    config["queue_size"] = 64;
+    config["flush_interval_ms"] = 60000;  // Flushed explicitly below
+    config["max_file_mb"] = 0;            // Rotate after every write
+    config["max_files"] = 1;
+    audit.start(config);
+    REQUIRE(audit.running());
+
+    audit.log("IssueToken", true, "1", "vue-client");
+    audit.log("RefreshToken", false, "1", "vue-client", {}, "token_revoked");
+    audit.flush();
+    CHECK(audit.written() >= 2);
+
+    // max_file_mb = 0: the batch was rotated into <file>.1
+    std::ifstream rotated(file + ".1");
+    std::string line;
+    REQUIRE(std::getline(rotated, line));
+    REQUIRE(reader.parse(line, json));
+    CHECK(json["action"].asString() == "IssueToken");
+    REQUIRE(std::getline(rotated, line));
+    REQUIRE(reader.parse(line, json));
+    CHECK(json["reason"].asString() == "token_revoked");
+    rotated.close();
+
+    // 3. A full queue drops instead of blocking
+    auto dropped = audit.dropped();
+    for (int i = 0; i < 200; ++i)
+        audit.log("Login", true, "u", "c");
+    CHECK(audit.dropped() >= dropped + 200 - 64);
+
+    audit.stop();
+    CHECK(!audit.running());
+    std::remove(file.c_str());
+    std::remove((file + ".1").c_str());
+}
@@ -0,0 +1,88 @@
+#include <drogon/drogon_test.h>
+#include "CircuitBreaker.h"
+#include <chrono>
+#include <thread>
+
+using namespace oauth2;
+using State = CircuitBreaker::State;
+
+DROGON_TEST(CircuitBreakerTest)
+{
+    CircuitBreaker::Options options;
+    options.window = 10;
+    options.minCalls = 4;
+    options.failureRate = 0.5;
+    options.slowCallNanos = 100'000'000;  // 100ms
+    options.slowCallRate = 0.75;
+    options.openNanos = 20'000'000;  // 20ms
+    options.halfOpenProbes = 2;
+
+    // 1. Error rate: stays closed below min_calls, opens at the threshold
+    {
+        CircuitBreaker breaker("test", options);
+        for (int i = 0; i < 3; ++i)
+        {
+            CHECK(breaker.allow());
+            breaker.record(false, 1000);
+        }
+        CHECK(breaker.state() == State::kClosed);
+        CHECK(breaker.allow());
+        breaker.record(true, 1000);  // 3 of 4 failed
+        CHECK(breaker.state() == State::kOpen);
+        CHECK(breaker.allow() == false);
+    }
+
+    // 2. Slow calls open it too; old outcomes slide out of the window
+    {
+        CircuitBreaker breaker("test", options);
+        for (int i = 0; i < 10; ++i)
+            breaker.record(i % 2 == 0, 1000);  // 50% errors, not < 50%
+        CHECK(breaker.state() == State::kOpen);
+
+        CircuitBreaker slow("test", options);
+        for (int i = 0; i < 10; ++i)
+            slow.record(true, 1000);
+        for (int i = 0; i < 7; ++i)
+            slow.record(true, 200'000'000);
+        CHECK(slow.state() == State::kClosed);  // 7 of 10 slow
+        slow.record(true, 200'000'000);
+        CHECK(slow.state() == State::kOpen);  // 8 of 10 slow
+    }
+
+    // 3. Half-open: limited probes, any failure re-opens
+    {
+        CircuitBreaker breaker("test", options);
+        for (int i = 0; i < 4; ++i)
+            breaker.record(false, 1000);
+        REQUIRE(breaker.state() == State::kOpen);
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        CHECK(breaker.allow());
+        CHECK(breaker.state() == State::kHalfOpen);
+        CHECK(breaker.allow());
+        CHECK(breaker.allow() == false);  // Both probes in flight
+        breaker.record(true, 1000);
+        breaker.record(false, 1000);
+        CHECK(breaker.state() == State::kOpen);
+        CHECK(breaker.allow() == false);
+
+        // Enough successful probes close it with a fresh window
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        CHECK(breaker.allow());
+        breaker.record(true, 1000);
+        CHECK(breaker.allow());
+        breaker.record(true, 1000);
+        CHECK(breaker.state() == State::kClosed);
+        breaker.record(false, 1000);
+        CHECK(breaker.state() == State::kClosed);
+    }
+
+    // 4. Options from config
+    Json::Value config;
+    config["min_calls"] = 100;  // Capped at the window
+    config["slow_call_ms"] = 50;
+    auto parsed = CircuitBreaker::Options::fromConfig(config);
+    CHECK(parsed.window == 50);
+    CHECK(parsed.minCalls == 50);
+    CHECK(parsed.slowCallNanos == 50'000'000);
+    CHECK(parsed.openNanos == 5'000'000'000);
+}
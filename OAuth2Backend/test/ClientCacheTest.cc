@@ -0,0 +1,189 @@
+#include <drogon/drogon_test.h>
+#include "ClientCache.h"
+#include "MemoryOAuth2Storage.h"
+#include <chrono>
+#include <thread>
+
+using namespace oauth2;
+
+namespace
+{
+
+class CountingStorage : public MemoryOAuth2Storage
+{
+  public:
+    void getClient(const std::string &clientId, ClientCallback &&cb) override
+    {
+        ++lookups;
+        MemoryOAuth2Storage::getClient(clientId, std::move(cb));
+    }
+
+    void listClients(ClientListCallback &&cb) override
+    {
+        ++lists;
+        if (failList)
+        {
+            cb({});
+            return;
+        }
+        if (holdList)
+        {
+            // Read now, answer when the test says so
+            MemoryOAuth2Storage::listClients(
+                [this](std::vector<OAuth2Client> clients) {
+                    heldClients = std::move(clients);
+                });
+            heldList = std::move(cb);
+            return;
+        }
+        MemoryOAuth2Storage::listClients(std::move(cb));
+    }
+
+    int lookups{0};
+    int lists{0};
+    bool failList{false};
+    bool holdList{false};
+    ClientListCallback heldList;
+    std::vector<OAuth2Client> heldClients;
+};
+
+}  // namespace
+
+DROGON_TEST(ClientCacheTest)
+{
+    CountingStorage storage;
+    Json::Value clients;
+    clients["app"]["secret"] = "s";
+    clients["app"]["redirect_uri"] = "http://localhost/cb";
+    clients["app"]["allowed_scopes"] = "openid profile";
+    clients["other"]["secret"] = "s";
+    clients["other"]["redirect_uri"] = "http://localhost/other";
+    storage.initFromConfig(clients);
+
+    auto lookup = [](ClientCache &cache, const std::string &id) {
+        ClientPtr result;
+        cache.getClient(id, [&](ClientPtr c) { result = std::move(c); });
+        return result;
+    };
+
+    // 1. Read-through: the second lookup is a hit, same shared record
+    {
+        ClientCache cache(&storage, ClientCache::Options{});
+        auto first = lookup(cache, "app");
+        REQUIRE(first != nullptr);
+        CHECK(first->redirectUris.size() == 1);
+        auto second = lookup(cache, "app");
+        CHECK(second == first);
+        CHECK(storage.lookups == 1);
+
+        cache.invalidate("app");
+        CHECK(lookup(cache, "app") != nullptr);
+        CHECK(storage.lookups == 2);
+    }
+
+    // 2. Unknown clients are not cached
+    {
+        storage.lookups = 0;
+        ClientCache cache(&storage, ClientCache::Options{});
+        CHECK(lookup(cache, "nobody") == nullptr);
+        CHECK(lookup(cache, "nobody") == nullptr);
+        CHECK(storage.lookups == 2);
+    }
+
+    // 3. Entries expire after the TTL
+    {
+        storage.lookups = 0;
+        ClientCache::Options options;
+        options.ttlNanos = 5'000'000;  // 5ms
+        ClientCache cache(&storage, options);
+        lookup(cache, "app");
+        CHECK(cache.find("app") != nullptr);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        CHECK(cache.find("app") == nullptr);
+        lookup(cache, "app");
+        CHECK(storage.lookups == 2);
+    }
+
+    // 4. Redirect URIs and scopes are hashed sets; no scopes = any scope
+    {
+        ClientCache cache(&storage, ClientCache::Options{});
+        auto app = lookup(cache, "app");
+        REQUIRE(app != nullptr);
+        CHECK(app->hasRedirectUri("http://localhost/cb"));
+        CHECK(!app->hasRedirectUri("http://localhost/cb/"));
+        CHECK(app->allowsScope("openid"));
+        CHECK(!app->allowsScope("admin"));
+        auto other = lookup(cache, "other");
+        REQUIRE(other != nullptr);
+        CHECK(other->allowsScope("admin"));
+    }
+
+    // 5. load() preloads every client; lookups then skip storage
+    {
+        storage.lookups = 0;
+        ClientCache cache(&storage, ClientCache::Options{});
+        bool loaded = false;
+        cache.load([&](bool ok) { loaded = ok; });
+        CHECK(loaded);
+        CHECK(cache.size() == 2);
+        CHECK(lookup(cache, "app") != nullptr);
+        CHECK(lookup(cache, "other") != nullptr);
+        CHECK(storage.lookups == 0);
+
+        // A failed reload keeps the registry
+        storage.failList = true;
+        cache.load([&](bool ok) { loaded = ok; });
+        CHECK(!loaded);
+        CHECK(cache.size() == 2);
+        storage.failList = false;
+    }
+
+    // 6. ttl 0: entries stay until refresh(), which re-reads or drops them
+    {
+        ClientCache::Options options;
+        options.ttlNanos = 0;
+        ClientCache cache(&storage, options);
+        cache.load();
+        auto before = cache.find("app");
+        REQUIRE(before != nullptr);
+
+        cache.refresh("app");
+        auto after = cache.find("app");
+        REQUIRE(after != nullptr);
+        CHECK(after != before);
+
+        cache.refresh("gone");
+        CHECK(cache.find("gone") == nullptr);
+        cache.put(before);
+        CHECK(cache.find("app") == before);
+    }
+
+    // 7. A full load read before a refresh does not undo the refresh
+    {
+        ClientCache::Options options;
+        options.ttlNanos = 0;
+        ClientCache cache(&storage, options);
+        cache.load();
+
+        storage.holdList = true;
+        cache.load();  // Reads the old "app"
+        storage.holdList = false;
+
+        Json::Value changed;
+        changed["app"]["secret"] = "rotated";
+        changed["app"]["redirect_uri"] = "http://localhost/new";
+        storage.initFromConfig(changed);
+        cache.refresh("app");
+
+        storage.heldList(std::move(storage.heldClients));
+        auto app = cache.find("app");
+        REQUIRE(app != nullptr);
+        CHECK(app->clientSecretHash == "rotated");
+        CHECK(app->hasRedirectUri("http://localhost/new"));
+        CHECK(cache.find("other") != nullptr);
+
+        // The next load covers the refresh and applies as usual
+        cache.load();
+        CHECK(cache.find("app")->clientSecretHash == "rotated");
+    }
+}
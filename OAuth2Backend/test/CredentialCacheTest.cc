@@ -0,0 +1,56 @@
+#include <drogon/drogon_test.h>
+#include "CredentialCache.h"
+#include <chrono>
+#include <thread>
+
+using namespace oauth2;
+
+DROGON_TEST(CredentialCacheTest)
+{
+    // 1. SipHash-2-4 reference vectors: key 00..0f, message 00..(n-1)
+    {
+        const uint64_t k0 = 0x0706050403020100ULL;
+        const uint64_t k1 = 0x0f0e0d0c0b0a0908ULL;
+        std::string message;
+        CHECK(CredentialCache::sipHash(k0, k1, message) ==
+              0x726fdb47dd0e0e31ULL);
+        for (int i = 0; i < 15; ++i)
+            message.push_back(static_cast<char>(i));
+        CHECK(CredentialCache::sipHash(k0, k1, message) ==
+              0xa129ca6149be45e5ULL);
+    }
+
+    // 2. Only the verified secret, against the same stored hash, hits
+    {
+        CredentialCache cache(CredentialCache::Options{});
+        CHECK(!cache.contains("app", "secret", "hash1"));
+        cache.put("app", "secret", "hash1");
+        CHECK(cache.contains("app", "secret", "hash1"));
+        CHECK(!cache.contains("app", "wrong", "hash1"));
+        CHECK(!cache.contains("other", "secret", "hash1"));
+
+        // Rotated secret: the registry now holds another hash
+        CHECK(!cache.contains("app", "secret", "hash2"));
+
+        cache.invalidate("app");
+        CHECK(!cache.contains("app", "secret", "hash1"));
+    }
+
+    // 3. Fields are length-prefixed: shifting bytes across them misses
+    {
+        CredentialCache cache(CredentialCache::Options{});
+        cache.put("ab", "c", "h");
+        CHECK(!cache.contains("ab", "", "ch"));
+    }
+
+    // 4. Entries expire after the TTL
+    {
+        CredentialCache::Options options;
+        options.ttlNanos = 5'000'000;  // 5ms
+        CredentialCache cache(options);
+        cache.put("app", "secret", "hash1");
+        CHECK(cache.contains("app", "secret", "hash1"));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        CHECK(!cache.contains("app", "secret", "hash1"));
+    }
+}
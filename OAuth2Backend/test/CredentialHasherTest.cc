@@ -0,0 +1,85 @@
+#include <drogon/drogon_test.h>
+#include "CredentialHasher.h"
+#include <future>
+
+using namespace oauth2;
+
+DROGON_TEST(CredentialHasherTest)
+{
+    auto &hasher = CredentialHasher::instance();
+    auto expected = CredentialHasher::hashPassword("secret", "salt");
+
+    // 1. Hex hashes compare case-insensitively
+    CHECK(CredentialHasher::hashesMatch("abc1", "ABC1"));
+    CHECK(!CredentialHasher::hashesMatch("abc1", "abc2"));
+    CHECK(!CredentialHasher::hashesMatch("abc", "abc1"));
+
+    // 2. Not started: hashes run inline
+    {
+        bool called = false;
+        hasher.verify("secret",
+                      "salt",
+                      expected,
+                      [&](CredentialHasher::Status status, bool match) {
+                          called = true;
+                          CHECK(status == CredentialHasher::Status::kOk);
+                          CHECK(match);
+                      });
+        CHECK(called);
+    }
+
+    // 3. On the pool: no loop here, so results arrive on a worker
+    {
+        Json::Value config;
+        config["threads"] = 2;
+        config["max_queue"] = 16;
+        hasher.start(config);
+
+        std::promise<bool> good, bad;
+        hasher.verify("secret",
+                      "salt",
+                      expected,
+                      [&](CredentialHasher::Status status, bool match) {
+                          good.set_value(status ==
+                                             CredentialHasher::Status::kOk &&
+                                         match);
+                      });
+        hasher.verify("wrong",
+                      "salt",
+                      expected,
+                      [&](CredentialHasher::Status status, bool match) {
+                          bad.set_value(status ==
+                                            CredentialHasher::Status::kOk &&
+                                        !match);
+                      });
+        CHECK(good.get_future().get());
+        CHECK(bad.get_future().get());
+
+        std::promise<std::string> hashed;
+        hasher.hash("secret",
+                    "salt",
+                    [&](CredentialHasher::Status status, std::string hash) {
+                        CHECK(status == CredentialHasher::Status::kOk);
+                        hashed.set_value(std::move(hash));
+                    });
+        CHECK(hashed.get_future().get() == expected);
+        hasher.stop();
+    }
+
+    // 4. No room in the queue: rejected at once, unhashed
+    {
+        Json::Value config;
+        config["max_queue"] = 0;
+        hasher.start(config);
+        bool rejected = false;
+        hasher.hash("secret",
+                    "salt",
+                    [&](CredentialHasher::Status status, std::string hash) {
+                        rejected =
+                            status == CredentialHasher::Status::kRejected &&
+                            hash.empty();
+                    });
+        CHECK(rejected);
+        hasher.stop();
+    }
+}
@@ -0,0 +1,152 @@
+#include <drogon/drogon_test.h>
+#include "ConcurrencyLimiter.h"
+#include "Deadline.h"
+#include "DeadlineOAuth2Storage.h"
+#include "MemoryOAuth2Storage.h"
+#include <trantor/net/EventLoopThread.h>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <future>
+#include <thread>
+
+using namespace oauth2;
+
+namespace
+{
+
+// Never answers getAccessToken until told to
+class StuckStorage : public MemoryOAuth2Storage
+{
+  public:
+    void getAccessToken(const std::string &,
+                        AccessTokenCallback &&cb) override
+    {
+        ++calls;
+        pending = std::move(cb);
+    }
+
+    std::atomic<int> calls{0};
+    AccessTokenCallback pending;
+};
+
+}  // namespace
+
+DROGON_TEST(DeadlineTest)
+{
+    // 1. Route budgets: longest prefix wins, default otherwise
+    {
+        Json::Value config;
+        config["enabled"] = true;
+        config["default_ms"] = 500;
+        config["routes"]["/oauth2"] = 1000;
+        config["routes"]["/oauth2/token"] = 2000;
+        auto &deadlines = RequestDeadlines::instance();
+        deadlines.configure(config);
+        CHECK(deadlines.budgetNanos("/oauth2/token") == 2'000'000'000);
+        CHECK(deadlines.budgetNanos("/oauth2/authorize") == 1'000'000'000);
+        CHECK(deadlines.budgetNanos("/api/register") == 500'000'000);
+        deadlines.configure(Json::Value());
+        CHECK(RequestDeadlines::enabled() == false);
+    }
+
+    // 2. Scopes nest
+    CHECK(DeadlineScope::current() == 0);
+    {
+        DeadlineScope outer(100);
+        {
+            DeadlineScope inner(50);
+            CHECK(DeadlineScope::current() == 50);
+        }
+        CHECK(DeadlineScope::current() == 100);
+    }
+    CHECK(DeadlineScope::current() == 0);
+
+    // 3. Past the deadline: completed at once, backend never called
+    {
+        auto stuck = std::make_unique<StuckStorage>();
+        auto *backend = stuck.get();
+        DeadlineOAuth2Storage storage(std::move(stuck));
+        DeadlineScope expired(DeadlineScope::now() - 1);
+        int answers = 0;
+        storage.getAccessToken("t", [&](AccessTokenPtr t) {
+            ++answers;
+            CHECK(t == nullptr);
+        });
+        CHECK(answers == 1);
+        CHECK(backend->calls == 0);
+    }
+
+    // 4. On an event loop the timer answers once; the late result is
+    // dropped
+    {
+        auto stuck = std::make_unique<StuckStorage>();
+        auto *backend = stuck.get();
+        DeadlineOAuth2Storage storage(std::move(stuck));
+        trantor::EventLoopThread loopThread;
+        loopThread.run();
+        std::atomic<int> answers{0};
+        std::promise<void> answered;
+        std::promise<void> issued;
+        loopThread.getLoop()->queueInLoop([&]() {
+            DeadlineScope deadline(DeadlineScope::now() + 20'000'000);
+            storage.getAccessToken("t", [&](AccessTokenPtr t) {
+                CHECK(t == nullptr);
+                CHECK(DeadlineScope::current() != 0);
+                if (++answers == 1)
+                    answered.set_value();
+            });
+            issued.set_value();
+        });
+        issued.get_future().get();
+        CHECK(answered.get_future().wait_for(std::chrono::seconds(2)) ==
+              std::future_status::ready);
+        CHECK(backend->calls == 1);
+        backend->pending(std::make_shared<OAuth2AccessToken>());
+        CHECK(answers == 1);
+    }
+
+    // 5. A queued storage call gives up at the caller's deadline
+    {
+        ConcurrencyLimiter::Options options;
+        options.maxConcurrency = 1;
+        options.queueTimeoutNanos[static_cast<size_t>(
+            StoragePriority::kIssue)] = 10'000'000'000;
+        ConcurrencyLimiter limiter("test", options);
+        limiter.submit(StoragePriority::kIssue, []() {}, []() {});
+        bool started = false;
+        bool rejected = false;
+        limiter.submit(
+            StoragePriority::kIssue,
+            [&]() { started = true; },
+            [&]() { rejected = true; },
+            true,
+            DeadlineScope::now() + 10'000'000);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        limiter.release();
+        CHECK(rejected);
+        CHECK(started == false);
+    }
+
+    // 6. Writes ignore the deadline: a token issued late is still stored
+    {
+        DeadlineOAuth2Storage storage(
+            std::make_unique<MemoryOAuth2Storage>());
+        OAuth2AccessToken token;
+        token.token = "late";
+        token.clientId = "vue-client";
+        token.expiresAt = std::time(nullptr) + 60;
+        bool saved = false;
+        {
+            DeadlineScope expired(DeadlineScope::now() - 1);
+            storage.saveAccessToken(token, [&]() {
+                saved = true;
+                CHECK(DeadlineScope::current() != 0);
+            });
+        }
+        CHECK(saved);
+        AccessTokenPtr found;
+        storage.getAccessToken("late", [&](AccessTokenPtr t) { found = t; });
+        CHECK(found != nullptr);
+    }
+}
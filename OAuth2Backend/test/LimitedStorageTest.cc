@@ -0,0 +1,182 @@
+#include <drogon/drogon_test.h>
+#include "ConcurrencyLimiter.h"
+#include "LimitedOAuth2Storage.h"
+#include "MemoryOAuth2Storage.h"
+#include <chrono>
+#include <future>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace oauth2;
+
+DROGON_TEST(ConcurrencyLimiterTest)
+{
+    ConcurrencyLimiter::Options options;
+    options.maxConcurrency = 2;
+    options.maxQueue = 3;
+    std::vector<std::string> events;
+    auto task = [&events](std::string name) {
+        return [&events, name]() { events.push_back(name); };
+    };
+    auto submit = [&](ConcurrencyLimiter &limiter,
+                      StoragePriority priority,
+                      const std::string &name,
+                      bool rejectable = true) {
+        limiter.submit(priority,
+                       task("start " + name),
+                       task("reject " + name),
+                       rejectable);
+    };
+
+    // 1. Priority order, and a full queue sheds the lowest class first
+    {
+        ConcurrencyLimiter limiter("test", options);
+        submit(limiter, StoragePriority::kIssue, "i1");
+        submit(limiter, StoragePriority::kIssue, "i2");
+        submit(limiter, StoragePriority::kCleanup, "c1");
+        submit(limiter, StoragePriority::kIssue, "i3");
+        submit(limiter, StoragePriority::kValidate, "v1");
+        CHECK(limiter.inFlight() == 2);
+        CHECK(limiter.queued() == 3);
+        submit(limiter, StoragePriority::kValidate, "v2");  // Evicts c1
+        submit(limiter, StoragePriority::kCleanup, "c2");   // Nothing lower
+        for (int i = 0; i < 5; ++i)
+            limiter.release();
+        CHECK(events == std::vector<std::string>({"start i1",
+                                                  "start i2",
+                                                  "reject c1",
+                                                  "reject c2",
+                                                  "start v1",
+                                                  "start v2",
+                                                  "start i3"}));
+        CHECK(limiter.inFlight() == 0);
+        CHECK(limiter.queued() == 0);
+    }
+
+    // 2. A waiter past its deadline is rejected, never started
+    {
+        events.clear();
+        auto opts = options;
+        opts.maxConcurrency = 1;
+        opts.queueTimeoutNanos[static_cast<size_t>(StoragePriority::kIssue)] =
+            20'000'000;
+        ConcurrencyLimiter limiter("test", opts);
+        submit(limiter, StoragePriority::kIssue, "a");
+        submit(limiter, StoragePriority::kIssue, "late");
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        limiter.release();
+        CHECK(events == std::vector<std::string>({"start a", "reject late"}));
+        CHECK(limiter.inFlight() == 0);
+    }
+
+    // 3. Writes are never rejected, even past max_queue
+    {
+        events.clear();
+        auto opts = options;
+        opts.maxConcurrency = 1;
+        opts.maxQueue = 0;
+        ConcurrencyLimiter limiter("test", opts);
+        submit(limiter, StoragePriority::kIssue, "a");
+        submit(limiter, StoragePriority::kIssue, "read");
+        submit(limiter, StoragePriority::kIssue, "write", false);
+        limiter.release();
+        limiter.release();
+        CHECK(events == std::vector<std::string>({"start a",
+                                                  "reject read",
+                                                  "start write"}));
+    }
+
+    // 3b. Deadlines out of FIFO order: an expired waiter behind a write
+    // and a live one is still rejected on the next submit
+    {
+        events.clear();
+        auto opts = options;
+        opts.maxConcurrency = 1;
+        opts.maxQueue = 10;  // Nothing evicted
+        ConcurrencyLimiter limiter("test", opts);
+        auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+        submit(limiter, StoragePriority::kIssue, "a");
+        submit(limiter, StoragePriority::kIssue, "write", false);
+        limiter.submit(StoragePriority::kIssue,
+                       task("start live"),
+                       task("reject live"),
+                       true,
+                       now + 10'000'000'000);
+        limiter.submit(StoragePriority::kIssue,
+                       task("start late"),
+                       task("reject late"),
+                       true,
+                       now + 20'000'000);
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        submit(limiter, StoragePriority::kValidate, "v");
+        CHECK(events == std::vector<std::string>({"start a", "reject late"}));
+        CHECK(limiter.queued() == 3);
+        for (int i = 0; i < 4; ++i)
+            limiter.release();
+        CHECK(events == std::vector<std::string>({"start a",
+                                                  "reject late",
+                                                  "start v",
+                                                  "start write",
+                                                  "start live"}));
+        CHECK(limiter.queued() == 0);
+        CHECK(limiter.inFlight() == 0);
+    }
+
+    // 4. Options from config
+    Json::Value config;
+    config["max_concurrency"] = 4;
+    config["queue_timeout_ms"]["validate"] = 50;
+    auto parsed = ConcurrencyLimiter::Options::fromConfig(config);
+    CHECK(parsed.maxConcurrency == 4);
+    CHECK(parsed.maxQueue == 1024);
+    CHECK(parsed.queueTimeoutNanos[0] == 50'000'000);
+}
+
+DROGON_TEST(LimitedOAuth2StorageTest)
+{
+    ConcurrencyLimiter::Options options;
+    options.maxConcurrency = 1;
+    auto limiter = std::make_shared<ConcurrencyLimiter>("memory", options);
+    LimitedOAuth2Storage storage(std::make_unique<MemoryOAuth2Storage>(),
+                                 limiter);
+
+    OAuth2AccessToken token;
+    token.token = "limited-token";
+    token.clientId = "vue-client";
+    token.userId = "user-1";
+    token.scope = "openid";
+    token.expiresAt = std::numeric_limits<int64_t>::max();
+    std::promise<void> saved;
+    storage.saveAccessToken(token, [&]() { saved.set_value(); });
+    saved.get_future().get();
+
+    std::promise<AccessTokenPtr> found;
+    storage.getAccessToken("limited-token",
+                           [&](AccessTokenPtr t) { found.set_value(t); });
+    auto result = found.get_future().get();
+    REQUIRE(result != nullptr);
+    CHECK(result->userId == "user-1");
+
+    // Every completion released its slot
+    CHECK(limiter->inFlight() == 0);
+
+    // With the only slot taken and no queue, a lookup is answered as
+    // "not found" without reaching the backend
+    ConcurrencyLimiter::Options full;
+    full.maxConcurrency = 1;
+    full.maxQueue = 0;
+    auto busy = std::make_shared<ConcurrencyLimiter>("memory", full);
+    LimitedOAuth2Storage limited(std::make_unique<MemoryOAuth2Storage>(),
+                                 busy);
+    busy->submit(StoragePriority::kIssue, []() {}, []() {});
+    bool rejected = false;
+    limited.getAccessToken("limited-token", [&](AccessTokenPtr t) {
+        rejected = (t == nullptr);
+    });
+    CHECK(rejected);
+    busy->release();
+}
@@ -100,4 +100,39 @@ DROGON_TEST(MemoryStorageTest)
         CHECK(c.has_value());
         CHECK(c->used == true);
     }
+
+    // Values longer than TokenValue::kCapacity are never issued: lookups
+    // report "not found" instead of failing
+    {
+        std::promise<std::optional<OAuth2AuthCode>> p;
+        auto f = p.get_future();
+        storage->getAuthCode(std::string(TokenValue::kCapacity + 1, 'x'),
+                             [&](std::optional<OAuth2AuthCode> c) {
+                                 p.set_value(c);
+                             });
+        CHECK(!f.get().has_value());
+
+        std::promise<AccessTokenPtr> p2;
+        auto f2 = p2.get_future();
+        storage->getAccessToken(std::string(200, 'x'), [&](AccessTokenPtr t) {
+            p2.set_value(t);
+        });
+        CHECK(f2.get() == nullptr);
+    }
+
+    // User IDs, scopes and redirect URIs come from requests: storing them
+    // must not grow the never-shrinking symbol table
+    {
+        auto interned = Symbol::tableSize();
+        OAuth2AuthCode other = code;
+        other.code = "test_code_456";
+        other.userId = "user-" + std::to_string(interned);
+        other.scope = "scope-" + std::to_string(interned);
+        other.redirectUri = "https://example.com/" + std::to_string(interned);
+        std::promise<void> p;
+        auto f = p.get_future();
+        storage->saveAuthCode(other, [&]() { p.set_value(); });
+        f.get();
+        CHECK(Symbol::tableSize() == interned);
+    }
 }
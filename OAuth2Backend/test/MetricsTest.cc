@@ -0,0 +1,247 @@
+#include <drogon/drogon_test.h>
+#include "MetricsRegistry.h"
+#include "LatencyHistogram.h"
+#include "LoadMonitor.h"
+#include "SlowOpLog.h"
+#include "../plugins/OAuth2Metrics.h"
+#include <trantor/net/EventLoopThread.h>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace oauth2;
+
+DROGON_TEST(MetricsRegistryTest)
+{
+    auto &registry = MetricsRegistry::instance();
+
+    // 1. Counters written from several threads are summed on snapshot,
+    // including threads that have already exited
+    auto counter = registry.addFamily("test_events_total",
+                                      "Test counter",
+                                      MetricsRegistry::Kind::kCounter,
+                                      {"kind"});
+    auto a = registry.series(counter, {"a"});
+    auto b = registry.series(counter, {"b"});
+    CHECK(a != b);
+    CHECK(registry.series(counter, {"a"}) == a);  // Same labels, same cell
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 1000; ++i)
+                registry.add(a);
+            registry.add(b, 5);
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    auto snap = registry.snapshot(counter);
+    REQUIRE(snap.size() == 2);
+    CHECK(snap[0].values[0] == 4000);
+    CHECK(snap[1].values[0] == 20);
+
+    // 2. Histogram: per-bucket counts, sum and count
+    auto histogram = registry.addFamily("test_latency_seconds",
+                                        "Test histogram",
+                                        MetricsRegistry::Kind::kHistogram,
+                                        {"op"},
+                                        {0.01, 0.1, 1.0});
+    auto h = registry.series(histogram, {"get"});
+    registry.observe(histogram, h, 0.005);  // <= 0.01
+    registry.observe(histogram, h, 0.05);   // <= 0.1
+    registry.observe(histogram, h, 0.05);
+    registry.observe(histogram, h, 5.0);  // +Inf
+
+    auto hs = registry.snapshot(histogram);
+    REQUIRE(hs.size() == 1);
+    REQUIRE(hs[0].values.size() == 6);  // 4 buckets + sum + count
+    CHECK(hs[0].values[0] == 1);
+    CHECK(hs[0].values[1] == 2);
+    CHECK(hs[0].values[2] == 0);
+    CHECK(hs[0].values[3] == 1);
+    CHECK(hs[0].values[4] > 5.105 - 1e-6);
+    CHECK(hs[0].values[4] < 5.105 + 1e-6);
+    CHECK(hs[0].values[5] == 4);
+
+    // 3. Business metrics land in the registry
+    Metrics::incRequest("metrics-test", 201);
+    Metrics::incRequest("metrics-test", 201);
+    bool found = false;
+    for (uint32_t i = 0; i < registry.familyCount(); ++i)
+    {
+        if (registry.family(i).name != "oauth2_requests_total")
+            continue;
+        for (const auto &s : registry.snapshot(i))
+        {
+            if (s.series->labelValues ==
+                std::vector<std::string>{"metrics-test", "201"})
+            {
+                found = true;
+                CHECK(s.values[0] == 2);
+            }
+        }
+    }
+    CHECK(found);
+}
+
+DROGON_TEST(LatencyHistogramTest)
+{
+    // 1. Bucket bounds: exact below kSubBuckets, ~3% relative error above
+    CHECK(LatencyHistogram::bucketOf(0) == 0);
+    CHECK(LatencyHistogram::bucketOf(31) == 31);
+    for (uint64_t v : {32ull, 1000ull, 123456ull, 987654321ull})
+    {
+        auto upper =
+            LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketOf(v));
+        CHECK(upper >= v);
+        CHECK(static_cast<double>(upper - v) / v <= 1.0 / 32);
+    }
+    CHECK(LatencyHistogram::bucketOf(UINT64_MAX) ==
+          LatencyHistogram::kBuckets - 1);
+
+    // 2. Percentiles across threads, including exited ones
+    auto &recorder = LatencyRecorder::instance();
+    recorder.reset();
+    constexpr size_t kSlot = LatencyRecorder::kMaxSlots - 1;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&recorder]() {
+            // 1..1000 us, one sample each
+            for (uint64_t us = 1; us <= 1000; ++us)
+                recorder.record(kSlot, us * 1000);
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    recorder.record(kSlot, 50'000'000);  // One 50 ms outlier
+
+    auto h = recorder.snapshot(kSlot);
+    CHECK(h.count() == 4001);
+    auto near = [](uint64_t actual, double expected) {
+        return std::abs(static_cast<double>(actual) - expected) <=
+               expected / 32;
+    };
+    CHECK(near(h.percentile(0.5), 500'000));
+    CHECK(near(h.percentile(0.99), 990'000));
+    CHECK(near(h.max(), 50'000'000));
+    CHECK(near(h.min(), 1'000));
+
+    recorder.reset();
+    CHECK(recorder.snapshot(kSlot).count() == 0);
+}
+
+DROGON_TEST(SlowOpLogTest)
+{
+    auto &log = SlowOpLog::instance();
+
+    // 1. The most specific threshold wins
+    Json::Value config;
+    config["enabled"] = true;
+    config["log"] = false;
+    config["max_per_second"] = 3;
+    config["thresholds_ms"]["default"] = 1000;
+    config["thresholds_ms"]["memory"] = 0;
+    config["thresholds_ms"]["memory.getClient"] = 1000;
+    config["thresholds_ms"]["getAccessToken"] = 0;
+    log.configure(config);
+    log.clear();
+    REQUIRE(SlowOpLog::enabled());
+
+    constexpr int64_t kMs = 1'000'000;
+    CHECK(!log.exceeds(log.site("getClient", "memory"), kMs));
+    CHECK(log.exceeds(log.site("saveAuthCode", "memory"), kMs));
+    CHECK(log.exceeds(log.site("getAccessToken", "redis"), kMs));
+    CHECK(!log.exceeds(log.site("saveAuthCode", "redis"), kMs));
+    CHECK(log.site("saveAuthCode", "memory") ==
+          log.site("saveAuthCode", "memory"));
+
+    // 2. Storage timers report with a hashed key and no queue wait
+    OperationTimer(StorageOp::kSaveAuthCode, StorageBackend::kMemory, "c-1")
+        .stop();
+    auto recent = log.recent(10);
+    REQUIRE(recent.size() == 1);
+    CHECK(recent[0].operation == "saveAuthCode");
+    CHECK(recent[0].backend == "memory");
+    CHECK(recent[0].keyHash == SlowOpLog::hashKey("c-1"));
+    CHECK(recent[0].keyHash != SlowOpLog::hashKey("c-2"));
+    CHECK(recent[0].queueNanos == -1);
+
+    auto json = log.toJson(10);
+    CHECK(json["operations"][0]["key_hash"].asString().size() == 16);
+    CHECK(!json["operations"][0].isMember("queue_ms"));
+
+    // 3. Rate limit: at most 3 per second get through
+    auto site = log.site("saveAuthCode", "memory");
+    for (int i = 0; i < 10; ++i)
+        log.report(site, 0, kMs, -1, {});
+    json = log.toJson(100);
+    CHECK(json["suppressed"].asUInt64() >= 4);
+    CHECK(json["reported"].asUInt64() + json["suppressed"].asUInt64() == 11);
+    CHECK(log.recent(100).size() == json["reported"].asUInt64());
+
+    // 4. Disabled: nothing is slow and keys are not hashed
+    log.configure(Json::Value());
+    log.clear();
+    CHECK(!SlowOpLog::enabled());
+    CHECK(!log.exceeds(site, INT64_MAX - 1));
+    CHECK(SlowOpLog::hashKey("c-1") == 0);
+}
+
+DROGON_TEST(LoadMonitorTest)
+{
+    auto &monitor = LoadMonitor::instance();
+    auto base = Metrics::storageInFlight();
+    Json::Value config;
+    config["enabled"] = true;
+    config["sample_interval_ms"] = 60000;  // Sampled by hand below
+    config["max_loop_lag_ms"] = 20;
+    config["max_storage_inflight"] = static_cast<Json::Int64>(base + 2);
+    config["low_priority_paths"].append("/api/register");
+    monitor.configure(config);
+
+    // 1. Storage operations count as in flight until stop()
+    std::vector<OperationTimer> timers;
+    for (int i = 0; i < 3; ++i)
+        timers.emplace_back(StorageOp::kGetClient, StorageBackend::kMemory);
+    monitor.sample();
+    CHECK(monitor.storageInFlight() == base + 3);
+    CHECK(monitor.shouldShed("/api/register") == "/api/register");
+    CHECK(monitor.shouldShed("/oauth2/token").empty());
+    for (const auto &timer : timers)
+        timer.stop();
+    monitor.sample();
+    CHECK(monitor.storageInFlight() == base);
+    CHECK(monitor.shouldShed("/api/register").empty());
+
+    // 2. A blocked loop reports its lag while still blocked
+    trantor::EventLoopThread thread("LoadMonitorTest");
+    thread.run();
+    auto *loop = thread.getLoop();
+    monitor.start({loop});
+    loop->queueInLoop([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    });
+    monitor.sample();  // Probe queued behind the sleep
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    monitor.sample();
+    CHECK(monitor.loopLagNanos(0) >= 40'000'000);
+    CHECK(monitor.currentLoopLagNanos() == 0);  // Not an IO loop
+
+    // Requests on the lagging loop are shed; the probe ran before this
+    std::promise<std::string> shed;
+    loop->queueInLoop([&]() {
+        shed.set_value(std::string(monitor.shouldShed("/api/register")));
+    });
+    CHECK(shed.get_future().get() == "/api/register");
+    CHECK(monitor.toJson()["loop_lag_ms"].size() == 1);
+
+    monitor.stop();
+    monitor.configure(Json::Value());
+    CHECK(!LoadMonitor::enabled());
+}
@@ -2,10 +2,32 @@
 #include <drogon/drogon_test.h>
 #include <drogon/drogon.h>
 #include "OAuth2Plugin.h"
+#include "Deadline.h"
+#include "DeadlineOAuth2Storage.h"
 #include <future>
+#include <algorithm>
 
 using namespace oauth2;
 
+namespace
+{
+
+// Every roles lookup runs out of time, as it does under overload
+class ExpiringRolesStorage : public DeadlineOAuth2Storage
+{
+  public:
+    using DeadlineOAuth2Storage::DeadlineOAuth2Storage;
+
+    void getUserRoles(const std::string &userId,
+                      StringListCallback &&cb) override
+    {
+        DeadlineScope expired(DeadlineScope::now() - 1);
+        DeadlineOAuth2Storage::getUserRoles(userId, std::move(cb));
+    }
+};
+
+}  // namespace
+
 DROGON_TEST(PluginTest)
 {
     // 1. Setup Plugin with Memory Storage
@@ -25,6 +47,7 @@ DROGON_TEST(PluginTest)
     Json::Value clientConfig;
     clientConfig["secret"] = "plugin-secret";
     clientConfig["redirect_uri"] = "http://localhost/cb";
+    clientConfig["allowed_scopes"] = "scope1 scope2";
     config["clients"]["plugin-client"] = clientConfig;
 
     // We need to check OAuth2Plugin::initStorage implementation to see what it
@@ -42,6 +65,53 @@ DROGON_TEST(PluginTest)
                                "plugin-secret",
                                [&](bool valid) { p.set_value(valid); });
         CHECK(f.get() == true);
+
+        // Repeat: answered from the verified-credential cache; a wrong
+        // secret still fails
+        auto validate = [&](const std::string &secret) {
+            std::promise<bool> r;
+            plugin->validateClient("plugin-client", secret, [&](bool valid) {
+                r.set_value(valid);
+            });
+            return r.get_future().get();
+        };
+        CHECK(validate("plugin-secret"));
+        CHECK(!validate("wrong-secret"));
+    }
+
+    // 2b. Authorize preflight: one lookup, checks in order
+    {
+        using Error = OAuth2Plugin::AuthorizePreflight::Error;
+        auto preflight = [&](const std::string &clientId,
+                             const std::string &redirectUri,
+                             const std::string &responseType,
+                             const std::string &scope) {
+            std::promise<OAuth2Plugin::AuthorizePreflight> p;
+            plugin->preflightAuthorize(
+                clientId,
+                redirectUri,
+                responseType,
+                scope,
+                [&](const OAuth2Plugin::AuthorizePreflight &r) {
+                    p.set_value(r);
+                });
+            return p.get_future().get();
+        };
+        auto ok = preflight(
+            "plugin-client", "http://localhost/cb", "code", "scope2 scope1");
+        CHECK(ok.ok());
+        REQUIRE(ok.client != nullptr);
+        CHECK(ok.client->clientId == "plugin-client");
+        CHECK(preflight("nobody", "http://localhost/cb", "code", "").error ==
+              Error::kInvalidClient);
+        CHECK(preflight("plugin-client", "http://evil/cb", "token", "")
+                  .error == Error::kInvalidRedirectUri);
+        CHECK(preflight("plugin-client", "http://localhost/cb", "token", "")
+                  .error == Error::kUnsupportedResponseType);
+        auto badScope = preflight(
+            "plugin-client", "http://localhost/cb", "code", "scope1 admin");
+        CHECK(badScope.error == Error::kInvalidScope);
+        CHECK(std::string(badScope.errorCode()) == "invalid_scope");
     }
 
     // 3. Generate Code
@@ -149,4 +219,159 @@ DROGON_TEST(PluginTest)
                 hasAdmin = true;
         CHECK(hasAdmin == true);
     }
+
+    // 9. Role Snapshot Embedded in Token + Invalidation
+    {
+        std::promise<std::string> p;
+        auto f = p.get_future();
+        plugin->generateAuthorizationCode("plugin-client",
+                                          "admin",
+                                          "scope1",
+                                          [&](std::string c) {
+                                              p.set_value(c);
+                                          });
+        auto code = f.get();
+
+        std::promise<Json::Value> p2;
+        auto f2 = p2.get_future();
+        plugin->exchangeCodeForToken(code,
+                                     "plugin-client",
+                                     [&](const Json::Value &v) {
+                                         p2.set_value(v);
+                                     });
+        auto accessToken = f2.get()["access_token"].asString();
+
+        std::promise<OAuth2Plugin::AccessTokenPtr> p3;
+        auto f3 = p3.get_future();
+        plugin->validateAccessToken(
+            accessToken, [&](OAuth2Plugin::AccessTokenPtr at) {
+                p3.set_value(at);
+            });
+        auto at = f3.get();
+        REQUIRE(at != nullptr);
+        REQUIRE(at->roleIds.has_value());
+        CHECK(at->roleIds->size() == 2);
+
+        std::promise<std::vector<std::string>> p4;
+        auto f4 = p4.get_future();
+        plugin->getTokenRoles(*at, [&](std::vector<std::string> roles) {
+            p4.set_value(roles);
+        });
+        auto roles = f4.get();
+        CHECK(std::find(roles.begin(), roles.end(), "admin") != roles.end());
+
+        std::promise<void> p5;
+        auto f5 = p5.get_future();
+        plugin->invalidateUserRoles("admin", [&]() { p5.set_value(); });
+        f5.get();
+
+        std::promise<OAuth2Plugin::AccessTokenPtr> p6;
+        auto f6 = p6.get_future();
+        plugin->validateAccessToken(
+            accessToken, [&](OAuth2Plugin::AccessTokenPtr at) {
+                p6.set_value(at);
+            });
+        auto invalidated = f6.get();
+        REQUIRE(invalidated != nullptr);  // Token itself stays valid
+        CHECK(!invalidated->roleIds.has_value());
+    }
+
+    // 10. Permission Checks (seeded RBAC catalog)
+    {
+        std::promise<bool> p;
+        auto f = p.get_future();
+        plugin->hasPermission("admin", "admin:access", [&](bool ok) {
+            p.set_value(ok);
+        });
+        CHECK(f.get() == true);
+
+        std::promise<bool> p2;
+        auto f2 = p2.get_future();
+        plugin->hasPermission("user1", "admin:access", [&](bool ok) {
+            p2.set_value(ok);
+        });
+        CHECK(f2.get() == false);
+
+        std::promise<bool> p3;
+        auto f3 = p3.get_future();
+        plugin->hasPermission("user1", "no:such:permission", [&](bool ok) {
+            p3.set_value(ok);
+        });
+        CHECK(f3.get() == false);
+    }
+
+    // 11. Server-Timing: off by default, phases recorded when requested
+    {
+        auto req = drogon::HttpRequest::newHttpRequest();
+        CHECK(plugin->startRequestTiming(req, "token") == nullptr);
+
+        std::promise<std::string> p;
+        auto f = p.get_future();
+        plugin->generateAuthorizationCode("plugin-client",
+                                          "user1",
+                                          "scope1",
+                                          [&](std::string c) {
+                                              p.set_value(c);
+                                          });
+        auto code = f.get();
+
+        auto timing = std::make_shared<RequestTiming>(req, "token", false);
+        std::promise<void> p2;
+        auto f2 = p2.get_future();
+        plugin->exchangeCodeForToken(
+            code,
+            "plugin-client",
+            [&](const Json::Value &) { p2.set_value(); },
+            timing);
+        f2.get();
+
+        auto resp = drogon::HttpResponse::newHttpResponse();
+        timing->finish(resp);
+        auto header = resp->getHeader("Server-Timing");
+        CHECK(header.find("queue;dur=") == 0);
+        CHECK(header.find("exchange.consumeAuthCode;dur=") !=
+              std::string::npos);
+        CHECK(header.find("exchange.saveRefreshToken;dur=") !=
+              std::string::npos);
+        CHECK(header.find(", total;dur=") != std::string::npos);
+    }
+
+    // 12. Failed roles lookup at issue: no snapshot, roles resolved live
+    // (last: the storage stays wrapped)
+    {
+        plugin->wrapStorageForTesting(
+            [](std::unique_ptr<IOAuth2Storage> storage) {
+                return std::unique_ptr<IOAuth2Storage>(
+                    new ExpiringRolesStorage(std::move(storage)));
+            });
+
+        std::promise<std::string> p;
+        auto f = p.get_future();
+        plugin->generateAuthorizationCode("plugin-client",
+                                          "admin",
+                                          "scope1",
+                                          [&](std::string c) {
+                                              p.set_value(c);
+                                          });
+        auto code = f.get();
+
+        std::promise<Json::Value> p2;
+        auto f2 = p2.get_future();
+        plugin->exchangeCodeForToken(code,
+                                     "plugin-client",
+                                     [&](const Json::Value &v) {
+                                         p2.set_value(v);
+                                     });
+        auto res = f2.get();
+        REQUIRE(res.isMember("access_token"));
+
+        std::promise<OAuth2Plugin::AccessTokenPtr> p3;
+        auto f3 = p3.get_future();
+        plugin->validateAccessToken(
+            res["access_token"].asString(),
+            [&](OAuth2Plugin::AccessTokenPtr at) { p3.set_value(at); });
+        auto at = f3.get();
+        REQUIRE(at != nullptr);
+        CHECK(!at->roleIds.has_value());
+    }
 }
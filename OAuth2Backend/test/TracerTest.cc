@@ -0,0 +1,133 @@
+#include <drogon/drogon_test.h>
+#include "Tracer.h"
+#include <json/json.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace oauth2;
+
+DROGON_TEST(TraceContextTest)
+{
+    // 1. Round trip of a W3C traceparent
+    const std::string header =
+        "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01";
+    auto ctx = TraceContext::parse(header);
+    REQUIRE(ctx.valid());
+    CHECK(ctx.traceHi == 0x4bf92f3577b34da6ULL);
+    CHECK(ctx.traceLo == 0xa3ce929d0e0e4736ULL);
+    CHECK(ctx.spanId == 0x00f067aa0ba902b7ULL);
+    CHECK(ctx.sampled);
+    CHECK(ctx.traceparent() == header);
+
+    auto unsampled = TraceContext::parse(
+        "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-00");
+    CHECK(unsampled.valid());
+    CHECK(!unsampled.sampled);
+
+    // 2. Malformed headers are ignored
+    CHECK(!TraceContext::parse("").valid());
+    CHECK(!TraceContext::parse("garbage").valid());
+    CHECK(!TraceContext::parse(
+               "00-4BF92F3577B34DA6A3CE929D0E0E4736-00f067aa0ba902b7-01")
+               .valid());  // Upper case
+    CHECK(!TraceContext::parse(
+               "00-00000000000000000000000000000000-00f067aa0ba902b7-01")
+               .valid());  // Zero trace ID
+    CHECK(!TraceContext::parse(
+               "00-4bf92f3577b34da6a3ce929d0e0e4736-0000000000000000-01")
+               .valid());  // Zero span ID
+    CHECK(!TraceContext::parse(
+               "ff-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01")
+               .valid());  // Reserved version
+}
+
+DROGON_TEST(TracerExportTest)
+{
+    auto &tracer = Tracer::instance();
+
+    // 1. Disabled: spans and scopes are inert
+    auto parent = TraceContext::parse(
+        "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01");
+    if (!Tracer::enabled())
+    {
+        Span span("inert", SpanKind::kInternal, parent);
+        CHECK(!span.context().valid());
+        TraceScope scope(parent);
+        CHECK(!TraceScope::current().valid());
+    }
+
+    // 2. OTLP/JSON export is valid JSON
+    SpanRecord record;
+    record.context = parent;
+    record.parentSpanId = 42;
+    record.name = "getAccessToken";
+    record.kind = SpanKind::kClient;
+    record.staticKey = "db.system";
+    record.staticValue = "redis";
+    record.error = true;
+    auto json = tracer.toOtlpJson({record});
+    Json::Value root;
+    Json::Reader reader;
+    REQUIRE(reader.parse(json, root));
+    const auto &spans = root["resourceSpans"][0]["scopeSpans"][0]["spans"];
+    REQUIRE(spans.size() == 1);
+    CHECK(spans[0]["traceId"].asString() ==
+          "4bf92f3577b34da6a3ce929d0e0e4736");
+    CHECK(spans[0]["parentSpanId"].asString() == "000000000000002a");
+    CHECK(spans[0]["name"].asString() == "getAccessToken");
+    CHECK(spans[0]["kind"].asInt() == 3);
+    CHECK(spans[0]["status"]["code"].asInt() == 2);
+    CHECK(spans[0]["attributes"][0]["value"]["stringValue"].asString() ==
+          "redis");
+
+    if (Tracer::enabled())
+        return;  // Configured by the running app; leave it alone
+
+    // 3. Spans recorded under a scope are exported by flush()
+    const std::string file = "./tracer_test.jsonl";
+    std::remove(file.c_str());
+    Json::Value config;
+    config["enabled"] = true;
+    config["file"] = file;
+    config["flush_interval_ms"] = 60000;  // Flushed explicitly below
+    tracer.start(config);
+    REQUIRE(Tracer::enabled());
+    {
+        Span root("GET", SpanKind::kInternal, parent);
+        TraceScope scope(root.context());
+        // A child on another thread, tied in through the captured context
+        auto ctx = TraceScope::current();
+        std::thread([ctx]() {
+            TraceScope resumed(ctx);
+            Span child("child", SpanKind::kInternal);
+            child.setAttribute("k", "v");
+            child.end();
+        }).join();
+        root.end();
+    }
+    tracer.flush();
+    tracer.stop();
+
+    std::ifstream in(file);
+    std::string line;
+    REQUIRE(std::getline(in, line));
+    Json::Value exported;
+    REQUIRE(reader.parse(line, exported));
+    const auto &out = exported["resourceSpans"][0]["scopeSpans"][0]["spans"];
+    REQUIRE(out.size() == 2);
+    std::string childParent, rootId;
+    for (const auto &s : out)
+    {
+        CHECK(s["traceId"].asString() == "4bf92f3577b34da6a3ce929d0e0e4736");
+        if (s["name"].asString() == "child")
+            childParent = s["parentSpanId"].asString();
+        else
+            rootId = s["spanId"].asString();
+    }
+    CHECK(!rootId.empty());
+    CHECK(childParent == rootId);
+    in.close();
+    std::remove(file.c_str());
+}
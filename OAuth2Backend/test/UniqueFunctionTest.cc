@@ -0,0 +1,97 @@
+#include <drogon/drogon_test.h>
+#include "UniqueFunction.h"
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+
+using namespace oauth2;
+
+DROGON_TEST(UniqueFunctionTest)
+{
+    // 1. Move-only captures, inline and on the heap
+    {
+        auto value = std::make_unique<int>(7);
+        UniqueFunction<int(int)> small(
+            [value = std::move(value)](int x) { return *value + x; });
+        CHECK(small(1) == 8);
+
+        std::array<char, 200> big{};
+        big[0] = 3;
+        UniqueFunction<int(int)> large([big, owned = std::make_unique<int>(
+                                                 4)](int x) {
+            return big[0] + *owned + x;
+        });
+        CHECK(large(1) == 8);
+
+        auto moved = std::move(large);
+        CHECK(!large);
+        CHECK(moved(2) == 9);
+        small = std::move(moved);
+        CHECK(small(0) == 7);
+    }
+
+    // 2. Empty sources give an empty function
+    {
+        UniqueFunction<void()> none;
+        UniqueFunction<void()> null(nullptr);
+        UniqueFunction<void()> fromEmpty(std::function<void()>{});
+        void (*noFn)() = nullptr;
+        UniqueFunction<void()> fromNullPointer(noFn);
+        CHECK(!none);
+        CHECK(!null);
+        CHECK(!fromEmpty);
+        CHECK(!fromNullPointer);
+        int calls = 0;
+        UniqueFunction<void()> set(std::function<void()>([&] { ++calls; }));
+        CHECK(static_cast<bool>(set));
+        set();
+        set = nullptr;
+        CHECK(!set);
+        CHECK(calls == 1);
+    }
+
+    // 3. Captured state is destroyed exactly once, wherever it lives
+    {
+        auto tracked = std::make_shared<int>(0);
+        {
+            UniqueFunction<void()> inlined([tracked] {});
+            std::array<char, 200> big{};
+            UniqueFunction<void()> heap([tracked, big] {});
+            auto movedInline = std::move(inlined);
+            auto movedHeap = std::move(heap);
+            CHECK(tracked.use_count() == 3);
+        }
+        CHECK(tracked.use_count() == 1);
+    }
+
+    // 4. singleShot: success and error paths share one callback, first
+    // one wins
+    {
+        int calls = 0;
+        std::string seen;
+        auto done = singleShot(UniqueFunction<void(std::string)>(
+            [&](std::string s) {
+                ++calls;
+                seen = std::move(s);
+            }));
+        auto onSuccess = [done]() { done("ok"); };
+        auto onError = [done]() { done("error"); };
+        onSuccess();
+        onError();
+        onSuccess();
+        CHECK(calls == 1);
+        CHECK(seen == "ok");
+
+        // The callback is released once it has run
+        auto tracked = std::make_shared<int>(0);
+        auto release = singleShot(UniqueFunction<void()>([tracked] {}));
+        CHECK(tracked.use_count() == 2);
+        release();
+        CHECK(tracked.use_count() == 1);
+
+        // An empty callback is consumed silently
+        auto empty = singleShot(UniqueFunction<void()>());
+        empty();
+    }
+}